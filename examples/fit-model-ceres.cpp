@@ -453,8 +453,7 @@ int main(int argc, char* argv[])
             Eigen::Map<const Eigen::VectorXf>(blendshape_coeffs_float.data(), blendshape_coeffs_float.size());
     core::Mesh mesh = morphablemodel::sample_to_mesh(
         shape_ceres, morphable_model.get_color_model().draw_sample(colour_coefficients),
-        morphable_model.get_shape_model().get_triangle_list(),
-        morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+        morphable_model.get_topology());
     for (auto idx : vertex_indices)
     {
         glm::dvec3 point_3d(mesh.vertices[idx][0], mesh.vertices[idx][1],
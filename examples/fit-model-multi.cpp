@@ -295,9 +295,7 @@ int main(int argc, char *argv[])
         glm::mat4 modelview_frontal = glm::mat4(1.0);
         core::Mesh neutral_expression = morphablemodel::sample_to_mesh(
             morphable_model.get_shape_model().draw_sample(pca_shape_coefficients),
-            morphable_model.get_color_model().get_mean(),
-            morphable_model.get_shape_model().get_triangle_list(),
-            morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+            morphable_model.get_color_model().get_mean(), morphable_model.get_topology());
         std::tie(frontal_rendering, std::ignore) = render::render(
             neutral_expression, modelview_frontal, glm::ortho(-130.0f, 130.0f, -130.0f, 130.0f), 256, 256,
             render::create_mipmapped_texture(isomap), true, false, false);
@@ -324,8 +322,7 @@ int main(int argc, char *argv[])
     glm::mat4 modelview_frontal = glm::mat4(1.0);
     core::Mesh neutral_expression = morphablemodel::sample_to_mesh(
         morphable_model.get_shape_model().draw_sample(pca_shape_coefficients),
-        morphable_model.get_color_model().get_mean(), morphable_model.get_shape_model().get_triangle_list(),
-        morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+        morphable_model.get_color_model().get_mean(), morphable_model.get_topology());
     std::tie(frontal_rendering, std::ignore) =
         render::render(neutral_expression, modelview_frontal, glm::ortho(-130.0f, 130.0f, -130.0f, 130.0f),
                        512, 512, render::create_mipmapped_texture(merged_isomap), true, false, false);
@@ -0,0 +1,273 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: examples/generate-dataset.cpp
+ *
+ * Copyright 2016 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Image.hpp"
+#include "eos/core/Image_opencv_interop.hpp"
+#include "eos/core/Mesh.hpp"
+#include "eos/morphablemodel/MorphableModel.hpp"
+#include "eos/render/render.hpp"
+#include "eos/cpp17/optional.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+
+#include "boost/filesystem.hpp"
+#include "boost/program_options.hpp"
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include "Eigen/Core"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace eos;
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+using Eigen::MatrixXf;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+/**
+ * The render target and mesh of one worker thread. They are allocated once and re-used for
+ * all the samples that the thread renders.
+ */
+struct Worker
+{
+    core::Mesh mesh; ///< Has the topology of the model. Only the vertices and colours change per sample.
+    core::Image4u colorbuffer;
+    core::Image1d depthbuffer;
+};
+
+/**
+ * This app generates a synthetic dataset of random faces from the model: For every sample, it
+ * draws random shape and colour coefficients and a random head pose, renders the face, and
+ * stores the rendering as png, together with the ground-truth parameters of all samples in a
+ * csv file.
+ *
+ * The samples are generated in batches: The shape and colour instances of a whole batch are
+ * computed with one matrix-matrix product each, and the samples are then rendered on several
+ * threads, each with its own mesh and render target. At the end, the achieved number of
+ * samples per second is reported.
+ */
+int main(int argc, char* argv[])
+{
+    string model_file, output_path;
+    int num_samples, batch_size, num_threads, resolution;
+    float shape_sigma, color_sigma, max_yaw, max_pitch;
+    unsigned int seed;
+    bool write_images;
+
+    try
+    {
+        po::options_description desc("Allowed options");
+        // clang-format off
+        desc.add_options()
+            ("help", "produce help message")
+            ("model", po::value<string>(&model_file)->required(), "an eos .bin Morphable Model file")
+            ("output", po::value<string>(&output_path)->default_value("dataset"),
+                "output directory for the images and the parameters.csv file. Will be created if it doesn't "
+                "exist.")
+            ("num-samples", po::value<int>(&num_samples)->default_value(1000),
+                "number of samples to generate")
+            ("batch-size", po::value<int>(&batch_size)->default_value(256),
+                "number of samples whose coefficients are drawn and turned into model instances at once")
+            ("threads", po::value<int>(&num_threads)->default_value(
+                    static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))),
+                "number of threads to render with")
+            ("resolution", po::value<int>(&resolution)->default_value(256),
+                "width and height of the rendered images")
+            ("shape-sigma", po::value<float>(&shape_sigma)->default_value(1.0f),
+                "standard deviation of the random shape coefficients")
+            ("color-sigma", po::value<float>(&color_sigma)->default_value(1.0f),
+                "standard deviation of the random colour coefficients")
+            ("max-yaw", po::value<float>(&max_yaw)->default_value(45.0f),
+                "the yaw angle of each sample is drawn uniformly from [-max-yaw, max-yaw] degrees")
+            ("max-pitch", po::value<float>(&max_pitch)->default_value(20.0f),
+                "the pitch angle of each sample is drawn uniformly from [-max-pitch, max-pitch] degrees")
+            ("seed", po::value<unsigned int>(&seed)->default_value(0), "seed of the random number generator")
+            ("write-images", po::value<bool>(&write_images)->default_value(true),
+                "whether to store the renderings. If false, only the parameters are written, which allows to "
+                "measure the speed of the sampling and rendering alone.");
+        // clang-format on
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+        if (vm.count("help"))
+        {
+            cout << "Usage: generate-dataset [options]" << endl;
+            cout << desc;
+            return EXIT_SUCCESS;
+        }
+        po::notify(vm);
+    } catch (const po::error& e)
+    {
+        cout << "Error while parsing command-line arguments: " << e.what() << endl;
+        cout << "Use --help to display a list of options." << endl;
+        return EXIT_FAILURE;
+    }
+    if (num_samples < 1 || batch_size < 1 || num_threads < 1 || resolution < 1)
+    {
+        cout << "The number of samples, batch size, number of threads and resolution have to be positive."
+             << endl;
+        return EXIT_FAILURE;
+    }
+
+    const morphablemodel::MorphableModel morphable_model = morphablemodel::load_model(model_file);
+    const morphablemodel::PcaModel& shape_model = morphable_model.get_shape_model();
+    const morphablemodel::PcaModel& color_model = morphable_model.get_color_model();
+    const int num_shape_coefficients = shape_model.get_num_principal_components();
+    const int num_color_coefficients = color_model.get_num_principal_components();
+
+    const fs::path output_dir(output_path);
+    fs::create_directories(output_dir);
+    std::ofstream parameters_file((output_dir / "parameters.csv").string());
+    if (!parameters_file)
+    {
+        cout << "Error opening " << (output_dir / "parameters.csv").string() << " for writing." << endl;
+        return EXIT_FAILURE;
+    }
+    parameters_file << "image,yaw,pitch";
+    for (int i = 0; i < num_shape_coefficients; ++i)
+    {
+        parameters_file << ",shape_" << i;
+    }
+    for (int i = 0; i < num_color_coefficients; ++i)
+    {
+        parameters_file << ",color_" << i;
+    }
+    parameters_file << "\n";
+
+    // Each worker starts off with the mean mesh, so it has the topology and texture coordinates of the
+    // model. The same orthographic projection is used for all samples, like in generate-obj.
+    const core::Mesh mean_mesh = morphable_model.get_mean();
+    vector<Worker> workers(num_threads,
+                           Worker{mean_mesh, core::Image4u(resolution, resolution),
+                                  core::Image1d(resolution, resolution)});
+    const glm::mat4x4 projection = glm::ortho(-130.0f, 130.0f, -130.0f, 130.0f);
+
+    std::mt19937 engine(seed);
+    std::normal_distribution<float> shape_distribution(0.0f, shape_sigma);
+    std::normal_distribution<float> color_distribution(0.0f, color_sigma);
+    std::uniform_real_distribution<float> yaw_distribution(-max_yaw, max_yaw);
+    std::uniform_real_distribution<float> pitch_distribution(-max_pitch, max_pitch);
+
+    double time_sampling = 0.0; // in seconds
+    double time_rendering = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int batch_start = 0; batch_start < num_samples; batch_start += batch_size)
+    {
+        const int current_batch_size = std::min(batch_size, num_samples - batch_start);
+
+        // Draw all random numbers of the batch on this thread, so that the dataset only depends on the seed,
+        // and not on the number of threads:
+        MatrixXf shape_coefficients(num_shape_coefficients, current_batch_size);
+        MatrixXf color_coefficients(num_color_coefficients, current_batch_size);
+        vector<float> yaws(current_batch_size), pitches(current_batch_size);
+        for (int s = 0; s < current_batch_size; ++s)
+        {
+            for (int i = 0; i < num_shape_coefficients; ++i)
+            {
+                shape_coefficients(i, s) = shape_distribution(engine);
+            }
+            for (int i = 0; i < num_color_coefficients; ++i)
+            {
+                color_coefficients(i, s) = color_distribution(engine);
+            }
+            yaws[s] = yaw_distribution(engine);
+            pitches[s] = pitch_distribution(engine);
+        }
+
+        // Compute the model instances of the whole batch with one matrix-matrix product per model:
+        const auto sampling_start = std::chrono::steady_clock::now();
+        const MatrixXf shape_instances = shape_model.draw_samples(shape_coefficients);
+        // For a shape-only model, this is a matrix with zero rows, i.e. each sample gets no colour:
+        const MatrixXf color_instances = color_model.draw_samples(color_coefficients);
+        const auto sampling_end = std::chrono::steady_clock::now();
+        time_sampling += std::chrono::duration<double>(sampling_end - sampling_start).count();
+
+        // Render the batch: Each thread renders every num_threads-th sample into its own render target.
+        vector<std::future<void>> results;
+        for (int t = 0; t < num_threads; ++t)
+        {
+            results.emplace_back(std::async(std::launch::async, [&, t]() {
+                Worker& worker = workers[t];
+                for (int s = t; s < current_batch_size; s += num_threads)
+                {
+                    morphablemodel::assign_sample_to_mesh(shape_instances.col(s), color_instances.col(s),
+                                                          worker.mesh);
+                    const glm::mat4x4 pitch = glm::rotate(glm::mat4x4(1.0f), glm::radians(pitches[s]),
+                                                          glm::vec3(1.0f, 0.0f, 0.0f));
+                    const glm::mat4x4 yaw =
+                        glm::rotate(glm::mat4x4(1.0f), glm::radians(yaws[s]), glm::vec3(0.0f, 1.0f, 0.0f));
+                    render::render_into(worker.mesh, pitch * yaw, projection, worker.colorbuffer,
+                                        worker.depthbuffer, cpp17::nullopt, true, false, false);
+                    if (write_images)
+                    {
+                        std::ostringstream filename;
+                        filename << std::setw(8) << std::setfill('0') << batch_start + s << ".png";
+                        cv::imwrite((output_dir / filename.str()).string(),
+                                    core::to_mat(worker.colorbuffer));
+                    }
+                }
+            }));
+        }
+        for (auto&& r : results)
+        {
+            r.get();
+        }
+        time_rendering +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - sampling_end).count();
+
+        for (int s = 0; s < current_batch_size; ++s)
+        {
+            parameters_file << std::setw(8) << std::setfill('0') << batch_start + s << ".png"
+                            << std::setfill(' ') << "," << yaws[s] << "," << pitches[s];
+            for (int i = 0; i < num_shape_coefficients; ++i)
+            {
+                parameters_file << "," << shape_coefficients(i, s);
+            }
+            for (int i = 0; i < num_color_coefficients; ++i)
+            {
+                parameters_file << "," << color_coefficients(i, s);
+            }
+            parameters_file << "\n";
+        }
+    }
+    const double time_total =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    cout << "Generated " << num_samples << " samples in " << time_total << " s with " << num_threads
+         << " threads: " << num_samples / time_total << " samples/s." << endl;
+    cout << "Time spent computing the model instances: " << time_sampling << " s, rendering"
+         << (write_images ? " and writing the images: " : ": ") << time_rendering << " s." << endl;
+    cout << "Wrote the dataset to " << output_dir.string() << "." << endl;
+
+    return EXIT_SUCCESS;
+}
@@ -22,14 +22,93 @@
 #ifndef EOS_IMAGE_HPP_
 #define EOS_IMAGE_HPP_
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 
 namespace eos {
 namespace core {
 
+template <class T, int num_channels>
+class Image;
+
+/**
+ * @brief A non-owning view of an image with \p num_channels channels.
+ *
+ * Refers to pixels that are stored in row-major order somewhere else, e.g. in a core::Image, a
+ * cv::Mat or a numpy array. Consecutive rows start \p stride pixels apart, so a view can
+ * also refer to images whose rows are padded (e.g. for alignment), or to a region of a
+ * larger image, without copying any pixels.
+ *
+ * Use a const \p T (e.g. ImageView<const std::array<std::uint8_t, 3>, 3>) for a read-only
+ * view. The referred-to pixels must outlive the view.
+ */
+template <class T, int num_channels>
+class ImageView
+{
+public:
+    ImageView() = default;
+
+    /**
+     * Creates a view of the pixels at \p data.
+     *
+     * @param[in] data Pointer to the first pixel of the first row.
+     * @param[in] rows Number of rows.
+     * @param[in] cols Number of columns.
+     * @param[in] stride Number of pixels from the start of one row to the start of the next. Has to be >= cols.
+     */
+    ImageView(T* data, std::size_t rows, std::size_t cols, std::size_t stride)
+        : data(data), rows(rows), cols(cols), stride(stride)
+    {
+        assert(stride >= cols);
+    };
+
+    /**
+     * Creates a view of the given image.
+     */
+    ImageView(Image<typename std::remove_const<T>::type, num_channels>& image)
+        : data(image.data.data()), rows(image.rows), cols(image.cols), stride(image.cols){};
+
+    /**
+     * Creates a read-only view of the given image. Only available if T is const.
+     */
+    template <class U = T, typename std::enable_if<std::is_const<U>::value, int>::type = 0>
+    ImageView(const Image<typename std::remove_const<T>::type, num_channels>& image)
+        : data(image.data.data()), rows(image.rows), cols(image.cols), stride(image.cols){};
+
+    /**
+     * A mutable view can be used wherever a read-only view is expected.
+     */
+    template <class U = T, typename std::enable_if<std::is_const<U>::value, int>::type = 0>
+    ImageView(const ImageView<typename std::remove_const<T>::type, num_channels>& view)
+        : data(view.data), rows(view.rows), cols(view.cols), stride(view.stride){};
+
+    T& operator()(std::size_t row, std::size_t col) const
+    {
+        assert(row < rows);
+        assert(col < cols);
+        return data[col + row * stride];
+    };
+
+    /**
+     * Returns a pointer to the first pixel of the given row. The pixels of a row are contiguous.
+     */
+    T* row_ptr(std::size_t row) const
+    {
+        assert(row < rows);
+        return data + row * stride;
+    };
+
+    T* data = nullptr;
+    std::size_t rows = 0;
+    std::size_t cols = 0;
+    std::size_t stride = 0; ///< Number of pixels from the start of one row to the start of the next.
+};
+
 /**
  * @brief Representation of an image with \p num_channels channels.
  *
@@ -37,19 +116,15 @@ namespace core {
  * to represent 1 and 3-channel images. The class was mainly created to be able to
  * remove OpenCV and cv::Mat as a dependency for the core of the eos headers.
  *
- * The class currently uses col-major storage order.
- *
- * Note: Ideally we'd have a template param for row and col major too?
- *       And then we could do stuff like strides and all too but then we'd end up with a matrix class like Eigen::Matrix...?
- *       It means we probably can't accept ROI's from Python into larger images without copying, but doesn't matter.
- *       Also what about vector<Eigen::Matrix>(num_channels)? But having an own type would be good?
+ * The class uses row-major storage order, with the channels of each pixel interleaved,
+ * like cv::Mat and numpy. The rows are stored contiguously, without padding, so
+ * \c data(r, c) is at \c data[c + r * cols]. To refer to pixels that are stored
+ * elsewhere, e.g. in a cv::Mat with padded rows, or in a numpy array, without copying
+ * them, use an ImageView.
  */
 template <class T, int num_channels>
 class Image
 {
-    // we store RGB RGB RGB ... col or rows first? Do the same as Eigen:col-major?
-    // numpy: 'f' = fortran = col-major
-    //        'c' = c = row-major = default I think.
 public:
     // using element_type = T;
 
@@ -57,73 +132,82 @@ public:
 
     Image(std::size_t rows, std::size_t cols) : rows(rows), cols(cols)
     {
-        // Question: Encode the channel into the plain array or not?
-        // data.reserve(rows * cols * num_channels);
-        // data.reserve(rows * cols);
         data.resize(rows * cols); // This actually zero-initialises, with std::array<>.
     };
 
-    // We can't just return T. Should be T* to return RGB or RGBA?
-    // And actually we may want to return a reference, or not? Well, it's only 1-4 values, we can copy them?
-    // But this must also act as a setter actually! So needs to return a reference? And a const& overload?
-    // Can we do a operator<>()? But we don't need it as in comparison to OpenCV, we know the type at compile
-    // time...
-    // hmm... SFINAE with num_channels == 1 or something?
-    // => I'm over-engineering. Go for simple solution first!
+    /**
+     * Creates an image with a copy of the pixels of the given view.
+     */
+    explicit Image(const ImageView<const T, num_channels>& view) : rows(view.rows), cols(view.cols)
+    {
+        data.resize(rows * cols);
+        for (std::size_t r = 0; r < rows; ++r)
+        {
+            std::copy(view.row_ptr(r), view.row_ptr(r) + cols, data.begin() + r * cols);
+        }
+    };
+
     // If we use array<uint8_t, 3> as type T for a 3-channel image, then this operator works out of the box.
     T& operator()(std::size_t row, std::size_t col)
     {
         assert(row < rows);
         assert(col < cols);
-        assert(row + col * rows < data.size());
-        return data[row + col * rows]; // Col-major for now.
-        // return data[col + row * cols]; // Ok, switching to row-major, to test with numpy.
-        /*
-         * [a b c]
-         * [d e f]
-         * // => [a d b e c f]
-         *
-         * (0, 0) => a
-         * (0, 1) => b
-         * (1, 0) => d
-         * (1, 2) => f
-         */
+        assert(col + row * cols < data.size());
+        return data[col + row * cols]; // Row-major, like cv::Mat and numpy.
     };
 
     const T& operator()(std::size_t row, std::size_t col) const
     {
         assert(row < rows);
         assert(col < cols);
-        assert(row + col * rows < data.size());
-        return data[row + col * rows]; // Col-major for now.
-        // return data[col + row * cols]; // Ok, switching to row-major, to test with numpy.
+        assert(col + row * cols < data.size());
+        return data[col + row * cols];
     };
 
-    /*	static Image<T, num_channels> zeros(std::size_t rows, std::size_t cols)
-            {
-                    Image<T, num_channels> image(rows, cols);
-                    for (int c=0; c < image.cols; ++c) {
-                            for (int r = 0; r < image.rows; ++r) {
-                                    image(r, c) = T{ 1 }; // Does this create an std::array with all zeros,
-       like we expect? No it doesn't, it only sets the first component to 0, and leaves the rest.
-                            }
-                    }
-                    return image;
-            }; */
+    /**
+     * Returns the number of pixels from the start of one row to the start of the next.
+     * The rows of an Image are not padded, so this is always equal to the number of columns.
+     */
+    std::size_t stride() const
+    {
+        return cols;
+    };
 
     // private:
-    std::vector<T> data;  // Maybe not too ideal, see the zeros(...) function. Should rather encode [RGB...]
-                          // etc in here too, directly. Maybe.
+    std::vector<T> data;  // Maybe not too ideal. Should rather encode [RGB...] etc in here too, directly.
     std::size_t rows = 0; // nobody should be able to set these directly, so.. yea... private.
     std::size_t cols = 0;
-    // Maybe array_view (span) is the way to go...? But nothing coming to the standard anytime soon...
 };
 
 // Note: The num_channels number needs to be repeated, not so nice.
 using Image1u = Image<std::uint8_t, 1>;
 using Image3u = Image<std::array<std::uint8_t, 3>, 3>;
 using Image4u = Image<std::array<std::uint8_t, 4>, 4>;
+using Image1f = Image<float, 1>;
 using Image1d = Image<double, 1>;
+using Image1i = Image<std::int32_t, 1>;
+using Image3f = Image<std::array<float, 3>, 3>;
+
+using ImageView1u = ImageView<std::uint8_t, 1>;
+using ImageView3u = ImageView<std::array<std::uint8_t, 3>, 3>;
+using ImageView4u = ImageView<std::array<std::uint8_t, 4>, 4>;
+using ImageView1f = ImageView<float, 1>;
+using ImageView1d = ImageView<double, 1>;
+
+using ConstImageView3u = ImageView<const std::array<std::uint8_t, 3>, 3>;
+using ConstImageView4u = ImageView<const std::array<std::uint8_t, 4>, 4>;
+
+/**
+ * Sets all pixels of the given view to \p value, row by row.
+ */
+template <class T, int num_channels>
+void fill(const ImageView<T, num_channels>& view, const T& value)
+{
+    for (std::size_t r = 0; r < view.rows; ++r)
+    {
+        std::fill(view.row_ptr(r), view.row_ptr(r) + view.cols, value);
+    }
+};
 
 } /* namespace core */
 } /* namespace eos */
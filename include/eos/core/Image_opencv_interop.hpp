@@ -27,54 +27,122 @@
 #include "opencv2/core/core.hpp"
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <stdexcept>
+#include <type_traits>
 
 namespace eos {
 namespace core {
 
-// We can support different types by making this a template and constexpr if? :-)
-inline cv::Mat to_mat(const Image4u& image)
+namespace detail {
+
+/**
+ * The OpenCV type (e.g. CV_8UC3) that corresponds to the pixel type T of an eos::core::Image.
+ */
+template <class T>
+struct OpenCVType;
+template <>
+struct OpenCVType<std::uint8_t>
+{
+    static constexpr int value = CV_8UC1;
+};
+template <>
+struct OpenCVType<std::array<std::uint8_t, 3>>
+{
+    static constexpr int value = CV_8UC3;
+};
+template <>
+struct OpenCVType<std::array<std::uint8_t, 4>>
+{
+    static constexpr int value = CV_8UC4;
+};
+template <>
+struct OpenCVType<float>
+{
+    static constexpr int value = CV_32FC1;
+};
+template <>
+struct OpenCVType<double>
 {
-    cv::Mat opencv_matrix(static_cast<int>(image.rows), static_cast<int>(image.cols), CV_8UC4);
-    for (int c = 0; c < image.cols; ++c)
-    { // size_t
-        for (int r = 0; r < image.rows; ++r)
-        {
-            // auto vals = image(r, c);
-            opencv_matrix.at<cv::Vec4b>(r, c) =
-                cv::Vec4b(image(r, c)[0], image(r, c)[1], image(r, c)[2], image(r, c)[3]);
-        }
+    static constexpr int value = CV_64FC1;
+};
+
+} /* namespace detail */
+
+/**
+ * Wraps the pixels of the given view in a cv::Mat header, without copying them.
+ *
+ * The cv::Mat refers to the same pixels as the view, so they must outlive it. If the view is
+ * read-only, the cv::Mat must not be written to.
+ *
+ * @param[in] image_view A view of an image.
+ * @return A cv::Mat that refers to the pixels of the view.
+ */
+template <class T, int num_channels>
+cv::Mat to_mat_view(const ImageView<T, num_channels>& image_view)
+{
+    using PixelType = typename std::remove_const<T>::type;
+    return cv::Mat(static_cast<int>(image_view.rows), static_cast<int>(image_view.cols),
+                   detail::OpenCVType<PixelType>::value, const_cast<PixelType*>(image_view.data),
+                   image_view.stride * sizeof(PixelType));
+};
+
+/**
+ * Wraps the pixels of the given image in a cv::Mat header, without copying them.
+ *
+ * The cv::Mat refers to the pixels of the image, so the image must outlive it, and must not
+ * be resized while the cv::Mat is in use.
+ *
+ * @param[in] image An image.
+ * @return A cv::Mat that refers to the pixels of the image.
+ */
+template <class T, int num_channels>
+cv::Mat to_mat_view(Image<T, num_channels>& image)
+{
+    return to_mat_view(ImageView<T, num_channels>(image));
+};
+
+/**
+ * Wraps the pixels of the given cv::Mat in an ImageView, without copying them.
+ *
+ * The view type has to be given explicitly, e.g. from_mat_view<ImageView3u>(mat), and its
+ * pixel type has to match the type of the cv::Mat (e.g. CV_8UC3). The cv::Mat may have padded
+ * rows, e.g. if it is a region of a larger cv::Mat.
+ *
+ * @param[in] mat A cv::Mat of the type that corresponds to the pixel type of \p ImageViewType.
+ * @return A view that refers to the pixels of the cv::Mat.
+ * @throws std::runtime_error if the type of the cv::Mat doesn't match the pixel type of the view.
+ */
+template <class ImageViewType>
+ImageViewType from_mat_view(const cv::Mat& mat)
+{
+    using T = typename std::remove_pointer<decltype(ImageViewType::data)>::type;
+    using PixelType = typename std::remove_const<T>::type;
+    if (mat.type() != detail::OpenCVType<PixelType>::value || mat.step[0] % sizeof(PixelType) != 0)
+    {
+        throw std::runtime_error("The type of the cv::Mat doesn't match the pixel type of the image view.");
     }
-    return opencv_matrix;
+    return ImageViewType(reinterpret_cast<T*>(mat.data), mat.rows, mat.cols,
+                         mat.step[0] / sizeof(PixelType));
+};
+
+// The conversions below copy the pixels. Both cv::Mat and eos::core::Image store them in row-major order, so
+// this is one memcpy per row.
+
+inline cv::Mat to_mat(const Image4u& image)
+{
+    return to_mat_view(ImageView<const std::array<std::uint8_t, 4>, 4>(image)).clone();
 };
 
 inline cv::Mat to_mat(const Image1d& image)
 {
-    cv::Mat opencv_matrix(static_cast<int>(image.rows), static_cast<int>(image.cols), CV_64FC1);
-    for (int c = 0; c < image.cols; ++c)
-    { // size_t
-        for (int r = 0; r < image.rows; ++r)
-        {
-            // auto vals = image(r, c);
-            opencv_matrix.at<double>(r, c) = image(r, c);
-        }
-    }
-    return opencv_matrix;
+    return to_mat_view(ImageView<const double, 1>(image)).clone();
 };
 
 inline cv::Mat to_mat(const Image1u& image)
 {
-    cv::Mat opencv_matrix(static_cast<int>(image.rows), static_cast<int>(image.cols), CV_8UC1);
-    for (int c = 0; c < image.cols; ++c)
-    { // size_t
-        for (int r = 0; r < image.rows; ++r)
-        {
-            // auto vals = image(r, c);
-            opencv_matrix.at<unsigned char>(r, c) = image(r, c);
-        }
-    }
-    return opencv_matrix;
+    return to_mat_view(ImageView<const std::uint8_t, 1>(image)).clone();
 };
 
 inline Image3u from_mat(const cv::Mat& image)
@@ -83,17 +151,7 @@ inline Image3u from_mat(const cv::Mat& image)
     {
         throw std::runtime_error("Can only convert a CV_8UC3 cv::Mat to an eos::core::Image3u.");
     }
-
-    Image3u converted(image.rows, image.cols);
-    for (int r = 0; r < image.rows; ++r)
-    {
-        for (int c = 0; c < image.cols; ++c)
-        {
-            converted(r, c) = std::array<std::uint8_t, 3>{
-                image.at<cv::Vec3b>(r, c)[0], image.at<cv::Vec3b>(r, c)[1], image.at<cv::Vec3b>(r, c)[2]};
-        }
-    }
-    return converted;
+    return Image3u(from_mat_view<ImageView<const std::array<std::uint8_t, 3>, 3>>(image));
 };
 
 } /* namespace core */
@@ -0,0 +1,149 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/MemoryMappedFile.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_MEMORYMAPPEDFILE_HPP_
+#define EOS_MEMORYMAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EOS_HAVE_MMAP
+#endif
+
+namespace eos {
+namespace core {
+
+/**
+ * A file that is mapped read-only into memory.
+ *
+ * On platforms without mmap, the file is read into a buffer instead, so it can still be used,
+ * but isn't shared with other processes and is read completely when it is opened.
+ */
+class MemoryMappedFile
+{
+public:
+    /**
+     * Maps the given file into memory.
+     *
+     * @param[in] filename Filename of the file to map.
+     * @throw std::runtime_error When the file can't be opened or mapped.
+     */
+    explicit MemoryMappedFile(const std::string& filename)
+    {
+#ifdef EOS_HAVE_MMAP
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            throw std::runtime_error("Error opening given file: " + filename);
+        }
+        struct stat file_status;
+        if (::fstat(fd, &file_status) == -1)
+        {
+            ::close(fd);
+            throw std::runtime_error("Error reading the size of the given file: " + filename);
+        }
+        file_size = static_cast<std::size_t>(file_status.st_size);
+        if (file_size > 0) // mmap doesn't map empty files
+        {
+            void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Error mapping given file into memory: " + filename);
+            }
+            file_data = static_cast<const char*>(mapping);
+        }
+        ::close(fd); // The mapping stays valid after closing the file.
+#else
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            throw std::runtime_error("Error opening given file: " + filename);
+        }
+        file_size = static_cast<std::size_t>(file.tellg());
+        // Allocate in 64-byte aligned blocks, so that aligned data in the file is aligned in memory too:
+        buffer.resize((file_size + sizeof(AlignedBlock) - 1) / sizeof(AlignedBlock));
+        file.seekg(0);
+        if (!file.read(reinterpret_cast<char*>(buffer.data()), file_size))
+        {
+            throw std::runtime_error("Error reading given file: " + filename);
+        }
+        file_data = reinterpret_cast<const char*>(buffer.data());
+#endif
+    };
+
+    ~MemoryMappedFile()
+    {
+#ifdef EOS_HAVE_MMAP
+        if (file_data)
+        {
+            ::munmap(const_cast<char*>(file_data), file_size);
+        }
+#endif
+    };
+
+    MemoryMappedFile(const MemoryMappedFile&) = delete;
+    MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+    /**
+     * Returns a pointer to the contents of the file, or nullptr if the file is empty.
+     *
+     * @return The contents of the file.
+     */
+    const char* data() const
+    {
+        return file_data;
+    };
+
+    /**
+     * Returns the size of the file in bytes.
+     *
+     * @return The size of the file.
+     */
+    std::size_t size() const
+    {
+        return file_size;
+    };
+
+private:
+    const char* file_data = nullptr;
+    std::size_t file_size = 0;
+#ifndef EOS_HAVE_MMAP
+    struct alignas(64) AlignedBlock
+    {
+        char bytes[64];
+    };
+    std::vector<AlignedBlock> buffer;
+#endif
+};
+
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_MEMORYMAPPEDFILE_HPP_ */
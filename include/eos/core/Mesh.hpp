@@ -22,11 +22,18 @@
 #ifndef EOS_MESH_HPP_
 #define EOS_MESH_HPP_
 
+#include "eos/core/MeshTopology.hpp"
+#include "eos/core/VertexBuffer.hpp"
+#include "eos/core/detail/BufferedWriter.hpp"
+
 #include "Eigen/Core"
 
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <fstream>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -39,79 +46,162 @@ namespace core {
  *
  * Additionally it stores the indices that specify which vertices
  * to use to generate the triangle mesh out of the vertices.
+ *
+ * The triangles and texture coordinates are the same for all meshes of a model, and are stored in a
+ * MeshTopology that the meshes share. Only the vertices and colours belong to each mesh. They are
+ * each stored in one contiguous buffer, in the layout of the PCA model instances, see VertexBuffer.
+ * mesh.vertices[i] is a copy of the i-th vertex; to change a vertex in place, use
+ * mesh.vertices.set(i, v) or mesh.vertices.mutable_vertex(i).
  */
 struct Mesh
 {
-    std::vector<Eigen::Vector3f> vertices;  ///< 3D vertex positions.
-    std::vector<Eigen::Vector3f> colors;    ///< Colour information for each vertex. Expected to be in RGB order.
-    std::vector<Eigen::Vector2f> texcoords; ///< Texture coordinates for each vertex.
+    VertexBuffer vertices; ///< 3D vertex positions.
+    VertexBuffer colors;   ///< Colour information for each vertex. Expected to be in RGB order.
 
-    std::vector<std::array<int, 3>> tvi;    ///< Triangle vertex indices
-    std::vector<std::array<int, 3>> tci;    ///< Triangle color indices
+    std::shared_ptr<const MeshTopology> topology; ///< Triangles and texture coordinates. May be null if the
+                                                  ///< mesh has none.
+
+    /**
+     * Overwrites the vertex positions with the given shape, e.g. a new instance of the shape model
+     * in every iteration of a fitting. If the number of vertices stays the same, the existing buffer
+     * is overwritten, without allocating.
+     *
+     * @param[in] shape_instance The new vertex positions, x0 y0 z0 x1 y1 z1 ...
+     */
+    void update_vertices(const Eigen::Ref<const Eigen::VectorXf>& shape_instance)
+    {
+        vertices.assign(shape_instance);
+    };
+
+    /**
+     * Returns the topology of the mesh, or an empty topology if the mesh doesn't have one.
+     *
+     * @return The topology of the mesh.
+     */
+    const MeshTopology& get_topology() const
+    {
+        static const MeshTopology empty_topology;
+        return topology ? *topology : empty_topology;
+    };
+
+    /**
+     * Returns the triangle vertex indices.
+     *
+     * @return The triangle vertex indices.
+     */
+    const std::vector<std::array<int, 3>>& tvi() const
+    {
+        return get_topology().tvi;
+    };
+
+    /**
+     * Returns the triangle colour indices.
+     *
+     * @return The triangle colour indices.
+     */
+    const std::vector<std::array<int, 3>>& tci() const
+    {
+        return get_topology().tci;
+    };
+
+    /**
+     * Returns the texture coordinates for each vertex. Their origin is in the top-left corner,
+     * see MeshTopology::texcoords.
+     *
+     * @return The texture coordinates, or an empty vector if the mesh has none.
+     */
+    const std::vector<Eigen::Vector2f>& texcoords() const
+    {
+        return get_topology().texcoords;
+    };
 };
 
+namespace detail {
+
+/**
+ * Writes the "v" lines of an obj file, with vertex colours if the mesh has them.
+ */
+inline void write_obj_vertices(BufferedWriter& obj_file, const Mesh& mesh)
+{
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        obj_file.write("v ", 2);
+        obj_file.write_float(mesh.vertices[i][0]);
+        obj_file.write(' ');
+        obj_file.write_float(mesh.vertices[i][1]);
+        obj_file.write(' ');
+        obj_file.write_float(mesh.vertices[i][2]);
+        if (!mesh.colors.empty())
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                obj_file.write(' ');
+                obj_file.write_float(mesh.colors[i][c]);
+            }
+        }
+        obj_file.write('\n');
+    }
+};
+
+} /* namespace detail */
+
 /**
  * @brief Writes the given Mesh to an obj file that for example can be read by MeshLab.
  *
  * If the mesh contains vertex colour information, it will be written to the obj as well.
+ * Texture coordinates are written with the origin in the bottom-left corner, like obj files
+ * expect, i.e. as (u, 1 - v). read_obj(...) flips them back.
  *
  * @param[in] mesh The mesh to save as obj.
  * @param[in] filename Output filename (including ".obj").
  */
-inline void write_obj(Mesh mesh, std::string filename)
+inline void write_obj(const Mesh& mesh, std::string filename)
 {
     assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
 
-    std::ofstream obj_file(filename);
-
-    if (mesh.colors.empty())
-    {
-        for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
-        {
-            obj_file << "v " << mesh.vertices[i][0] << " " << mesh.vertices[i][1] << " "
-                     << mesh.vertices[i][2] << std::endl;
-        }
-    } else
-    {
-        for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
-        {
-            obj_file << "v " << mesh.vertices[i][0] << " " << mesh.vertices[i][1] << " "
-                     << mesh.vertices[i][2] << " " << mesh.colors[i][0] << " " << mesh.colors[i][1] << " "
-                     << mesh.colors[i][2] << std::endl;
-        }
-    }
+    detail::BufferedWriter obj_file(filename);
+    detail::write_obj_vertices(obj_file, mesh);
 
-    if (!mesh.texcoords.empty())
+    for (auto&& tc : mesh.texcoords())
     {
-        for (auto&& tc : mesh.texcoords)
-        {
-            obj_file << "vt " << tc[0] << " " << tc[1] << std::endl;
-        }
+        // We invert y because the obj uv origin (0, 0) is on the bottom-left
+        obj_file.write("vt ", 3);
+        obj_file.write_float(tc[0]);
+        obj_file.write(' ');
+        obj_file.write_float(1.0f - tc[1]);
+        obj_file.write('\n');
     }
 
-    for (auto&& v : mesh.tvi)
+    for (auto&& v : mesh.tvi())
     {
         // Add one because obj starts counting triangle indices at 1
-        obj_file << "f " << v[0] + 1 << " " << v[1] + 1 << " " << v[2] + 1 << std::endl;
+        obj_file.write("f ", 2);
+        obj_file.write_int(v[0] + 1);
+        obj_file.write(' ');
+        obj_file.write_int(v[1] + 1);
+        obj_file.write(' ');
+        obj_file.write_int(v[2] + 1);
+        obj_file.write('\n');
     }
 
-    return;
+    obj_file.close();
 }
 
 /**
  * @brief Writes an obj file of the given Mesh, including texture coordinates,
  * and an mtl file containing a reference to the isomap.
  *
- * The obj will contain texture coordinates for the mesh, and the
+ * The obj will contain texture coordinates for the mesh, with the origin in the
+ * bottom-left corner, like write_obj(...), and the
  * mtl file will link to a file named <filename>.isomap.png.
  * Note that the texture (isomap) has to be saved separately.
  *
  * @param[in] mesh The mesh to save as obj.
  * @param[in] filename Output filename, including .obj.
  */
-inline void write_textured_obj(Mesh mesh, std::string filename)
+inline void write_textured_obj(const Mesh& mesh, std::string filename)
 {
-    assert((mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty()) && !mesh.texcoords.empty());
+    assert((mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty()) && !mesh.texcoords().empty());
 
     if (filename.at(filename.size() - 4) != '.')
     {
@@ -130,49 +220,44 @@ inline void write_textured_obj(Mesh mesh, std::string filename)
         return path.substr(last_slash + 1, path.size());
     };
 
-    std::ofstream obj_file(filename);
+    detail::BufferedWriter obj_file(filename);
 
     std::string mtl_filename(filename);
     // replace '.obj' at the end with '.mtl':
     mtl_filename.replace(std::end(mtl_filename) - 4, std::end(mtl_filename), ".mtl");
 
-    obj_file << "mtllib " << get_filename(mtl_filename) << std::endl; // first line of the obj file
+    obj_file.write("mtllib " + get_filename(mtl_filename) + "\n"); // first line of the obj file
 
-    // same as in write_obj():
-    if (mesh.colors.empty())
-    {
-        for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
-        {
-            obj_file << "v " << mesh.vertices[i][0] << " " << mesh.vertices[i][1] << " "
-                     << mesh.vertices[i][2] << " " << std::endl;
-        }
-    } else
-    {
-        for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
-        {
-            obj_file << "v " << mesh.vertices[i][0] << " " << mesh.vertices[i][1] << " "
-                     << mesh.vertices[i][2] << " " << mesh.colors[i][0] << " " << mesh.colors[i][1] << " "
-                     << mesh.colors[i][2] << " " << std::endl;
-        }
-    }
-    // end
+    detail::write_obj_vertices(obj_file, mesh);
 
-    for (std::size_t i = 0; i < mesh.texcoords.size(); ++i)
+    for (std::size_t i = 0; i < mesh.texcoords().size(); ++i)
     {
-        obj_file << "vt " << mesh.texcoords[i][0] << " " << 1.0f - mesh.texcoords[i][1] << std::endl;
         // We invert y because Meshlab's uv origin (0, 0) is on the bottom-left
+        obj_file.write("vt ", 3);
+        obj_file.write_float(mesh.texcoords()[i][0]);
+        obj_file.write(' ');
+        obj_file.write_float(1.0f - mesh.texcoords()[i][1]);
+        obj_file.write('\n');
     }
 
-    obj_file << "usemtl FaceTexture" << std::endl; // the name of our texture (material) will be 'FaceTexture'
+    obj_file.write("usemtl FaceTexture\n"); // the name of our texture (material) will be 'FaceTexture'
 
-    for (auto&& v : mesh.tvi)
+    for (auto&& v : mesh.tvi())
     {
         // This assumes mesh.texcoords.size() == mesh.vertices.size(). The texture indices could theoretically be different (for example in the cube-mapped 3D scan).
         // Add one because obj starts counting triangle indices at 1
-        obj_file << "f " << v[0] + 1 << "/" << v[0] + 1 << " " << v[1] + 1 << "/" << v[1] + 1 << " "
-                 << v[2] + 1 << "/" << v[2] + 1 << std::endl;
+        obj_file.write("f ", 2);
+        for (int j = 0; j < 3; ++j)
+        {
+            obj_file.write_int(v[j] + 1);
+            obj_file.write('/');
+            obj_file.write_int(v[j] + 1);
+            obj_file.write(j < 2 ? ' ' : '\n');
+        }
     }
 
+    obj_file.close();
+
     std::ofstream mtl_file(mtl_filename);
     std::string texture_filename(filename);
     // replace '.obj' at the end with '.isomap.png':
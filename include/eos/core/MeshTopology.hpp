@@ -0,0 +1,62 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/MeshTopology.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_MESH_TOPOLOGY_HPP_
+#define EOS_MESH_TOPOLOGY_HPP_
+
+#include "Eigen/Core"
+
+#include <array>
+#include <vector>
+
+namespace eos {
+namespace core {
+
+/**
+ * @brief The part of a mesh that is the same for all meshes of a model: The triangles, the
+ * texture coordinates, and optionally the edge topology.
+ *
+ * A Mesh references its topology through a std::shared_ptr<const MeshTopology>, so all the meshes
+ * that are created from a model, e.g. in every iteration of a fitting or every frame of a video,
+ * share one topology instead of each having a copy of the triangle lists. A topology is never
+ * modified once it is shared: To change the triangles of a mesh, create a new topology.
+ */
+struct MeshTopology
+{
+    std::vector<std::array<int, 3>> tvi;    ///< Triangle vertex indices
+    std::vector<std::array<int, 3>> tci;    ///< Triangle color indices
+    /// Texture coordinates for each vertex, in [0, 1], with the origin in the top-left corner of
+    /// the texture, like the rows and columns of an image (and like glTF). Obj and ply files have
+    /// the origin in the bottom-left corner, so the readers and writers flip the second coordinate.
+    std::vector<Eigen::Vector2f> texcoords;
+
+    /// Optional: For each edge of the mesh, the two faces adjacent to it, in the format of
+    /// morphablemodel::EdgeTopology (i.e. 1-based). Empty if the topology has no edge information.
+    std::vector<std::array<int, 2>> adjacent_faces;
+    /// Optional: For each edge of the mesh, its two vertices, in the format of
+    /// morphablemodel::EdgeTopology (i.e. 1-based). Empty if the topology has no edge information.
+    std::vector<std::array<int, 2>> adjacent_vertices;
+};
+
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_MESH_TOPOLOGY_HPP_ */
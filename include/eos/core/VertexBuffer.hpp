@@ -0,0 +1,278 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/VertexBuffer.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_VERTEX_BUFFER_HPP_
+#define EOS_VERTEX_BUFFER_HPP_
+
+#include "Eigen/Core"
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace eos {
+namespace core {
+
+namespace detail {
+
+/**
+ * Iterates over the vertices of a VertexBuffer. Dereferencing gives a copy of the vertex, like
+ * VertexBuffer::operator[](std::size_t) const.
+ */
+template <class Buffer>
+class VertexBufferIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Eigen::Vector3f;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = const Eigen::Vector3f;
+
+    VertexBufferIterator(Buffer* buffer, std::size_t index) : buffer(buffer), index(index){};
+
+    reference operator*() const
+    {
+        return (*buffer)[index];
+    };
+
+    VertexBufferIterator& operator++()
+    {
+        ++index;
+        return *this;
+    };
+
+    VertexBufferIterator operator++(int)
+    {
+        VertexBufferIterator previous = *this;
+        ++index;
+        return previous;
+    };
+
+    bool operator==(const VertexBufferIterator& other) const
+    {
+        return index == other.index;
+    };
+
+    bool operator!=(const VertexBufferIterator& other) const
+    {
+        return index != other.index;
+    };
+
+private:
+    Buffer* buffer;
+    std::size_t index;
+};
+
+} /* namespace detail */
+
+/**
+ * @brief Three floats per vertex, e.g. the positions or colours of a mesh, stored in one
+ * contiguous, aligned buffer in the order x0 y0 z0 x1 y1 z1 ...
+ *
+ * This is the layout of the instances of a PcaModel, so a sample of a model can be moved into a
+ * VertexBuffer, or copied over an existing one, without repacking it vertex by vertex. The whole
+ * buffer can be used as a 3 x N matrix with as_matrix(), e.g. to transform all vertices with one
+ * matrix product.
+ *
+ * For the code that works with single vertices, the buffer can be read like a
+ * std::vector<Eigen::Vector3f>: buffer[i], and iterating over the buffer, give a copy of a vertex,
+ * as a const Eigen::Vector3f. So `auto v = buffer[i]; v += offset;` changes the copy only, and
+ * `buffer[i] = v` doesn't compile. To change a vertex in place, use buffer.set(i, v), or
+ * buffer.mutable_vertex(i), which is a view into the buffer.
+ */
+class VertexBuffer
+{
+public:
+    using MutableReference = Eigen::VectorBlock<Eigen::VectorXf, 3>;
+    using const_iterator = detail::VertexBufferIterator<const VertexBuffer>;
+    using iterator = const_iterator;
+
+    VertexBuffer() = default;
+
+    /**
+     * Creates a buffer that takes over the given values, without copying them if an rvalue is given.
+     *
+     * @param[in] values Three values per vertex, x0 y0 z0 x1 y1 z1 ...
+     */
+    explicit VertexBuffer(Eigen::VectorXf values) : values(std::move(values))
+    {
+        assert(this->values.size() % 3 == 0);
+    };
+
+    /**
+     * Creates a buffer with a copy of the given vertices.
+     *
+     * @param[in] vertices The vertices.
+     */
+    VertexBuffer(const std::vector<Eigen::Vector3f>& vertices) : values(3 * vertices.size())
+    {
+        for (std::size_t i = 0; i < vertices.size(); ++i)
+        {
+            set(i, vertices[i]);
+        }
+    };
+
+    std::size_t size() const
+    {
+        return static_cast<std::size_t>(values.size() / 3);
+    };
+
+    bool empty() const
+    {
+        return values.size() == 0;
+    };
+
+    /**
+     * Changes the number of vertices. The values of the vertices that are kept are preserved, the
+     * values of new vertices are uninitialised.
+     *
+     * @param[in] num_vertices The new number of vertices.
+     */
+    void resize(std::size_t num_vertices)
+    {
+        values.conservativeResize(3 * num_vertices);
+    };
+
+    void clear()
+    {
+        values.resize(0);
+    };
+
+    /**
+     * Returns a copy of the given vertex. It's const, so that assigning to it, which wouldn't
+     * change the buffer, doesn't compile. Use set(...) or mutable_vertex(...) to change a vertex.
+     *
+     * @param[in] index The index of the vertex.
+     * @return A copy of the vertex.
+     */
+    const Eigen::Vector3f operator[](std::size_t index) const
+    {
+        return values.segment<3>(3 * index);
+    };
+
+    /**
+     * Overwrites the given vertex.
+     *
+     * @param[in] index The index of the vertex.
+     * @param[in] vertex The new value of the vertex.
+     */
+    void set(std::size_t index, const Eigen::Vector3f& vertex)
+    {
+        values.segment<3>(3 * index) = vertex;
+    };
+
+    /**
+     * Returns a view of the given vertex, through which it can be changed in place, e.g.
+     * buffer.mutable_vertex(i) += offset. Unlike operator[], the view refers to the buffer, so
+     * `auto v = buffer.mutable_vertex(i); v += offset;` changes the buffer too, and the view is
+     * invalidated when the buffer is resized or assigned to.
+     *
+     * @param[in] index The index of the vertex.
+     * @return A 3-element Eigen block of the buffer.
+     */
+    MutableReference mutable_vertex(std::size_t index)
+    {
+        return values.segment<3>(3 * index);
+    };
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, 0);
+    };
+
+    const_iterator end() const
+    {
+        return const_iterator(this, size());
+    };
+
+    /**
+     * Overwrites the buffer with the given values. If the number of vertices is the same as
+     * before, they are copied into the existing buffer, without allocating.
+     *
+     * @param[in] new_values Three values per vertex, x0 y0 z0 x1 y1 z1 ...
+     */
+    void assign(const Eigen::Ref<const Eigen::VectorXf>& new_values)
+    {
+        assert(new_values.size() % 3 == 0);
+        values = new_values;
+    };
+
+    /**
+     * Returns the buffer as a 3 x N matrix, with one vertex per column.
+     *
+     * @return A map of the buffer.
+     */
+    Eigen::Map<Eigen::Matrix3Xf, Eigen::AlignedMax> as_matrix()
+    {
+        return Eigen::Map<Eigen::Matrix3Xf, Eigen::AlignedMax>(values.data(), 3, values.size() / 3);
+    };
+
+    Eigen::Map<const Eigen::Matrix3Xf, Eigen::AlignedMax> as_matrix() const
+    {
+        return Eigen::Map<const Eigen::Matrix3Xf, Eigen::AlignedMax>(values.data(), 3, values.size() / 3);
+    };
+
+    /**
+     * Returns the buffer as one vector, x0 y0 z0 x1 y1 z1 ..., like the instances of a PcaModel.
+     *
+     * @return The values of the buffer.
+     */
+    const Eigen::VectorXf& as_vector() const
+    {
+        return values;
+    };
+
+    float* data()
+    {
+        return values.data();
+    };
+
+    const float* data() const
+    {
+        return values.data();
+    };
+
+    /**
+     * Returns a copy of the vertices as a std::vector, e.g. for the bindings to other languages.
+     *
+     * @return The vertices.
+     */
+    std::vector<Eigen::Vector3f> to_vector() const
+    {
+        std::vector<Eigen::Vector3f> vertices(size());
+        for (std::size_t i = 0; i < vertices.size(); ++i)
+        {
+            vertices[i] = (*this)[i];
+        }
+        return vertices;
+    };
+
+private:
+    Eigen::VectorXf values; ///< Three values per vertex. Eigen allocates it aligned for vectorisation.
+};
+
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_VERTEX_BUFFER_HPP_ */
@@ -0,0 +1,301 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/detail/BufferedWriter.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_BUFFERED_WRITER_HPP_
+#define EOS_BUFFERED_WRITER_HPP_
+
+#include <cstddef>
+#include <algorithm>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+
+/**
+ * Implementations of internal functions, not part of the
+ * API we expose and not meant to be used by a user.
+ */
+namespace eos {
+namespace core {
+namespace detail {
+
+/**
+ * The maximum number of characters that format_float(...) writes.
+ */
+constexpr std::size_t max_formatted_float_length = 32;
+
+/**
+ * Writes the shortest decimal representation of the given float that reads back as the same
+ * value, like "0.1" or "-1.2345678e-05", without a terminating null character.
+ *
+ * Uses std::to_chars if the standard library supports it for floating point types, and falls
+ * back to std::snprintf with 9 significant digits otherwise, which reads back the same too.
+ * snprintf uses the decimal point of the current C locale (e.g. a comma in a German locale),
+ * so the fallback replaces it with a '.', and the output is the same in every locale.
+ *
+ * @param[in] first Where to write to. Has to have space for max_formatted_float_length characters.
+ * @param[in] value The value to format.
+ * @return A pointer past the last written character.
+ */
+inline char* format_float(char* first, float value)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(first, first + max_formatted_float_length, value).ptr;
+#else
+    char* last = first + std::snprintf(first, max_formatted_float_length, "%.9g", value);
+    const char* const decimal_point = std::localeconv()->decimal_point;
+    const std::size_t decimal_point_length = std::strlen(decimal_point);
+    if (decimal_point_length > 0 && std::strcmp(decimal_point, ".") != 0)
+    {
+        char* const position = std::search(first, last, decimal_point, decimal_point + decimal_point_length);
+        if (position != last)
+        {
+            // The decimal point can have more than one byte, so the rest of the number moves forward:
+            *position = '.';
+            last = std::copy(position + decimal_point_length, last, position + 1);
+        }
+    }
+    return last;
+#endif
+};
+
+/**
+ * Writes text and binary data to a file through a large buffer.
+ *
+ * std::endl flushes the stream, so writing a mesh line by line with it issues a system call per
+ * line. This class collects the output in a buffer and only writes whole buffers to the file.
+ * Numbers are formatted directly into the buffer, without a temporary string.
+ *
+ * Binary values are always written in little-endian byte order, independent of the platform.
+ *
+ * The buffer is flushed on destruction, but call close() to find out about write errors.
+ */
+class BufferedWriter
+{
+public:
+    /**
+     * The smallest buffer size. Smaller sizes are increased to it, so that every number that
+     * write_int(...) and write_float(...) format fits into the buffer.
+     */
+    static constexpr std::size_t min_buffer_size = 64;
+
+    /**
+     * Opens the given file for writing. Existing files are overwritten.
+     *
+     * @param[in] filename The file to write to.
+     * @param[in] buffer_size Size of the buffer in bytes, at least min_buffer_size.
+     * @throw std::runtime_error If the file can't be opened.
+     */
+    explicit BufferedWriter(const std::string& filename, std::size_t buffer_size = 1 << 20)
+        : file(filename, std::ios::binary), buffer(std::max(buffer_size, min_buffer_size)), filename(filename)
+    {
+        if (!file)
+        {
+            throw std::runtime_error("Error opening given file for writing: " + filename);
+        }
+    };
+
+    ~BufferedWriter()
+    {
+        if (file.is_open())
+        {
+            file.write(buffer.data(), position); // Errors can't be reported from the destructor.
+        }
+    };
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    void write(const char* data, std::size_t size)
+    {
+        if (size > buffer.size() - position)
+        {
+            flush();
+            if (size > buffer.size())
+            {
+                file.write(data, size);
+                flushed_size += size;
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + position, data, size);
+        position += size;
+    };
+
+    void write(const std::string& text)
+    {
+        write(text.data(), text.size());
+    };
+
+    void write(char c)
+    {
+        reserve(1);
+        buffer[position++] = c;
+    };
+
+    /**
+     * Writes the given integer in decimal.
+     */
+    void write_int(std::int64_t value)
+    {
+        char digits[20];
+        int num_digits = 0;
+        // Negate in unsigned arithmetic, so that the smallest value doesn't overflow:
+        std::uint64_t magnitude = value < 0 ? 0 - static_cast<std::uint64_t>(value) : value;
+        do
+        {
+            digits[num_digits++] = static_cast<char>('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude != 0);
+        reserve(num_digits + 1);
+        if (value < 0)
+        {
+            buffer[position++] = '-';
+        }
+        while (num_digits > 0)
+        {
+            buffer[position++] = digits[--num_digits];
+        }
+    };
+
+    /**
+     * Writes the given float in decimal, see format_float(...).
+     */
+    void write_float(float value)
+    {
+        reserve(max_formatted_float_length);
+        position = format_float(buffer.data() + position, value) - buffer.data();
+    };
+
+    void write_uint8(std::uint8_t value)
+    {
+        write(static_cast<char>(value));
+    };
+
+    void write_uint32(std::uint32_t value)
+    {
+        reserve(4);
+        for (int i = 0; i < 4; ++i)
+        {
+            buffer[position++] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    };
+
+    void write_uint64(std::uint64_t value)
+    {
+        write_uint32(static_cast<std::uint32_t>(value & 0xFFFFFFFF));
+        write_uint32(static_cast<std::uint32_t>(value >> 32));
+    };
+
+    void write_float32(float value)
+    {
+        static_assert(sizeof(float) == sizeof(std::uint32_t), "float has to be a 32-bit type.");
+        std::uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        write_uint32(bits);
+    };
+
+    /**
+     * Writes the buffer to the file.
+     */
+    void flush()
+    {
+        file.write(buffer.data(), position);
+        flushed_size += position;
+        position = 0;
+    };
+
+    /**
+     * Writes the buffer to the file, and flushes the file stream, which hands the data to the
+     * operating system. Like std::ofstream::flush(), this doesn't wait until the operating
+     * system has written it to the disk (there's no portable fsync for a std::ofstream), but
+     * the data survives the program crashing.
+     *
+     * @throw std::runtime_error If writing to the file failed.
+     */
+    void flush_to_os()
+    {
+        flush();
+        file.flush();
+        if (!file)
+        {
+            throw std::runtime_error("Error writing to file: " + filename);
+        }
+    };
+
+    /**
+     * Returns the number of bytes that have been written so far, i.e. the offset in the file
+     * that the next write goes to.
+     *
+     * @return The number of bytes written.
+     */
+    std::uint64_t get_position() const
+    {
+        return flushed_size + position;
+    };
+
+    /**
+     * Writes the rest of the buffer to the file, and closes it.
+     *
+     * @throw std::runtime_error If writing to the file failed.
+     */
+    void close()
+    {
+        flush();
+        file.close();
+        if (!file)
+        {
+            throw std::runtime_error("Error writing to file: " + filename);
+        }
+    };
+
+private:
+    std::ofstream file;
+    std::vector<char> buffer;
+    std::size_t position = 0; ///< Number of bytes in the buffer that haven't been written to the file yet.
+    std::uint64_t flushed_size = 0; ///< Number of bytes that have been written to the file.
+    std::string filename;
+
+    // Makes sure that the buffer has space for the given number of bytes.
+    void reserve(std::size_t size)
+    {
+        if (size > buffer.size() - position)
+        {
+            flush();
+        }
+    };
+};
+
+} /* namespace detail */
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_BUFFERED_WRITER_HPP_ */
@@ -0,0 +1,65 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/detail/little_endian.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_LITTLE_ENDIAN_HPP_
+#define EOS_LITTLE_ENDIAN_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+/**
+ * Implementations of internal functions, not part of the
+ * API we expose and not meant to be used by a user.
+ */
+namespace eos {
+namespace core {
+namespace detail {
+
+/**
+ * Reads an unsigned 32-bit integer that is stored in little-endian byte order, like
+ * BufferedWriter writes it, at any alignment and on any platform.
+ */
+inline std::uint32_t read_uint32(const char* data)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8) |
+           (static_cast<std::uint32_t>(bytes[2]) << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+};
+
+inline std::uint64_t read_uint64(const char* data)
+{
+    return static_cast<std::uint64_t>(read_uint32(data)) |
+           (static_cast<std::uint64_t>(read_uint32(data + 4)) << 32);
+};
+
+inline float read_float32(const char* data)
+{
+    const std::uint32_t bits = read_uint32(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+};
+
+} /* namespace detail */
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_LITTLE_ENDIAN_HPP_ */
@@ -22,151 +22,377 @@
 #ifndef READ_OBJ_HPP_
 #define READ_OBJ_HPP_
 
+#include "eos/core/MemoryMappedFile.hpp"
 #include "eos/core/Mesh.hpp"
-#include "eos/cpp17/optional.hpp"
+#include "eos/core/MeshTopology.hpp"
 
 #include "Eigen/Core"
 
-#include <cassert>
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <clocale>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <tuple>
 #include <utility>
 #include <vector>
 
+#if defined(__has_include)
+#if __has_include(<charconv>) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#include <charconv>
+#endif
+#endif
+
 namespace eos {
 namespace core {
 
 namespace detail {
 
-/*
-// Split on a single delimiter.
-template <typename Out>
-void split(const std::string& s, char delim, Out result)
+/**
+ * The data that is read from one chunk (a range of whole lines) of an obj file.
+ *
+ * The obj format allows negative vertex indices, which are relative to the number of vertices
+ * read so far. In a chunk, they're resolved against the vertices of the chunk only, and
+ * \c relative_indices stores where in \c tvi they are (as index into the flattened array), so
+ * that the number of vertices in the previous chunks can be added to them when merging.
+ */
+struct ObjChunk
 {
-    std::stringstream ss;
-    ss.str(s);
-    std::string item;
-    while (std::getline(ss, item, delim))
-    {
-        // Can use an if here and push back for behaviour like token_compress. See https://stackoverflow.com/questions/236129/most-elegant-way-to-split-a-string/236803#236803.
-        *(result++) = item;
-    }
-}
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<Eigen::Vector3f> colors;
+    std::vector<Eigen::Vector2f> texcoords;
+    std::vector<std::array<int, 3>> tvi;
+    std::vector<std::size_t> relative_indices;
+};
 
-inline std::vector<std::string> split(const std::string& s, char delim)
+inline bool is_obj_space(char c)
 {
-    std::vector<std::string> elems;
-    split(s, delim, std::back_inserter(elems));
-    return elems;
-}
-*/
+    return c == ' ' || c == '\t' || c == '\r';
+};
 
-// From: https://stackoverflow.com/a/1493195/1345959
-template <class ContainerType>
-void tokenize(const std::string& str, ContainerType& tokens, const std::string& delimiters = " ",
-              bool trim_empty = false)
+inline void skip_obj_spaces(const char*& first, const char* last)
 {
-    std::string::size_type pos, last_pos = 0;
-    const auto length = str.length();
-
-    using value_type = typename ContainerType::value_type;
-    using size_type = typename ContainerType::size_type;
+    while (first != last && is_obj_space(*first))
+    {
+        ++first;
+    }
+};
 
-    while (last_pos < length + 1)
+/**
+ * Parses a float at \p first, and advances \p first past it.
+ *
+ * Uses std::from_chars if the standard library supports it for floating point types, which
+ * doesn't allocate and doesn't depend on the locale, and falls back to std::strtof otherwise,
+ * with the '.' replaced by the decimal point of the current locale.
+ *
+ * @param[in,out] first Start of the number. Points past the number afterwards.
+ * @param[in] last End of the line.
+ * @param[out] value The parsed value.
+ * @return Whether a number could be parsed.
+ */
+inline bool parse_obj_float(const char*& first, const char* last, float& value)
+{
+    // from_chars doesn't accept a leading '+', but std::stof, which we used before, does:
+    if (first != last && *first == '+')
     {
-        pos = str.find_first_of(delimiters, last_pos);
-        if (pos == std::string::npos)
+        ++first;
+    }
+#if defined(__cpp_lib_to_chars)
+    const auto result = std::from_chars(first, last, value);
+    if (result.ec != std::errc())
+    {
+        return false;
+    }
+    first = result.ptr;
+    return true;
+#else
+    // strtof needs a null-terminated string, so we copy the number to a small buffer first. strtof
+    // expects the decimal point of the current C locale, e.g. a comma in a German locale, so the '.'
+    // is replaced with it:
+    const char* const decimal_point = std::localeconv()->decimal_point;
+    const std::size_t decimal_point_length = std::max<std::size_t>(std::strlen(decimal_point), 1);
+    char buffer[64];
+    std::size_t length = 0;
+    std::size_t decimal_point_position = sizeof(buffer); // Where in the buffer the decimal point is.
+    for (const char* p = first;
+         p != last && length + decimal_point_length < sizeof(buffer) && !is_obj_space(*p); ++p)
+    {
+        if (*p == '.' && decimal_point_position == sizeof(buffer))
+        {
+            decimal_point_position = length;
+            std::memcpy(buffer + length, *decimal_point ? decimal_point : ".", decimal_point_length);
+            length += decimal_point_length;
+        } else
         {
-            pos = length;
+            buffer[length++] = *p;
         }
-
-        if (pos != last_pos || !trim_empty)
-            tokens.push_back(value_type(str.data() + last_pos, (size_type)pos - last_pos));
-
-        last_pos = pos + 1;
     }
-}
+    buffer[length] = '\0';
+    char* end;
+    value = std::strtof(buffer, &end);
+    if (end == buffer)
+    {
+        return false;
+    }
+    std::size_t parsed_length = end - buffer;
+    if (parsed_length > decimal_point_position)
+    {
+        parsed_length -= decimal_point_length - 1;
+    }
+    first += parsed_length;
+    return true;
+#endif
+};
 
 /**
- * @brief Parse a line starting with 'v' from an obj file.
- *
- * The 'v' will have already been stripped from the line.
+ * Parses a (possibly negative) integer at \p first, and advances \p first past it.
  *
- * These can contain vertex colours too actually. Can potentially have 3, 4, 6 or 7 elements...? (xyz, xyzw, xyzrgb, xyzwrgb)
- * assimp only deals with 3, 4 or 6 elements: https://github.com/assimp/assimp/blob/master/code/ObjFileParser.cpp#L138
- * For now, let's ignore homogeneous coordinates, and deal with the case when we have either 3 or 6 elements.
- * If it's homogeneous coords, we can also just divide by 'w', like assimp.
+ * Numbers whose magnitude doesn't fit an int are rejected, so -INT_MAX is the smallest value.
  *
- * Another obj parser we can check: https://github.com/qnzhou/PyMesh/blob/master/src/IO/OBJParser.cpp (and same file with .h)
- *
- * Todo: Consider using std::string_view for these instead of const string&.
- * And should change to glm::vec3, and just divide by 'w'. As soon as we change the Mesh to vec3.
+ * @param[in,out] first Start of the number. Points past the number afterwards.
+ * @param[in] last End of the line.
+ * @param[out] value The parsed value.
+ * @return Whether a number could be parsed.
  */
-inline std::pair<Eigen::Vector4f, cpp17::optional<Eigen::Vector3f>> parse_vertex(const std::string& line)
+inline bool parse_obj_int(const char*& first, const char* last, int& value)
 {
-    std::vector<std::string> tokens;
-    tokenize(line, tokens, " ");
-    assert(tokens.size() == 3 || tokens.size() == 6); // Maybe we should throw instead?
-    const Eigen::Vector4f vertex(std::stof(tokens[0]), std::stof(tokens[1]), std::stof(tokens[2]), 1.0);
-    cpp17::optional<Eigen::Vector3f> vertex_color;
-    if (tokens.size() == 6)
+    const char* p = first;
+    const bool negative = p != last && *p == '-';
+    if (p != last && (*p == '-' || *p == '+'))
     {
-        vertex_color = Eigen::Vector3f(std::stof(tokens[3]), std::stof(tokens[4]), std::stof(tokens[5]));
+        ++p;
     }
-    return {vertex, vertex_color};
+    if (p == last || *p < '0' || *p > '9')
+    {
+        return false;
+    }
+    long long result = 0;
+    while (p != last && *p >= '0' && *p <= '9')
+    {
+        result = result * 10 + (*p - '0');
+        if (result > std::numeric_limits<int>::max())
+        {
+            return false;
+        }
+        ++p;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    first = p;
+    return true;
 };
 
-inline Eigen::Vector2f parse_texcoords(const std::string& line)
+/**
+ * Parses up to \p max_values floats, separated by spaces, until the end of the line or a comment.
+ *
+ * @return The number of values that were parsed.
+ * @throw std::runtime_error If the line contains something that isn't a number.
+ */
+inline int parse_obj_floats(const char* first, const char* last, float* values, int max_values)
 {
-    std::vector<std::string> tokens;
-    tokenize(line, tokens, " ");
-    assert(tokens.size() == 2);
-    const Eigen::Vector2f texcoords(std::stof(tokens[0]), std::stof(tokens[1]));
-    return texcoords;
+    int num_values = 0;
+    while (true)
+    {
+        skip_obj_spaces(first, last);
+        if (first == last || *first == '#')
+        {
+            return num_values;
+        }
+        if (num_values == max_values || !parse_obj_float(first, last, values[num_values]))
+        {
+            throw std::runtime_error("Invalid line in obj file: " + std::string(first, last));
+        }
+        ++num_values;
+    }
 };
 
-inline void parse_vertex_normal(const std::string& line)
+/**
+ * Parses a line starting with 'v', without the 'v'.
+ *
+ * A vertex can have 3, 4, 6 or 7 values (xyz, xyzw, xyzrgb, xyzwrgb). Homogeneous
+ * coordinates are divided by w, like assimp does.
+ */
+inline void parse_obj_vertex(const char* first, const char* last, ObjChunk& chunk)
 {
-    throw std::runtime_error("Parsing \"vt\" is not yet implemented.");
+    float values[7];
+    const int num_values = parse_obj_floats(first, last, values, 7);
+    if (num_values != 3 && num_values != 4 && num_values != 6 && num_values != 7)
+    {
+        throw std::runtime_error("Invalid vertex in obj file: " + std::string(first, last));
+    }
+    const bool has_w = num_values == 4 || num_values == 7;
+    const float w = has_w ? values[3] : 1.0f;
+    chunk.vertices.emplace_back(values[0] / w, values[1] / w, values[2] / w);
+    if (num_values >= 6)
+    {
+        const float* const color = values + (has_w ? 4 : 3);
+        chunk.colors.emplace_back(color[0], color[1], color[2]);
+    }
 };
 
-// Note: Indices in obj's start at 1!
-// Oh no, these contain 3 entries for triangles, but can be quads (=4 entries), and potentially more.
-// Their triplets of: vertex, texture and normal indices. Some of them can be missing. E.g.:
-//  f 1 2 3
-//  f 3/1 4/2 5/3
-//  f 6/4/1 3/5/3 7/6/5
-//  f 7//1 8//2 9//3
-inline auto parse_face(const std::string& line)
+/**
+ * Parses a line starting with 'vt', without the 'vt'. An optional third (w) coordinate is ignored.
+ *
+ * Obj files have the uv origin in the bottom-left corner, and the mesh in the top-left corner (see
+ * MeshTopology::texcoords), so the second coordinate is flipped.
+ */
+inline void parse_obj_texcoords(const char* first, const char* last, ObjChunk& chunk)
 {
-    using std::string;
-    using std::vector;
+    float values[3];
+    const int num_values = parse_obj_floats(first, last, values, 3);
+    if (num_values < 2)
+    {
+        throw std::runtime_error("Invalid texture coordinates in obj file: " + std::string(first, last));
+    }
+    chunk.texcoords.emplace_back(values[0], 1.0f - values[1]);
+};
 
-    // Obj indices are 1-based.
-    vector<int> vertex_indices;  // size() = 3 or 4
-    vector<int> texture_indices; // size() = 3 or 4
-    vector<int> normal_indices;  // size() = 3 or 4
+/**
+ * Parses a line starting with 'f', without the 'f', and adds its triangles to the chunk.
+ *
+ * Each corner of a face consists of a vertex index, and optional texture and normal indices:
+ *  f 1 2 3
+ *  f 3/1 4/2 5/3
+ *  f 6/4/1 3/5/3 7/6/5
+ *  f 7//1 8//2 9//3
+ * Only the vertex indices are used, since the Mesh has per-vertex texture coordinates and no
+ * normals. Obj indices start at 1, and negative indices are relative to the last vertex read.
+ * Whether the indices are in range can only be checked once the whole file has been read, see
+ * check_obj_vertex_indices(...).
+ * Faces with more than three corners are split into a triangle fan, i.e. a quad (0, 1, 2, 3)
+ * becomes the triangles (0, 1, 2) and (0, 2, 3), like MeshLab does.
+ *
+ * @param[in,out] corners Buffer for the vertex indices of the face, and whether they are relative, that is
+ * reused between faces.
+ */
+inline void parse_obj_face(const char* first, const char* last, ObjChunk& chunk,
+                           std::vector<std::pair<int, bool>>& corners)
+{
+    const auto invalid_face = [&]() {
+        return std::runtime_error("Invalid face in obj file: " + std::string(first, last));
+    };
+    const int num_vertices = static_cast<int>(chunk.vertices.size());
+    corners.clear();
+    const char* p = first;
+    while (true)
+    {
+        skip_obj_spaces(p, last);
+        if (p == last || *p == '#')
+        {
+            break;
+        }
+        int vertex_index;
+        if (!parse_obj_int(p, last, vertex_index) || vertex_index == 0)
+        {
+            throw invalid_face();
+        }
+        // Skip the optional texture and normal indices:
+        for (int i = 0; i < 2 && p != last && *p == '/'; ++i)
+        {
+            ++p;
+            int ignored_index;
+            parse_obj_int(p, last, ignored_index); // Can be empty, like in "7//1".
+        }
+        if (p != last && !is_obj_space(*p) && *p != '#')
+        {
+            throw invalid_face();
+        }
+        if (vertex_index < 0)
+        {
+            corners.emplace_back(num_vertices + vertex_index, true);
+        } else
+        {
+            corners.emplace_back(vertex_index - 1, false); // obj indices are 1-based, so we subtract one.
+        }
+    }
+    if (corners.size() < 3)
+    {
+        throw invalid_face();
+    }
+    for (std::size_t i = 2; i < corners.size(); ++i)
+    {
+        const std::array<std::size_t, 3> triangle_corners{0, i - 1, i};
+        for (int j = 0; j < 3; ++j)
+        {
+            if (corners[triangle_corners[j]].second)
+            {
+                chunk.relative_indices.push_back(3 * chunk.tvi.size() + j);
+            }
+        }
+        chunk.tvi.push_back({corners[0].first, corners[i - 1].first, corners[i].first});
+    }
+};
 
-    vector<string> tokens;
-    tokenize(line, tokens, " ");
-    assert(tokens.size() == 3 || tokens.size() == 4); // For now we need this to be 3 (triangles) or 4 (quads).
-    // Now for each of these tokens, we want to split on "/":
-    for (const auto& token : tokens)
+/**
+ * Parses all lines in [first, last) of an obj file. Elements other than v, vt, vn and f, e.g.
+ * materials and named objects, are ignored, and so are the normals, since the Mesh doesn't have any.
+ *
+ * @param[in] first Start of the first line.
+ * @param[in] last End of the last line.
+ * @return The data of the chunk.
+ */
+inline ObjChunk parse_obj_chunk(const char* first, const char* last)
+{
+    ObjChunk chunk;
+    std::vector<std::pair<int, bool>> corners;
+    while (first != last)
     {
-        vector<string> subtokens;
-        tokenize(token, subtokens, "/"); // do we want trim_empty true or false?
-        assert(subtokens.size() > 0 && subtokens.size() <= 3); // <= 3 correct or not?
-        // Ok, let's make our life easy, for now only support the 1/2/3 syntax of the FaceWarehouse scans. In
-        // fact the normal_indices are 0... we should check for that - zero-index = ignore, but note that, it's
-        // probably a non-standard obj format extension.
-        assert(subtokens.size() == 3);                         // FaceWarehouse
-        vertex_indices.push_back(std::stoi(subtokens[0]) - 1); // obj indices are 1-based, so we subtract one.
-        texture_indices.push_back(std::stoi(subtokens[1]) - 1);
-        // subtokens[2] is zero, hence, no normal_indices.
+        const char* line_end = static_cast<const char*>(std::memchr(first, '\n', last - first));
+        if (!line_end)
+        {
+            line_end = last;
+        }
+        const char* p = first;
+        skip_obj_spaces(p, line_end);
+        // The keyword has to be followed by a space, so that e.g. "v" doesn't match "vt":
+        const auto keyword = [&](const char* name, std::size_t length) {
+            if (static_cast<std::size_t>(line_end - p) > length && std::memcmp(p, name, length) == 0 &&
+                is_obj_space(p[length]))
+            {
+                p += length;
+                return true;
+            }
+            return false;
+        };
+        if (keyword("v", 1))
+        {
+            parse_obj_vertex(p, line_end, chunk);
+        } else if (keyword("vt", 2))
+        {
+            parse_obj_texcoords(p, line_end, chunk);
+        } else if (keyword("f", 1))
+        {
+            parse_obj_face(p, line_end, chunk, corners);
+        }
+        first = line_end == last ? last : line_end + 1;
     }
+    return chunk;
+};
 
-    return std::make_tuple(vertex_indices, texture_indices, normal_indices);
+/**
+ * Checks that all vertex indices of the triangles, with relative indices resolved, refer to one of
+ * the \p num_vertices vertices of the file.
+ *
+ * @throw std::runtime_error If an index is out of range.
+ */
+inline void check_obj_vertex_indices(const std::vector<std::array<int, 3>>& tvi, std::size_t num_vertices)
+{
+    for (const auto& triangle : tvi)
+    {
+        for (const int index : triangle)
+        {
+            if (index < 0 || static_cast<std::size_t>(index) >= num_vertices)
+            {
+                throw std::runtime_error("Invalid face in obj file: The vertex index " +
+                                         std::to_string(index + 1) + " is out of range, the file has " +
+                                         std::to_string(num_vertices) + " vertices.");
+            }
+        }
+    }
 };
 
 } /* namespace detail */
@@ -174,88 +400,113 @@ inline auto parse_face(const std::string& line)
 /**
  * @brief Reads the given Wavefront .obj file into a \c Mesh.
  *
- * X.
- * https://en.wikipedia.org/wiki/Wavefront_.obj_file as of 22 August 2017.
+ * Reads the vertices (including vertex colours, if present), texture coordinates and faces.
+ * The texture coordinates are converted from the bottom-left origin of obj files to the
+ * top-left origin of the mesh, see MeshTopology::texcoords.
+ * Faces with more than three vertices are split into triangles. Normals, materials and other
+ * elements are ignored. See https://en.wikipedia.org/wiki/Wavefront_.obj_file.
+ *
+ * The file is memory-mapped and parsed in place, without allocating per line or per token. With
+ * \p num_threads greater than one, the file is split into that many chunks of whole lines, which
+ * are parsed in parallel, which is worthwhile for large scans.
  *
  * @param[in] filename Input filename (ending in ".obj").
- * @return X.
+ * @param[in] num_threads Number of threads to parse the file with.
+ * @return The mesh that is read from the file.
+ * @throw std::runtime_error If the file can't be opened, contains an invalid v, vt or f line, or a face
+ * refers to a vertex that doesn't exist.
  */
-inline Mesh read_obj(std::string filename)
+inline Mesh read_obj(std::string filename, int num_threads = 1)
 {
-    std::ifstream file(filename);
-    if (!file)
+    const MemoryMappedFile file(filename);
+    const char* const begin = file.data();
+    const char* const end = begin + file.size();
+
+    // Split the file into chunks that end at a line break:
+    num_threads = std::max(num_threads, 1);
+    std::vector<const char*> chunk_boundaries{begin};
+    for (int i = 1; i < num_threads; ++i)
     {
-        throw std::runtime_error(std::string("Could not open obj file: " + filename));
+        const char* boundary = std::max(begin + file.size() * i / num_threads, chunk_boundaries.back());
+        boundary = std::find(boundary, end, '\n');
+        chunk_boundaries.push_back(boundary == end ? end : boundary + 1);
     }
+    chunk_boundaries.push_back(end);
 
-    // We'll need these helper functions for the parsing:
-    const auto starts_with = [](const std::string& input, const std::string& match) {
-        return input.size() >= match.size() && std::equal(match.begin(), match.end(), input.begin());
-    };
-
-    /*    auto trim_left = [](const std::string& input, std::string pattern = " \t") {
-            auto first = input.find_first_not_of(pattern);
-            if (first == std::string::npos)
-            {
-                return input;
-            }
-            return input.substr(first, input.size());
-        }; */
-
-    Mesh mesh;
-
-    std::string line;
-    while (getline(file, line))
+    std::vector<detail::ObjChunk> chunks;
+    if (num_threads == 1)
+    {
+        chunks.push_back(detail::parse_obj_chunk(begin, end));
+    } else
     {
-        if (starts_with(line, "#"))
+        std::vector<std::future<detail::ObjChunk>> parsed_chunks;
+        for (int i = 0; i < num_threads; ++i)
         {
-            continue;
+            parsed_chunks.push_back(std::async(std::launch::async, detail::parse_obj_chunk,
+                                               chunk_boundaries[i], chunk_boundaries[i + 1]));
         }
-
-        if (starts_with(line, "v "))
-        { // matching with a space so that it doesn't match 'vt'
-            auto vertex_data =
-                detail::parse_vertex(line.substr(2)); // pass the string without the first two characters
-            mesh.vertices.push_back(
-                Eigen::Vector3f(vertex_data.first[0], vertex_data.first[1], vertex_data.first[2]));
-            if (vertex_data.second)
-            { // there are vertex colours:
-                mesh.colors.push_back(vertex_data.second.value());
-            }
+        for (auto& parsed_chunk : parsed_chunks)
+        {
+            chunks.push_back(parsed_chunk.get());
         }
-        if (starts_with(line, "vt "))
+    }
+    if (chunks.size() == 1)
+    {
+        // The relative indices are already relative to the whole file:
+        detail::check_obj_vertex_indices(chunks[0].tvi, chunks[0].vertices.size());
+        MeshTopology topology;
+        topology.texcoords = std::move(chunks[0].texcoords);
+        topology.tvi = std::move(chunks[0].tvi);
+        Mesh mesh;
+        mesh.vertices = chunks[0].vertices;
+        mesh.colors = chunks[0].colors;
+        mesh.topology = std::make_shared<const MeshTopology>(std::move(topology));
+        return mesh;
+    }
+
+    // Merge the chunks, and make their relative indices relative to the whole file:
+    Mesh mesh;
+    MeshTopology topology;
+    std::size_t num_vertices = 0, num_colors = 0, num_texcoords = 0, num_triangles = 0;
+    for (const auto& chunk : chunks)
+    {
+        num_vertices += chunk.vertices.size();
+        num_colors += chunk.colors.size();
+        num_texcoords += chunk.texcoords.size();
+        num_triangles += chunk.tvi.size();
+    }
+    if (num_vertices > static_cast<std::size_t>(std::numeric_limits<int>::max()))
+    {
+        throw std::runtime_error("The obj file has more vertices than an int can index: " + filename);
+    }
+    mesh.vertices.resize(num_vertices);
+    mesh.colors.resize(num_colors);
+    std::size_t vertex_offset = 0, color_offset = 0;
+    topology.texcoords.reserve(num_texcoords);
+    topology.tvi.reserve(num_triangles);
+    for (const auto& chunk : chunks)
+    {
+        const std::size_t first_triangle = topology.tvi.size();
+        for (std::size_t i = 0; i < chunk.vertices.size(); ++i)
         {
-            const auto texcoords = detail::parse_texcoords(line.substr(3));
-            mesh.texcoords.push_back(texcoords);
+            mesh.vertices.set(vertex_offset + i, chunk.vertices[i]);
         }
-        if (starts_with(line, "vn "))
+        for (std::size_t i = 0; i < chunk.colors.size(); ++i)
         {
-            // detail::parse_vertex_normal(line.substr(3));
-            // Not handled yet, our Mesh class doesn't contain normals right now anyway.
+            mesh.colors.set(color_offset + i, chunk.colors[i]);
         }
-        // There's other things like "vp ", which we don't handle
-        if (starts_with(line, "f "))
+        topology.texcoords.insert(std::end(topology.texcoords), std::begin(chunk.texcoords),
+                                  std::end(chunk.texcoords));
+        topology.tvi.insert(std::end(topology.tvi), std::begin(chunk.tvi), std::end(chunk.tvi));
+        for (const auto index : chunk.relative_indices)
         {
-            auto face_data = detail::parse_face(line.substr(2));
-            if (std::get<0>(face_data).size() == 3) // 3 triangle indices, nothing to do:
-            {
-                mesh.tvi.push_back(
-                    {std::get<0>(face_data)[0], std::get<0>(face_data)[1], std::get<0>(face_data)[2]});
-            }
-            // If their sizes are 4, we convert the quad to two triangles:
-            // Actually I think MeshLab does the same, it shows the FaceWarehouse number of "Faces" as twice the "f" entries in the obj.
-            else if (std::get<0>(face_data).size() == 4)
-            {
-                // Just create two faces with (quad[0], quad[1], quad[2]) and (quad[0], quad[2], quad[3]).
-                mesh.tvi.push_back(
-                    {std::get<0>(face_data)[0], std::get<0>(face_data)[1], std::get<0>(face_data)[2]});
-                mesh.tvi.push_back(
-                    {std::get<0>(face_data)[0], std::get<0>(face_data)[2], std::get<0>(face_data)[3]});
-            }
-            // We don't handle normal_indices for now.
+            topology.tvi[first_triangle + index / 3][index % 3] += static_cast<int>(vertex_offset);
         }
-        // There can be other stuff in obj's like materials, named objects, etc., which are not handled here.
+        vertex_offset += chunk.vertices.size();
+        color_offset += chunk.colors.size();
     }
+    detail::check_obj_vertex_indices(topology.tvi, num_vertices);
+    mesh.topology = std::make_shared<const MeshTopology>(std::move(topology));
     return mesh;
 }
 
@@ -0,0 +1,280 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/core/write_mesh.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_WRITE_MESH_HPP_
+#define EOS_WRITE_MESH_HPP_
+
+#include "eos/core/Mesh.hpp"
+#include "eos/core/detail/BufferedWriter.hpp"
+
+#include "Eigen/Core"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace eos {
+namespace core {
+
+/**
+ * @brief Writes the given Mesh to a binary little-endian ply file.
+ *
+ * Binary files are smaller than obj files, and are written and read much faster, since no
+ * numbers have to be formatted or parsed. The vertex colours, if the mesh has any, are stored
+ * as 8-bit "red", "green" and "blue" properties, and the texture coordinates, if the mesh has
+ * any, as per-vertex "s" and "t" properties. MeshLab, Blender and most other tools read them.
+ * Like in obj files, the texture coordinates of ply files have their origin in the bottom-left
+ * corner, so they are written as (u, 1 - v), see MeshTopology::texcoords.
+ *
+ * @param[in] mesh The mesh to save as ply.
+ * @param[in] filename Output filename (including ".ply").
+ * @throw std::runtime_error If the file can't be written.
+ */
+inline void write_ply(const Mesh& mesh, std::string filename)
+{
+    assert(mesh.colors.empty() || mesh.colors.size() == mesh.vertices.size());
+    assert(mesh.texcoords().empty() || mesh.texcoords().size() == mesh.vertices.size());
+
+    detail::BufferedWriter ply_file(filename);
+    ply_file.write("ply\nformat binary_little_endian 1.0\ncomment Created by eos\n");
+    ply_file.write("element vertex " + std::to_string(mesh.vertices.size()) + "\n");
+    ply_file.write("property float x\nproperty float y\nproperty float z\n");
+    if (!mesh.colors.empty())
+    {
+        ply_file.write("property uchar red\nproperty uchar green\nproperty uchar blue\n");
+    }
+    if (!mesh.texcoords().empty())
+    {
+        ply_file.write("property float s\nproperty float t\n");
+    }
+    ply_file.write("element face " + std::to_string(mesh.tvi().size()) + "\n");
+    ply_file.write("property list uchar int vertex_indices\nend_header\n");
+
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            ply_file.write_float32(mesh.vertices[i][j]);
+        }
+        if (!mesh.colors.empty())
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                const float color = std::min(std::max(mesh.colors[i][c], 0.0f), 1.0f);
+                ply_file.write_uint8(static_cast<std::uint8_t>(std::lround(color * 255.0f)));
+            }
+        }
+        if (!mesh.texcoords().empty())
+        {
+            ply_file.write_float32(mesh.texcoords()[i][0]);
+            ply_file.write_float32(1.0f - mesh.texcoords()[i][1]);
+        }
+    }
+    for (const auto& triangle : mesh.tvi())
+    {
+        ply_file.write_uint8(3);
+        for (int j = 0; j < 3; ++j)
+        {
+            ply_file.write_uint32(static_cast<std::uint32_t>(triangle[j]));
+        }
+    }
+    ply_file.close();
+};
+
+/**
+ * @brief Writes the triangle indices of a mesh to a binary file, which glb files that are written
+ * with write_glb(...) can reference instead of containing the indices themselves.
+ *
+ * All meshes of a model have the same triangles, so when a fitted mesh is written in every frame
+ * of a video, the indices only need to be written once.
+ *
+ * The file contains the indices as little-endian unsigned 32-bit integers, as a glTF buffer.
+ *
+ * @param[in] triangle_indices The triangle indices, e.g. Mesh::tvi.
+ * @param[in] filename Output filename (e.g. ending in ".bin").
+ * @throw std::runtime_error If the file can't be written.
+ */
+inline void write_glb_index_buffer(const std::vector<std::array<int, 3>>& triangle_indices,
+                                   std::string filename)
+{
+    detail::BufferedWriter index_file(filename);
+    for (const auto& triangle : triangle_indices)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            index_file.write_uint32(static_cast<std::uint32_t>(triangle[j]));
+        }
+    }
+    index_file.close();
+};
+
+/**
+ * @brief Writes the given Mesh to a binary glTF 2.0 (.glb) file.
+ *
+ * The file contains one mesh with one triangle primitive, with the vertices, and the vertex
+ * colours and texture coordinates if the mesh has them, as float attributes (POSITION, COLOR_0
+ * and TEXCOORD_0). glTF has the uv origin in the top-left corner, like the mesh, so
+ * the texture coordinates are stored unchanged.
+ *
+ * If \p index_buffer_uri is given, the triangle indices aren't stored in the file, but are read
+ * from the given file, which has to be written once with write_glb_index_buffer(...). The URI is
+ * relative to the glb file.
+ *
+ * @param[in] mesh The mesh to save. Must have at least one vertex.
+ * @param[in] filename Output filename (including ".glb").
+ * @param[in] index_buffer_uri URI of a shared index buffer, or empty to store the indices in the file.
+ * @throw std::runtime_error If the file can't be written.
+ */
+inline void write_glb(const Mesh& mesh, std::string filename, std::string index_buffer_uri = "")
+{
+    assert(!mesh.vertices.empty());
+    assert(mesh.colors.empty() || mesh.colors.size() == mesh.vertices.size());
+    assert(mesh.texcoords().empty() || mesh.texcoords().size() == mesh.vertices.size());
+
+    const bool shared_indices = !index_buffer_uri.empty();
+    const std::size_t num_vertices = mesh.vertices.size();
+    const std::size_t positions_size = num_vertices * 12;
+    const std::size_t colors_size = mesh.colors.empty() ? 0 : num_vertices * 12;
+    const std::size_t texcoords_size = mesh.texcoords().empty() ? 0 : num_vertices * 8;
+    const std::size_t indices_size = mesh.tvi().size() * 12;
+    const std::size_t binary_size =
+        positions_size + colors_size + texcoords_size + (shared_indices ? 0 : indices_size);
+
+    // The accessor of the positions needs their bounds:
+    const Eigen::Vector3f min_position = mesh.vertices.as_matrix().rowwise().minCoeff();
+    const Eigen::Vector3f max_position = mesh.vertices.as_matrix().rowwise().maxCoeff();
+    const auto to_json = [](const Eigen::Vector3f& vector) {
+        std::string json = "[";
+        for (int i = 0; i < 3; ++i)
+        {
+            char number[detail::max_formatted_float_length];
+            json.append(number, detail::format_float(number, vector[i]));
+            json += i < 2 ? "," : "]";
+        }
+        return json;
+    };
+
+    // The attributes are stored one after the other in the binary chunk, in this order:
+    std::string buffer_views;
+    std::string accessors;
+    std::string attributes;
+    std::size_t offset = 0;
+    int index = 0;
+    const auto add_view = [&](std::size_t size, int buffer, int target, const std::string& type,
+                              std::size_t count, const std::string& extra) {
+        const std::string separator = index > 0 ? "," : "";
+        buffer_views += separator + "{\"buffer\":" + std::to_string(buffer) +
+                        ",\"byteOffset\":" + std::to_string(buffer == 0 ? offset : 0) +
+                        ",\"byteLength\":" + std::to_string(size) + ",\"target\":" + std::to_string(target) +
+                        "}";
+        accessors += separator + "{\"bufferView\":" + std::to_string(index) + ",\"componentType\":" +
+                     (type == "SCALAR" ? "5125" : "5126") + ",\"count\":" + std::to_string(count) +
+                     ",\"type\":\"" + type + "\"" + extra + "}";
+        if (buffer == 0)
+        {
+            offset += size;
+        }
+        return index++;
+    };
+    attributes += "\"POSITION\":" + std::to_string(add_view(positions_size, 0, 34962, "VEC3", num_vertices,
+                                                            ",\"min\":" + to_json(min_position) +
+                                                                ",\"max\":" + to_json(max_position)));
+    if (!mesh.colors.empty())
+    {
+        attributes +=
+            ",\"COLOR_0\":" + std::to_string(add_view(colors_size, 0, 34962, "VEC3", num_vertices, ""));
+    }
+    if (!mesh.texcoords().empty())
+    {
+        attributes +=
+            ",\"TEXCOORD_0\":" + std::to_string(add_view(texcoords_size, 0, 34962, "VEC2", num_vertices, ""));
+    }
+    std::string primitive = "{\"attributes\":{" + attributes + "},\"mode\":4";
+    if (!mesh.tvi().empty())
+    {
+        const int indices_accessor =
+            add_view(indices_size, shared_indices ? 1 : 0, 34963, "SCALAR", mesh.tvi().size() * 3, "");
+        primitive += ",\"indices\":" + std::to_string(indices_accessor);
+    }
+    primitive += "}";
+
+    std::string buffers = "{\"byteLength\":" + std::to_string(binary_size) + "}";
+    if (shared_indices)
+    {
+        // Escaping the URI is left to the caller, it's expected to be a plain relative filename:
+        buffers += ",{\"uri\":\"" + index_buffer_uri + "\",\"byteLength\":" + std::to_string(indices_size) +
+                   "}";
+    }
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"eos\"},\"scene\":0,"
+                       "\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+                       "\"meshes\":[{\"primitives\":[" +
+                       primitive + "]}],\"buffers\":[" + buffers + "],\"bufferViews\":[" + buffer_views +
+                       "],\"accessors\":[" + accessors + "]}";
+    // Both chunks have to be padded to a multiple of 4 bytes, the JSON with spaces:
+    json.append((4 - json.size() % 4) % 4, ' ');
+    // All the binary data consists of 4-byte values, so it doesn't need any padding:
+    const std::size_t file_size = 12 + 8 + json.size() + 8 + binary_size;
+
+    detail::BufferedWriter glb_file(filename);
+    glb_file.write_uint32(0x46546C67); // "glTF"
+    glb_file.write_uint32(2);          // version
+    glb_file.write_uint32(static_cast<std::uint32_t>(file_size));
+    glb_file.write_uint32(static_cast<std::uint32_t>(json.size()));
+    glb_file.write_uint32(0x4E4F534A); // "JSON"
+    glb_file.write(json);
+    glb_file.write_uint32(static_cast<std::uint32_t>(binary_size));
+    glb_file.write_uint32(0x004E4942); // "BIN"
+    // The positions and colours are stored x0 y0 z0 x1 ... like in the vertex buffers of the mesh:
+    for (Eigen::Index i = 0; i < mesh.vertices.as_vector().size(); ++i)
+    {
+        glb_file.write_float32(mesh.vertices.as_vector()[i]);
+    }
+    for (Eigen::Index i = 0; i < mesh.colors.as_vector().size(); ++i)
+    {
+        glb_file.write_float32(mesh.colors.as_vector()[i]);
+    }
+    for (const auto& texcoord : mesh.texcoords())
+    {
+        glb_file.write_float32(texcoord[0]);
+        glb_file.write_float32(texcoord[1]);
+    }
+    if (!shared_indices)
+    {
+        for (const auto& triangle : mesh.tvi())
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                glb_file.write_uint32(static_cast<std::uint32_t>(triangle[j]));
+            }
+        }
+    }
+    glb_file.close();
+};
+
+} /* namespace core */
+} /* namespace eos */
+
+#endif /* EOS_WRITE_MESH_HPP_ */
@@ -33,13 +33,15 @@ namespace fitting {
  * @brief A struct holding the result from a fitting.
  *
  * Holds the parameters to store and reproduce a shape fitting result:
- * Rendering parameters, PCA shape and expression coefficients.
+ * Rendering parameters, PCA shape and expression coefficients, and the PCA colour
+ * coefficients, if the colour model has been fitted too.
  */
 struct FittingResult
 {
     RenderingParameters rendering_parameters;
     std::vector<float> pca_shape_coefficients;
     std::vector<float> expression_coefficients;
+    std::vector<float> pca_color_coefficients;
 };
 
 } /* namespace fitting */
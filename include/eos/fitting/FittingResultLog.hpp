@@ -0,0 +1,525 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/fitting/FittingResultLog.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef FITTINGRESULTLOG_HPP_
+#define FITTINGRESULTLOG_HPP_
+
+#include "eos/core/MemoryMappedFile.hpp"
+#include "eos/core/detail/BufferedWriter.hpp"
+#include "eos/core/detail/little_endian.hpp"
+#include "eos/fitting/FittingResult.hpp"
+#include "eos/fitting/RenderingParameters.hpp"
+#include "eos/cpp17/optional.hpp"
+
+#include "glm/gtc/quaternion.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A fitting result log stores the fitting results of the frames of a video, one fixed-size
+ * record per frame, so that a record can be found by its position in the file.
+ *
+ * The file consists of (all values little-endian):
+ *  - A header: the magic string "eosfitlg", the version, the number of shape, expression and
+ *    colour coefficients of every record, and the size of a record in bytes.
+ *  - The records. Each one contains the frame number (int64), the camera type, screen width and
+ *    height (int32), the rotation quaternion (w, x, y, z), the translation (x, y), the frustum
+ *    (l, r, b, t), and the shape, expression and colour coefficients (all float32).
+ *  - A footer, written when the log is closed: the magic string "eosfitft", the frame numbers of
+ *    all records (int64), the number of records (uint64), and the magic string "eosfitix".
+ *
+ * The footer lets a reader look up frames without reading every record. It is only used if both
+ * magic strings are where the number of records says they are. If the writer didn't finish, e.g.
+ * because the program crashed, the log has no footer or only a part of it, and the reader
+ * recovers all complete records from the file instead. A part of a footer starts with
+ * "eosfitft" at the end of the last record, so it isn't mistaken for a record.
+ *
+ * Meshes don't need to be stored along with the log, they can be regenerated from the
+ * coefficients with MorphableModel::draw_sample(...) when they're needed.
+ */
+namespace eos {
+namespace fitting {
+
+namespace detail {
+
+constexpr char fitting_log_magic[8] = {'e', 'o', 's', 'f', 'i', 't', 'l', 'g'};
+constexpr char fitting_log_footer_start_magic[8] = {'e', 'o', 's', 'f', 'i', 't', 'f', 't'};
+constexpr char fitting_log_footer_magic[8] = {'e', 'o', 's', 'f', 'i', 't', 'i', 'x'};
+constexpr std::uint32_t fitting_log_version = 1;
+constexpr std::size_t fitting_log_header_size = 8 + 5 * 4;
+// Frame number, camera type, screen size, rotation, translation and frustum:
+constexpr std::size_t fitting_log_record_base_size = 8 + 3 * 4 + (4 + 2 + 4) * 4;
+
+inline std::size_t get_fitting_log_record_size(std::size_t num_coefficients)
+{
+    return fitting_log_record_base_size + 4 * num_coefficients;
+};
+
+} /* namespace detail */
+
+/**
+ * @brief Appends the fitting results of the frames of a video to a binary log file.
+ *
+ * See the description of the file format above. Every record has room for the number of
+ * coefficients given to the constructor. Results with fewer coefficients are padded with zeros,
+ * which gives the same shape when drawing a sample from the model.
+ *
+ * The records are buffered. Call flush() to hand them to the operating system, e.g. every few
+ * seconds of video, so that they survive the program crashing.
+ */
+class FittingResultLogWriter
+{
+public:
+    /**
+     * Creates the given log file.
+     *
+     * @param[in] filename The file to write to. An existing file is overwritten.
+     * @param[in] num_shape_coefficients Number of shape coefficients stored per frame.
+     * @param[in] num_expression_coefficients Number of expression coefficients stored per frame.
+     * @param[in] num_color_coefficients Number of colour coefficients stored per frame.
+     * @throw std::runtime_error If the file can't be opened.
+     */
+    FittingResultLogWriter(std::string filename, int num_shape_coefficients, int num_expression_coefficients,
+                           int num_color_coefficients = 0)
+        : file(filename), num_shape_coefficients(num_shape_coefficients),
+          num_expression_coefficients(num_expression_coefficients),
+          num_color_coefficients(num_color_coefficients)
+    {
+        if (num_shape_coefficients < 0 || num_expression_coefficients < 0 || num_color_coefficients < 0)
+        {
+            throw std::runtime_error("FittingResultLogWriter: The numbers of coefficients can't be "
+                                     "negative.");
+        }
+        file.write(detail::fitting_log_magic, sizeof(detail::fitting_log_magic));
+        file.write_uint32(detail::fitting_log_version);
+        file.write_uint32(static_cast<std::uint32_t>(num_shape_coefficients));
+        file.write_uint32(static_cast<std::uint32_t>(num_expression_coefficients));
+        file.write_uint32(static_cast<std::uint32_t>(num_color_coefficients));
+        file.write_uint32(static_cast<std::uint32_t>(detail::get_fitting_log_record_size(
+            num_shape_coefficients + num_expression_coefficients + num_color_coefficients)));
+    };
+
+    /**
+     * Writes the footer and closes the file, if it hasn't been closed yet. Errors can't be
+     * reported from the destructor, so call close() to find out about them.
+     */
+    ~FittingResultLogWriter()
+    {
+        if (!closed)
+        {
+            try
+            {
+                close();
+            } catch (const std::exception&)
+            {
+            }
+        }
+    };
+
+    FittingResultLogWriter(const FittingResultLogWriter&) = delete;
+    FittingResultLogWriter& operator=(const FittingResultLogWriter&) = delete;
+
+    /**
+     * Appends the fitting result of a frame.
+     *
+     * @param[in] frame_number The number of the frame, which it can be looked up with.
+     * @param[in] fitting_result The fitting result of the frame.
+     * @throw std::runtime_error If the result has more coefficients than the log has room for.
+     */
+    void add(std::int64_t frame_number, const FittingResult& fitting_result)
+    {
+        if (fitting_result.pca_shape_coefficients.size() > static_cast<std::size_t>(num_shape_coefficients) ||
+            fitting_result.expression_coefficients.size() >
+                static_cast<std::size_t>(num_expression_coefficients) ||
+            fitting_result.pca_color_coefficients.size() > static_cast<std::size_t>(num_color_coefficients))
+        {
+            throw std::runtime_error("FittingResultLogWriter: The fitting result has more coefficients than "
+                                     "the log has room for.");
+        }
+        const RenderingParameters& rendering_parameters = fitting_result.rendering_parameters;
+        const glm::quat rotation = rendering_parameters.get_rotation();
+        const glm::mat4x4 modelview = rendering_parameters.get_modelview();
+        const Frustum frustum = rendering_parameters.get_frustum();
+
+        file.write_uint64(static_cast<std::uint64_t>(frame_number));
+        file.write_uint32(static_cast<std::uint32_t>(rendering_parameters.get_camera_type()));
+        file.write_uint32(static_cast<std::uint32_t>(rendering_parameters.get_screen_width()));
+        file.write_uint32(static_cast<std::uint32_t>(rendering_parameters.get_screen_height()));
+        for (const float value : {rotation.w, rotation.x, rotation.y, rotation.z, modelview[3][0],
+                                  modelview[3][1], frustum.l, frustum.r, frustum.b, frustum.t})
+        {
+            file.write_float32(value);
+        }
+        write_coefficients(fitting_result.pca_shape_coefficients, num_shape_coefficients);
+        write_coefficients(fitting_result.expression_coefficients, num_expression_coefficients);
+        write_coefficients(fitting_result.pca_color_coefficients, num_color_coefficients);
+        frame_numbers.push_back(frame_number);
+    };
+
+    /**
+     * Writes all records that have been added to the file, and hands them to the operating
+     * system. It doesn't wait until they are on the disk, see BufferedWriter::flush_to_os().
+     *
+     * @throw std::runtime_error If writing to the file failed.
+     */
+    void flush()
+    {
+        file.flush_to_os();
+    };
+
+    /**
+     * Writes the footer, and closes the file.
+     *
+     * @throw std::runtime_error If writing to the file failed.
+     */
+    void close()
+    {
+        closed = true;
+        file.write(detail::fitting_log_footer_start_magic, sizeof(detail::fitting_log_footer_start_magic));
+        for (const auto frame_number : frame_numbers)
+        {
+            file.write_uint64(static_cast<std::uint64_t>(frame_number));
+        }
+        file.write_uint64(frame_numbers.size());
+        file.write(detail::fitting_log_footer_magic, sizeof(detail::fitting_log_footer_magic));
+        file.close();
+    };
+
+private:
+    core::detail::BufferedWriter file;
+    int num_shape_coefficients;
+    int num_expression_coefficients;
+    int num_color_coefficients;
+    std::vector<std::int64_t> frame_numbers; ///< For the footer.
+    bool closed = false;
+
+    void write_coefficients(const std::vector<float>& coefficients, int num_coefficients)
+    {
+        for (const float coefficient : coefficients)
+        {
+            file.write_float32(coefficient);
+        }
+        for (int i = static_cast<int>(coefficients.size()); i < num_coefficients; ++i)
+        {
+            file.write_float32(0.0f);
+        }
+    };
+};
+
+/**
+ * @brief Reads a fitting result log written by FittingResultLogWriter.
+ *
+ * The file is memory-mapped. Single records can be read by their position in the log, or looked
+ * up by their frame number, in constant time. The get_*_coefficients() functions read one value
+ * of every record into a contiguous matrix, e.g. to analyse the coefficients over the video.
+ */
+class FittingResultLogReader
+{
+public:
+    /**
+     * Opens the given log.
+     *
+     * @param[in] filename The log file.
+     * @throw std::runtime_error If the file can't be opened, or isn't a fitting result log.
+     */
+    explicit FittingResultLogReader(std::string filename)
+        : file(std::make_shared<const core::MemoryMappedFile>(filename))
+    {
+        const char* const data = file->data();
+        const std::size_t size = file->size();
+        if (size < detail::fitting_log_header_size ||
+            std::memcmp(data, detail::fitting_log_magic, sizeof(detail::fitting_log_magic)) != 0)
+        {
+            throw std::runtime_error("FittingResultLogReader: Not a fitting result log: " + filename);
+        }
+        if (core::detail::read_uint32(data + 8) != detail::fitting_log_version)
+        {
+            throw std::runtime_error("FittingResultLogReader: Unsupported log version: " + filename);
+        }
+        num_shape_coefficients = static_cast<int>(core::detail::read_uint32(data + 12));
+        num_expression_coefficients = static_cast<int>(core::detail::read_uint32(data + 16));
+        num_color_coefficients = static_cast<int>(core::detail::read_uint32(data + 20));
+        record_size = core::detail::read_uint32(data + 24);
+        if (record_size != detail::get_fitting_log_record_size(num_shape_coefficients +
+                                                               num_expression_coefficients +
+                                                               num_color_coefficients))
+        {
+            throw std::runtime_error("FittingResultLogReader: Not a fitting result log: " + filename);
+        }
+
+        // Use the footer if there is a complete one, otherwise, recover the complete records:
+        const std::size_t footer_tail_size = 8 + sizeof(detail::fitting_log_footer_magic);
+        const std::size_t footer_start_size = sizeof(detail::fitting_log_footer_start_magic);
+        bool has_footer = false;
+        if (size >= detail::fitting_log_header_size + footer_start_size + footer_tail_size &&
+            std::memcmp(data + size - 8, detail::fitting_log_footer_magic, 8) == 0)
+        {
+            num_records = core::detail::read_uint64(data + size - footer_tail_size);
+            const std::size_t footer_size = footer_start_size + num_records * 8 + footer_tail_size;
+            has_footer = num_records <= size / (record_size + 8) &&
+                         detail::fitting_log_header_size + num_records * record_size + footer_size == size &&
+                         std::memcmp(get_record_data(num_records), detail::fitting_log_footer_start_magic,
+                                     footer_start_size) == 0;
+        }
+        if (!has_footer)
+        {
+            num_records = (size - detail::fitting_log_header_size) / record_size;
+            // The start of a footer that was only partly written isn't a record:
+            for (std::size_t i = 0; i < num_records; ++i)
+            {
+                if (std::memcmp(get_record_data(i), detail::fitting_log_footer_start_magic,
+                                footer_start_size) == 0)
+                {
+                    num_records = i;
+                    break;
+                }
+            }
+        }
+        const char* const frame_numbers =
+            has_footer ? get_record_data(num_records) + footer_start_size : nullptr;
+        frame_to_record.reserve(num_records);
+        for (std::size_t i = 0; i < num_records; ++i)
+        {
+            const std::int64_t frame_number = static_cast<std::int64_t>(core::detail::read_uint64(
+                has_footer ? frame_numbers + 8 * i : get_record_data(i)));
+            frame_to_record.emplace(frame_number, i); // If a frame was logged twice, the first one is used.
+        }
+    };
+
+    /**
+     * Returns the number of records (frames) in the log.
+     *
+     * @return The number of records.
+     */
+    std::size_t get_num_records() const
+    {
+        return num_records;
+    };
+
+    int get_num_shape_coefficients() const
+    {
+        return num_shape_coefficients;
+    };
+
+    int get_num_expression_coefficients() const
+    {
+        return num_expression_coefficients;
+    };
+
+    int get_num_color_coefficients() const
+    {
+        return num_color_coefficients;
+    };
+
+    /**
+     * Returns the position of the record of the given frame in the log.
+     *
+     * @param[in] frame_number A frame number.
+     * @return The index of the record, or an empty optional if the frame isn't in the log.
+     */
+    cpp17::optional<std::size_t> find_frame(std::int64_t frame_number) const
+    {
+        const auto record = frame_to_record.find(frame_number);
+        if (record == std::end(frame_to_record))
+        {
+            return cpp17::nullopt;
+        }
+        return record->second;
+    };
+
+    /**
+     * Returns the frame number of the given record.
+     *
+     * @param[in] record The index of a record, in [0, get_num_records()).
+     * @return The frame number.
+     */
+    std::int64_t get_frame_number(std::size_t record) const
+    {
+        check_record(record);
+        return static_cast<std::int64_t>(core::detail::read_uint64(get_record_data(record)));
+    };
+
+    /**
+     * Reads the given record.
+     *
+     * @param[in] record The index of a record, in [0, get_num_records()).
+     * @return The fitting result.
+     * @throw std::runtime_error If the record index is out of range.
+     */
+    FittingResult read(std::size_t record) const
+    {
+        check_record(record);
+        const char* p = get_record_data(record) + 8;
+        const auto camera_type = static_cast<CameraType>(core::detail::read_uint32(p));
+        const int screen_width = static_cast<int>(core::detail::read_uint32(p + 4));
+        const int screen_height = static_cast<int>(core::detail::read_uint32(p + 8));
+        p += 12;
+        float values[10];
+        for (auto& value : values)
+        {
+            value = core::detail::read_float32(p);
+            p += 4;
+        }
+        glm::quat rotation;
+        rotation.w = values[0];
+        rotation.x = values[1];
+        rotation.y = values[2];
+        rotation.z = values[3];
+
+        FittingResult fitting_result;
+        fitting_result.rendering_parameters =
+            RenderingParameters(camera_type, Frustum(values[6], values[7], values[8], values[9]), 0.0f, 0.0f,
+                                0.0f, values[4], values[5], screen_width, screen_height);
+        fitting_result.rendering_parameters.set_rotation(rotation);
+        const auto read_coefficients = [&p](int num_coefficients) {
+            std::vector<float> coefficients(num_coefficients);
+            for (auto& coefficient : coefficients)
+            {
+                coefficient = core::detail::read_float32(p);
+                p += 4;
+            }
+            return coefficients;
+        };
+        fitting_result.pca_shape_coefficients = read_coefficients(num_shape_coefficients);
+        fitting_result.expression_coefficients = read_coefficients(num_expression_coefficients);
+        fitting_result.pca_color_coefficients = read_coefficients(num_color_coefficients);
+        return fitting_result;
+    };
+
+    /**
+     * Returns the frame numbers of all records.
+     *
+     * @return The frame number of every record.
+     */
+    std::vector<std::int64_t> get_frame_numbers() const
+    {
+        std::vector<std::int64_t> frame_numbers(num_records);
+        for (std::size_t i = 0; i < num_records; ++i)
+        {
+            frame_numbers[i] = static_cast<std::int64_t>(core::detail::read_uint64(get_record_data(i)));
+        }
+        return frame_numbers;
+    };
+
+    /**
+     * Returns the rotation quaternions of all records.
+     *
+     * @return A get_num_records() x 4 matrix, with the (w, x, y, z) components in each row.
+     */
+    Eigen::MatrixXf get_rotations() const
+    {
+        return read_columns(20, 4);
+    };
+
+    /**
+     * Returns the translations of all records.
+     *
+     * @return A get_num_records() x 2 matrix, with the x and y translation in each row.
+     */
+    Eigen::MatrixXf get_translations() const
+    {
+        return read_columns(36, 2);
+    };
+
+    /**
+     * Returns the shape coefficients of all records.
+     *
+     * @return A get_num_records() x get_num_shape_coefficients() matrix, one record per row.
+     */
+    Eigen::MatrixXf get_shape_coefficients() const
+    {
+        return read_columns(detail::fitting_log_record_base_size, num_shape_coefficients);
+    };
+
+    /**
+     * Returns the expression coefficients of all records.
+     *
+     * @return A get_num_records() x get_num_expression_coefficients() matrix, one record per row.
+     */
+    Eigen::MatrixXf get_expression_coefficients() const
+    {
+        return read_columns(detail::fitting_log_record_base_size + 4 * num_shape_coefficients,
+                            num_expression_coefficients);
+    };
+
+    /**
+     * Returns the colour coefficients of all records.
+     *
+     * @return A get_num_records() x get_num_color_coefficients() matrix, one record per row.
+     */
+    Eigen::MatrixXf get_color_coefficients() const
+    {
+        return read_columns(detail::fitting_log_record_base_size +
+                                4 * (num_shape_coefficients + num_expression_coefficients),
+                            num_color_coefficients);
+    };
+
+private:
+    std::shared_ptr<const core::MemoryMappedFile> file;
+    int num_shape_coefficients = 0;
+    int num_expression_coefficients = 0;
+    int num_color_coefficients = 0;
+    std::size_t record_size = 0;
+    std::size_t num_records = 0;
+    std::unordered_map<std::int64_t, std::size_t> frame_to_record;
+
+    const char* get_record_data(std::size_t record) const
+    {
+        return file->data() + detail::fitting_log_header_size + record * record_size;
+    };
+
+    void check_record(std::size_t record) const
+    {
+        if (record >= num_records)
+        {
+            throw std::runtime_error("FittingResultLogReader: The record index is out of range.");
+        }
+    };
+
+    // Reads num_columns consecutive floats at the given offset of every record into the rows of a matrix.
+    Eigen::MatrixXf read_columns(std::size_t offset, int num_columns) const
+    {
+        Eigen::MatrixXf matrix(num_records, num_columns);
+        for (std::size_t i = 0; i < num_records; ++i)
+        {
+            const char* const p = get_record_data(i) + offset;
+            for (int j = 0; j < num_columns; ++j)
+            {
+                matrix(i, j) = core::detail::read_float32(p + 4 * j);
+            }
+        }
+        return matrix;
+    };
+};
+
+} /* namespace fitting */
+} /* namespace eos */
+
+#endif /* FITTINGRESULTLOG_HPP_ */
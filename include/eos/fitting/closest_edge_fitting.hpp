@@ -127,13 +127,15 @@ inline std::vector<int> occluding_boundary_vertices(const core::Mesh& mesh,
 {
     // Rotate the mesh:
     std::vector<glm::vec4> rotated_vertices;
-    std::for_each(begin(mesh.vertices), end(mesh.vertices), [&rotated_vertices, &R](const auto& v) {
+    rotated_vertices.reserve(mesh.vertices.size());
+    for (const auto& v : mesh.vertices)
+    {
         rotated_vertices.push_back(R * glm::vec4(v[0], v[1], v[2], 1.0f));
-    });
+    }
 
     // Compute the face normals of the rotated mesh:
     std::vector<glm::vec3> facenormals;
-    for (const auto& f : mesh.tvi)
+    for (const auto& f : mesh.tvi())
     { // for each face (triangle):
         const auto n =
             render::compute_face_normal(glm::vec3(rotated_vertices[f[0]]), glm::vec3(rotated_vertices[f[1]]),
@@ -182,7 +184,7 @@ inline std::vector<int> occluding_boundary_vertices(const core::Mesh& mesh,
     {
         bool visible = true;
         // For every tri of the rotated mesh:
-        for (const auto& tri : mesh.tvi)
+        for (const auto& tri : mesh.tvi())
         {
             auto& v0 = rotated_vertices[tri[0]];
             auto& v1 = rotated_vertices[tri[1]];
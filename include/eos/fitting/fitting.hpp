@@ -312,9 +312,7 @@ inline std::pair<core::Mesh, fitting::RenderingParameters> fit_shape_and_pose(
         current_pca_shape + blendshapes_as_basis * Eigen::Map<const VectorXf>(blendshape_coefficients.data(),
                                                                               blendshape_coefficients.size());
     auto current_mesh = morphablemodel::sample_to_mesh(
-        current_combined_shape, morphable_model.get_color_model().get_mean(),
-        morphable_model.get_shape_model().get_triangle_list(),
-        morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+        current_combined_shape, morphable_model.get_color_model().get_mean(), morphable_model.get_topology());
 
     // The 2D and 3D point correspondences used for the fitting:
     vector<Vector4f> model_points; // the points in the 3D shape model
@@ -354,10 +352,7 @@ inline std::pair<core::Mesh, fitting::RenderingParameters> fit_shape_and_pose(
         current_pca_shape +
         morphablemodel::to_matrix(blendshapes) *
             Eigen::Map<const VectorXf>(blendshape_coefficients.data(), blendshape_coefficients.size());
-    current_mesh = morphablemodel::sample_to_mesh(
-        current_combined_shape, morphable_model.get_color_model().get_mean(),
-        morphable_model.get_shape_model().get_triangle_list(),
-        morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+    current_mesh.update_vertices(current_combined_shape);
 
     // The static (fixed) landmark correspondences which will stay the same throughout
     // the fitting (the inner face landmarks):
@@ -439,10 +434,7 @@ inline std::pair<core::Mesh, fitting::RenderingParameters> fit_shape_and_pose(
             current_pca_shape +
             blendshapes_as_basis *
                 Eigen::Map<const VectorXf>(blendshape_coefficients.data(), blendshape_coefficients.size());
-        current_mesh = morphablemodel::sample_to_mesh(
-            current_combined_shape, morphable_model.get_color_model().get_mean(),
-            morphable_model.get_shape_model().get_triangle_list(),
-            morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+        current_mesh.update_vertices(current_combined_shape);
     }
 
     fitted_image_points = image_points;
@@ -23,6 +23,7 @@
 #define LINEARSHAPEFITTING_HPP_
 
 #include "eos/morphablemodel/PcaModel.hpp"
+#include "eos/morphablemodel/QuantisedPcaModel.hpp"
 #include "eos/cpp17/optional.hpp"
 
 #include "Eigen/Core"
@@ -32,6 +33,7 @@
 #include <vector>
 #include <cstdint>
 #include <cassert>
+#include <utility>
 
 namespace eos {
 namespace fitting {
@@ -63,7 +65,38 @@ inline std::vector<float> fit_shape_to_landmarks_linear(
     Eigen::VectorXf base_face = Eigen::VectorXf(), float lambda = 3.0f,
     cpp17::optional<int> num_coefficients_to_fit = cpp17::optional<int>(),
     cpp17::optional<float> detector_standard_deviation = cpp17::optional<float>(),
-    cpp17::optional<float> model_standard_deviation = cpp17::optional<float>())
+    cpp17::optional<float> model_standard_deviation = cpp17::optional<float>());
+
+/**
+ * Fits the shape of a quantised Morphable Model to given 2D landmarks, like
+ * fit_shape_to_landmarks_linear(const morphablemodel::PcaModel&, ...). Only the basis rows of
+ * the landmark vertices are dequantised.
+ *
+ * The parameters are the same as the ones of the PcaModel overload.
+ *
+ * @return The estimated shape-coefficients (alphas).
+ */
+template <typename QuantisedType>
+std::vector<float> fit_shape_to_landmarks_linear(
+    const morphablemodel::QuantisedPcaModel<QuantisedType>& shape_model,
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix, const std::vector<Eigen::Vector2f>& landmarks,
+    const std::vector<int>& vertex_ids, Eigen::VectorXf base_face = Eigen::VectorXf(), float lambda = 3.0f,
+    cpp17::optional<int> num_coefficients_to_fit = cpp17::optional<int>(),
+    cpp17::optional<float> detector_standard_deviation = cpp17::optional<float>(),
+    cpp17::optional<float> model_standard_deviation = cpp17::optional<float>());
+
+namespace detail {
+
+/**
+ * The implementation of fit_shape_to_landmarks_linear(...), for any shape model that provides
+ * get_num_principal_components(), get_mean() and get_rescaled_pca_basis_at_point(int).
+ */
+template <typename ShapeModel>
+std::vector<float> fit_shape_to_landmarks_linear(
+    const ShapeModel& shape_model, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+    const std::vector<Eigen::Vector2f>& landmarks, const std::vector<int>& vertex_ids,
+    Eigen::VectorXf base_face, float lambda, cpp17::optional<int> num_coefficients_to_fit,
+    cpp17::optional<float> detector_standard_deviation, cpp17::optional<float> model_standard_deviation)
 {
     assert(landmarks.size() == vertex_ids.size());
 
@@ -156,6 +189,32 @@ inline std::vector<float> fit_shape_to_landmarks_linear(
     return std::vector<float>(c_s.data(), c_s.data() + c_s.size());
 };
 
+} /* namespace detail */
+
+inline std::vector<float> fit_shape_to_landmarks_linear(
+    const morphablemodel::PcaModel& shape_model, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+    const std::vector<Eigen::Vector2f>& landmarks, const std::vector<int>& vertex_ids,
+    Eigen::VectorXf base_face, float lambda, cpp17::optional<int> num_coefficients_to_fit,
+    cpp17::optional<float> detector_standard_deviation, cpp17::optional<float> model_standard_deviation)
+{
+    return detail::fit_shape_to_landmarks_linear(shape_model, affine_camera_matrix, landmarks, vertex_ids,
+                                                 std::move(base_face), lambda, num_coefficients_to_fit,
+                                                 detector_standard_deviation, model_standard_deviation);
+};
+
+template <typename QuantisedType>
+std::vector<float> fit_shape_to_landmarks_linear(
+    const morphablemodel::QuantisedPcaModel<QuantisedType>& shape_model,
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix, const std::vector<Eigen::Vector2f>& landmarks,
+    const std::vector<int>& vertex_ids, Eigen::VectorXf base_face, float lambda,
+    cpp17::optional<int> num_coefficients_to_fit, cpp17::optional<float> detector_standard_deviation,
+    cpp17::optional<float> model_standard_deviation)
+{
+    return detail::fit_shape_to_landmarks_linear(shape_model, affine_camera_matrix, landmarks, vertex_ids,
+                                                 std::move(base_face), lambda, num_coefficients_to_fit,
+                                                 detector_standard_deviation, model_standard_deviation);
+};
+
 /**
 * Fits the shape of a Morphable Model to given 2D landmarks from multiple images.
 *
@@ -156,8 +156,7 @@ inline std::pair<std::vector<core::Mesh>, std::vector<fitting::RenderingParamete
 
         core::Mesh current_mesh = morphablemodel::sample_to_mesh(
             current_combined_shape, morphable_model.get_color_model().get_mean(),
-            morphable_model.get_shape_model().get_triangle_list(),
-            morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+            morphable_model.get_topology());
         current_meshes.push_back(current_mesh);
     }
 
@@ -218,10 +217,7 @@ inline std::pair<std::vector<core::Mesh>, std::vector<fitting::RenderingParamete
             current_pca_shape + morphablemodel::to_matrix(blendshapes) *
                                     Eigen::Map<const Eigen::VectorXf>(blendshape_coefficients[j].data(),
                                                                       blendshape_coefficients[j].size());
-        current_meshes[j] = morphablemodel::sample_to_mesh(
-            current_combined_shapes[j], morphable_model.get_color_model().get_mean(),
-            morphable_model.get_shape_model().get_triangle_list(),
-            morphable_model.get_color_model().get_triangle_list(), morphable_model.get_texture_coordinates());
+        current_meshes[j].update_vertices(current_combined_shapes[j]);
     }
 
     // The static (fixed) landmark correspondences which will stay the same throughout
@@ -319,11 +315,7 @@ inline std::pair<std::vector<core::Mesh>, std::vector<fitting::RenderingParamete
                 current_pca_shape +
                 blendshapes_as_basis * Eigen::Map<const Eigen::VectorXf>(blendshape_coefficients[j].data(),
                                                                          blendshape_coefficients[j].size());
-            current_meshes[j] = morphablemodel::sample_to_mesh(
-                current_combined_shapes[j], morphable_model.get_color_model().get_mean(),
-                morphable_model.get_shape_model().get_triangle_list(),
-                morphable_model.get_color_model().get_triangle_list(),
-                morphable_model.get_texture_coordinates());
+            current_meshes[j].update_vertices(current_combined_shapes[j]);
         }
     }
 
@@ -0,0 +1,315 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/morphablemodel/MeshletTopology.hpp
+ *
+ * Copyright 2026 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef MESHLETTOPOLOGY_HPP_
+#define MESHLETTOPOLOGY_HPP_
+
+#include "eos/core/Mesh.hpp"
+
+#include "cereal/cereal.hpp"
+#include "cereal/types/array.hpp"
+#include "cereal/types/vector.hpp"
+#include "cereal/archives/json.hpp"
+
+#include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace eos {
+namespace morphablemodel {
+
+/**
+ * @brief A cluster of neighbouring triangles of a mesh, together with bounds that
+ * allow culling the whole cluster at once.
+ *
+ * The triangles of the meshlet are
+ * MeshletTopology::triangle_indices[triangle_offset, triangle_offset + triangle_count).
+ *
+ * The bounding sphere contains all vertices of the meshlet. The normal cone contains
+ * the normals of all its triangles: Every triangle normal n fulfils
+ * angle(n, cone_axis) <= asin(cone_cutoff). If the triangle normals span 90 degrees or
+ * more, cone_cutoff is 1 and the meshlet can never be backface-culled.
+ */
+struct Meshlet
+{
+    int triangle_offset; ///< Index of the meshlet's first triangle in MeshletTopology::triangle_indices
+    int triangle_count;  ///< Number of triangles of the meshlet
+
+    std::array<float, 3> center; ///< Centre of the bounding sphere
+    float radius;                ///< Radius of the bounding sphere
+
+    std::array<float, 3> cone_axis; ///< Unit-length axis of the normal cone
+    float cone_cutoff;              ///< Sine of the normal cone's half-angle, or 1 if it spans >= 90 degrees
+
+    friend class cereal::access;
+    /**
+     * Serialises this class using cereal.
+     *
+     * @param[in] archive The archive to serialise to (or to serialise from).
+     */
+    template <class Archive>
+    void serialize(Archive& archive)
+    {
+        archive(CEREAL_NVP(triangle_offset), CEREAL_NVP(triangle_count), CEREAL_NVP(center),
+                CEREAL_NVP(radius), CEREAL_NVP(cone_axis), CEREAL_NVP(cone_cutoff));
+    };
+};
+
+/**
+ * @brief A struct containing a partition of a 3D shape model's triangles into meshlets.
+ *
+ * Each meshlet is a connected cluster of a few dozen to a hundred triangles. The
+ * renderers can test a whole meshlet against the view frustum and against the viewing
+ * direction (backface culling) before doing any per-triangle work, see
+ * render::detail::cull_meshlets(...).
+ *
+ * The partition only depends on the mesh topology, so it can be computed once per model
+ * with compute_meshlet_topology(...) and stored alongside the model, like the
+ * EdgeTopology. The bounds depend on the vertex positions though: When rendering a
+ * different shape instance than the one the topology was computed from (for example
+ * after fitting), the bounds need to be recomputed with update_meshlet_bounds(...),
+ * otherwise visible triangles may be culled.
+ *
+ * triangle_indices.size() is equal to the number of triangles of the mesh.
+ */
+struct MeshletTopology
+{
+    std::vector<int> triangle_indices; ///< Indices into core::Mesh::tvi, ordered by meshlet
+    std::vector<Meshlet> meshlets;     ///< The meshlets, each refers to a range of triangle_indices
+
+    friend class cereal::access;
+    /**
+     * Serialises this class using cereal.
+     *
+     * @param[in] archive The archive to serialise to (or to serialise from).
+     */
+    template <class Archive>
+    void serialize(Archive& archive)
+    {
+        archive(CEREAL_NVP(triangle_indices), CEREAL_NVP(meshlets));
+    };
+};
+
+/**
+ * Recomputes the bounding sphere and normal cone of all meshlets from the given mesh.
+ *
+ * The mesh has to have the same triangles as the mesh the topology was computed from,
+ * but the vertex positions can differ (e.g. a different shape instance of the same
+ * model). Each cone axis is the normalised average of the triangle normals, and the
+ * cutoff is the sine of the largest angle between the axis and any triangle normal.
+ * Degenerate triangles are ignored.
+ *
+ * @param[in,out] meshlet_topology A meshlet topology whose bounds to update.
+ * @param[in] mesh The mesh the bounds are computed from.
+ */
+inline void update_meshlet_bounds(MeshletTopology& meshlet_topology, const core::Mesh& mesh)
+{
+    for (auto& meshlet : meshlet_topology.meshlets)
+    {
+        const auto triangles_begin = std::begin(meshlet_topology.triangle_indices) + meshlet.triangle_offset;
+        const auto triangles_end = triangles_begin + meshlet.triangle_count;
+
+        // Bounding sphere: Centred at the centroid of the triangle vertices. This is not the minimal
+        // sphere, but it's close for compact, roughly planar clusters, and cheap to compute.
+        Eigen::Vector3f center = Eigen::Vector3f::Zero();
+        Eigen::Vector3f axis = Eigen::Vector3f::Zero();
+        for (auto t = triangles_begin; t != triangles_end; ++t)
+        {
+            const auto& tri = mesh.tvi()[*t];
+            const Eigen::Vector3f v0 = mesh.vertices[tri[0]];
+            const Eigen::Vector3f v1 = mesh.vertices[tri[1]];
+            const Eigen::Vector3f v2 = mesh.vertices[tri[2]];
+            center += v0 + v1 + v2;
+            const Eigen::Vector3f normal = (v1 - v0).cross(v2 - v0);
+            if (normal.norm() > 0.0f)
+            {
+                axis += normal.normalized();
+            }
+        }
+        center /= 3.0f * meshlet.triangle_count;
+
+        float radius = 0.0f;
+        for (auto t = triangles_begin; t != triangles_end; ++t)
+        {
+            for (const auto vertex_index : mesh.tvi()[*t])
+            {
+                radius = std::max(radius, (mesh.vertices[vertex_index] - center).norm());
+            }
+        }
+
+        // Normal cone: cos_min is the cosine of the largest angle between the axis and a triangle normal.
+        float cos_min = -1.0f;
+        if (axis.norm() > 0.0f)
+        {
+            axis.normalize();
+            cos_min = 1.0f;
+            for (auto t = triangles_begin; t != triangles_end; ++t)
+            {
+                const auto& tri = mesh.tvi()[*t];
+                const Eigen::Vector3f normal = (mesh.vertices[tri[1]] - mesh.vertices[tri[0]])
+                                                   .cross(mesh.vertices[tri[2]] - mesh.vertices[tri[0]]);
+                if (normal.norm() > 0.0f)
+                {
+                    cos_min = std::min(cos_min, axis.dot(normal.normalized()));
+                }
+            }
+        }
+
+        meshlet.center = {center[0], center[1], center[2]};
+        meshlet.radius = radius;
+        meshlet.cone_axis = {axis[0], axis[1], axis[2]};
+        // If the normals span 90 degrees or more, no viewing direction sees only back-faces:
+        meshlet.cone_cutoff = cos_min > 0.0f ? std::sqrt(1.0f - cos_min * cos_min) : 1.0f;
+    }
+};
+
+/**
+ * Partitions the triangles of the given mesh into meshlets, and computes the bounds of
+ * each meshlet from the mesh's vertex positions.
+ *
+ * Meshlets are grown greedily: Starting from the first triangle that is not yet part of
+ * a meshlet, neighbouring triangles (triangles that share a vertex) are added in
+ * breadth-first order, until the meshlet contains \p max_triangles_per_meshlet triangles
+ * or there are no more unassigned neighbours. This gives compact, connected clusters,
+ * which have tight bounding spheres and narrow normal cones.
+ *
+ * This only needs to be run once per model topology, e.g. on the mean mesh, and the
+ * result can be stored with save_meshlet_topology(...).
+ *
+ * @param[in] mesh The mesh to partition.
+ * @param[in] max_triangles_per_meshlet Maximum number of triangles per meshlet.
+ * @return The meshlet topology of the mesh.
+ * @throws std::runtime_error if max_triangles_per_meshlet is not positive.
+ */
+inline MeshletTopology compute_meshlet_topology(const core::Mesh& mesh, int max_triangles_per_meshlet = 128)
+{
+    if (max_triangles_per_meshlet <= 0)
+    {
+        throw std::runtime_error("The maximum number of triangles per meshlet has to be positive.");
+    }
+    const int num_triangles = static_cast<int>(mesh.tvi().size());
+
+    // For each vertex, the triangles adjacent to it:
+    std::vector<std::vector<int>> vertex_triangles(mesh.vertices.size());
+    for (int t = 0; t < num_triangles; ++t)
+    {
+        for (const auto vertex_index : mesh.tvi()[t])
+        {
+            vertex_triangles[vertex_index].push_back(t);
+        }
+    }
+
+    MeshletTopology meshlet_topology;
+    meshlet_topology.triangle_indices.reserve(num_triangles);
+    std::vector<bool> assigned(num_triangles, false);
+    std::deque<int> candidates;
+    for (int seed = 0; seed < num_triangles; ++seed)
+    {
+        if (assigned[seed])
+        {
+            continue;
+        }
+        Meshlet meshlet{};
+        meshlet.triangle_offset = static_cast<int>(meshlet_topology.triangle_indices.size());
+        candidates.clear();
+        candidates.push_back(seed);
+        assigned[seed] = true;
+        while (!candidates.empty() && meshlet.triangle_count < max_triangles_per_meshlet)
+        {
+            const int t = candidates.front();
+            candidates.pop_front();
+            meshlet_topology.triangle_indices.push_back(t);
+            ++meshlet.triangle_count;
+            for (const auto vertex_index : mesh.tvi()[t])
+            {
+                for (const auto neighbour : vertex_triangles[vertex_index])
+                {
+                    if (!assigned[neighbour])
+                    {
+                        assigned[neighbour] = true;
+                        candidates.push_back(neighbour);
+                    }
+                }
+            }
+        }
+        // Candidates that didn't fit into this meshlet are free again, and will seed or join later ones:
+        for (const auto t : candidates)
+        {
+            assigned[t] = false;
+        }
+        meshlet_topology.meshlets.push_back(meshlet);
+    }
+
+    update_meshlet_bounds(meshlet_topology, mesh);
+    return meshlet_topology;
+};
+
+/**
+ * Saves a 3DMM meshlet topology file to a json file.
+ *
+ * @param[in] meshlet_topology A model's meshlet topology.
+ * @param[in] filename The file to write.
+ * @throws std::runtime_error if unable to open the given file for writing.
+ */
+inline void save_meshlet_topology(const MeshletTopology& meshlet_topology, std::string filename)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Error creating given file: " + filename);
+    }
+    cereal::JSONOutputArchive output_archive(file);
+    output_archive(cereal::make_nvp("meshlet_topology", meshlet_topology));
+};
+
+/**
+ * Load a 3DMM meshlet topology file from a json file.
+ *
+ * @param[in] filename The file to load the meshlet topology from.
+ * @return A struct containing the meshlet topology.
+ * @throws std::runtime_error if unable to open the given file for reading.
+ */
+inline MeshletTopology load_meshlet_topology(std::string filename)
+{
+    MeshletTopology meshlet_topology;
+    std::ifstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Error opening file for reading: " + filename);
+    }
+    cereal::JSONInputArchive input_archive(file);
+    input_archive(cereal::make_nvp("meshlet_topology", meshlet_topology));
+
+    return meshlet_topology;
+};
+
+} /* namespace morphablemodel */
+} /* namespace eos */
+
+#endif /* MESHLETTOPOLOGY_HPP_ */
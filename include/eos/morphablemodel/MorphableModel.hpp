@@ -23,8 +23,9 @@
 #define MORPHABLEMODEL_HPP_
 
 #include "eos/core/Mesh.hpp"
+#include "eos/core/MeshTopology.hpp"
 #include "eos/morphablemodel/PcaModel.hpp"
-#include "eos/cpp17/clamp.hpp"
+#include "eos/cpp17/optional.hpp"
 
 #include "cereal/access.hpp"
 #include "cereal/cereal.hpp"
@@ -36,18 +37,53 @@
 #include "Eigen/Core"
 
 #include <array>
+#include <cassert>
 #include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
 #include <vector>
 #include <fstream>
 
 namespace eos {
 namespace morphablemodel {
 
-// Forward declaration:
+// Forward declarations:
 core::Mesh sample_to_mesh(
     const Eigen::VectorXf& shape_instance, const Eigen::VectorXf& color_instance,
     const std::vector<std::array<int, 3>>& tvi, const std::vector<std::array<int, 3>>& tci,
     const std::vector<std::array<double, 2>>& texture_coordinates = std::vector<std::array<double, 2>>());
+core::Mesh sample_to_mesh(Eigen::VectorXf shape_instance, Eigen::VectorXf color_instance,
+                          std::shared_ptr<const core::MeshTopology> topology);
+
+namespace detail {
+
+/**
+ * Creates a topology from the triangle lists and the texture coordinates of a model.
+ *
+ * @param[in] tvi Triangle vertex indices.
+ * @param[in] tci Triangle colour indices (empty in case of a shape-only model).
+ * @param[in] texture_coordinates Texture coordinates for each vertex, or empty.
+ * @return The topology, to be shared by the meshes of the model.
+ */
+inline std::shared_ptr<const core::MeshTopology>
+create_topology(const std::vector<std::array<int, 3>>& tvi, const std::vector<std::array<int, 3>>& tci,
+                const std::vector<std::array<double, 2>>& texture_coordinates)
+{
+    core::MeshTopology topology;
+    topology.tvi = tvi;
+    topology.tci = tci;
+    topology.texcoords.reserve(texture_coordinates.size());
+    for (const auto& texture_coordinate : texture_coordinates)
+    {
+        topology.texcoords.emplace_back(texture_coordinate[0], texture_coordinate[1]);
+    }
+    return std::make_shared<const core::MeshTopology>(std::move(topology));
+};
+
+} /* namespace detail */
 
 /**
  * @brief A class representing a 3D Morphable Model, consisting
@@ -72,7 +108,10 @@ public:
     MorphableModel(
         PcaModel shape_model, PcaModel color_model,
         std::vector<std::array<double, 2>> texture_coordinates = std::vector<std::array<double, 2>>())
-        : shape_model(shape_model), color_model(color_model), texture_coordinates(texture_coordinates){};
+        : shape_model(shape_model), color_model(color_model), texture_coordinates(texture_coordinates),
+          topology(detail::create_topology(this->shape_model.get_triangle_list(),
+                                           this->color_model.get_triangle_list(),
+                                           this->texture_coordinates)){};
 
     /**
      * Returns the PCA shape model of this Morphable Model.
@@ -105,20 +144,7 @@ public:
                !has_color_model()); // The number of vertices (= model.getDataDimension() / 3) has to be equal
                                     // for both models, or, alternatively, it has to be a shape-only model.
 
-        const Eigen::VectorXf shape = shape_model.get_mean();
-        const Eigen::VectorXf color = color_model.get_mean();
-
-        core::Mesh mesh;
-        if (has_texture_coordinates())
-        {
-            mesh = sample_to_mesh(shape, color, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list(), texture_coordinates);
-        } else
-        {
-            mesh = sample_to_mesh(shape, color, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list());
-        }
-        return mesh;
+        return sample_to_mesh(shape_model.get_mean(), color_model.get_mean(), topology);
     };
 
     /**
@@ -141,20 +167,8 @@ public:
                !has_color_model()); // The number of vertices (= model.getDataDimension() / 3) has to be equal
                                     // for both models, or, alternatively, it has to be a shape-only model.
 
-        const Eigen::VectorXf shape_sample = shape_model.draw_sample(engine, shape_sigma);
-        const Eigen::VectorXf color_sample = color_model.draw_sample(engine, color_sigma);
-
-        core::Mesh mesh;
-        if (has_texture_coordinates())
-        {
-            mesh = sample_to_mesh(shape_sample, color_sample, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list(), texture_coordinates);
-        } else
-        {
-            mesh = sample_to_mesh(shape_sample, color_sample, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list());
-        }
-        return mesh;
+        return sample_to_mesh(shape_model.draw_sample(engine, shape_sigma),
+                              color_model.draw_sample(engine, color_sigma), topology);
     };
 
     /**
@@ -195,17 +209,7 @@ public:
             color_sample = color_model.draw_sample(color_coefficients);
         }
 
-        core::Mesh mesh;
-        if (has_texture_coordinates())
-        {
-            mesh = sample_to_mesh(shape_sample, color_sample, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list(), texture_coordinates);
-        } else
-        {
-            mesh = sample_to_mesh(shape_sample, color_sample, shape_model.get_triangle_list(),
-                                  color_model.get_triangle_list());
-        }
-        return mesh;
+        return sample_to_mesh(std::move(shape_sample), std::move(color_sample), topology);
     };
 
     /**
@@ -224,37 +228,53 @@ public:
      *
      * @return The texture coordinates for the model vertices.
      */
-    std::vector<std::array<double, 2>> get_texture_coordinates() const
+    const std::vector<std::array<double, 2>>& get_texture_coordinates() const
     {
         return texture_coordinates;
     };
 
+    /**
+     * Returns the topology of the meshes of the model, i.e. the triangle lists of the shape and
+     * colour model, and the texture coordinates.
+     *
+     * All the meshes that the model creates share this topology, and sample_to_mesh(...) can be
+     * given it, to create meshes without copying the triangle lists.
+     *
+     * @return The topology of the model's meshes.
+     */
+    const std::shared_ptr<const core::MeshTopology>& get_topology() const
+    {
+        return topology;
+    };
+
 private:
     PcaModel shape_model;                                   ///< A PCA model of the shape
     PcaModel color_model;                                   ///< A PCA model of vertex colour information
     std::vector<std::array<double, 2>> texture_coordinates; ///< uv-coordinates for every vertex
+    std::shared_ptr<const core::MeshTopology> topology;     ///< Created from the members above, shared by all
+                                                            ///< meshes of the model.
 
+    friend class cereal::access;
     /**
-     * Returns whether the model has texture mapping coordinates, i.e.
-     * coordinates for every vertex.
+     * Serialises this class using cereal.
      *
-     * @return True if the model contains texture mapping coordinates.
+     * @param[in] archive The archive to serialise to.
      */
-    bool has_texture_coordinates() const
+    template <class Archive>
+    void save(Archive& archive, const std::uint32_t /* version */) const
     {
-        return texture_coordinates.size() > 0 ? true : false;
+        archive(CEREAL_NVP(shape_model), CEREAL_NVP(color_model), CEREAL_NVP(texture_coordinates));
     };
 
-    friend class cereal::access;
     /**
-     * Serialises this class using cereal.
+     * Deserialises this class using cereal, and creates the topology of its meshes.
      *
-     * @param[in] archive The archive to serialise to (or to serialise from).
+     * @param[in] archive The archive to serialise from.
      * @param[in] version Version number of the archive.
      * @throw std::runtime_error When the model file doesn't have the most recent version (=1).
      */
     template <class Archive>
-    void serialize(Archive& archive, const std::uint32_t version)
+    void load(Archive& archive, const std::uint32_t version)
     {
         if (version != 1)
         {
@@ -262,6 +282,8 @@ private:
                                      "download the most recent model files.");
         }
         archive(CEREAL_NVP(shape_model), CEREAL_NVP(color_model), CEREAL_NVP(texture_coordinates));
+        topology = detail::create_topology(shape_model.get_triangle_list(), color_model.get_triangle_list(),
+                                           texture_coordinates);
     };
 };
 
@@ -289,6 +311,72 @@ inline MorphableModel load_model(std::string filename)
     return model;
 };
 
+/**
+ * Options for load_model(std::string, const LoadOptions&), to load only the part of a model
+ * that is needed, e.g. for fitting only the first few shape coefficients.
+ *
+ * A maximum of 0 (or less) components still loads the mean and the triangle list of that
+ * model, i.e. a model with an empty basis. Only skip_color_model leaves the colour model
+ * empty.
+ */
+struct LoadOptions
+{
+    cpp17::optional<int> max_shape_components; ///< Load at most this many shape principal components. All if
+                                               ///< not set.
+    cpp17::optional<int> max_color_components; ///< Load at most this many colour principal components. All if
+                                               ///< not set.
+    bool skip_color_model = false; ///< Don't load the colour model, i.e. load a shape-only model.
+};
+
+/**
+ * Loads a Morphable Model from a cereal::BinaryInputArchive (.bin), like
+ * load_model(std::string), but only the principal components that are needed.
+ *
+ * The bases are stored column-major, so the first n principal components are one
+ * contiguous block of the file. Only this block is read, the remaining components (and the
+ * colour model, if \p options.skip_color_model is set) are skipped with a seek, and the
+ * rescaled bases are only computed for the loaded components. Load time and memory thus
+ * shrink in proportion to the number of components that are loaded.
+ *
+ * @param[in] filename Filename to a model.
+ * @param[in] options Which parts of the model to load.
+ * @return The loaded Morphable Model.
+ * @throw std::runtime_error When the file given in \c filename fails to be opened, or has an old format.
+ */
+inline MorphableModel load_model(std::string filename, const LoadOptions& options)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Error opening given file: " + filename);
+    }
+    cereal::BinaryInputArchive input_archive(file);
+    // The fields in the order of MorphableModel::serialize(...), starting with the version of the class that
+    // cereal stores:
+    std::uint32_t version;
+    input_archive(version);
+    if (version != 1)
+    {
+        throw std::runtime_error("The model file you are trying to load is in an old format. Please "
+                                 "download the most recent model files.");
+    }
+    const PcaModel shape_model = detail::load_truncated_pca_model(
+        input_archive, file, options.max_shape_components.value_or(std::numeric_limits<int>::max()));
+    PcaModel color_model;
+    if (options.skip_color_model)
+    {
+        detail::skip_pca_model(input_archive, file);
+    } else
+    {
+        color_model = detail::load_truncated_pca_model(
+            input_archive, file, options.max_color_components.value_or(std::numeric_limits<int>::max()));
+    }
+    std::vector<std::array<double, 2>> texture_coordinates;
+    input_archive(texture_coordinates);
+
+    return MorphableModel(shape_model, color_model, texture_coordinates);
+};
+
 /**
  * Helper method to save a Morphable Model to the
  * harddrive as cereal::BinaryOutputArchive.
@@ -307,11 +395,55 @@ inline void save_model(MorphableModel model, std::string filename)
     output_archive(model);
 };
 
+/**
+ * Helper function that creates a Mesh from given shape and colour PCA
+ * instances and the topology of the model, which the mesh then shares
+ * (see MorphableModel::get_topology()).
+ *
+ * The instances become the vertex and colour buffers of the mesh. If they are
+ * given as rvalues, e.g. directly from PcaModel::draw_sample(...), they are moved,
+ * not copied.
+ *
+ * If \c color_instance is empty, it will create a mesh without vertex colouring.
+ * Colour values are assumed to be in the range [0, 1] and will be clamped to [0, 1].
+ *
+ * @param[in] shape_instance PCA shape model instance.
+ * @param[in] color_instance PCA colour model instance.
+ * @param[in] topology The triangle lists and texture coordinates of the mesh.
+ * @return A mesh created from given parameters.
+ */
+inline core::Mesh sample_to_mesh(Eigen::VectorXf shape_instance, Eigen::VectorXf color_instance,
+                                 std::shared_ptr<const core::MeshTopology> topology)
+{
+    assert(shape_instance.rows() == color_instance.rows() ||
+           color_instance.size() == 0); // The number of vertices (= model.getDataDimension() / 3) has to be
+                                        // equal for both models, or, alternatively, it has to be a shape-only
+                                        // model.
+
+    core::Mesh mesh;
+    mesh.vertices = core::VertexBuffer(std::move(shape_instance));
+
+    // Assign the vertex colour information if it's not a shape-only model (we use RGB order everywhere):
+    if (color_instance.size() > 0)
+    {
+        color_instance = color_instance.cwiseMax(0.0f).cwiseMin(1.0f);
+        mesh.colors = core::VertexBuffer(std::move(color_instance));
+    }
+
+    // The triangle lists and texture coordinates are shared, not copied:
+    mesh.topology = std::move(topology);
+
+    return mesh;
+};
+
 /**
  * Helper function that creates a Mesh from given shape and colour PCA
  * instances. Needs the vertex index lists as well to assemble the mesh -
  * and optional texture coordinates.
  *
+ * This copies the triangle lists into a new topology. To create many meshes of
+ * the same model, prefer the overload that takes the model's topology.
+ *
  * If \c color_instance is empty, it will create a mesh without vertex colouring.
  * Colour values are assumed to be in the range [0, 1] and will be clamped to [0, 1].
  *
@@ -328,54 +460,41 @@ inline core::Mesh sample_to_mesh(const Eigen::VectorXf& shape_instance, const Ei
                                  const std::vector<std::array<double, 2>>&
                                      texture_coordinates /* = std::vector<std::array<double, 2>>() */)
 {
-    assert(shape_instance.rows() == color_instance.rows() ||
-           color_instance.size() == 0); // The number of vertices (= model.getDataDimension() / 3) has to be
-                                        // equal for both models, or, alternatively, it has to be a shape-only
-                                        // model.
-
-    const auto num_vertices = shape_instance.rows() / 3;
+    return sample_to_mesh(shape_instance, color_instance,
+                          detail::create_topology(tvi, tci, texture_coordinates));
+};
 
-    core::Mesh mesh;
+/**
+ * Overwrites the vertex positions and colours of an existing mesh with the given shape and
+ * colour PCA instances, and leaves its triangle lists and texture coordinates untouched.
+ *
+ * This allows to turn many samples of a model into meshes without re-creating the
+ * topology of the mesh for every sample, e.g. together with PcaModel::draw_samples(...):
+ * Create a mesh once, for example with MorphableModel::get_mean(), and then assign each
+ * sample to it.
+ *
+ * If \c color_instance is empty, the vertex colours of the mesh are removed. Colour values
+ * are clamped to [0, 1], as in sample_to_mesh(...).
+ *
+ * @param[in] shape_instance PCA shape model instance.
+ * @param[in] color_instance PCA colour model instance.
+ * @param[in,out] mesh A mesh with the topology of the model, whose vertices and colours are overwritten.
+ */
+inline void assign_sample_to_mesh(const Eigen::Ref<const Eigen::VectorXf>& shape_instance,
+                                  const Eigen::Ref<const Eigen::VectorXf>& color_instance, core::Mesh& mesh)
+{
+    assert(shape_instance.rows() == color_instance.rows() || color_instance.size() == 0);
 
-    // Construct the mesh vertices:
-    mesh.vertices.resize(num_vertices);
-    for (auto i = 0; i < num_vertices; ++i)
-    {
-        mesh.vertices[i] = Eigen::Vector3f(
-            shape_instance(i * 3 + 0), shape_instance(i * 3 + 1),
-            shape_instance(i * 3 + 2)); // Note: This can probably be simplified now, Eigen on both sides!
-    }
+    mesh.update_vertices(shape_instance);
 
-    // Assign the vertex colour information if it's not a shape-only model:
     if (color_instance.size() > 0)
     {
-        mesh.colors.resize(num_vertices);
-        for (auto i = 0; i < num_vertices; ++i)
-        {
-            mesh.colors[i] = Eigen::Vector3f(
-                cpp17::clamp(color_instance(i * 3 + 0), 0.0f, 1.0f),
-                cpp17::clamp(color_instance(i * 3 + 1), 0.0f, 1.0f),
-                cpp17::clamp(color_instance(i * 3 + 2), 0.0f, 1.0f)); // We use RGB order everywhere.
-        }
-    }
-
-    // Assign the triangle lists:
-    mesh.tvi = tvi;
-    mesh.tci = tci; // tci will be empty in case of a shape-only model
-
-    // Texture coordinates, if the model has them:
-    if (!texture_coordinates.empty())
+        mesh.colors.assign(color_instance);
+        mesh.colors.as_matrix() = mesh.colors.as_matrix().cwiseMax(0.0f).cwiseMin(1.0f);
+    } else
     {
-        mesh.texcoords.resize(num_vertices);
-        for (auto i = 0; i < num_vertices; ++i)
-        {
-            mesh.texcoords[i] = Eigen::Vector2f(
-                texture_coordinates[i][0],
-                texture_coordinates[i][1]); // Note: This can probably be simplified now, Eigen on both sides!
-        }
+        mesh.colors.clear();
     }
-
-    return mesh;
 };
 
 } /* namespace morphablemodel */
@@ -30,10 +30,15 @@
 
 #include "Eigen/Core"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <istream>
+#include <memory>
 #include <random>
 #include <string>
+#include <utility>
 #include <vector>
 #include <fstream>
 
@@ -46,6 +51,22 @@ Eigen::MatrixXf rescale_pca_basis(const Eigen::MatrixXf& orthonormal_basis,
 Eigen::MatrixXf normalise_pca_basis(const Eigen::MatrixXf& rescaled_basis,
                                     const Eigen::VectorXf& eigenvalues);
 
+namespace detail {
+
+/**
+ * The arrays of a PcaModel that has been constructed from Eigen matrices. The model
+ * points into them, and all copies of the model share them.
+ */
+struct PcaModelData
+{
+    Eigen::VectorXf mean;
+    Eigen::MatrixXf orthonormal_pca_basis;
+    Eigen::MatrixXf rescaled_pca_basis;
+    Eigen::VectorXf eigenvalues;
+};
+
+} /* namespace detail */
+
 /**
  * @brief This class represents a PCA-model that consists of:
  *   - a mean vector (y x z)
@@ -54,6 +75,13 @@ Eigen::MatrixXf normalise_pca_basis(const Eigen::MatrixXf& rescaled_basis,
  *
  * It also contains a list of triangles to built a mesh as well as a mapping
  * from landmark points to the corresponding vertex-id in the mesh.
+ *
+ * The model is immutable, and the mean, bases and eigenvalues are not stored in the
+ * model itself, but in a storage that all copies of the model share. The storage is
+ * either a set of Eigen matrices, or memory that someone else owns, e.g. a memory-mapped
+ * model file (see load_mapped_model(...)), so copying a model doesn't copy its data. The
+ * getters return Eigen::Map views into the storage, which stay valid as long as any copy of
+ * the model exists.
  */
 class PcaModel
 {
@@ -74,12 +102,52 @@ public:
      */
     PcaModel(Eigen::VectorXf mean, Eigen::MatrixXf orthonormal_pca_basis, Eigen::VectorXf eigenvalues,
              std::vector<std::array<int, 3>> triangle_list)
-        : mean(mean), orthonormal_pca_basis(orthonormal_pca_basis), eigenvalues(eigenvalues),
-          triangle_list(triangle_list)
+        : triangle_list(std::move(triangle_list))
     {
-        rescaled_pca_basis = rescale_pca_basis(orthonormal_pca_basis, eigenvalues);
+        const auto data = std::make_shared<detail::PcaModelData>();
+        data->rescaled_pca_basis = rescale_pca_basis(orthonormal_pca_basis, eigenvalues);
+        data->mean = std::move(mean);
+        data->orthonormal_pca_basis = std::move(orthonormal_pca_basis);
+        data->eigenvalues = std::move(eigenvalues);
+        assert(data->mean.rows() == data->orthonormal_pca_basis.rows());
+        assert(data->eigenvalues.rows() == data->orthonormal_pca_basis.cols());
+        mean_data = data->mean.data();
+        orthonormal_pca_basis_data = data->orthonormal_pca_basis.data();
+        rescaled_pca_basis_data = data->rescaled_pca_basis.data();
+        eigenvalues_data = data->eigenvalues.data();
+        data_dimension = static_cast<int>(data->orthonormal_pca_basis.rows());
+        num_principal_components = static_cast<int>(data->orthonormal_pca_basis.cols());
+        storage = data;
     };
 
+    /**
+     * Construct a PCA model whose mean, bases and eigenvalues are stored in memory that
+     * is kept alive by the given \p storage, e.g. a memory-mapped model file. The data is not
+     * copied.
+     *
+     * The bases are expected in column-major order, like Eigen::MatrixXf, and the rescaled
+     * basis has to be consistent with the orthonormal one and the eigenvalues (see
+     * rescale_pca_basis(...)).
+     *
+     * @param[in] storage An object that owns the memory that the pointers point into.
+     * @param[in] mean The mean, with \p data_dimension elements.
+     * @param[in] orthonormal_pca_basis The orthonormal PCA basis, a data_dimension x num_principal_components
+     * matrix.
+     * @param[in] rescaled_pca_basis The rescaled PCA basis, a data_dimension x num_principal_components
+     * matrix.
+     * @param[in] eigenvalues The eigenvalues, with \p num_principal_components elements.
+     * @param[in] data_dimension The dimension of the data, i.e. three times the number of vertices.
+     * @param[in] num_principal_components The number of principal components.
+     * @param[in] triangle_list An index list of how to assemble the mesh.
+     */
+    PcaModel(std::shared_ptr<const void> storage, const float* mean, const float* orthonormal_pca_basis,
+             const float* rescaled_pca_basis, const float* eigenvalues, int data_dimension,
+             int num_principal_components, std::vector<std::array<int, 3>> triangle_list)
+        : storage(std::move(storage)), mean_data(mean), orthonormal_pca_basis_data(orthonormal_pca_basis),
+          rescaled_pca_basis_data(rescaled_pca_basis), eigenvalues_data(eigenvalues),
+          data_dimension(data_dimension), num_principal_components(num_principal_components),
+          triangle_list(std::move(triangle_list)){};
+
     /**
      * Returns the number of principal components in the model.
      *
@@ -87,8 +155,7 @@ public:
      */
     int get_num_principal_components() const
     {
-        // Note: we could assert(rescaled_pca_basis.cols==orthonormal_pca_basis.cols)
-        return static_cast<int>(rescaled_pca_basis.cols());
+        return num_principal_components;
     };
 
     /**
@@ -101,8 +168,7 @@ public:
      */
     int get_data_dimension() const
     {
-        // Note: we could assert(rescaled_pca_basis.rows==orthonormal_pca_basis.rows)
-        return static_cast<int>(rescaled_pca_basis.rows());
+        return data_dimension;
     };
 
     /**
@@ -110,7 +176,7 @@ public:
      *
      * @return The list of triangles to build a mesh.
      */
-    std::vector<std::array<int, 3>> get_triangle_list() const
+    const std::vector<std::array<int, 3>>& get_triangle_list() const
     {
         return triangle_list;
     };
@@ -120,9 +186,9 @@ public:
      *
      * @return The mean of the model.
      */
-    const Eigen::VectorXf& get_mean() const
+    Eigen::Map<const Eigen::VectorXf> get_mean() const
     {
-        return mean;
+        return Eigen::Map<const Eigen::VectorXf>(mean_data, data_dimension);
     };
 
     /**
@@ -134,8 +200,8 @@ public:
     Eigen::Vector3f get_mean_at_point(int vertex_index) const
     {
         vertex_index *= 3;
-        // Note: We could maybe also return a const& to mean.block(...).
-        return Eigen::Vector3f(mean(vertex_index), mean(vertex_index + 1), mean(vertex_index + 2));
+        return Eigen::Vector3f(mean_data[vertex_index], mean_data[vertex_index + 1],
+                               mean_data[vertex_index + 2]);
     };
 
     /**
@@ -178,7 +244,7 @@ public:
         }
         const Eigen::Map<Eigen::VectorXf> alphas(coefficients.data(), coefficients.size());
 
-        const Eigen::VectorXf model_sample = mean + rescaled_pca_basis * alphas;
+        const Eigen::VectorXf model_sample = get_mean() + get_rescaled_pca_basis() * alphas;
 
         return model_sample;
     };
@@ -193,6 +259,26 @@ public:
         return draw_sample(coeffs_float);
     };
 
+    /**
+     * Returns a batch of samples from the model, one for each column of the given
+     * coefficient matrix. All samples are computed with one matrix-matrix product,
+     * which is much faster than calling draw_sample(...) for each of them.
+     *
+     * The coefficients should follow a standard normal distribution, like the ones given to
+     * draw_sample(...). If the matrix has fewer rows than the model has principal components,
+     * the remaining coefficients are assumed to be zero.
+     *
+     * @param[in] coefficients A matrix with the PCA coefficients of one sample in each column.
+     * @return A matrix with one model instance in each column.
+     */
+    Eigen::MatrixXf draw_samples(const Eigen::MatrixXf& coefficients) const
+    {
+        assert(coefficients.rows() <= get_num_principal_components());
+        Eigen::MatrixXf model_samples = get_rescaled_pca_basis().leftCols(coefficients.rows()) * coefficients;
+        model_samples.colwise() += get_mean();
+        return model_samples;
+    };
+
     /**
      * Returns the PCA basis matrix, i.e. the eigenvectors.
      * Each column of the matrix is an eigenvector.
@@ -201,9 +287,10 @@ public:
      *
      * @return Returns the rescaled PCA basis matrix.
      */
-    const Eigen::MatrixXf& get_rescaled_pca_basis() const
+    Eigen::Map<const Eigen::MatrixXf> get_rescaled_pca_basis() const
     {
-        return rescaled_pca_basis;
+        return Eigen::Map<const Eigen::MatrixXf>(rescaled_pca_basis_data, data_dimension,
+                                                 num_principal_components);
     };
 
     /**
@@ -225,7 +312,7 @@ public:
         vertex_id *= 3;                           // the basis is stored in the format [x y z x y z ...]
         assert(vertex_id < get_data_dimension()); // Make sure the given vertex index isn't larger than the
                                                   // number of model vertices.
-        return rescaled_pca_basis.block(vertex_id, 0, 3, rescaled_pca_basis.cols());
+        return get_rescaled_pca_basis().middleRows(vertex_id, 3);
     };
 
     /**
@@ -236,9 +323,10 @@ public:
      *
      * @return Returns the orthonormal PCA basis matrix.
      */
-    const Eigen::MatrixXf& get_orthonormal_pca_basis() const
+    Eigen::Map<const Eigen::MatrixXf> get_orthonormal_pca_basis() const
     {
-        return orthonormal_pca_basis;
+        return Eigen::Map<const Eigen::MatrixXf>(orthonormal_pca_basis_data, data_dimension,
+                                                 num_principal_components);
     };
 
     /**
@@ -255,7 +343,7 @@ public:
         vertex_id *= 3;                           // the basis is stored in the format [x y z x y z ...]
         assert(vertex_id < get_data_dimension()); // Make sure the given vertex index isn't larger than the
                                                   // number of model vertices.
-        return orthonormal_pca_basis.block(vertex_id, 0, 3, orthonormal_pca_basis.cols());
+        return get_orthonormal_pca_basis().middleRows(vertex_id, 3);
     };
 
     /**
@@ -263,9 +351,9 @@ public:
      *
      * @return The eigenvalues.
      */
-    const Eigen::VectorXf& get_eigenvalues() const
+    Eigen::Map<const Eigen::VectorXf> get_eigenvalues() const
     {
-        return eigenvalues;
+        return Eigen::Map<const Eigen::VectorXf>(eigenvalues_data, num_principal_components);
     };
 
     /**
@@ -276,17 +364,24 @@ public:
      */
     float get_eigenvalue(int index) const
     {
-        // no assert - Eigen checks access with an assert in debug builds
-        return eigenvalues(index);
+        assert(index >= 0 && index < num_principal_components);
+        return eigenvalues_data[index];
     };
 
 private:
-    Eigen::VectorXf mean; ///< A 3m x 1 col-vector (xyzxyz...)', where m is the number of model-vertices.
-    Eigen::MatrixXf orthonormal_pca_basis; ///< m x n (rows x cols) = numShapeDims x numShapePcaCoeffs,
-                                           ///< (=eigenvector matrix V). Each column is an eigenvector.
-    Eigen::MatrixXf rescaled_pca_basis;    ///< m x n (rows x cols) = numShapeDims x numShapePcaCoeffs,
-                                           ///< (=eigenvector matrix V). Each column is an eigenvector.
-    Eigen::VectorXf eigenvalues;           ///< A col-vector of the eigenvalues (variances in the PCA space).
+    std::shared_ptr<const void> storage; ///< Owns the memory that the pointers below point into.
+    const float* mean_data = nullptr;    ///< A 3m x 1 col-vector (xyzxyz...)', where m is the number of
+                                         ///< model-vertices.
+    const float* orthonormal_pca_basis_data = nullptr; ///< m x n (rows x cols) = numShapeDims x
+                                                       ///< numShapePcaCoeffs, (=eigenvector matrix V),
+                                                       ///< column-major. Each column is an eigenvector.
+    const float* rescaled_pca_basis_data = nullptr;    ///< m x n (rows x cols) = numShapeDims x
+                                                       ///< numShapePcaCoeffs, (=eigenvector matrix V),
+                                                       ///< column-major. Each column is an eigenvector.
+    const float* eigenvalues_data = nullptr; ///< A col-vector of the eigenvalues (variances in the PCA
+                                             ///< space).
+    int data_dimension = 0;                  ///< Number of rows of the bases, i.e. 3m.
+    int num_principal_components = 0;        ///< Number of columns of the bases.
 
     std::vector<std::array<int, 3>> triangle_list; ///< List of triangles that make up the mesh of the model.
 
@@ -294,19 +389,35 @@ private:
     /**
      * Serialises this class using cereal.
      *
-     * @param[in] archive The archive to serialise to (or to serialise from).
+     * @param[in] archive The archive to serialise to.
      */
     template <class Archive>
-    void serialize(Archive& archive)
+    void save(Archive& archive) const
     {
+        const Eigen::VectorXf mean = get_mean();
+        const Eigen::MatrixXf orthonormal_pca_basis = get_orthonormal_pca_basis();
+        const Eigen::VectorXf eigenvalues = get_eigenvalues();
         archive(CEREAL_NVP(mean), CEREAL_NVP(orthonormal_pca_basis), CEREAL_NVP(eigenvalues),
                 CEREAL_NVP(triangle_list));
-        // If we're loading, we have to recompute the rescaled basis, so that it's available (we don't
-        // store it anymore):
-        if (Archive::is_loading::value)
-        {
-            rescaled_pca_basis = rescale_pca_basis(orthonormal_pca_basis, eigenvalues);
-        }
+    };
+
+    /**
+     * Deserialises this class using cereal.
+     *
+     * @param[in] archive The archive to serialise from.
+     */
+    template <class Archive>
+    void load(Archive& archive)
+    {
+        Eigen::VectorXf mean;
+        Eigen::MatrixXf orthonormal_pca_basis;
+        Eigen::VectorXf eigenvalues;
+        std::vector<std::array<int, 3>> triangle_list;
+        archive(CEREAL_NVP(mean), CEREAL_NVP(orthonormal_pca_basis), CEREAL_NVP(eigenvalues),
+                CEREAL_NVP(triangle_list));
+        // The rescaled basis isn't stored, the constructor recomputes it:
+        *this = PcaModel(std::move(mean), std::move(orthonormal_pca_basis), std::move(eigenvalues),
+                         std::move(triangle_list));
     };
 };
 
@@ -356,6 +467,86 @@ inline void save_pca_model(PcaModel model, std::string filename)
     output_archive(model);
 };
 
+namespace detail {
+
+/**
+ * Reads a matrix that has been serialised with eigen_cerealisation.hpp to a binary archive,
+ * but only its first \p max_cols columns. The matrix is stored column-major, so these are one
+ * contiguous block, and the remaining columns are skipped with a seek on the stream, without
+ * reading them.
+ *
+ * @param[in] archive The archive to read from.
+ * @param[in] stream The stream that \p archive reads from.
+ * @param[in] max_cols The maximum number of columns to read.
+ * @return The first min(cols, max_cols) columns of the stored matrix.
+ */
+inline Eigen::MatrixXf load_leading_columns(cereal::BinaryInputArchive& archive, std::istream& stream,
+                                            int max_cols)
+{
+    std::int32_t rows;
+    std::int32_t cols;
+    archive(rows);
+    archive(cols);
+    const std::int32_t cols_to_load = std::min(cols, static_cast<std::int32_t>(std::max(max_cols, 0)));
+    Eigen::MatrixXf matrix(rows, cols_to_load);
+    archive(
+        cereal::binary_data(matrix.data(), static_cast<std::size_t>(rows) * cols_to_load * sizeof(float)));
+    stream.seekg(static_cast<std::streamoff>(rows) * (cols - cols_to_load) * sizeof(float), std::ios::cur);
+    return matrix;
+};
+
+/**
+ * Reads a PcaModel that has been serialised to a binary archive, but only its first
+ * \p max_components principal components. The remaining columns of the basis are skipped
+ * without reading them, and the rescaled basis is only computed for the components that
+ * are loaded.
+ *
+ * The mean and the triangle list are always loaded. With max_components <= 0, the returned
+ * model consists of only these, with a basis that has zero columns.
+ *
+ * @param[in] archive The archive to read from.
+ * @param[in] stream The stream that \p archive reads from.
+ * @param[in] max_components The maximum number of principal components to load.
+ * @return The loaded PCA model.
+ */
+inline PcaModel load_truncated_pca_model(cereal::BinaryInputArchive& archive, std::istream& stream,
+                                         int max_components)
+{
+    // The fields in the order of PcaModel::save(...):
+    const Eigen::MatrixXf mean = load_leading_columns(archive, stream, 1);
+    Eigen::MatrixXf orthonormal_pca_basis = load_leading_columns(archive, stream, max_components);
+    const Eigen::MatrixXf eigenvalues = load_leading_columns(archive, stream, 1);
+    std::vector<std::array<int, 3>> triangle_list;
+    archive(triangle_list);
+    // The mean and eigenvalues are column vectors, but an empty one might have been stored with zero
+    // columns, so we view their data as a vector instead of taking col(0):
+    const Eigen::Index num_components = orthonormal_pca_basis.cols();
+    Eigen::VectorXf mean_vector = Eigen::Map<const Eigen::VectorXf>(mean.data(), mean.size());
+    Eigen::VectorXf leading_eigenvalues =
+        Eigen::Map<const Eigen::VectorXf>(eigenvalues.data(), eigenvalues.size()).head(num_components);
+    return PcaModel(std::move(mean_vector), std::move(orthonormal_pca_basis), std::move(leading_eigenvalues),
+                    std::move(triangle_list));
+};
+
+/**
+ * Skips a PcaModel that has been serialised to a binary archive, without reading its mean,
+ * bases and eigenvalues. Only the (small) triangle list is read, since its size is not known
+ * in advance.
+ *
+ * @param[in] archive The archive to read from.
+ * @param[in] stream The stream that \p archive reads from.
+ */
+inline void skip_pca_model(cereal::BinaryInputArchive& archive, std::istream& stream)
+{
+    load_leading_columns(archive, stream, 0); // mean
+    load_leading_columns(archive, stream, 0); // orthonormal basis
+    load_leading_columns(archive, stream, 0); // eigenvalues
+    std::vector<std::array<int, 3>> triangle_list;
+    archive(triangle_list);
+};
+
+} /* namespace detail */
+
 /**
  * Takes an orthonormal PCA basis matrix (a matrix consisting
  * of the eigenvectors) and rescales it, i.e. multiplies each
@@ -0,0 +1,396 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/morphablemodel/QuantisedPcaModel.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef QUANTISEDPCAMODEL_HPP_
+#define QUANTISEDPCAMODEL_HPP_
+
+#include "eos/morphablemodel/PcaModel.hpp"
+#include "eos/morphablemodel/io/eigen_cerealisation.hpp"
+
+#include "cereal/access.hpp"
+#include "cereal/archives/binary.hpp"
+#include "cereal/types/array.hpp"
+#include "cereal/types/vector.hpp"
+
+#include "Eigen/Core"
+
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace eos {
+namespace morphablemodel {
+
+/**
+ * @brief A compact version of a PcaModel, whose rescaled PCA basis is quantised to 8- or
+ * 16-bit integers.
+ *
+ * Each column (eigenvector) of the basis is stored as integers in [-max, max] of the given
+ * type, together with one float scale factor per column, that the integers are multiplied
+ * with to get the basis back. draw_sample(...) and get_rescaled_pca_basis_at_point(...) work
+ * directly on the integers and dequantise them on the fly.
+ *
+ * Only the rescaled basis is stored, so compared to a PcaModel, which stores an orthonormal
+ * and a rescaled float basis, the model needs a quarter (std::int16_t) or an eighth
+ * (std::int8_t) of the memory, and draw_sample(...), which is limited by the memory bandwidth
+ * for large models, reads a half or a quarter of the data. The error that the quantisation
+ * introduces can be measured with compute_quantisation_error(...).
+ *
+ * The quantised model can be stored with save_quantised_pca_model(...) and loaded with
+ * load_quantised_pca_model(...), so it doesn't have to be recomputed from the float model.
+ * fitting::fit_shape_to_landmarks_linear(...) accepts it in place of a PcaModel.
+ *
+ * @tparam QuantisedType The integer type of the basis, std::int8_t or std::int16_t.
+ */
+template <typename QuantisedType>
+class QuantisedPcaModel
+{
+    static_assert(std::is_same<QuantisedType, std::int8_t>::value ||
+                      std::is_same<QuantisedType, std::int16_t>::value,
+                  "QuantisedPcaModel only supports std::int8_t and std::int16_t.");
+
+public:
+    QuantisedPcaModel() = default;
+
+    /**
+     * Quantises the rescaled PCA basis of the given model. The mean, eigenvalues and
+     * triangle list are copied.
+     *
+     * @param[in] model The PCA model to quantise.
+     */
+    explicit QuantisedPcaModel(const PcaModel& model)
+        : mean(model.get_mean()), eigenvalues(model.get_eigenvalues()),
+          triangle_list(model.get_triangle_list())
+    {
+        const auto rescaled_basis = model.get_rescaled_pca_basis();
+        data_dimension = model.get_data_dimension();
+        num_principal_components = model.get_num_principal_components();
+        scales.resize(num_principal_components);
+        basis.resize(static_cast<std::size_t>(data_dimension) * num_principal_components);
+        const float max_value = std::numeric_limits<QuantisedType>::max();
+        for (int j = 0; j < num_principal_components; ++j)
+        {
+            // A symmetric range around zero, so that a zero in the basis stays exactly zero:
+            const float max_abs = data_dimension > 0 ? rescaled_basis.col(j).cwiseAbs().maxCoeff() : 0.0f;
+            scales[j] = max_abs / max_value;
+            const float inverse_scale = max_abs > 0.0f ? max_value / max_abs : 0.0f;
+            QuantisedType* column = &basis[static_cast<std::size_t>(j) * data_dimension];
+            for (int i = 0; i < data_dimension; ++i)
+            {
+                column[i] = static_cast<QuantisedType>(std::lround(rescaled_basis(i, j) * inverse_scale));
+            }
+        }
+    };
+
+    /**
+     * Returns the number of principal components in the model.
+     *
+     * @return The number of principal components in the model.
+     */
+    int get_num_principal_components() const
+    {
+        return num_principal_components;
+    };
+
+    /**
+     * Returns the dimension of the data, i.e. the number of shape dimensions.
+     *
+     * @return The dimension of the data.
+     */
+    int get_data_dimension() const
+    {
+        return data_dimension;
+    };
+
+    /**
+     * Returns a list of triangles on how to assemble the vertices into a mesh.
+     *
+     * @return The list of triangles to build a mesh.
+     */
+    const std::vector<std::array<int, 3>>& get_triangle_list() const
+    {
+        return triangle_list;
+    };
+
+    /**
+     * Returns the mean of the model. The mean is not quantised.
+     *
+     * @return The mean of the model.
+     */
+    const Eigen::VectorXf& get_mean() const
+    {
+        return mean;
+    };
+
+    /**
+     * Returns the models eigenvalues. The eigenvalues are not quantised.
+     *
+     * @return The eigenvalues.
+     */
+    const Eigen::VectorXf& get_eigenvalues() const
+    {
+        return eigenvalues;
+    };
+
+    /**
+     * Returns a sample from the model with the given PCA coefficients, like
+     * PcaModel::draw_sample(std::vector<float>) const.
+     *
+     * The basis is dequantised on the fly. Four columns of the basis are added to the sample
+     * at a time, so that the sample is read and written a quarter as often, while each column
+     * is streamed through once.
+     *
+     * @param[in] coefficients The PCA coefficients used to generate the sample.
+     * @return A model instance with given coefficients.
+     */
+    Eigen::VectorXf draw_sample(const std::vector<float>& coefficients) const
+    {
+        assert(coefficients.size() <= static_cast<std::size_t>(num_principal_components));
+        // Fold the scales of the columns into the coefficients, and skip the zero ones:
+        std::vector<float> weights;
+        std::vector<const QuantisedType*> columns;
+        for (std::size_t j = 0; j < coefficients.size(); ++j)
+        {
+            if (coefficients[j] != 0.0f)
+            {
+                weights.push_back(coefficients[j] * scales[j]);
+                columns.push_back(&basis[j * data_dimension]);
+            }
+        }
+
+        Eigen::VectorXf model_sample = mean;
+        float* const sample = model_sample.data();
+        // Plain loops over contiguous data, that the compiler vectorises:
+        std::size_t j = 0;
+        for (; j + 4 <= columns.size(); j += 4)
+        {
+            const QuantisedType* const c0 = columns[j];
+            const QuantisedType* const c1 = columns[j + 1];
+            const QuantisedType* const c2 = columns[j + 2];
+            const QuantisedType* const c3 = columns[j + 3];
+            const float w0 = weights[j];
+            const float w1 = weights[j + 1];
+            const float w2 = weights[j + 2];
+            const float w3 = weights[j + 3];
+            for (int i = 0; i < data_dimension; ++i)
+            {
+                sample[i] += w0 * c0[i] + w1 * c1[i] + w2 * c2[i] + w3 * c3[i];
+            }
+        }
+        for (; j < columns.size(); ++j)
+        {
+            const QuantisedType* const column = columns[j];
+            const float weight = weights[j];
+            for (int i = 0; i < data_dimension; ++i)
+            {
+                sample[i] += weight * column[i];
+            }
+        }
+        return model_sample;
+    };
+
+    /**
+     * Returns the PCA basis for a particular vertex, from the rescaled basis, like
+     * PcaModel::get_rescaled_pca_basis_at_point(int) const. The basis is dequantised.
+     *
+     * @param[in] vertex_id A vertex index. Make sure it is valid.
+     * @return A 3 x num_principal_components matrix of the relevant rows of the rescaled basis.
+     */
+    Eigen::MatrixXf get_rescaled_pca_basis_at_point(int vertex_id) const
+    {
+        vertex_id *= 3; // the basis is stored in the format [x y z x y z ...]
+        assert(vertex_id < get_data_dimension());
+        Eigen::MatrixXf basis_at_point(3, num_principal_components);
+        for (int j = 0; j < num_principal_components; ++j)
+        {
+            const QuantisedType* const column =
+                &basis[static_cast<std::size_t>(j) * data_dimension + vertex_id];
+            for (int r = 0; r < 3; ++r)
+            {
+                basis_at_point(r, j) = scales[j] * column[r];
+            }
+        }
+        return basis_at_point;
+    };
+
+    /**
+     * Returns the whole rescaled PCA basis, dequantised to float.
+     *
+     * @return The dequantised rescaled PCA basis matrix.
+     */
+    Eigen::MatrixXf get_rescaled_pca_basis() const
+    {
+        Eigen::MatrixXf rescaled_basis(data_dimension, num_principal_components);
+        for (int j = 0; j < num_principal_components; ++j)
+        {
+            const QuantisedType* const column = &basis[static_cast<std::size_t>(j) * data_dimension];
+            for (int i = 0; i < data_dimension; ++i)
+            {
+                rescaled_basis(i, j) = scales[j] * column[i];
+            }
+        }
+        return rescaled_basis;
+    };
+
+private:
+    Eigen::VectorXf mean;             ///< A 3m x 1 col-vector (xyzxyz...)', where m is the number of
+                                      ///< model-vertices.
+    std::vector<QuantisedType> basis; ///< The quantised rescaled basis, 3m x n, column-major.
+    std::vector<float> scales;        ///< The scale factor of each column of the basis.
+    Eigen::VectorXf eigenvalues;      ///< A col-vector of the eigenvalues (variances in the PCA space).
+    std::vector<std::array<int, 3>> triangle_list; ///< List of triangles that make up the mesh of the model.
+    int data_dimension = 0;           ///< Number of rows of the basis, i.e. 3m.
+    int num_principal_components = 0; ///< Number of columns of the basis.
+
+    friend class cereal::access;
+    /**
+     * Serialises this class using cereal.
+     *
+     * @param[in] archive The archive to serialise to.
+     */
+    template <class Archive>
+    void save(Archive& archive) const
+    {
+        archive(CEREAL_NVP(data_dimension), CEREAL_NVP(num_principal_components), CEREAL_NVP(mean),
+                CEREAL_NVP(basis), CEREAL_NVP(scales), CEREAL_NVP(eigenvalues), CEREAL_NVP(triangle_list));
+    };
+
+    /**
+     * Deserialises this class using cereal.
+     *
+     * @param[in] archive The archive to serialise from.
+     * @throw std::runtime_error If the sizes of the stored fields don't match each other.
+     */
+    template <class Archive>
+    void load(Archive& archive)
+    {
+        archive(CEREAL_NVP(data_dimension), CEREAL_NVP(num_principal_components), CEREAL_NVP(mean),
+                CEREAL_NVP(basis), CEREAL_NVP(scales), CEREAL_NVP(eigenvalues), CEREAL_NVP(triangle_list));
+        if (data_dimension < 0 || num_principal_components < 0 || mean.size() != data_dimension ||
+            basis.size() != static_cast<std::size_t>(data_dimension) * num_principal_components ||
+            scales.size() != static_cast<std::size_t>(num_principal_components) ||
+            eigenvalues.size() != num_principal_components)
+        {
+            throw std::runtime_error("The quantised PCA model is corrupt: The sizes of its fields don't match.");
+        }
+    };
+};
+
+using QuantisedPcaModel8 = QuantisedPcaModel<std::int8_t>;   ///< 8-bit quantised PCA model.
+using QuantisedPcaModel16 = QuantisedPcaModel<std::int16_t>; ///< 16-bit quantised PCA model.
+
+/**
+ * Helper method to load a quantised PCA model from
+ * a cereal::BinaryInputArchive from the harddisk.
+ *
+ * The integer type has to be the same as the one of the model that has been saved.
+ *
+ * @param[in] filename Filename to a model.
+ * @return The loaded quantised PCA model.
+ * @throw std::runtime_error When the file given in \c filename fails to be opened, or is corrupt.
+ */
+template <typename QuantisedType>
+QuantisedPcaModel<QuantisedType> load_quantised_pca_model(std::string filename)
+{
+    QuantisedPcaModel<QuantisedType> model;
+
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Error opening given file: " + filename);
+    }
+    cereal::BinaryInputArchive input_archive(file);
+    input_archive(model);
+
+    return model;
+};
+
+/**
+ * Helper method to save a quantised PCA model to the
+ * harddrive as cereal::BinaryOutputArchive.
+ *
+ * @param[in] model The model to be saved.
+ * @param[in] filename Filename for the model.
+ */
+template <typename QuantisedType>
+void save_quantised_pca_model(const QuantisedPcaModel<QuantisedType>& model, std::string filename)
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Error creating given file: " + filename);
+    }
+    cereal::BinaryOutputArchive output_archive(file);
+    output_archive(model);
+};
+
+/**
+ * The error of a quantised PCA basis, compared to the original float basis, in the units of
+ * the model (e.g. millimetres for a shape model).
+ */
+struct QuantisationError
+{
+    float max_abs_error = 0.0f; ///< The largest absolute error of any element of the rescaled basis.
+    float rms_error = 0.0f;     ///< The root mean square error over all elements of the rescaled basis.
+    float max_sample_error = 0.0f; ///< The largest absolute error of any element of the sample that is drawn
+                                   ///< with all coefficients set to one.
+};
+
+/**
+ * Computes the error of a quantised PCA model, compared to the model it has been created from.
+ *
+ * @param[in] quantised_model The quantised model.
+ * @param[in] model The PCA model that \p quantised_model has been created from.
+ * @return The errors of the quantised basis.
+ */
+template <typename QuantisedType>
+QuantisationError compute_quantisation_error(const QuantisedPcaModel<QuantisedType>& quantised_model,
+                                             const PcaModel& model)
+{
+    assert(quantised_model.get_data_dimension() == model.get_data_dimension());
+    assert(quantised_model.get_num_principal_components() == model.get_num_principal_components());
+    QuantisationError error;
+    if (model.get_data_dimension() == 0 || model.get_num_principal_components() == 0)
+    {
+        return error;
+    }
+    const Eigen::MatrixXf difference =
+        quantised_model.get_rescaled_pca_basis() - model.get_rescaled_pca_basis();
+    error.max_abs_error = difference.cwiseAbs().maxCoeff();
+    error.rms_error = std::sqrt(difference.squaredNorm() / static_cast<float>(difference.size()));
+    const std::vector<float> ones(model.get_num_principal_components(), 1.0f);
+    error.max_sample_error =
+        (quantised_model.draw_sample(ones) - model.draw_sample(ones)).cwiseAbs().maxCoeff();
+    return error;
+};
+
+} /* namespace morphablemodel */
+} /* namespace eos */
+
+#endif /* QUANTISEDPCAMODEL_HPP_ */
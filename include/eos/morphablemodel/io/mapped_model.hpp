@@ -0,0 +1,438 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/morphablemodel/io/mapped_model.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef MAPPED_MODEL_HPP_
+#define MAPPED_MODEL_HPP_
+
+#include "eos/core/MemoryMappedFile.hpp"
+#include "eos/morphablemodel/Blendshape.hpp"
+#include "eos/morphablemodel/MorphableModel.hpp"
+#include "eos/morphablemodel/PcaModel.hpp"
+
+#include "Eigen/Core"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * A model file format that can be memory-mapped, so that a model can be loaded without
+ * deserialising or copying its data.
+ *
+ * A file consists of a header (MappedModelHeader), followed by the arrays of the model, each
+ * aligned to 64 bytes. Everything is stored in little-endian byte order, the matrices in
+ * column-major order, like Eigen::MatrixXf. In contrast to the cereal .bin files, the rescaled
+ * PCA bases are stored as well, so they don't have to be recomputed when loading.
+ */
+namespace eos {
+namespace morphablemodel {
+
+namespace detail {
+
+/**
+ * The arrays that a mapped model file consists of. The sections of the shape and of the
+ * colour model are in the same order.
+ */
+enum class MappedModelSection : std::uint32_t {
+    ShapeMean,              ///< float, data_dimension x 1.
+    ShapeOrthonormalBasis,  ///< float, data_dimension x num_principal_components.
+    ShapeRescaledBasis,     ///< float, data_dimension x num_principal_components.
+    ShapeEigenvalues,       ///< float, num_principal_components x 1.
+    ShapeTriangles,         ///< int32, num_triangles x 3.
+    ColorMean,              ///< Like ShapeMean. All colour sections are empty for a shape-only model.
+    ColorOrthonormalBasis,  ///< Like ShapeOrthonormalBasis.
+    ColorRescaledBasis,     ///< Like ShapeRescaledBasis.
+    ColorEigenvalues,       ///< Like ShapeEigenvalues.
+    ColorTriangles,         ///< Like ShapeTriangles.
+    TextureCoordinates,     ///< double, num_vertices x 2, or empty.
+    BlendshapeDeformations, ///< float, data_dimension x num_blendshapes, or empty.
+    BlendshapeNames,        ///< char, the blendshape names, each terminated by '\0'. rows is their number.
+    Count
+};
+
+/**
+ * Location and size of one array in a mapped model file.
+ */
+struct MappedModelSectionEntry
+{
+    std::uint64_t offset; ///< Offset of the first byte, from the start of the file. A multiple of 64.
+    std::uint64_t size;   ///< Size in bytes.
+    std::uint64_t rows;
+    std::uint64_t cols;
+};
+
+/**
+ * The header at the start of a mapped model file.
+ */
+struct MappedModelHeader
+{
+    char magic[8];            ///< "eosmodel".
+    std::uint32_t version;    ///< Version of the format, currently 1.
+    std::uint32_t byte_order; ///< 0x01020304, to detect files with a different byte order.
+    std::uint64_t file_size;  ///< Size of the whole file in bytes.
+    std::uint64_t reserved;   ///< Zero.
+    MappedModelSectionEntry sections[static_cast<std::size_t>(MappedModelSection::Count)];
+};
+
+constexpr char mapped_model_magic[8] = {'e', 'o', 's', 'm', 'o', 'd', 'e', 'l'};
+constexpr std::uint32_t mapped_model_version = 1;
+constexpr std::uint32_t mapped_model_byte_order = 0x01020304;
+constexpr std::uint64_t mapped_model_alignment = 64;
+
+// The triangle lists and texture coordinates are written and mapped as arrays of their scalars:
+static_assert(sizeof(std::array<int, 3>) == 3 * sizeof(std::int32_t), "int has to be a 32-bit integer.");
+static_assert(sizeof(std::array<double, 2>) == 2 * sizeof(double), "std::array<double, 2> can't be padded.");
+
+inline bool is_little_endian()
+{
+    const std::uint32_t one = 1;
+    unsigned char first_byte;
+    std::memcpy(&first_byte, &one, 1);
+    return first_byte == 1;
+};
+
+/**
+ * Reads the header of a mapped model file and checks that it is valid, and that all its
+ * sections lie within the file.
+ *
+ * @param[in] file A mapped model file.
+ * @param[in] filename Filename of the file, for the error messages.
+ * @return The header of the file.
+ * @throw std::runtime_error When the file is not a valid mapped model file.
+ */
+inline const MappedModelHeader& read_mapped_model_header(const core::MemoryMappedFile& file,
+                                                         const std::string& filename)
+{
+    if (!is_little_endian())
+    {
+        throw std::runtime_error("Mapped model files are only supported on little-endian platforms.");
+    }
+    if (file.size() < sizeof(MappedModelHeader) ||
+        std::memcmp(file.data(), mapped_model_magic, sizeof(mapped_model_magic)) != 0)
+    {
+        throw std::runtime_error("The given file is not a mapped model file: " + filename);
+    }
+    const MappedModelHeader& header = *reinterpret_cast<const MappedModelHeader*>(file.data());
+    if (header.version != mapped_model_version)
+    {
+        throw std::runtime_error("The mapped model file has version " + std::to_string(header.version) +
+                                 ", but only version " + std::to_string(mapped_model_version) +
+                                 " is supported: " + filename);
+    }
+    if (header.byte_order != mapped_model_byte_order)
+    {
+        throw std::runtime_error("The mapped model file has a different byte order: " + filename);
+    }
+    if (header.file_size != file.size())
+    {
+        throw std::runtime_error("The mapped model file is truncated: " + filename);
+    }
+    for (const auto& section : header.sections)
+    {
+        if (section.offset % mapped_model_alignment != 0 || section.offset > file.size() ||
+            section.size > file.size() - section.offset)
+        {
+            throw std::runtime_error("The mapped model file is corrupt: " + filename);
+        }
+    }
+    return header;
+};
+
+/**
+ * Returns a pointer to the start of the given section of a mapped model file, after checking
+ * that the section has the expected size.
+ *
+ * @param[in] file A mapped model file, whose header has been checked with read_mapped_model_header(...).
+ * @param[in] id The section to return.
+ * @param[in] rows The expected number of rows.
+ * @param[in] cols The expected number of columns.
+ * @param[in] filename Filename of the file, for the error messages.
+ * @return A pointer to the elements of the section, of scalar type T.
+ * @throw std::runtime_error When the section has a different size.
+ */
+template <typename T>
+const T* get_mapped_section(const core::MemoryMappedFile& file, MappedModelSection id, std::uint64_t rows,
+                            std::uint64_t cols, const std::string& filename)
+{
+    const auto& header = *reinterpret_cast<const MappedModelHeader*>(file.data());
+    const MappedModelSectionEntry& section = header.sections[static_cast<std::size_t>(id)];
+    if (section.rows != rows || section.cols != cols || section.size != rows * cols * sizeof(T))
+    {
+        throw std::runtime_error("The mapped model file is corrupt, a section has the wrong size: " +
+                                 filename);
+    }
+    return reinterpret_cast<const T*>(file.data() + section.offset);
+};
+
+/**
+ * Creates a PcaModel whose mean, bases and eigenvalues point into a mapped model file.
+ *
+ * @param[in] file A mapped model file, whose header has been checked with read_mapped_model_header(...).
+ * @param[in] first_section MappedModelSection::ShapeMean or MappedModelSection::ColorMean.
+ * @param[in] filename Filename of the file, for the error messages.
+ * @return The PCA model, which keeps the file mapped.
+ */
+inline PcaModel map_pca_model(const std::shared_ptr<const core::MemoryMappedFile>& file,
+                              MappedModelSection first_section, const std::string& filename)
+{
+    const auto& header = *reinterpret_cast<const MappedModelHeader*>(file->data());
+    const auto section = [&](int offset) {
+        return static_cast<MappedModelSection>(static_cast<std::uint32_t>(first_section) + offset);
+    };
+    const auto& basis_entry = header.sections[static_cast<std::size_t>(section(1))];
+    const auto& triangles_entry = header.sections[static_cast<std::size_t>(section(4))];
+    if (basis_entry.rows > static_cast<std::uint64_t>(std::numeric_limits<int>::max()) ||
+        basis_entry.cols > static_cast<std::uint64_t>(std::numeric_limits<int>::max()))
+    {
+        throw std::runtime_error("The mapped model file is corrupt: " + filename);
+    }
+    const std::uint64_t data_dimension = basis_entry.rows;
+    const std::uint64_t num_principal_components = basis_entry.cols;
+
+    const float* mean = get_mapped_section<float>(*file, section(0), data_dimension, 1, filename);
+    const float* orthonormal_basis = get_mapped_section<float>(*file, section(1), data_dimension,
+                                                               num_principal_components, filename);
+    const float* rescaled_basis = get_mapped_section<float>(*file, section(2), data_dimension,
+                                                            num_principal_components, filename);
+    const float* eigenvalues =
+        get_mapped_section<float>(*file, section(3), num_principal_components, 1, filename);
+    // The triangles are copied, since PcaModel returns them as std::vector:
+    const auto* triangles = reinterpret_cast<const std::array<int, 3>*>(
+        get_mapped_section<std::int32_t>(*file, section(4), triangles_entry.rows, 3, filename));
+    std::vector<std::array<int, 3>> triangle_list(triangles, triangles + triangles_entry.rows);
+
+    return PcaModel(file, mean, orthonormal_basis, rescaled_basis, eigenvalues,
+                    static_cast<int>(data_dimension), static_cast<int>(num_principal_components),
+                    std::move(triangle_list));
+};
+
+/**
+ * Writes the arrays of a mapped model file, and fills in their entries in the header.
+ */
+class MappedModelWriter
+{
+public:
+    MappedModelWriter(std::ofstream& file, MappedModelHeader& header) : file(file), header(header){};
+
+    template <typename T>
+    void write(MappedModelSection id, const T* data, std::uint64_t rows, std::uint64_t cols)
+    {
+        write_bytes(id, reinterpret_cast<const char*>(data), rows * cols * sizeof(T), rows, cols);
+    };
+
+    void write_bytes(MappedModelSection id, const char* data, std::uint64_t size, std::uint64_t rows,
+                     std::uint64_t cols)
+    {
+        // Pad to the alignment with zeros:
+        const std::uint64_t padding = (mapped_model_alignment - position % mapped_model_alignment) %
+                                      mapped_model_alignment;
+        static const char zeros[mapped_model_alignment] = {};
+        file.write(zeros, padding);
+        position += padding;
+        header.sections[static_cast<std::size_t>(id)] = MappedModelSectionEntry{position, size, rows, cols};
+        file.write(data, size);
+        position += size;
+    };
+
+    std::uint64_t get_position() const
+    {
+        return position;
+    };
+
+private:
+    std::ofstream& file;
+    MappedModelHeader& header;
+    std::uint64_t position = sizeof(MappedModelHeader);
+};
+
+inline void write_mapped_pca_model(MappedModelWriter& writer, const PcaModel& model,
+                                   MappedModelSection first_section)
+{
+    const auto section = [&](int offset) {
+        return static_cast<MappedModelSection>(static_cast<std::uint32_t>(first_section) + offset);
+    };
+    const std::uint64_t data_dimension = model.get_data_dimension();
+    const std::uint64_t num_principal_components = model.get_num_principal_components();
+    const std::vector<std::array<int, 3>>& triangle_list = model.get_triangle_list();
+    writer.write(section(0), model.get_mean().data(), data_dimension, 1);
+    writer.write(section(1), model.get_orthonormal_pca_basis().data(), data_dimension,
+                 num_principal_components);
+    writer.write(section(2), model.get_rescaled_pca_basis().data(), data_dimension, num_principal_components);
+    writer.write(section(3), model.get_eigenvalues().data(), num_principal_components, 1);
+    writer.write(section(4), reinterpret_cast<const std::int32_t*>(triangle_list.data()),
+                 triangle_list.size(), 3);
+};
+
+} /* namespace detail */
+
+/**
+ * Saves a Morphable Model, and optionally a set of blendshapes, as a mapped model file, which
+ * can be loaded with load_mapped_model(...) without copying the model's data.
+ *
+ * @param[in] model The model to be saved.
+ * @param[in] filename Filename for the model.
+ * @param[in] blendshapes Optional blendshapes, which have to have the dimension of the shape model.
+ * @throw std::runtime_error When the file can't be written, or the blendshapes have the wrong dimension.
+ */
+inline void save_mapped_model(const MorphableModel& model, std::string filename,
+                              const std::vector<Blendshape>& blendshapes = std::vector<Blendshape>())
+{
+    if (!detail::is_little_endian())
+    {
+        throw std::runtime_error("Mapped model files are only supported on little-endian platforms.");
+    }
+    const PcaModel& shape_model = model.get_shape_model();
+    for (const auto& blendshape : blendshapes)
+    {
+        if (blendshape.deformation.size() != shape_model.get_data_dimension())
+        {
+            throw std::runtime_error("The blendshapes have to have the same dimension as the shape model.");
+        }
+    }
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Error creating given file: " + filename);
+    }
+
+    detail::MappedModelHeader header{};
+    std::memcpy(header.magic, detail::mapped_model_magic, sizeof(header.magic));
+    header.version = detail::mapped_model_version;
+    header.byte_order = detail::mapped_model_byte_order;
+    // The header is written at the end, once the offsets of all sections are known:
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    detail::MappedModelWriter writer(file, header);
+    detail::write_mapped_pca_model(writer, shape_model, detail::MappedModelSection::ShapeMean);
+    detail::write_mapped_pca_model(writer, model.get_color_model(), detail::MappedModelSection::ColorMean);
+    const std::vector<std::array<double, 2>>& texture_coordinates = model.get_texture_coordinates();
+    writer.write(detail::MappedModelSection::TextureCoordinates,
+                 reinterpret_cast<const double*>(texture_coordinates.data()), texture_coordinates.size(), 2);
+    Eigen::MatrixXf deformations(shape_model.get_data_dimension(), blendshapes.size());
+    std::string names;
+    for (std::size_t i = 0; i < blendshapes.size(); ++i)
+    {
+        deformations.col(i) = blendshapes[i].deformation;
+        names += blendshapes[i].name;
+        names += '\0';
+    }
+    writer.write(detail::MappedModelSection::BlendshapeDeformations, deformations.data(), deformations.rows(),
+                 deformations.cols());
+    writer.write_bytes(detail::MappedModelSection::BlendshapeNames, names.data(), names.size(),
+                       blendshapes.size(), 1);
+
+    header.file_size = writer.get_position();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!file)
+    {
+        throw std::runtime_error("Error writing given file: " + filename);
+    }
+};
+
+/**
+ * Loads a Morphable Model from a mapped model file, which has been created with
+ * save_mapped_model(...), e.g. by the cereal-to-mapped converter.
+ *
+ * The file is memory-mapped read-only, and the mean, bases and eigenvalues of the returned
+ * model point directly into the mapping, so nothing is deserialised or copied, and the
+ * pages of the file are only read when they are accessed. All processes that load the same
+ * file share its pages. The file stays mapped until the last copy of the model (or of its
+ * shape or colour model) is destroyed. Only the triangle lists and texture coordinates are
+ * copied.
+ *
+ * @param[in] filename Filename of a mapped model file.
+ * @return The loaded Morphable Model.
+ * @throw std::runtime_error When the file can't be opened, or is not a valid mapped model file.
+ */
+inline MorphableModel load_mapped_model(std::string filename)
+{
+    const auto file = std::make_shared<const core::MemoryMappedFile>(filename);
+    const detail::MappedModelHeader& header = detail::read_mapped_model_header(*file, filename);
+
+    PcaModel shape_model = detail::map_pca_model(file, detail::MappedModelSection::ShapeMean, filename);
+    PcaModel color_model = detail::map_pca_model(file, detail::MappedModelSection::ColorMean, filename);
+    const auto& texture_coordinates_entry =
+        header.sections[static_cast<std::size_t>(detail::MappedModelSection::TextureCoordinates)];
+    const double* texture_coordinates_data = detail::get_mapped_section<double>(
+        *file, detail::MappedModelSection::TextureCoordinates, texture_coordinates_entry.rows, 2, filename);
+    const auto* texture_coordinates =
+        reinterpret_cast<const std::array<double, 2>*>(texture_coordinates_data);
+    return MorphableModel(
+        std::move(shape_model), std::move(color_model),
+        std::vector<std::array<double, 2>>(texture_coordinates,
+                                           texture_coordinates + texture_coordinates_entry.rows));
+};
+
+/**
+ * Loads the blendshapes that have been stored in a mapped model file. If the file doesn't
+ * contain any, an empty vector is returned.
+ *
+ * The blendshapes are copied out of the file, since a Blendshape owns its deformation.
+ *
+ * @param[in] filename Filename of a mapped model file.
+ * @return The blendshapes stored in the file.
+ * @throw std::runtime_error When the file can't be opened, or is not a valid mapped model file.
+ */
+inline std::vector<Blendshape> load_mapped_blendshapes(std::string filename)
+{
+    const core::MemoryMappedFile file(filename);
+    const detail::MappedModelHeader& header = detail::read_mapped_model_header(file, filename);
+    const auto& deformations_entry =
+        header.sections[static_cast<std::size_t>(detail::MappedModelSection::BlendshapeDeformations)];
+    const auto& names_entry =
+        header.sections[static_cast<std::size_t>(detail::MappedModelSection::BlendshapeNames)];
+    const float* deformations =
+        detail::get_mapped_section<float>(file, detail::MappedModelSection::BlendshapeDeformations,
+                                          deformations_entry.rows, deformations_entry.cols, filename);
+    const char* names = file.data() + names_entry.offset;
+    const char* const names_end = names + names_entry.size;
+    if (names_entry.rows != deformations_entry.cols || (names_entry.size > 0 && names_end[-1] != '\0'))
+    {
+        throw std::runtime_error("The mapped model file is corrupt: " + filename);
+    }
+
+    std::vector<Blendshape> blendshapes(deformations_entry.cols);
+    for (std::size_t i = 0; i < blendshapes.size(); ++i)
+    {
+        if (names == names_end)
+        {
+            throw std::runtime_error("The mapped model file is corrupt: " + filename);
+        }
+        blendshapes[i].name = names;
+        names += blendshapes[i].name.size() + 1;
+        blendshapes[i].deformation = Eigen::Map<const Eigen::VectorXf>(
+            deformations + i * deformations_entry.rows, deformations_entry.rows);
+    }
+    return blendshapes;
+};
+
+} /* namespace morphablemodel */
+} /* namespace eos */
+
+#endif /* MAPPED_MODEL_HPP_ */
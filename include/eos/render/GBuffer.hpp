@@ -0,0 +1,64 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/GBuffer.hpp
+ *
+ * Copyright 2026 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_GBUFFER_HPP_
+#define EOS_GBUFFER_HPP_
+
+#include "eos/core/Image.hpp"
+
+namespace eos {
+namespace render {
+
+/**
+ * @brief Selects which render targets render_gbuffer(...) writes, in addition to the
+ * colour and depth buffer, which are always written.
+ */
+struct RenderTargets
+{
+    bool normals = false;      ///< Per-pixel unit normals in eye space, interpolated from the vertex normals
+    bool barycentrics = false; ///< Per-pixel barycentric coordinates w.r.t. the visible mesh triangle
+    bool triangle_ids = false; ///< Per-pixel index of the visible mesh triangle (into core::Mesh::tvi)
+    bool mask = false;         ///< 255 where the mesh is visible, 0 elsewhere
+};
+
+/**
+ * @brief The outputs of a single rendering pass (a "G-buffer"), with one image per render
+ * target.
+ *
+ * The colour and depth buffer are the same as the ones returned by render(...). The other
+ * images are only allocated if they were requested in the RenderTargets, otherwise they
+ * are empty. Background pixels are 0 in the normals, barycentrics and mask, and -1 in
+ * the triangle ids.
+ */
+struct GBuffer
+{
+    core::Image4u colorbuffer;  ///< Colour, in BGRA order
+    core::Image1d depthbuffer;  ///< Depth in NDC, std::numeric_limits<double>::max() for the background
+    core::Image3f normals;      ///< Unit normals in eye space
+    core::Image3f barycentrics; ///< Barycentric coordinates w.r.t. the triangle given in triangle_ids
+    core::Image1i triangle_ids; ///< Index into core::Mesh::tvi, or -1 for the background
+    core::Image1u mask;         ///< 255 where the mesh is visible, 0 elsewhere
+};
+
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* EOS_GBUFFER_HPP_ */
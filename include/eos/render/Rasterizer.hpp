@@ -22,19 +22,47 @@
 #ifndef RASTERIZER_HPP_
 #define RASTERIZER_HPP_
 
+#include "eos/render/GBuffer.hpp"
 #include "eos/render/Rect.hpp"
 #include "eos/render/detail/Vertex.hpp"
 #include "eos/render/utils.hpp" // for Texture
 
+#include "glm/geometric.hpp"
+#include "glm/vec3.hpp"
+
 #include "opencv2/core/core.hpp"
 
 #include "boost/optional.hpp"
 
+#include <array>
 #include <limits>
 
 namespace eos {
 namespace render {
 
+namespace detail {
+
+/**
+ * @brief Per-triangle data that the Rasterizer needs to write the additional render targets.
+ *
+ * triangle_index is the index of the mesh triangle (into core::Mesh::tvi) the rasterised
+ * triangle was set up from, and barycentrics are the barycentric coordinates of its three
+ * vertices w.r.t. that mesh triangle (the unit vectors, unless the triangle was created by
+ * clipping). normals are the eye-space normals of the mesh triangle's three vertices.
+ */
+template <typename T, glm::precision P = glm::defaultp>
+struct TriangleAttributes
+{
+    int triangle_index = -1;
+    std::array<glm::tvec3<T, P>, 3> barycentrics = {glm::tvec3<T, P>(T(1), T(0), T(0)),
+                                                    glm::tvec3<T, P>(T(0), T(1), T(0)),
+                                                    glm::tvec3<T, P>(T(0), T(0), T(1))};
+    std::array<glm::tvec3<T, P>, 3> normals = {glm::tvec3<T, P>(T(0)), glm::tvec3<T, P>(T(0)),
+                                               glm::tvec3<T, P>(T(0))};
+};
+
+} /* namespace detail */
+
 /**
  * @brief Todo.
  *
@@ -54,17 +82,57 @@ public:
             std::numeric_limits<double>::max() * cv::Mat::ones(viewport_height, viewport_width, CV_64FC1);
     };
 
+    /**
+     * @brief Allocates the additional render targets that raster_triangle(...) writes in
+     * the same pass as the colour and depth buffer, and frees the ones that are not
+     * requested.
+     *
+     * The background of the normal, barycentric and mask buffers is 0, and -1 for the
+     * triangle id buffer. See RenderTargets and GBuffer for what they contain.
+     *
+     * @param[in] render_targets The render targets to write, in addition to colour and depth.
+     */
+    void set_render_targets(const RenderTargets& render_targets)
+    {
+        normalbuffer = render_targets.normals
+                           ? cv::Mat(viewport_height, viewport_width, CV_32FC3, cv::Scalar::all(0))
+                           : cv::Mat();
+        barycentricbuffer = render_targets.barycentrics
+                                ? cv::Mat(viewport_height, viewport_width, CV_32FC3, cv::Scalar::all(0))
+                                : cv::Mat();
+        triangle_id_buffer = render_targets.triangle_ids
+                                 ? cv::Mat(viewport_height, viewport_width, CV_32SC1, cv::Scalar::all(-1))
+                                 : cv::Mat();
+        maskbuffer = render_targets.mask
+                         ? cv::Mat(viewport_height, viewport_width, CV_8UC1, cv::Scalar::all(0))
+                         : cv::Mat();
+    };
+
+    /**
+     * @brief Returns whether any of the additional render targets is allocated.
+     */
+    bool has_render_targets() const
+    {
+        return !normalbuffer.empty() || !barycentricbuffer.empty() || !triangle_id_buffer.empty() ||
+               !maskbuffer.empty();
+    };
+
     /**
      * @brief Todo.
      *
      * X
+     * If additional render targets are set (see set_render_targets(...)), they are written
+     * in the same pass, using the given triangle attributes.
      *
      * @param[in] vertex X.
+     * @param[in] attributes Data of the mesh triangle, used to write the additional render targets.
      * @ return X.
      */
     template <typename T, glm::precision P = glm::defaultp>
     void raster_triangle(const detail::Vertex<T, P>& point_a, const detail::Vertex<T, P>& point_b,
-                         const detail::Vertex<T, P>& point_c, const boost::optional<Texture>& texture)
+                         const detail::Vertex<T, P>& point_c, const boost::optional<Texture>& texture,
+                         const detail::TriangleAttributes<T, P>& attributes =
+                             detail::TriangleAttributes<T, P>())
     {
         // We already calculated this in the culling/clipping stage. Maybe we should save/cache it after all.
         Rect<int> boundingBox = detail::calculate_clipped_bounding_box(
@@ -208,10 +276,10 @@ public:
                                 one_over_squared_one_over_z * (alpha_ffy * one_over_z - u_over_z * gamma_ffy);
                             float dvdy =
                                 one_over_squared_one_over_z * (beta_ffy * one_over_z - v_over_z * gamma_ffy);
-                            dudx *= texture.get().mipmaps[0].cols;
-                            dudy *= texture.get().mipmaps[0].cols;
-                            dvdx *= texture.get().mipmaps[0].rows;
-                            dvdy *= texture.get().mipmaps[0].rows;
+                            dudx *= texture.get().base_level.cols;
+                            dudy *= texture.get().base_level.cols;
+                            dvdx *= texture.get().base_level.rows;
+                            dvdy *= texture.get().base_level.rows;
 
                             // Why does it need x and y? Maybe some shaders (eg TexExtr?) need it?
                             pixel_color = fragment_shader.shade_triangle_pixel(
@@ -241,6 +309,37 @@ public:
                         colorbuffer.at<cv::Vec4b>(pixel_index_row, pixel_index_col)[1] = green;
                         colorbuffer.at<cv::Vec4b>(pixel_index_row, pixel_index_col)[2] = red;
                         colorbuffer.at<cv::Vec4b>(pixel_index_row, pixel_index_col)[3] = alpha;
+                        // Additional render targets, if enabled with set_render_targets(...):
+                        if (!normalbuffer.empty() || !barycentricbuffer.empty())
+                        {
+                            // Barycentric coordinates w.r.t. the mesh triangle:
+                            const glm::tvec3<T, P> barycentrics = lambda[0] * attributes.barycentrics[0] +
+                                                                  lambda[1] * attributes.barycentrics[1] +
+                                                                  lambda[2] * attributes.barycentrics[2];
+                            if (!normalbuffer.empty())
+                            {
+                                const glm::tvec3<T, P> normal = glm::normalize(
+                                    barycentrics[0] * attributes.normals[0] +
+                                    barycentrics[1] * attributes.normals[1] +
+                                    barycentrics[2] * attributes.normals[2]);
+                                normalbuffer.at<cv::Vec3f>(pixel_index_row, pixel_index_col) =
+                                    cv::Vec3f(normal[0], normal[1], normal[2]);
+                            }
+                            if (!barycentricbuffer.empty())
+                            {
+                                barycentricbuffer.at<cv::Vec3f>(pixel_index_row, pixel_index_col) =
+                                    cv::Vec3f(barycentrics[0], barycentrics[1], barycentrics[2]);
+                            }
+                        }
+                        if (!triangle_id_buffer.empty())
+                        {
+                            triangle_id_buffer.at<int>(pixel_index_row, pixel_index_col) =
+                                attributes.triangle_index;
+                        }
+                        if (!maskbuffer.empty())
+                        {
+                            maskbuffer.at<unsigned char>(pixel_index_row, pixel_index_col) = 255;
+                        }
                         if (enable_depth_test) // TODO: A better name for this might be enable_zbuffer? or
                                                // enable_zbuffer_test?
                         {
@@ -265,6 +364,11 @@ public:                            // will eventually go private
 
     cv::Mat colorbuffer;
     cv::Mat depthbuffer;
+    // Additional render targets, only allocated if requested with set_render_targets(...):
+    cv::Mat normalbuffer;       // CV_32FC3, eye-space unit normals
+    cv::Mat barycentricbuffer;  // CV_32FC3, barycentric coordinates w.r.t. the mesh triangle
+    cv::Mat triangle_id_buffer; // CV_32SC1, index into core::Mesh::tvi, -1 for the background
+    cv::Mat maskbuffer;         // CV_8UC1, 255 where the mesh is visible
 };
 
 } /* namespace render */
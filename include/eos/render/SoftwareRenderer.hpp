@@ -23,21 +23,31 @@
 #define SOFTWARERENDERER_HPP_
 
 #include "eos/core/Mesh.hpp"
+#include "eos/morphablemodel/MeshletTopology.hpp"
+#include "eos/render/GBuffer.hpp"
 #include "eos/render/Rasterizer.hpp"
 #include "eos/render/detail/Vertex.hpp"
+#include "eos/render/detail/meshlet_culling.hpp"
 #include "eos/render/detail/render_detail.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
 #include "eos/render/utils.hpp" // for Texture, potentially others
 
 #include "glm/mat4x4.hpp"
 #include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
 
+#include "Eigen/Core"
+#include "Eigen/LU"
+
 #include "opencv2/core/core.hpp"
 
 #include "boost/optional.hpp"
 
 #include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -53,12 +63,6 @@
 namespace eos {
 namespace render {
 
-// Forward declarations (these functions should probably be moved into detail/):
-template <typename T, glm::precision P = glm::defaultp>
-std::vector<detail::Vertex<T, P>>
-clip_polygon_to_plane_in_4d(const std::vector<detail::Vertex<T, P>>& vertices,
-                            const glm::tvec4<T, P>& plane_normal);
-
 /**
  * @brief X.
  *
@@ -110,8 +114,8 @@ public:
         assert(mesh.vertices.size() == mesh.colors.size() ||
                mesh.colors.empty()); // The number of vertices has to be equal for both shape and colour, or,
                                      // alternatively, it has to be a shape-only model.
-        assert(mesh.vertices.size() == mesh.texcoords.size() ||
-               mesh.texcoords.empty()); // same for the texcoords
+        assert(mesh.vertices.size() == mesh.texcoords().size() ||
+               mesh.texcoords().empty()); // same for the texcoords
         // Add another assert: If cv::Mat texture != empty (and/or texturing=true?), then we need texcoords?
 
         using cv::Mat;
@@ -119,6 +123,7 @@ public:
         using std::vector;
 
         vector<glm::tvec4<T, P>> clipspace_vertices;
+        clipspace_vertices.reserve(mesh.vertices.size());
         for (const auto& vertex_position : mesh.vertices)
         {
             clipspace_vertices.push_back(
@@ -128,34 +133,75 @@ public:
             // need vertex-colours at all! We can do it in a custom VertexShader if needed!
         }
 
+        // Compute the frustum outcodes once per vertex (instead of once per triangle corner):
+        vector<std::uint8_t> outcodes;
+        outcodes.reserve(clipspace_vertices.size());
+        for (const auto& v : clipspace_vertices)
+        {
+            outcodes.push_back(detail::compute_outcode(v.x, v.y, v.z, v.w, enable_near_clipping,
+                                                       rasterizer->enable_far_clipping));
+        }
+
         // All vertices are in clip-space now. Prepare the rasterisation stage:
+        // If a meshlet topology is set, cull whole meshlets first, and only process the triangles of the
+        // remaining ones:
+        vector<int> meshlet_triangles;
+        if (meshlet_topology)
+        {
+            const glm::tmat4x4<float> mvp(projection_matrix * model_view_matrix);
+            meshlet_triangles =
+                detail::cull_meshlets(*meshlet_topology, detail::to_eigen(mvp), enable_backface_culling,
+                                      enable_near_clipping, rasterizer->enable_far_clipping);
+        }
+        const std::size_t num_triangles = meshlet_topology ? meshlet_triangles.size() : mesh.tvi().size();
+
+        // If the rasteriser writes additional render targets, we keep track of which mesh triangle each
+        // rasterised triangle comes from, and compute the eye-space vertex normals:
+        const bool write_render_targets = rasterizer->has_render_targets();
+        vector<glm::tvec3<T, P>> vertex_normals;
+        if (!rasterizer->normalbuffer.empty())
+        {
+            const Eigen::Matrix4f model_view = detail::to_eigen(glm::tmat4x4<float>(model_view_matrix));
+            const Eigen::Matrix3f normal_matrix = model_view.topLeftCorner<3, 3>().inverse().transpose();
+            vertex_normals.reserve(mesh.vertices.size());
+            for (const auto& n : compute_vertex_normals(mesh.vertices.as_matrix(), mesh.tvi()))
+            {
+                Eigen::Vector3f n_eye = normal_matrix * n;
+                if (n_eye.norm() > 0.0f)
+                {
+                    n_eye.normalize();
+                }
+                vertex_normals.push_back(glm::tvec3<T, P>(n_eye[0], n_eye[1], n_eye[2]));
+            }
+        }
+        vector<detail::TriangleAttributes<T, P>> triangle_attributes;
+        const auto make_triangle_attributes = [&vertex_normals](int triangle_index,
+                                                                const std::array<int, 3>& tri_indices) {
+            detail::TriangleAttributes<T, P> attributes;
+            attributes.triangle_index = triangle_index;
+            if (!vertex_normals.empty())
+            {
+                attributes.normals = {vertex_normals[tri_indices[0]], vertex_normals[tri_indices[1]],
+                                      vertex_normals[tri_indices[2]]};
+            }
+            return attributes;
+        };
+
         vector<Triangle<T, P>> triangles_to_raster;
+        triangles_to_raster.reserve(num_triangles);
+        if (write_render_targets)
+        {
+            triangle_attributes.reserve(num_triangles);
+        }
         // This builds the (one and final) triangles to render. Meaning: The triangles formed of mesh.tvi (the
         // ones that survived the clip/culling), plus possibly more that intersect one of the frustum planes
         // (i.e. this can generate new triangles with new pos/vc/texcoords).
-        for (const auto& tri_indices : mesh.tvi)
+        for (std::size_t i = 0; i < num_triangles; ++i)
         {
-            unsigned char visibility_bits[3];
-            for (unsigned char k = 0; k < 3; k++)
-            {
-                visibility_bits[k] = 0;
-                const auto x_cc = clipspace_vertices[tri_indices[k]].x;
-                const auto y_cc = clipspace_vertices[tri_indices[k]].y;
-                const auto z_cc = clipspace_vertices[tri_indices[k]].z;
-                const auto w_cc = clipspace_vertices[tri_indices[k]].w;
-                if (x_cc < -w_cc) // true if outside of view frustum. False if on or inside the plane.
-                    visibility_bits[k] |= 1; // set bit if outside of frustum
-                if (x_cc > w_cc)
-                    visibility_bits[k] |= 2;
-                if (y_cc < -w_cc)
-                    visibility_bits[k] |= 4;
-                if (y_cc > w_cc)
-                    visibility_bits[k] |= 8;
-                if (enable_near_clipping && z_cc < -w_cc) // near plane frustum clipping
-                    visibility_bits[k] |= 16;
-                if (rasterizer->enable_far_clipping && z_cc > w_cc) // far plane frustum clipping
-                    visibility_bits[k] |= 32;
-            } // if all bits are 0, then it's inside the frustum
+            const int triangle_index = meshlet_topology ? meshlet_triangles[i] : static_cast<int>(i);
+            const auto& tri_indices = mesh.tvi()[triangle_index];
+            const std::uint8_t visibility_bits[3] = {outcodes[tri_indices[0]], outcodes[tri_indices[1]],
+                                                     outcodes[tri_indices[2]]};
             // all vertices are not visible - reject the triangle.
             if ((visibility_bits[0] & visibility_bits[1] & visibility_bits[2]) > 0)
             {
@@ -220,44 +266,55 @@ public:
                 // If we're here, the triangle is CCW in screen space and the bbox is inside the viewport!
                 triangles_to_raster.push_back(
                     Triangle<T, P>{detail::Vertex<T, P>{prospective_tri[0], mesh.colors[tri_indices[0]],
-                                                        mesh.texcoords[tri_indices[0]]},
+                                                        mesh.texcoords()[tri_indices[0]]},
                                    detail::Vertex<T, P>{prospective_tri[1], mesh.colors[tri_indices[1]],
-                                                        mesh.texcoords[tri_indices[1]]},
+                                                        mesh.texcoords()[tri_indices[1]]},
                                    detail::Vertex<T, P>{prospective_tri[2], mesh.colors[tri_indices[2]],
-                                                        mesh.texcoords[tri_indices[2]]}});
+                                                        mesh.texcoords()[tri_indices[2]]}});
+                if (write_render_targets)
+                {
+                    triangle_attributes.push_back(make_triangle_attributes(triangle_index, tri_indices));
+                }
                 continue; // Triangle was either added or not added. Continue with next triangle.
             }
             // At this point, the triangle is known to be intersecting one of the view frustum's planes
             // Note: It seems that this is only w.r.t. the near-plane. If a triangle is partially outside the
             // tlbr viewport, it'll get rejected.
             // Well, 'z' of these triangles seems to be -1, so is that really the near plane?
-            std::vector<detail::Vertex<T, P>> vertices;
-            vertices.reserve(3);
+            detail::PolygonToClip<T, P> vertices;
             vertices.push_back(detail::Vertex<T, P>{clipspace_vertices[tri_indices[0]],
                                                     mesh.colors[tri_indices[0]],
-                                                    mesh.texcoords[tri_indices[0]]});
+                                                    mesh.texcoords()[tri_indices[0]]});
             vertices.push_back(detail::Vertex<T, P>{clipspace_vertices[tri_indices[1]],
                                                     mesh.colors[tri_indices[1]],
-                                                    mesh.texcoords[tri_indices[1]]});
+                                                    mesh.texcoords()[tri_indices[1]]});
             vertices.push_back(detail::Vertex<T, P>{clipspace_vertices[tri_indices[2]],
                                                     mesh.colors[tri_indices[2]],
-                                                    mesh.texcoords[tri_indices[2]]});
-            // split the triangle if it intersects the near plane:
-            if (enable_near_clipping)
+                                                    mesh.texcoords()[tri_indices[2]]});
+            // split the triangle if it intersects the near plane (bit 16 of the outcodes, only set if
+            // enable_near_clipping is true), or if it extends beyond the guard band. Clipping happens in
+            // place, without allocating.
+            const unsigned int planes_crossed = visibility_bits[0] | visibility_bits[1] | visibility_bits[2];
+            const unsigned int planes_to_clip =
+                (planes_crossed & 16u) | detail::compute_guard_band_planes(vertices);
+            detail::clip_polygon_to_frustum(vertices, planes_to_clip, T(detail::guard_band_size));
+
+            // Where the polygon's vertices lie on the mesh triangle, for the additional render targets:
+            std::array<glm::tvec3<T, P>, detail::PolygonToClip<T, P>::max_vertices> polygon_barycentrics;
+            if (write_render_targets)
             {
-                vertices = clip_polygon_to_plane_in_4d(
-                    vertices, glm::tvec4<T, P>(T(0.0), T(0.0), T(-1.0),
-                                               T(-1.0))); // "Normal" (or "4D hyperplane") of the near-plane.
-                                                          // I tested it and it works like this but I'm a
-                                                          // little bit unsure because Songho says the normal
-                                                          // of the near-plane is (0,0,-1,1) (maybe I have to
-                                                          // switch around the < 0 checks in the function?)
+                for (int k = 0; k < vertices.size; k++)
+                {
+                    polygon_barycentrics[k] = detail::compute_barycentrics_in_4d(
+                        vertices[k].position, clipspace_vertices[tri_indices[0]],
+                        clipspace_vertices[tri_indices[1]], clipspace_vertices[tri_indices[2]]);
+                }
             }
 
             // Triangulation of the polygon formed of the 'vertices' array:
-            if (vertices.size() >= 3)
+            if (vertices.size >= 3)
             {
-                for (unsigned char k = 0; k < vertices.size() - 2; k++)
+                for (int k = 0; k < vertices.size - 2; k++)
                 {
                     // Build a triangle from vertices[0], vertices[1 + k], vertices[2 + k]:
                     // Add to triangles_to_raster if it passed culling etc.
@@ -313,6 +370,14 @@ public:
                                              vertices[1 + k].texcoords},
                         detail::Vertex<T, P>{prospective_tri[2], vertices[2 + k].color,
                                              vertices[2 + k].texcoords}});
+                    if (write_render_targets)
+                    {
+                        detail::TriangleAttributes<T, P> attributes =
+                            make_triangle_attributes(triangle_index, tri_indices);
+                        attributes.barycentrics = {polygon_barycentrics[0], polygon_barycentrics[1 + k],
+                                                   polygon_barycentrics[2 + k]};
+                        triangle_attributes.push_back(attributes);
+                    }
                     // continue; // triangle was either added or not added. Continue with next triangle.
                     // COPY END
                 }
@@ -324,15 +389,24 @@ public:
         // We may have more triangles than in the original mesh.
 
         // Raster each triangle and apply the fragment shader on each pixel:
-        for (const auto& tri : triangles_to_raster)
+        for (std::size_t t = 0; t < triangles_to_raster.size(); ++t)
         {
-            rasterizer->raster_triangle(tri[0], tri[1], tri[2], texture);
+            const auto& tri = triangles_to_raster[t];
+            if (write_render_targets)
+            {
+                rasterizer->raster_triangle(tri[0], tri[1], tri[2], texture, triangle_attributes[t]);
+            } else
+            {
+                rasterizer->raster_triangle(tri[0], tri[1], tri[2], texture);
+            }
         }
         return rasterizer->colorbuffer;
     };
 
 public: // Todo: these should go private in the final implementation
     boost::optional<Texture> texture = boost::none;
+    boost::optional<morphablemodel::MeshletTopology> meshlet_topology =
+        boost::none; // If set, whole meshlets are culled first. Its bounds must match the rendered mesh.
     bool enable_backface_culling = false;
     bool enable_near_clipping = true;
 
@@ -341,76 +415,6 @@ private:
     VertexShaderType vertex_shader;
 };
 
-/**
- * @brief Todo.
- *
- * This function copied from render_detail.hpp and adjusted for v2:: stuff.
- * I think it should go back to render_details eventually.
- *
- * @param[in] vertices X.
- * @param[in] plane_normal X.
- * @ return X.
- */
-template <typename T, glm::precision P = glm::defaultp>
-std::vector<detail::Vertex<T, P>>
-clip_polygon_to_plane_in_4d(const std::vector<detail::Vertex<T, P>>& vertices,
-                            const glm::tvec4<T, P>& plane_normal)
-{
-    std::vector<detail::Vertex<T, P>> clipped_vertices;
-
-    // We can have 2 cases:
-    //	* 1 vertex visible: we make 1 new triangle out of the visible vertex plus the 2 intersection points
-    // with the near-plane
-    //  * 2 vertices visible: we have a quad, so we have to make 2 new triangles out of it.
-
-    // See here for more info?
-    // http://math.stackexchange.com/questions/400268/equation-for-a-line-through-a-plane-in-homogeneous-coordinates
-
-    for (unsigned int i = 0; i < vertices.size(); i++)
-    {
-        int a = i;                         // the current vertex
-        int b = (i + 1) % vertices.size(); // the following vertex (wraps around 0)
-
-        using glm::dot;
-        const T fa = dot(vertices[a].position, plane_normal); // Note: Shouldn't they be unit length?
-        const T fb = dot(vertices[b].position,
-                         plane_normal); // < 0 means on visible side, > 0 means on invisible side?
-
-        if ((fa < 0 && fb > 0) || (fa > 0 && fb < 0)) // one vertex is on the visible side of the plane, one
-                                                      // on the invisible? so we need to split?
-        {
-            const glm::tvec4<T, P> direction = vertices[b].position - vertices[a].position;
-            const T t = -(dot(plane_normal, vertices[a].position)) /
-                        (dot(plane_normal, direction)); // the parametric value on the line, where the line to
-                                                        // draw intersects the plane?
-
-            // generate a new vertex at the line-plane intersection point
-            const glm::tvec4<T, P> position = vertices[a].position + t * direction;
-            const glm::tvec3<T, P> color = vertices[a].color + t * (vertices[b].color - vertices[a].color);
-            const glm::tvec2<T, P> texcoords =
-                vertices[a].texcoords +
-                t * (vertices[b].texcoords -
-                     vertices[a].texcoords); // We could omit that if we don't render with texture.
-
-            if (fa < 0) // we keep the original vertex plus the new one
-            {
-                clipped_vertices.push_back(vertices[a]);
-                clipped_vertices.push_back(detail::Vertex<T, P>{position, color, texcoords});
-            } else if (fb < 0) // we use only the new vertex
-            {
-                clipped_vertices.push_back(detail::Vertex<T, P>{position, color, texcoords});
-            }
-        } else if (fa < 0 && fb < 0) // both are visible (on the "good" side of the plane), no splitting
-                                     // required, use the current vertex
-        {
-            clipped_vertices.push_back(vertices[a]);
-        }
-        // else, both vertices are not visible, nothing to add and draw
-    }
-
-    return clipped_vertices;
-};
-
 } /* namespace render */
 } /* namespace eos */
 
@@ -26,6 +26,16 @@
 #include "opencv2/imgproc/imgproc.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 namespace eos {
@@ -52,84 +62,317 @@ inline unsigned int get_max_possible_mipmaps_num(unsigned int width, unsigned in
 inline bool is_power_of_two(int x) { return !(x & (x - 1)); };
 
 /**
- * @brief Represents a texture for rendering.
+ * @brief One mip level of a Texture, stored in tiles of 4x4 texels.
  *
- * Represents a texture and mipmap levels for use in the renderer.
- * Todo: This whole class needs a major overhaul and documentation.
+ * Each tile holds 16 BGRA texels (64 bytes, one cache line) in row-major order, and the
+ * tiles are stored row by row. The four taps of a bilinear lookup thus mostly fall into
+ * the same cache line, whereas in a row-major image they're spread over two rows.
+ *
+ * The level is padded with one extra column and row, which hold copies of the first
+ * column and row (wrap-around addressing). A bilinear lookup at (x, y) with
+ * 0 <= x < width and 0 <= y < height can thus read the texels at x + 1 and y + 1 without
+ * any edge checks. The remaining padding up to a multiple of the tile size is filled the
+ * same way.
  */
-class Texture
+struct TiledMipmap
 {
-public:
-    std::vector<cv::Mat> mipmaps;      // make Texture a friend class of renderer, then move this to private?
-    unsigned char widthLog, heightLog; // log2 of width and height of the base mip-level
+    static constexpr int tile_size = 4; ///< Width and height of a tile, in texels.
 
-    // private:
-    // std::string filename;
-    unsigned int mipmaps_num;
+    std::vector<std::array<std::uint8_t, 4>> texels; ///< BGRA texels, in tile order.
+    int width = 0;                                   ///< Width of the mip level (without padding).
+    int height = 0;                                  ///< Height of the mip level (without padding).
+    int tiles_per_row = 0;                           ///< Number of tiles in a row of tiles.
+
+    /**
+     * Returns the index of the texel at (x, y) in \c texels. x and y may be
+     * one past the last column or row, i.e. lie in the padding.
+     */
+    std::size_t index(int x, int y) const
+    {
+        const int tile = (y / tile_size) * tiles_per_row + x / tile_size;
+        return static_cast<std::size_t>(tile) * tile_size * tile_size + (y % tile_size) * tile_size +
+               x % tile_size;
+    };
 };
 
-// throws: ocv exc,  runtime_ex
-inline Texture create_mipmapped_texture(cv::Mat image, unsigned int mipmapsNum = 0)
+/**
+ * Allocates a tiled mip level of the given size, including its padding.
+ */
+inline TiledMipmap allocate_tiled_mipmap(int width, int height)
 {
-    assert(image.type() == CV_8UC3 || image.type() == CV_8UC4);
-
-    Texture texture;
+    constexpr int tile_size = TiledMipmap::tile_size;
+    TiledMipmap tiled;
+    tiled.width = width;
+    tiled.height = height;
+    // One column and row of padding for the wrap-around, then round up to full tiles:
+    tiled.tiles_per_row = (width + 1 + tile_size - 1) / tile_size;
+    const int tiles_per_col = (height + 1 + tile_size - 1) / tile_size;
+    tiled.texels.resize(static_cast<std::size_t>(tiled.tiles_per_row) * tiles_per_col * tile_size *
+                        tile_size);
+    return tiled;
+};
 
-    texture.mipmaps_num =
-        (mipmapsNum == 0 ? get_max_possible_mipmaps_num(image.cols, image.rows) : mipmapsNum);
-    /*if (mipmapsNum == 0)
+/**
+ * Fills the padding of a tiled mip level with the wrap-around texels, after its texels
+ * inside [0, width) x [0, height) have been set.
+ */
+inline void fill_tiled_mipmap_padding(TiledMipmap& tiled)
+{
+    const int padded_width = tiled.tiles_per_row * TiledMipmap::tile_size;
+    const int padded_height = static_cast<int>(tiled.texels.size()) / padded_width;
+    for (int y = 0; y < padded_height; ++y)
     {
-    uchar mmn = render::utils::MatrixUtils::getMaxPossibleMipmapsNum(image.cols, image.rows);
-    this->mipmapsNum = mmn;
-    } else
+        for (int x = (y < tiled.height ? tiled.width : 0); x < padded_width; ++x)
+        {
+            tiled.texels[tiled.index(x, y)] = tiled.texels[tiled.index(x % tiled.width, y % tiled.height)];
+        }
+    }
+};
+
+/**
+ * Creates a tiled and padded copy of the given mip level, see TiledMipmap.
+ *
+ * @param[in] mipmap A mip level of type CV_8UC4.
+ * @return The mip level in tiled layout.
+ */
+inline TiledMipmap create_tiled_mipmap(const cv::Mat& mipmap)
+{
+    assert(mipmap.type() == CV_8UC4);
+    TiledMipmap tiled = allocate_tiled_mipmap(mipmap.cols, mipmap.rows);
+    for (int y = 0; y < tiled.height; ++y)
     {
-    this->mipmapsNum = mipmapsNum;
-    }*/
+        const cv::Vec4b* source_row = mipmap.ptr<cv::Vec4b>(y);
+        for (int x = 0; x < tiled.width; ++x)
+        {
+            const cv::Vec4b& texel = source_row[x];
+            tiled.texels[tiled.index(x, y)] = {texel[0], texel[1], texel[2], texel[3]};
+        }
+    }
+    fill_tiled_mipmap_padding(tiled);
+    return tiled;
+};
 
-    if (texture.mipmaps_num > 1)
+/**
+ * Computes the next smaller mip level with a box filter.
+ *
+ * The width and height are halved and rounded down. For an even size, each texel is the
+ * average of a 2x2 block. Sizes don't have to be powers of two: Along an odd dimension,
+ * the last texel of the new level averages three texels instead of two, so that every
+ * texel of the larger level contributes.
+ *
+ * @param[in] mipmap A mip level.
+ * @return The next smaller mip level.
+ */
+inline TiledMipmap downsample_tiled_mipmap(const TiledMipmap& mipmap)
+{
+    // The texels and weights along one dimension that contribute to texel i of the new level:
+    struct BoxTaps
     {
-        if (!is_power_of_two(image.cols) || !is_power_of_two(image.rows))
+        std::array<int, 3> positions;
+        std::array<float, 3> weights;
+    };
+    const auto box_taps = [](int i, int size, int new_size) {
+        if (size == 1)
         {
-            throw std::runtime_error("Error: Couldn't generate mipmaps, width or height not power of two.");
+            return BoxTaps{{0, 0, 0}, {1.0f, 0.0f, 0.0f}};
         }
+        if (size % 2 == 1 && i == new_size - 1)
+        {
+            return BoxTaps{{2 * i, 2 * i + 1, 2 * i + 2}, {1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f}};
+        }
+        return BoxTaps{{2 * i, 2 * i + 1, 2 * i + 1}, {0.5f, 0.5f, 0.0f}};
+    };
+
+    TiledMipmap downsampled =
+        allocate_tiled_mipmap(std::max(mipmap.width / 2, 1), std::max(mipmap.height / 2, 1));
+    std::vector<BoxTaps> column_taps(downsampled.width);
+    for (int x = 0; x < downsampled.width; ++x)
+    {
+        column_taps[x] = box_taps(x, mipmap.width, downsampled.width);
     }
-    if (image.type() == CV_8UC3)
+    for (int y = 0; y < downsampled.height; ++y)
     {
-        image.convertTo(image, CV_8UC4); // Most often, the input img is CV_8UC3. Img is BGR. Add an alpha
-                                         // channel. TODO: Actually I think this doesn't do anything. Below
-                                         // line adds the 4th channel...
-        cv::cvtColor(image, image, CV_BGR2BGRA);
+        const BoxTaps row_taps = box_taps(y, mipmap.height, downsampled.height);
+        for (int x = 0; x < downsampled.width; ++x)
+        {
+            std::array<float, 4> sum{};
+            for (int j = 0; j < 3; ++j)
+            {
+                for (int i = 0; i < 3; ++i)
+                {
+                    const float weight = row_taps.weights[j] * column_taps[x].weights[i];
+                    const auto& texel =
+                        mipmap.texels[mipmap.index(column_taps[x].positions[i], row_taps.positions[j])];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        sum[c] += weight * texel[c];
+                    }
+                }
+            }
+            auto& texel = downsampled.texels[downsampled.index(x, y)];
+            for (int c = 0; c < 4; ++c)
+            {
+                texel[c] = static_cast<std::uint8_t>(sum[c] + 0.5f);
+            }
+        }
     }
+    fill_tiled_mipmap_padding(downsampled);
+    return downsampled;
+};
 
-    int currWidth = image.cols;
-    int currHeight = image.rows;
-    std::vector<cv::Mat> mipmaps;
-    for (unsigned int i = 0; i < texture.mipmaps_num; i++)
+/**
+ * @brief Represents a texture for rendering.
+ *
+ * Represents a texture and mipmap levels for use in the renderer.
+ *
+ * Only the base level is stored as cv::Mat, in \c base_level. The mip levels that the
+ * samplers read, in tiled layout, are built the first time they're accessed with
+ * get_mipmap(...). Copies of a Texture share these levels, so they're only built once.
+ *
+ * Todo: This whole class needs a major overhaul and documentation.
+ */
+class Texture
+{
+public:
+    cv::Mat base_level; // the base mip level (level 0), in BGRA. The other levels are built on access.
+    unsigned char widthLog = 0, heightLog = 0; // log2 of width and height of the base mip-level
+
+    // private:
+    // std::string filename;
+    unsigned int mipmaps_num = 0;
+
+    /**
+     * Returns the given mip level in tiled layout. If the level hasn't been accessed
+     * before, it's built first (and the levels above it, if necessary). This is
+     * thread-safe.
+     *
+     * Throws a std::out_of_range if \p level isn't smaller than the number of levels that
+     * were set up by the last call to reset_mipmaps() (or set_texture_image(...)). In
+     * particular, a default-constructed Texture has no levels.
+     *
+     * @param[in] level The mip level. Has to be smaller than mipmaps_num.
+     * @return The mip level.
+     */
+    const TiledMipmap& get_mipmap(unsigned int level) const
     {
-        if (i == 0)
+        if (level >= tiled_mipmaps->size())
         {
-            mipmaps.push_back(image);
-        } else
-        {
-            cv::Mat currMipMap(currHeight, currWidth, CV_8UC4);
-            cv::resize(mipmaps[i - 1], currMipMap, currMipMap.size());
-            mipmaps.push_back(currMipMap);
+            throw std::out_of_range("Texture::get_mipmap: The texture has no mip level " +
+                                    std::to_string(level) + ".");
         }
+        LazyMipmap& mipmap = (*tiled_mipmaps)[level];
+        std::call_once(mipmap.built, [&]() {
+            mipmap.mipmap = (level == 0 ? create_tiled_mipmap(base_level)
+                                        : downsample_tiled_mipmap(get_mipmap(level - 1)));
+        });
+        return mipmap.mipmap;
+    };
+
+    /**
+     * Discards all mip levels that have been built, for example after the base level
+     * changed. They will be rebuilt from the base level on their next access. Copies of
+     * this Texture keep the previous levels.
+     */
+    void reset_mipmaps() { tiled_mipmaps = std::make_shared<std::vector<LazyMipmap>>(mipmaps_num); };
+
+private:
+    struct LazyMipmap
+    {
+        std::once_flag built;
+        TiledMipmap mipmap;
+    };
+    // Never null, so that copies can share it. Empty until reset_mipmaps() is called:
+    std::shared_ptr<std::vector<LazyMipmap>> tiled_mipmaps = std::make_shared<std::vector<LazyMipmap>>();
+};
 
-        if (currWidth > 1)
-            currWidth >>= 1;
-        if (currHeight > 1)
-            currHeight >>= 1;
+/**
+ * Converts the given image to BGRA, the format of the base level of a Texture. The
+ * result never shares its data with the given image.
+ */
+inline cv::Mat convert_to_texture_format(const cv::Mat& image)
+{
+    assert(image.type() == CV_8UC3 || image.type() == CV_8UC4);
+    cv::Mat converted;
+    if (image.type() == CV_8UC3)
+    {
+        // Most often, the input img is CV_8UC3. Img is BGR. Add an alpha channel:
+        cv::cvtColor(image, converted, CV_BGR2BGRA);
+    } else
+    {
+        converted = image.clone();
     }
-    texture.mipmaps = mipmaps;
-    texture.widthLog = (uchar)(std::log(mipmaps[0].cols) / CV_LOG2 +
+    return converted;
+};
+
+/**
+ * Sets the base level of a texture and discards its mip levels.
+ *
+ * @param[in,out] texture The texture.
+ * @param[in] image The new base level, in BGRA (see convert_to_texture_format(...)).
+ * @param[in] mipmaps_num The number of mip levels. 0 means the full chain, down to 1x1.
+ */
+inline void set_texture_image(Texture& texture, cv::Mat image, unsigned int mipmaps_num)
+{
+    const unsigned int max_mipmaps_num = get_max_possible_mipmaps_num(image.cols, image.rows);
+    texture.mipmaps_num = (mipmaps_num == 0 ? max_mipmaps_num : std::min(mipmaps_num, max_mipmaps_num));
+    texture.base_level = image;
+    texture.widthLog = (uchar)(std::log(image.cols) / CV_LOG2 +
                                0.0001f); // std::epsilon or something? or why 0.0001f here?
     texture.heightLog = (uchar)(
-        std::log(mipmaps[0].rows) / CV_LOG2 +
+        std::log(image.rows) / CV_LOG2 +
         0.0001f); // Changed std::logf to std::log because it doesnt compile in linux (gcc 4.8). CHECK THAT
+    texture.reset_mipmaps();
+};
+
+/**
+ * Creates a texture from the given image. The mip levels are built lazily, the first
+ * time the renderer samples from them.
+ *
+ * The image doesn't need to have a power-of-two size, see downsample_tiled_mipmap(...).
+ * The texture keeps its own copy of the image.
+ *
+ * @param[in] image An image of type CV_8UC3 (BGR) or CV_8UC4 (BGRA).
+ * @param[in] mipmapsNum The number of mip levels. 0 means the full chain, down to 1x1.
+ * @return The texture.
+ */
+inline Texture create_mipmapped_texture(cv::Mat image, unsigned int mipmapsNum = 0)
+{
+    Texture texture;
+    set_texture_image(texture, convert_to_texture_format(image), mipmapsNum);
     return texture;
 };
 
+/**
+ * Updates a texture with a new image, e.g. with the isomap of the next video frame.
+ *
+ * If the image is identical to the current base level, the texture is left untouched, and
+ * all mip levels that have been built so far are re-used. Otherwise, the image becomes the
+ * new base level and the mip levels are rebuilt lazily, with the same number of levels (or
+ * fewer, if the image is smaller).
+ *
+ * @param[in,out] texture A texture created with create_mipmapped_texture(...).
+ * @param[in] image An image of type CV_8UC3 (BGR) or CV_8UC4 (BGRA).
+ */
+inline void update_texture(Texture& texture, const cv::Mat& image)
+{
+    const cv::Mat converted = convert_to_texture_format(image);
+    const cv::Mat& base = texture.base_level;
+    if (converted.rows == base.rows && converted.cols == base.cols)
+    {
+        bool identical = true;
+        const std::size_t row_size = static_cast<std::size_t>(converted.cols) * 4;
+        for (int y = 0; y < converted.rows && identical; ++y)
+        {
+            identical = std::memcmp(converted.ptr(y), base.ptr(y), row_size) == 0;
+        }
+        if (identical)
+        {
+            return;
+        }
+    }
+    set_texture_image(texture, converted, texture.mipmaps_num);
+};
+
 } /* namespace render */
 } /* namespace eos */
 
@@ -0,0 +1,81 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/detail/PolygonToClip.hpp
+ *
+ * Copyright 2026 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef POLYGONTOCLIP_HPP_
+#define POLYGONTOCLIP_HPP_
+
+#include "eos/render/detail/Vertex.hpp"
+
+#include "glm/vec4.hpp"
+
+#include <array>
+#include <cassert>
+
+/**
+ * The detail namespace contains implementations of internal functions, not part of the API we expose and not
+ * meant to be used by a user.
+ */
+namespace eos {
+namespace render {
+namespace detail {
+
+/**
+ * A convex polygon that is the result of clipping a triangle against the planes of
+ * the view frustum.
+ *
+ * The vertices are stored in a fixed-capacity array, so the polygon lives on the stack
+ * and clipping doesn't allocate. Each of the six frustum planes can add at most one
+ * vertex to a convex polygon, so a clipped triangle never has more than 3 + 6 = 9 vertices.
+ *
+ * Used in render and SoftwareRenderer.
+ */
+template <typename T, glm::precision P = glm::defaultp>
+struct PolygonToClip
+{
+    static constexpr int max_vertices = 9;
+
+    std::array<Vertex<T, P>, max_vertices> vertices;
+    int size = 0;
+
+    void push_back(const Vertex<T, P>& vertex)
+    {
+        assert(size < max_vertices);
+        vertices[size++] = vertex;
+    };
+
+    Vertex<T, P>& operator[](int i)
+    {
+        assert(i < size);
+        return vertices[i];
+    };
+
+    const Vertex<T, P>& operator[](int i) const
+    {
+        assert(i < size);
+        return vertices[i];
+    };
+};
+
+} /* namespace detail */
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* POLYGONTOCLIP_HPP_ */
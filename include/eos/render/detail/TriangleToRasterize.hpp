@@ -26,6 +26,7 @@
 
 #include "glm/glm.hpp"
 
+#include <array>
 #include <cmath>
 
 /**
@@ -138,6 +139,12 @@ struct TriangleToRasterize
     float alpha_ffy;
     float beta_ffy;
     float gamma_ffy;
+    // The triangle of the mesh (an index into core::Mesh::tvi) that this triangle was set up from, and the
+    // barycentric coordinates of v0, v1 and v2 w.r.t. that mesh triangle. They're only different from the
+    // unit vectors for triangles that were created by clipping. Only used to write a G-buffer.
+    int triangle_index = -1;
+    std::array<glm::vec3, 3> barycentrics = {glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+                                             glm::vec3(0.0f, 0.0f, 1.0f)};
 };
 
 } /* namespace detail */
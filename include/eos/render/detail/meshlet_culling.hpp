@@ -0,0 +1,187 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/detail/meshlet_culling.hpp
+ *
+ * Copyright 2026 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef MESHLET_CULLING_HPP_
+#define MESHLET_CULLING_HPP_
+
+#include "eos/morphablemodel/MeshletTopology.hpp"
+
+#include "Eigen/Core"
+#include "Eigen/LU"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * Implementations of internal functions, not part of the
+ * API we expose and not meant to be used by a user.
+ */
+namespace eos {
+namespace render {
+namespace detail {
+
+/**
+ * Computes the camera centre of the given model-view-projection matrix, in homogeneous
+ * model-space coordinates.
+ *
+ * The camera centre C is the point that is mapped to x_clip = y_clip = w_clip = 0. It is
+ * computed as the 4D cross product of the x, y and w rows of the matrix, i.e. C is
+ * defined by dot(C, Y) = det([row_x; row_y; row_w; Y]) for all Y. With this sign
+ * convention, a triangle with (model-space) normal n = (v1 - v0) x (v2 - v0) is
+ * front-facing (CCW in NDC) iff dot(n, C.xyz - C.w * v0) < 0.
+ *
+ * For a perspective projection, C is a finite point (C.w != 0). For an orthographic
+ * projection, C.w = 0 and C.xyz is the viewing direction.
+ *
+ * @param[in] mvp A 4x4 model-view-projection matrix.
+ * @return The homogeneous camera centre.
+ */
+inline Eigen::Vector4d compute_camera_center(const Eigen::Matrix4d& mvp)
+{
+    Eigen::Matrix4d rows;
+    rows.row(0) = mvp.row(0);
+    rows.row(1) = mvp.row(1);
+    rows.row(2) = mvp.row(3);
+    Eigen::Vector4d camera_center;
+    for (int j = 0; j < 4; ++j)
+    {
+        rows.row(3) = Eigen::RowVector4d::Unit(j);
+        camera_center[j] = rows.determinant();
+    }
+    return camera_center;
+};
+
+/**
+ * Returns whether all triangles of the given meshlet are back-facing, as seen from the
+ * given homogeneous camera centre (see compute_camera_center(...)).
+ *
+ * The test is conservative: It only returns true if every direction inside the normal
+ * cone faces away from every point inside the bounding sphere.
+ *
+ * @param[in] meshlet A meshlet with up-to-date bounds.
+ * @param[in] camera_center The homogeneous camera centre in model space.
+ * @return True if the whole meshlet can be backface-culled.
+ */
+inline bool is_meshlet_backfacing(const morphablemodel::Meshlet& meshlet,
+                                  const Eigen::Vector4d& camera_center)
+{
+    if (meshlet.cone_cutoff >= 1.0f)
+    {
+        return false;
+    }
+    const Eigen::Vector3d axis(meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2]);
+    const double sin_half_angle = meshlet.cone_cutoff;
+    if (camera_center[3] == 0.0)
+    {
+        // Orthographic: A triangle is back-facing iff dot(n, C.xyz) > 0, for all positions.
+        const Eigen::Vector3d view_direction = camera_center.head<3>().normalized();
+        return axis.dot(view_direction) > sin_half_angle;
+    }
+    // Perspective: A triangle is back-facing iff sign(C.w) * dot(n, p - e) < 0, with e = C.xyz / C.w.
+    // All normals of the cone face away from all points p of the sphere if the angle between the axis and
+    // (p - e) is smaller than 90 degrees minus the cone's half-angle, for all p.
+    const Eigen::Vector3d eye = camera_center.head<3>() / camera_center[3];
+    const Eigen::Vector3d oriented_axis = camera_center[3] > 0.0 ? -axis : axis;
+    const Eigen::Vector3d center_to_eye =
+        Eigen::Vector3d(meshlet.center[0], meshlet.center[1], meshlet.center[2]) - eye;
+    const double radius = meshlet.radius;
+    return oriented_axis.dot(center_to_eye) >
+           center_to_eye.norm() * sin_half_angle + radius * (1.0 + sin_half_angle);
+};
+
+/**
+ * Returns whether the bounding sphere of the given meshlet is entirely outside one of the
+ * planes of the view frustum. Like the per-triangle outcode test, the near and far planes
+ * are only tested if the respective clipping is enabled.
+ *
+ * @param[in] meshlet A meshlet with up-to-date bounds.
+ * @param[in] mvp The 4x4 model-view-projection matrix.
+ * @param[in] enable_near_clipping Whether to test against the near plane.
+ * @param[in] enable_far_clipping Whether to test against the far plane.
+ * @return True if the whole meshlet is outside the view frustum.
+ */
+inline bool is_meshlet_outside_frustum(const morphablemodel::Meshlet& meshlet, const Eigen::Matrix4d& mvp,
+                                       bool enable_near_clipping, bool enable_far_clipping)
+{
+    const Eigen::Vector4d center(meshlet.center[0], meshlet.center[1], meshlet.center[2], 1.0);
+    // A point p is inside all planes iff dot(plane, p) >= 0, with the planes in the same order as the
+    // outcode bits: left, right, bottom, top, near, far.
+    for (int i = 0; i < 6; ++i)
+    {
+        if ((i == 4 && !enable_near_clipping) || (i == 5 && !enable_far_clipping))
+        {
+            continue;
+        }
+        const double sign = (i % 2 == 0) ? 1.0 : -1.0;
+        const Eigen::RowVector4d plane = mvp.row(3) + sign * mvp.row(i / 2);
+        if (plane.dot(center) < -meshlet.radius * plane.head<3>().norm())
+        {
+            return true;
+        }
+    }
+    return false;
+};
+
+/**
+ * Culls whole meshlets against the view frustum and, if enabled, against the viewing
+ * direction, and returns the indices of the triangles of all remaining meshlets.
+ *
+ * The result contains a subset of the triangles that the per-triangle tests of the
+ * renderer would keep, so rendering only these triangles gives the same image, as long
+ * as the meshlet bounds are up-to-date for the rendered mesh.
+ *
+ * @param[in] meshlet_topology The meshlet topology of the mesh.
+ * @param[in] mvp The 4x4 model-view-projection matrix.
+ * @param[in] enable_backface_culling Whether back-facing meshlets should be culled.
+ * @param[in] enable_near_clipping Whether to test against the near plane.
+ * @param[in] enable_far_clipping Whether to test against the far plane.
+ * @return Indices into core::Mesh::tvi of the triangles that need to be processed.
+ */
+inline std::vector<int> cull_meshlets(const morphablemodel::MeshletTopology& meshlet_topology,
+                                      const Eigen::Matrix4f& mvp, bool enable_backface_culling,
+                                      bool enable_near_clipping, bool enable_far_clipping)
+{
+    const Eigen::Matrix4d mvp_d = mvp.cast<double>();
+    const Eigen::Vector4d camera_center = compute_camera_center(mvp_d);
+
+    std::vector<int> triangle_indices;
+    triangle_indices.reserve(meshlet_topology.triangle_indices.size());
+    for (const auto& meshlet : meshlet_topology.meshlets)
+    {
+        if (is_meshlet_outside_frustum(meshlet, mvp_d, enable_near_clipping, enable_far_clipping))
+        {
+            continue;
+        }
+        if (enable_backface_culling && is_meshlet_backfacing(meshlet, camera_center))
+        {
+            continue;
+        }
+        const auto first = std::begin(meshlet_topology.triangle_indices) + meshlet.triangle_offset;
+        triangle_indices.insert(std::end(triangle_indices), first, first + meshlet.triangle_count);
+    }
+    return triangle_indices;
+};
+
+} /* namespace detail */
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* MESHLET_CULLING_HPP_ */
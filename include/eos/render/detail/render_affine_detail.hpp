@@ -23,14 +23,21 @@
 #define RENDER_AFFINE_DETAIL_HPP_
 
 #include "eos/core/Image.hpp"
+#include "eos/core/Mesh.hpp"
 #include "eos/render/detail/TriangleToRasterize.hpp"
 #include "eos/render/detail/render_detail_utils.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
 
+#include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
 
 #include "Eigen/Core"
 #include "Eigen/Geometry"
 
+#include <cstddef>
+#include <vector>
+
 /**
  * Implementations of internal functions, not part of the
  * API we expose and not meant to be used by a user.
@@ -78,6 +85,92 @@ calculate_affine_z_direction(Eigen::Matrix<float, 3, 4> affine_camera_matrix)
     return affine_cam_4x4;
 };
 
+/**
+ * Projects the vertices of the mesh with the given affine camera matrix and does the
+ * triangle setup for render_affine(...), i.e. backface culling and computing the clipped
+ * bounding box of each triangle. Triangles whose bounding box is empty are discarded.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ * @return All triangles that need to be rasterised, in screen coordinates.
+ */
+inline std::vector<TriangleToRasterize>
+setup_triangles_affine(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                       int viewport_width, int viewport_height, bool do_backface_culling)
+{
+    using std::vector;
+
+    const Eigen::Matrix<float, 4, 4> affine_with_z = calculate_affine_z_direction(affine_camera_matrix);
+    // Project all vertices at once:
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> vertices_screen_coords =
+        transform_vertices(mesh.vertices.as_matrix(), affine_with_z);
+
+    vector<Vertex<float>> projected_vertices;
+    projected_vertices.reserve(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const glm::tvec4<float> vertex_screen_coords_glm(
+            vertices_screen_coords(0, i), vertices_screen_coords(1, i), vertices_screen_coords(2, i),
+            vertices_screen_coords(3, i));
+        glm::tvec3<float> vertex_colour;
+        if (mesh.colors.empty())
+        {
+            vertex_colour = glm::tvec3<float>(0.5f, 0.5f, 0.5f);
+        } else
+        {
+            vertex_colour = glm::tvec3<float>(mesh.colors[i][0], mesh.colors[i][1], mesh.colors[i][2]);
+        }
+        projected_vertices.push_back(Vertex<float>{
+            vertex_screen_coords_glm, vertex_colour,
+            glm::tvec2<float>(mesh.texcoords()[i][0], mesh.texcoords()[i][1])});
+    }
+
+    // All vertices are screen-coordinates now
+    vector<TriangleToRasterize> triangles_to_raster;
+    triangles_to_raster.reserve(mesh.tvi().size());
+    for (const auto& tri_indices : mesh.tvi())
+    {
+        if (do_backface_culling)
+        {
+            if (!are_vertices_ccw_in_screen_space(
+                    glm::tvec2<float>(projected_vertices[tri_indices[0]].position),
+                    glm::tvec2<float>(projected_vertices[tri_indices[1]].position),
+                    glm::tvec2<float>(projected_vertices[tri_indices[2]].position)))
+                continue; // don't render this triangle
+        }
+
+        // Get the bounding box of the triangle:
+        // take care: What do we do if all 3 vertices are not visible. Seems to work on a test case.
+        const Rect<int> bounding_box = calculate_clipped_bounding_box(
+            glm::tvec2<float>(projected_vertices[tri_indices[0]].position),
+            glm::tvec2<float>(projected_vertices[tri_indices[1]].position),
+            glm::tvec2<float>(projected_vertices[tri_indices[2]].position), viewport_width, viewport_height);
+        const auto min_x = bounding_box.x;
+        const auto max_x = bounding_box.x + bounding_box.width;
+        const auto min_y = bounding_box.y;
+        const auto max_y = bounding_box.y + bounding_box.height;
+
+        if (max_x <= min_x || max_y <= min_y) // Note: Can the width/height of the bbox be negative? Maybe we only need to check for equality here?
+            continue;
+
+        TriangleToRasterize t;
+        t.min_x = min_x;
+        t.max_x = max_x;
+        t.min_y = min_y;
+        t.max_y = max_y;
+        t.v0 = projected_vertices[tri_indices[0]];
+        t.v1 = projected_vertices[tri_indices[1]];
+        t.v2 = projected_vertices[tri_indices[2]];
+
+        triangles_to_raster.push_back(t);
+    }
+
+    return triangles_to_raster;
+};
+
 /**
  * Rasters a triangle into the given colour and depth buffer.
  *
@@ -97,9 +190,12 @@ calculate_affine_z_direction(Eigen::Matrix<float, 3, 4> affine_camera_matrix)
  * @param[in] triangle A triangle.
  * @param[in] colourbuffer The colour buffer to draw into.
  * @param[in] depthbuffer The depth buffer to draw into and use for the depth test.
+ * @param[in] offset_x x-coordinate of the top-left pixel of the buffers in the viewport (if they only
+ *                     cover a region of it).
+ * @param[in] offset_y y-coordinate of the top-left pixel of the buffers in the viewport.
  */
-inline void raster_triangle_affine(TriangleToRasterize triangle, core::Image4u& colourbuffer,
-                                   core::Image1d& depthbuffer)
+inline void raster_triangle_affine(TriangleToRasterize triangle, core::ImageView4u colourbuffer,
+                                   core::ImageView1d depthbuffer, int offset_x = 0, int offset_y = 0)
 {
     for (int yi = triangle.min_y; yi <= triangle.max_y; ++yi)
     {
@@ -130,8 +226,8 @@ inline void raster_triangle_affine(TriangleToRasterize triangle, core::Image4u&
             // if pixel (x, y) is inside the triangle or on one of its edges
             if (alpha >= 0 && beta >= 0 && gamma >= 0)
             {
-                const int pixel_index_row = yi;
-                const int pixel_index_col = xi;
+                const int pixel_index_row = yi - offset_y;
+                const int pixel_index_col = xi - offset_x;
 
                 const double z_affine = alpha * static_cast<double>(triangle.v0.position[2]) +
                                         beta * static_cast<double>(triangle.v1.position[2]) +
@@ -0,0 +1,300 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/detail/render_depth_detail.hpp
+ *
+ * Copyright 2014-2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef RENDER_DEPTH_DETAIL_HPP_
+#define RENDER_DEPTH_DETAIL_HPP_
+
+#include "eos/core/Image.hpp"
+#include "eos/core/Mesh.hpp"
+#include "eos/render/Rect.hpp"
+#include "eos/render/utils.hpp"
+#include "eos/render/detail/PolygonToClip.hpp"
+#include "eos/render/detail/Vertex.hpp"
+#include "eos/render/detail/render_affine_detail.hpp"
+#include "eos/render/detail/render_detail_utils.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
+#include "eos/cpp17/optional.hpp"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec4.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Implementations of internal functions, not part of the
+ * API we expose and not meant to be used by a user.
+ *
+ * This file contains the depth-only rendering of render_depth(...) and
+ * render_affine_depth(...).
+ */
+namespace eos {
+namespace render {
+namespace detail {
+
+/**
+ * A triangle that is to be rasterised into a depth buffer only: Its vertices in
+ * screen space, [x_screen, y_screen, z, 1], and its clipped bounding box.
+ *
+ * In contrast to TriangleToRasterize, it carries no vertex attributes, and none of the
+ * per-triangle values for perspective-correct interpolation and texturing.
+ */
+struct DepthTriangle
+{
+    glm::tvec4<float> v0, v1, v2;
+    int min_x;
+    int max_x;
+    int min_y;
+    int max_y;
+};
+
+/**
+ * Does the triangle setup for a depth-only triangle whose vertices are in screen space:
+ * Backface culling and computing the clipped bounding box. Same as
+ * process_screen_space_tri(...), without the texturing setup.
+ *
+ * @param[in] v0 First vertex, in screen space.
+ * @param[in] v1 Second vertex, in screen space.
+ * @param[in] v2 Third vertex, in screen space.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] enable_backface_culling Whether to discard triangles that are not CCW in screen space.
+ * @return The triangle, or an empty optional if it doesn't need to be rasterised.
+ */
+inline cpp17::optional<DepthTriangle> setup_depth_triangle(const glm::tvec4<float>& v0,
+                                                           const glm::tvec4<float>& v1,
+                                                           const glm::tvec4<float>& v2, int viewport_width,
+                                                           int viewport_height, bool enable_backface_culling)
+{
+    if (enable_backface_culling)
+    {
+        if (!are_vertices_ccw_in_screen_space(glm::tvec2<float>(v0), glm::tvec2<float>(v1),
+                                              glm::tvec2<float>(v2)))
+            return cpp17::nullopt;
+    }
+    const Rect<int> bounding_box =
+        calculate_clipped_bounding_box(glm::tvec2<float>(v0), glm::tvec2<float>(v1), glm::tvec2<float>(v2),
+                                       viewport_width, viewport_height);
+    DepthTriangle t{v0, v1, v2, bounding_box.x, bounding_box.x + bounding_box.width, bounding_box.y,
+                    bounding_box.y + bounding_box.height};
+    if (t.max_x <= t.min_x || t.max_y <= t.min_y)
+        return cpp17::nullopt;
+    return t;
+};
+
+/**
+ * Runs the geometry stage of render_depth(...). Like setup_triangles(...), but it only
+ * transforms the vertex positions, and skips all attribute setup.
+ *
+ * See render_depth(...) for a description of the parameters.
+ *
+ * @return All triangles that need to be rasterised, with their bounding boxes in screen space.
+ */
+inline std::vector<DepthTriangle>
+setup_depth_triangles(const core::Mesh& mesh, const glm::tmat4x4<float>& model_view_matrix,
+                      const glm::tmat4x4<float>& projection_matrix, int viewport_width, int viewport_height,
+                      bool enable_backface_culling, bool enable_near_clipping, bool enable_far_clipping)
+{
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> clipspace_coords =
+        transform_vertices(mesh.vertices.as_matrix(), to_eigen(projection_matrix * model_view_matrix));
+    const std::vector<std::uint8_t> outcodes =
+        compute_outcodes(clipspace_coords, enable_near_clipping, enable_far_clipping);
+
+    // The screen-space position of every vertex, for the triangles that don't need clipping. This is the
+    // same computation as in clip_to_screen_space_vertex(...), so the depth values match render(...).
+    const auto to_screen_space = [viewport_width, viewport_height](glm::tvec4<float> position) {
+        position = position / position[3];
+        const glm::vec2 screen_coords =
+            clip_to_screen_space(glm::vec2(position[0], position[1]), viewport_width, viewport_height);
+        position[0] = screen_coords[0];
+        position[1] = screen_coords[1];
+        return position;
+    };
+    std::vector<glm::tvec4<float>> screenspace_positions;
+    screenspace_positions.reserve(mesh.vertices.size());
+    for (Eigen::Index i = 0; i < clipspace_coords.cols(); ++i)
+    {
+        screenspace_positions.push_back(to_screen_space(glm::tvec4<float>(
+            clipspace_coords(0, i), clipspace_coords(1, i), clipspace_coords(2, i), clipspace_coords(3, i))));
+    }
+
+    std::vector<DepthTriangle> triangles_to_raster;
+    triangles_to_raster.reserve(mesh.tvi().size());
+    for (const auto& tri_indices : mesh.tvi())
+    {
+        const std::uint8_t visibility_bits[3] = {outcodes[tri_indices[0]], outcodes[tri_indices[1]],
+                                                 outcodes[tri_indices[2]]};
+        if ((visibility_bits[0] & visibility_bits[1] & visibility_bits[2]) > 0)
+        {
+            continue;
+        }
+        const unsigned int planes_crossed = visibility_bits[0] | visibility_bits[1] | visibility_bits[2];
+        // Triangles that only cross the planes handled by the guard band and the depth test don't need
+        // clipping, see setup_triangles(...):
+        unsigned int guard_band_planes = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const Eigen::Index vertex_index = tri_indices[k];
+            guard_band_planes |= compute_guard_band_outcode(
+                clipspace_coords(0, vertex_index), clipspace_coords(1, vertex_index),
+                clipspace_coords(3, vertex_index));
+        }
+        const unsigned int planes_to_clip = (planes_crossed & 16u) | guard_band_planes;
+        if (planes_to_clip == 0)
+        {
+            const cpp17::optional<DepthTriangle> t = setup_depth_triangle(
+                screenspace_positions[tri_indices[0]], screenspace_positions[tri_indices[1]],
+                screenspace_positions[tri_indices[2]], viewport_width, viewport_height,
+                enable_backface_culling);
+            if (t)
+            {
+                triangles_to_raster.push_back(*t);
+            }
+            continue;
+        }
+        PolygonToClip<float> polygon;
+        for (int k = 0; k < 3; ++k)
+        {
+            const Eigen::Index vertex_index = tri_indices[k];
+            polygon.push_back(Vertex<float>{
+                glm::tvec4<float>(clipspace_coords(0, vertex_index), clipspace_coords(1, vertex_index),
+                                  clipspace_coords(2, vertex_index), clipspace_coords(3, vertex_index)),
+                glm::tvec3<float>(0.0f, 0.0f, 0.0f), glm::tvec2<float>(0.0f, 0.0f)});
+        }
+        clip_polygon_to_frustum(polygon, planes_to_clip, guard_band_size);
+        for (int k = 0; k + 2 < polygon.size; k++)
+        {
+            const cpp17::optional<DepthTriangle> t = setup_depth_triangle(
+                to_screen_space(polygon[0].position), to_screen_space(polygon[1 + k].position),
+                to_screen_space(polygon[2 + k].position), viewport_width, viewport_height,
+                enable_backface_culling);
+            if (t)
+            {
+                triangles_to_raster.push_back(*t);
+            }
+        }
+    }
+    return triangles_to_raster;
+};
+
+/**
+ * Projects the vertices of the mesh with the given affine camera matrix and does the
+ * triangle setup for render_affine_depth(...). Like setup_triangles_affine(...), but
+ * without the vertex attributes.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ * @return All triangles that need to be rasterised, in screen coordinates.
+ */
+inline std::vector<DepthTriangle>
+setup_depth_triangles_affine(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                             int viewport_width, int viewport_height, bool do_backface_culling)
+{
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> vertices_screen_coords =
+        transform_vertices(mesh.vertices.as_matrix(), calculate_affine_z_direction(affine_camera_matrix));
+
+    std::vector<DepthTriangle> triangles_to_raster;
+    triangles_to_raster.reserve(mesh.tvi().size());
+    for (const auto& tri_indices : mesh.tvi())
+    {
+        const auto vertex = [&vertices_screen_coords](Eigen::Index i) {
+            return glm::tvec4<float>(vertices_screen_coords(0, i), vertices_screen_coords(1, i),
+                                     vertices_screen_coords(2, i), vertices_screen_coords(3, i));
+        };
+        const cpp17::optional<DepthTriangle> t =
+            setup_depth_triangle(vertex(tri_indices[0]), vertex(tri_indices[1]), vertex(tri_indices[2]),
+                                 viewport_width, viewport_height, do_backface_culling);
+        if (t)
+        {
+            triangles_to_raster.push_back(*t);
+        }
+    }
+    return triangles_to_raster;
+};
+
+/**
+ * Rasters a triangle into a depth buffer only.
+ *
+ * The coverage test and the depth values are computed exactly as in raster_triangle(...)
+ * and raster_triangle_affine(...), so a pixel is covered by the same triangles, and gets
+ * the same depth (rounded to float). Depth is affine in screen space for both perspective
+ * and affine cameras, so no perspective correction is needed, and no attributes are
+ * interpolated.
+ *
+ * The buffer may cover only a region of the viewport. In that case, \p offset_x and
+ * \p offset_y give the position of its top-left pixel in the viewport, and the triangle's
+ * bounding box has to lie within that region.
+ *
+ * @param[in] triangle A triangle, after triangle setup with setup_depth_triangle(...).
+ * @param[in] depthbuffer The depth buffer to draw into and use for the depth test.
+ * @param[in] enable_far_clipping Whether fragments should be clipped against the far plane.
+ * @param[in] offset_x x-coordinate of the top-left pixel of the buffer in the viewport.
+ * @param[in] offset_y y-coordinate of the top-left pixel of the buffer in the viewport.
+ */
+inline void raster_triangle_depth(const DepthTriangle& triangle, core::ImageView1f depthbuffer,
+                                  bool enable_far_clipping, int offset_x = 0, int offset_y = 0)
+{
+    const double one_over_v0ToLine12 =
+        1.0 / implicit_line(triangle.v0[0], triangle.v0[1], triangle.v1, triangle.v2);
+    const double one_over_v1ToLine20 =
+        1.0 / implicit_line(triangle.v1[0], triangle.v1[1], triangle.v2, triangle.v0);
+    const double one_over_v2ToLine01 =
+        1.0 / implicit_line(triangle.v2[0], triangle.v2[1], triangle.v0, triangle.v1);
+
+    for (int yi = triangle.min_y; yi <= triangle.max_y; ++yi)
+    {
+        const float y = static_cast<float>(yi) + 0.5f;
+        for (int xi = triangle.min_x; xi <= triangle.max_x; ++xi)
+        {
+            const float x = static_cast<float>(xi) + 0.5f;
+            const double alpha = implicit_line(x, y, triangle.v1, triangle.v2) * one_over_v0ToLine12;
+            const double beta = implicit_line(x, y, triangle.v2, triangle.v0) * one_over_v1ToLine20;
+            const double gamma = implicit_line(x, y, triangle.v0, triangle.v1) * one_over_v2ToLine01;
+            if (alpha >= 0 && beta >= 0 && gamma >= 0)
+            {
+                const double z_affine = alpha * static_cast<double>(triangle.v0[2]) +
+                                        beta * static_cast<double>(triangle.v1[2]) +
+                                        gamma * static_cast<double>(triangle.v2[2]);
+                if (enable_far_clipping && z_affine > 1.0)
+                {
+                    continue;
+                }
+                float& depth = depthbuffer(yi - offset_y, xi - offset_x);
+                if (static_cast<float>(z_affine) < depth)
+                {
+                    depth = static_cast<float>(z_affine);
+                }
+            }
+        }
+    }
+};
+
+} /* namespace detail */
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* RENDER_DEPTH_DETAIL_HPP_ */
@@ -23,6 +23,8 @@
 #define RENDER_DETAIL_HPP_
 
 #include "eos/core/Image.hpp"
+#include "eos/core/Mesh.hpp"
+#include "eos/render/GBuffer.hpp"
 #include "eos/render/Rect.hpp"
 #include "eos/render/Texture.hpp"
 #include "eos/render/utils.hpp"
@@ -30,10 +32,22 @@
 #include "eos/render/detail/TriangleToRasterize.hpp"
 #include "eos/render/detail/render_detail_utils.hpp"
 #include "eos/render/detail/texturing.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
 #include "eos/cpp17/optional.hpp"
 
+#include "glm/mat4x4.hpp"
 #include "glm/vec2.hpp"
 #include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+#include "glm/geometric.hpp"
+
+#include "Eigen/Core"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 /**
  * Implementations of internal functions, not part of the
@@ -43,54 +57,50 @@ namespace eos {
 namespace render {
 namespace detail {
 
-// Todo: Split this function into the general (core-part) and the texturing part.
-// Then, utils::extractTexture can re-use the core-part.
-// Note: Maybe a bit outdated "todo" above.
-inline cpp17::optional<TriangleToRasterize> process_prospective_tri(Vertex<float> v0, Vertex<float> v1,
-                                                                  Vertex<float> v2, int viewport_width,
-                                                                  int viewport_height,
-                                                                  bool enable_backface_culling)
+/**
+ * Transforms a vertex from clip space to screen space: Divides by w, and then applies
+ * the viewport transform to x and y. The resulting position is
+ * [x_screen, y_screen, z_ndc, 1].
+ *
+ * @param[in] clipspace_vertex A vertex in clip space.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @return The vertex in screen space, with its colour and texture coordinates unchanged.
+ */
+inline Vertex<float> clip_to_screen_space_vertex(Vertex<float> clipspace_vertex, int viewport_width,
+                                                 int viewport_height)
 {
-    using glm::vec2;
-    using glm::vec3;
-
-    TriangleToRasterize t;
-    t.v0 = v0; // no memcopy I think. the transformed vertices don't get copied and exist only once. They are
-               // a local variable in runVertexProcessor(), the ref is passed here, and if we need to
-               // rasterize it, it gets push_back'ed (=copied?) to trianglesToRasterize. Perfect I think.
-               // TODO: Not anymore, no ref here
-    t.v1 = v1;
-    t.v2 = v2;
-
-    // Only for texturing or perspective texturing:
-    // t.texture = _texture;
-    t.one_over_z0 = 1.0 / (double)t.v0.position[3];
-    t.one_over_z1 = 1.0 / (double)t.v1.position[3];
-    t.one_over_z2 = 1.0 / (double)t.v2.position[3];
-
     // divide by w
     // if ortho, we can do the divide as well, it will just be a / 1.0f.
-    t.v0.position = t.v0.position / t.v0.position[3];
-    t.v1.position = t.v1.position / t.v1.position[3];
-    t.v2.position = t.v2.position / t.v2.position[3];
+    clipspace_vertex.position = clipspace_vertex.position / clipspace_vertex.position[3];
 
     // project from 4D to 2D window position with depth value in z coordinate
     // Viewport transform:
-    // (a possible optimisation might be to use matrix multiplication for this as well
-    //   and do it for all triangles at once? See 'windowTransform' in:
-    //   https://github.com/elador/FeatureDetection/blob/964f0b2107ce73ef2f06dc829e5084be421de5a5/libRender/src/render/RenderDevice.cpp)
-    vec2 v0_screen =
-        clip_to_screen_space(vec2(t.v0.position[0], t.v0.position[1]), viewport_width, viewport_height);
-    t.v0.position[0] = v0_screen[0];
-    t.v0.position[1] = v0_screen[1];
-    vec2 v1_screen =
-        clip_to_screen_space(vec2(t.v1.position[0], t.v1.position[1]), viewport_width, viewport_height);
-    t.v1.position[0] = v1_screen[0];
-    t.v1.position[1] = v1_screen[1];
-    vec2 v2_screen =
-        clip_to_screen_space(vec2(t.v2.position[0], t.v2.position[1]), viewport_width, viewport_height);
-    t.v2.position[0] = v2_screen[0];
-    t.v2.position[1] = v2_screen[1];
+    const glm::vec2 screen_coords =
+        clip_to_screen_space(glm::vec2(clipspace_vertex.position[0], clipspace_vertex.position[1]),
+                             viewport_width, viewport_height);
+    clipspace_vertex.position[0] = screen_coords[0];
+    clipspace_vertex.position[1] = screen_coords[1];
+    return clipspace_vertex;
+};
+
+/**
+ * Does the triangle setup for a triangle whose vertices are already in screen space
+ * (see clip_to_screen_space_vertex(...)), and whose one_over_z values are set: Backface
+ * culling, computing the clipped bounding box, and the planes needed for perspective-correct
+ * texturing.
+ *
+ * @param[in] t A triangle with v0, v1, v2 and one_over_z0, one_over_z1, one_over_z2 set.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] enable_backface_culling Whether to discard triangles that are not CCW in screen space.
+ * @return The triangle, or an empty optional if it doesn't need to be rasterised.
+ */
+inline cpp17::optional<TriangleToRasterize>
+process_screen_space_tri(TriangleToRasterize t, int viewport_width, int viewport_height,
+                         bool enable_backface_culling)
+{
+    using glm::vec3;
 
     if (enable_backface_culling)
     {
@@ -137,148 +147,563 @@ inline cpp17::optional<TriangleToRasterize> process_prospective_tri(Vertex<float
     return cpp17::optional<TriangleToRasterize>(t);
 };
 
-inline void raster_triangle(TriangleToRasterize triangle, core::Image4u& colorbuffer,
-                            core::Image1d& depthbuffer, cpp17::optional<Texture> texture,
-                            bool enable_far_clipping)
+// Todo: Split this function into the general (core-part) and the texturing part.
+// Then, utils::extractTexture can re-use the core-part.
+// Note: Maybe a bit outdated "todo" above.
+inline cpp17::optional<TriangleToRasterize> process_prospective_tri(Vertex<float> v0, Vertex<float> v1,
+                                                                  Vertex<float> v2, int viewport_width,
+                                                                  int viewport_height,
+                                                                  bool enable_backface_culling)
 {
-    for (int yi = triangle.min_y; yi <= triangle.max_y; ++yi)
+    TriangleToRasterize t;
+
+    // Only for texturing or perspective texturing:
+    // t.texture = _texture;
+    t.one_over_z0 = 1.0 / (double)v0.position[3];
+    t.one_over_z1 = 1.0 / (double)v1.position[3];
+    t.one_over_z2 = 1.0 / (double)v2.position[3];
+
+    // divide by w and do the viewport transform:
+    // (a possible optimisation might be to use matrix multiplication for this as well
+    //   and do it for all triangles at once? See 'windowTransform' in:
+    //   https://github.com/elador/FeatureDetection/blob/964f0b2107ce73ef2f06dc829e5084be421de5a5/libRender/src/render/RenderDevice.cpp)
+    // Note: setup_triangles(...) does this once per vertex for all triangles that don't need clipping.
+    t.v0 = clip_to_screen_space_vertex(v0, viewport_width, viewport_height);
+    t.v1 = clip_to_screen_space_vertex(v1, viewport_width, viewport_height);
+    t.v2 = clip_to_screen_space_vertex(v2, viewport_width, viewport_height);
+
+    return process_screen_space_tri(t, viewport_width, viewport_height, enable_backface_culling);
+};
+
+/**
+ * Runs the geometry stage of render(...): Transforms the vertices of the mesh to clip
+ * space, classifies them against the view frustum, clips triangles against the near plane
+ * if required, and then does the triangle setup (w-division, viewport transform, backface
+ * culling and bounding box computation) for all triangles that are (partly) visible.
+ *
+ * See render(...) for a description of the parameters. If \p triangle_subset is given, only
+ * these triangles of mesh.tvi are processed, e.g. the triangles of the meshlets that survived
+ * cull_meshlets(...).
+ *
+ * @return All triangles that need to be rasterised, with their bounding boxes in screen space.
+ */
+inline std::vector<TriangleToRasterize>
+setup_triangles(const core::Mesh& mesh, const glm::tmat4x4<float>& model_view_matrix,
+                const glm::tmat4x4<float>& projection_matrix, int viewport_width, int viewport_height,
+                bool enable_backface_culling, bool enable_near_clipping, bool enable_far_clipping,
+                const cpp17::optional<std::vector<int>>& triangle_subset = cpp17::nullopt)
+{
+    using std::vector;
+
+    // Vertex shader:
+    // Transform all vertices to clip space at once, and compute their frustum outcodes
+    // once per vertex (instead of once per triangle corner):
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> clipspace_coords =
+        transform_vertices(mesh.vertices.as_matrix(), to_eigen(projection_matrix * model_view_matrix));
+    const vector<std::uint8_t> outcodes =
+        compute_outcodes(clipspace_coords, enable_near_clipping, enable_far_clipping);
+
+    // Assemble the vertices and store them as detail::Vertex (the internal representation). We also
+    // store the vertices in screen space, for all triangles that are entirely inside the frustum and
+    // don't need clipping.
+    vector<Vertex<float>> clipspace_vertices;
+    vector<Vertex<float>> screenspace_vertices;
+    clipspace_vertices.reserve(mesh.vertices.size());
+    screenspace_vertices.reserve(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
     {
-        for (int xi = triangle.min_x; xi <= triangle.max_x; ++xi)
+        glm::tvec3<float> vertex_colour;
+        if (mesh.colors.empty())
+        {
+            vertex_colour = glm::tvec3<float>(0.5f, 0.5f, 0.5f);
+        } else
+        {
+            vertex_colour = glm::tvec3<float>(mesh.colors[i][0], mesh.colors[i][1], mesh.colors[i][2]);
+        }
+        // Meshes without texture coordinates can still be rendered with vertex colouring:
+        const glm::tvec2<float> vertex_texcoords =
+            mesh.texcoords().empty() ? glm::tvec2<float>(0.0f, 0.0f)
+                                   : glm::tvec2<float>(mesh.texcoords()[i][0], mesh.texcoords()[i][1]);
+        clipspace_vertices.push_back(
+            Vertex<float>{glm::tvec4<float>(clipspace_coords(0, i), clipspace_coords(1, i),
+                                            clipspace_coords(2, i), clipspace_coords(3, i)),
+                          vertex_colour, vertex_texcoords});
+        screenspace_vertices.push_back(
+            clip_to_screen_space_vertex(clipspace_vertices.back(), viewport_width, viewport_height));
+    }
+
+    // All vertices are in clip-space now.
+    // Prepare the rasterisation stage.
+    // For every vertex/tri:
+    const std::size_t num_triangles = triangle_subset ? triangle_subset->size() : mesh.tvi().size();
+    vector<TriangleToRasterize> triangles_to_raster;
+    triangles_to_raster.reserve(num_triangles);
+    for (std::size_t i = 0; i < num_triangles; ++i)
+    {
+        const int triangle_index = triangle_subset ? (*triangle_subset)[i] : static_cast<int>(i);
+        const auto& tri_indices = mesh.tvi()[triangle_index];
+        // Classify the triangle with respect to the planes of the view frustum, using the outcodes of its
+        // vertices. The outcodes were computed in clip-coords (not NDC, which we're only in after the
+        // division by w). See http://www.songho.ca/opengl/gl_projectionmatrix.html for more details.
+        // However, when comparing against w_c, we might run into the trouble of the sign again in the
+        // affine case.
+        // 'w' is always positive, as it is -z_camspace, and all z_camspace are negative.
+        const std::uint8_t visibility_bits[3] = {outcodes[tri_indices[0]], outcodes[tri_indices[1]],
+                                                 outcodes[tri_indices[2]]};
+        // all vertices are not visible - reject the triangle.
+        if ((visibility_bits[0] & visibility_bits[1] & visibility_bits[2]) > 0)
+        {
+            continue;
+        }
+        // all vertices are visible - pass the whole triangle to the rasterizer. = All bits of all 3 triangles
+        // are 0.
+        if ((visibility_bits[0] | visibility_bits[1] | visibility_bits[2]) == 0)
+        {
+            TriangleToRasterize prospective_tri;
+            prospective_tri.v0 = screenspace_vertices[tri_indices[0]];
+            prospective_tri.v1 = screenspace_vertices[tri_indices[1]];
+            prospective_tri.v2 = screenspace_vertices[tri_indices[2]];
+            prospective_tri.one_over_z0 = 1.0 / (double)clipspace_vertices[tri_indices[0]].position[3];
+            prospective_tri.one_over_z1 = 1.0 / (double)clipspace_vertices[tri_indices[1]].position[3];
+            prospective_tri.one_over_z2 = 1.0 / (double)clipspace_vertices[tri_indices[2]].position[3];
+            prospective_tri.triangle_index = triangle_index;
+            cpp17::optional<TriangleToRasterize> t = process_screen_space_tri(
+                prospective_tri, viewport_width, viewport_height, enable_backface_culling);
+            if (t)
+            {
+                triangles_to_raster.push_back(*t);
+            }
+            continue;
+        }
+        // at this moment the triangle is known to be intersecting one of the view frustum's planes
+        PolygonToClip<float> polygon;
+        polygon.push_back(clipspace_vertices[tri_indices[0]]);
+        polygon.push_back(clipspace_vertices[tri_indices[1]]);
+        polygon.push_back(clipspace_vertices[tri_indices[2]]);
+        // split the triangle if it intersects the near plane (bit 16 of the outcodes, which is only set if
+        // enable_near_clipping is true), or if it extends beyond the guard band. The other planes are
+        // handled by the guard band and the depth test, see clip_polygon_to_frustum(...).
+        const unsigned int planes_crossed = visibility_bits[0] | visibility_bits[1] | visibility_bits[2];
+        clip_polygon_to_frustum(polygon, (planes_crossed & 16u) | compute_guard_band_planes(polygon),
+                                guard_band_size);
+
+        // Where the polygon's vertices lie on the mesh triangle, for the G-buffer's barycentrics:
+        std::array<glm::vec3, PolygonToClip<float>::max_vertices> polygon_barycentrics;
+        for (int k = 0; k < polygon.size; k++)
+        {
+            polygon_barycentrics[k] = compute_barycentrics_in_4d(
+                polygon[k].position, clipspace_vertices[tri_indices[0]].position,
+                clipspace_vertices[tri_indices[1]].position, clipspace_vertices[tri_indices[2]].position);
+        }
+
+        // triangulation of the polygon formed of vertices array
+        for (int k = 0; k + 2 < polygon.size; k++)
         {
-            // we want centers of pixels to be used in computations. Todo: Do we?
-            const float x = static_cast<float>(xi) + 0.5f;
-            const float y = static_cast<float>(yi) + 0.5f;
-
-            // these will be used for barycentric weights computation
-            const double one_over_v0ToLine12 =
-                1.0 / implicit_line(triangle.v0.position[0], triangle.v0.position[1], triangle.v1.position,
-                                    triangle.v2.position);
-            const double one_over_v1ToLine20 =
-                1.0 / implicit_line(triangle.v1.position[0], triangle.v1.position[1], triangle.v2.position,
-                                    triangle.v0.position);
-            const double one_over_v2ToLine01 =
-                1.0 / implicit_line(triangle.v2.position[0], triangle.v2.position[1], triangle.v0.position,
-                                    triangle.v1.position);
-            // affine barycentric weights
-            double alpha =
-                implicit_line(x, y, triangle.v1.position, triangle.v2.position) * one_over_v0ToLine12;
-            double beta =
-                implicit_line(x, y, triangle.v2.position, triangle.v0.position) * one_over_v1ToLine20;
-            double gamma =
-                implicit_line(x, y, triangle.v0.position, triangle.v1.position) * one_over_v2ToLine01;
-
-            // if pixel (x, y) is inside the triangle or on one of its edges
-            if (alpha >= 0 && beta >= 0 && gamma >= 0)
+            cpp17::optional<TriangleToRasterize> t =
+                process_prospective_tri(polygon[0], polygon[1 + k], polygon[2 + k], viewport_width,
+                                        viewport_height, enable_backface_culling);
+            if (t)
             {
-                const int pixel_index_row = yi;
-                const int pixel_index_col = xi;
+                t->triangle_index = triangle_index;
+                t->barycentrics = {polygon_barycentrics[0], polygon_barycentrics[1 + k],
+                                   polygon_barycentrics[2 + k]};
+                triangles_to_raster.push_back(*t);
+            }
+        }
+    }
 
-                const double z_affine = alpha * static_cast<double>(triangle.v0.position[2]) +
-                                        beta * static_cast<double>(triangle.v1.position[2]) +
-                                        gamma * static_cast<double>(triangle.v2.position[2]);
+    return triangles_to_raster;
+};
 
-                bool draw = true;
-                if (enable_far_clipping)
+/**
+ * Computes the partial derivatives of the texture coordinates w.r.t. the screen
+ * coordinates at the given screen position, for mip-mapping.
+ *
+ * @param[in] triangle The triangle to compute the derivatives for.
+ * @param[in] x Screen-space x-coordinate.
+ * @param[in] y Screen-space y-coordinate.
+ * @param[in] texture The texture. The derivatives are scaled to texels of its base level.
+ * @return The derivatives dudx, dudy, dvdx and dvdy.
+ */
+inline std::array<float, 4> compute_texcoord_derivatives(const TriangleToRasterize& triangle, float x,
+                                                         float y, const Texture& texture)
+{
+    const float u_over_z = -(triangle.alphaPlane.a * x + triangle.alphaPlane.b * y + triangle.alphaPlane.d) *
+                           triangle.one_over_alpha_c;
+    const float v_over_z = -(triangle.betaPlane.a * x + triangle.betaPlane.b * y + triangle.betaPlane.d) *
+                           triangle.one_over_beta_c;
+    const float one_over_z =
+        -(triangle.gammaPlane.a * x + triangle.gammaPlane.b * y + triangle.gammaPlane.d) *
+        triangle.one_over_gamma_c;
+    const float one_over_squared_one_over_z = 1.0f / std::pow(one_over_z, 2);
+
+    // partial derivatives of U/V coordinates with respect to X/Y pixel's screen coordinates
+    const float dudx =
+        one_over_squared_one_over_z * (triangle.alpha_ffx * one_over_z - u_over_z * triangle.gamma_ffx);
+    const float dudy =
+        one_over_squared_one_over_z * (triangle.beta_ffx * one_over_z - v_over_z * triangle.gamma_ffx);
+    const float dvdx =
+        one_over_squared_one_over_z * (triangle.alpha_ffy * one_over_z - u_over_z * triangle.gamma_ffy);
+    const float dvdy =
+        one_over_squared_one_over_z * (triangle.beta_ffy * one_over_z - v_over_z * triangle.gamma_ffy);
+
+    return {dudx * texture.base_level.cols, dudy * texture.base_level.cols, dvdx * texture.base_level.rows,
+            dvdy * texture.base_level.rows};
+};
+
+/**
+ * Converts an RGB colour in the range [0, 1] to a BGRA pixel, clamping values above 1.
+ */
+inline std::array<std::uint8_t, 4> to_bgra_pixel(const glm::tvec3<float>& pixel_color)
+{
+    // clamp bytes to 255
+    const unsigned char red = static_cast<unsigned char>(
+        255.0f * std::min(pixel_color[0], 1.0f)); // Todo: Proper casting (rounding?)
+    const unsigned char green = static_cast<unsigned char>(255.0f * std::min(pixel_color[1], 1.0f));
+    const unsigned char blue = static_cast<unsigned char>(255.0f * std::min(pixel_color[2], 1.0f));
+    return {blue, green, red, 255}; // alpha channel is 255
+};
+
+/**
+ * Computes the colour of a fragment, by perspective-correct interpolation of the vertex
+ * colours, or by sampling the texture at the interpolated texture coordinates.
+ *
+ * The rasteriser shades textured fragments a quad at a time, with shade_quad(...).
+ *
+ * @param[in] triangle The triangle the fragment belongs to.
+ * @param[in] x Screen-space x-coordinate of the fragment (the pixel centre).
+ * @param[in] y Screen-space y-coordinate of the fragment (the pixel centre).
+ * @param[in] alpha Perspective-correct barycentric weight of v0.
+ * @param[in] beta Perspective-correct barycentric weight of v1.
+ * @param[in] gamma Perspective-correct barycentric weight of v2.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @return The fragment's colour, in BGRA order.
+ */
+inline std::array<std::uint8_t, 4> shade_fragment(const TriangleToRasterize& triangle, float x, float y,
+                                                  double alpha, double beta, double gamma,
+                                                  const cpp17::optional<Texture>& texture)
+{
+    // attributes interpolation
+    const glm::tvec3<float> color_persp =
+        static_cast<float>(alpha) * triangle.v0.color + static_cast<float>(beta) * triangle.v1.color +
+        static_cast<float>(gamma) * triangle.v2.color; // Note: color might be empty if we use texturing and
+                                                       // the shape-only model - but it works nonetheless? I
+                                                       // think I set the vertex-colour to 127 in the
+                                                       // shape-only model.
+    const glm::tvec2<float> texcoords_persp = static_cast<float>(alpha) * triangle.v0.texcoords +
+                                              static_cast<float>(beta) * triangle.v1.texcoords +
+                                              static_cast<float>(gamma) * triangle.v2.texcoords;
+
+    glm::tvec3<float> pixel_color;
+    // Pixel Shader:
+    if (texture)
+    { // We use texturing
+        // partial derivatives (for mip-mapping)
+        const std::array<float, 4> derivatives =
+            compute_texcoord_derivatives(triangle, x, y, texture.value());
+
+        // The Texture is in BGR, thus tex2D returns BGR
+        glm::tvec3<float> texture_color =
+            detail::tex2d(texcoords_persp, texture.value(), derivatives[0], derivatives[1], derivatives[2],
+                          derivatives[3]); // uses the current texture
+        pixel_color = glm::tvec3<float>(texture_color[2], texture_color[1], texture_color[0]);
+        // other: color.mul(tex2D(texture, texCoord));
+        // Old note: for texturing, we load the texture as BGRA, so the colors get the wrong way in the next
+        // few lines...
+    } else
+    { // We use vertex-coloring
+        // color_persp is in RGB
+        pixel_color = color_persp;
+    }
+
+    return to_bgra_pixel(pixel_color);
+};
+
+/**
+ * A 2x2 block of pixels, as produced by raster_triangle_quads(...).
+ *
+ * The four fragments are stored in the order top-left, top-right, bottom-left,
+ * bottom-right. Only the fragments with \c covered set lie inside the triangle and its
+ * bounding box, and passed the depth test. The barycentric weights are only set for these.
+ */
+struct FragmentQuad
+{
+    int x;   ///< Viewport x-coordinate of the top-left pixel.
+    int y;   ///< Viewport y-coordinate of the top-left pixel.
+    int row; ///< Buffer row of the top-left pixel. May be outside the buffer if that pixel isn't covered.
+    int col; ///< Buffer column of the top-left pixel. May be outside the buffer if that pixel isn't covered.
+    std::array<bool, 4> covered;
+    std::array<double, 4> alpha; ///< Perspective-correct barycentric weights of v0.
+    std::array<double, 4> beta;  ///< Perspective-correct barycentric weights of v1.
+    std::array<double, 4> gamma; ///< Perspective-correct barycentric weights of v2.
+};
+
+/**
+ * Computes the colours of the covered fragments of a quad.
+ *
+ * With a texture, the quad is sampled in one go with tex2d_quad(...), and the mip levels
+ * are selected from the texture coordinate derivatives at the centre of the quad.
+ * Fragments that aren't covered are sampled at a covered fragment's position, so that all
+ * lookups stay within the triangle. Without a texture, each fragment is shaded with
+ * shade_fragment(...).
+ *
+ * @param[in] triangle The triangle the quad belongs to.
+ * @param[in] quad The quad, with at least one covered fragment.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @return The colours of the four fragments, in BGRA order. Only set for covered fragments.
+ */
+inline std::array<std::array<std::uint8_t, 4>, 4>
+shade_quad(const TriangleToRasterize& triangle, const FragmentQuad& quad,
+           const cpp17::optional<Texture>& texture)
+{
+    std::array<std::array<std::uint8_t, 4>, 4> colors{};
+    if (!texture)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            if (quad.covered[i])
+            {
+                colors[i] = shade_fragment(triangle, static_cast<float>(quad.x + (i & 1)) + 0.5f,
+                                           static_cast<float>(quad.y + (i >> 1)) + 0.5f, quad.alpha[i],
+                                           quad.beta[i], quad.gamma[i], texture);
+            }
+        }
+        return colors;
+    }
+
+    const int first_covered = static_cast<int>(
+        std::find(std::begin(quad.covered), std::end(quad.covered), true) - std::begin(quad.covered));
+    std::array<glm::vec2, 4> texcoords;
+    for (int i = 0; i < 4; ++i)
+    {
+        const int fragment = quad.covered[i] ? i : first_covered;
+        texcoords[i] = static_cast<float>(quad.alpha[fragment]) * triangle.v0.texcoords +
+                       static_cast<float>(quad.beta[fragment]) * triangle.v1.texcoords +
+                       static_cast<float>(quad.gamma[fragment]) * triangle.v2.texcoords;
+    }
+    const std::array<float, 4> derivatives = compute_texcoord_derivatives(
+        triangle, static_cast<float>(quad.x) + 1.0f, static_cast<float>(quad.y) + 1.0f, texture.value());
+    // The Texture is in BGR, thus tex2d_quad returns BGR
+    const QuadColors texture_colors = detail::tex2d_quad(texcoords, texture.value(), derivatives[0],
+                                                         derivatives[1], derivatives[2], derivatives[3]);
+    for (int i = 0; i < 4; ++i)
+    {
+        colors[i] =
+            to_bgra_pixel(glm::tvec3<float>(texture_colors.r[i], texture_colors.g[i], texture_colors.b[i]));
+    }
+    return colors;
+};
+
+/**
+ * Rasters a triangle in blocks of 2x2 pixels: Runs the depth test for every pixel covered
+ * by the triangle, updates the depth buffer for the fragments that pass it, and calls
+ * \p write_quad for each quad that has at least one such fragment. The quads are aligned
+ * to even viewport coordinates. write_quad is called as write_quad(quad), with a
+ * FragmentQuad.
+ *
+ * This is the loop that raster_triangle(...) and raster_triangle_gbuffer(...) share; they
+ * only differ in what they write for each quad. Shading a quad at a time lets the texture
+ * lookups of the four fragments share the mip level selection and be done together, see
+ * shade_quad(...).
+ *
+ * The buffers may cover only a region of the viewport. In that case, \p offset_x and
+ * \p offset_y give the position of the buffers' top-left pixel in the viewport, and the
+ * triangle's bounding box has to lie within that region.
+ *
+ * @param[in] triangle A triangle, after triangle setup with process_prospective_tri.
+ * @param[in] depthbuffer The depth buffer to draw into and use for the depth test.
+ * @param[in] enable_far_clipping Whether fragments should be clipped against the far plane.
+ * @param[in] offset_x x-coordinate of the top-left pixel of the buffers in the viewport.
+ * @param[in] offset_y y-coordinate of the top-left pixel of the buffers in the viewport.
+ * @param[in] write_quad Function that writes the outputs of a quad.
+ */
+template <typename QuadWriter>
+void raster_triangle_quads(const TriangleToRasterize& triangle, core::ImageView1d depthbuffer,
+                           bool enable_far_clipping, int offset_x, int offset_y, QuadWriter&& write_quad)
+{
+    // these will be used for barycentric weights computation
+    const double one_over_v0ToLine12 = 1.0 / implicit_line(triangle.v0.position[0], triangle.v0.position[1],
+                                                           triangle.v1.position, triangle.v2.position);
+    const double one_over_v1ToLine20 = 1.0 / implicit_line(triangle.v1.position[0], triangle.v1.position[1],
+                                                           triangle.v2.position, triangle.v0.position);
+    const double one_over_v2ToLine01 = 1.0 / implicit_line(triangle.v2.position[0], triangle.v2.position[1],
+                                                           triangle.v0.position, triangle.v1.position);
+
+    FragmentQuad quad;
+    for (quad.y = triangle.min_y & ~1; quad.y <= triangle.max_y; quad.y += 2)
+    {
+        for (quad.x = triangle.min_x & ~1; quad.x <= triangle.max_x; quad.x += 2)
+        {
+            quad.row = quad.y - offset_y;
+            quad.col = quad.x - offset_x;
+            bool any_covered = false;
+            for (int i = 0; i < 4; ++i)
+            {
+                quad.covered[i] = false;
+                const int xi = quad.x + (i & 1);
+                const int yi = quad.y + (i >> 1);
+                if (xi < triangle.min_x || xi > triangle.max_x || yi < triangle.min_y || yi > triangle.max_y)
                 {
-                    if (z_affine > 1.0)
-                    {
-                        draw = false;
-                    }
+                    continue;
                 }
-                // The '<= 1.0' clips against the far-plane in NDC. We clip against the near-plane earlier.
-                //if (z_affine < depthbuffer.at<double>(pixelIndexRow, pixelIndexCol)/* && z_affine <= 1.0*/) // what to do in ortho case without n/f "squashing"? should we always squash? or a flag?
-                if (z_affine < depthbuffer(pixel_index_row, pixel_index_col) && draw)
+                // we want centers of pixels to be used in computations. Todo: Do we?
+                const float x = static_cast<float>(xi) + 0.5f;
+                const float y = static_cast<float>(yi) + 0.5f;
+
+                // affine barycentric weights
+                double alpha =
+                    implicit_line(x, y, triangle.v1.position, triangle.v2.position) * one_over_v0ToLine12;
+                double beta =
+                    implicit_line(x, y, triangle.v2.position, triangle.v0.position) * one_over_v1ToLine20;
+                double gamma =
+                    implicit_line(x, y, triangle.v0.position, triangle.v1.position) * one_over_v2ToLine01;
+
+                // if pixel (x, y) is inside the triangle or on one of its edges
+                if (alpha >= 0 && beta >= 0 && gamma >= 0)
                 {
-                    // perspective-correct barycentric weights
-                    double d = alpha * triangle.one_over_z0 + beta * triangle.one_over_z1 +
-                               gamma * triangle.one_over_z2;
-                    d = 1.0 / d;
-                    alpha *= d * triangle.one_over_z0; // In case of affine cam matrix, everything is 1 and
-                                                       // a/b/g don't get changed.
-                    beta *= d * triangle.one_over_z1;
-                    gamma *= d * triangle.one_over_z2;
-
-                    // attributes interpolation
-                    const glm::tvec3<float> color_persp =
-                        static_cast<float>(alpha) * triangle.v0.color +
-                        static_cast<float>(beta) * triangle.v1.color +
-                        static_cast<float>(gamma) * triangle.v2.color; // Note: color might be empty if we use
-                                                                       // texturing and the shape-only model -
-                                                                       // but it works nonetheless? I think I
-                                                                       // set the vertex-colour to 127 in the
-                                                                       // shape-only model.
-                    const glm::tvec2<float> texcoords_persp =
-                        static_cast<float>(alpha) * triangle.v0.texcoords +
-                        static_cast<float>(beta) * triangle.v1.texcoords +
-                        static_cast<float>(gamma) * triangle.v2.texcoords;
-
-                    glm::tvec3<float> pixel_color;
-                    // Pixel Shader:
-                    if (texture)
-                    { // We use texturing
-                        // check if texture != NULL?
-                        // partial derivatives (for mip-mapping)
-                        const float u_over_z =
-                            -(triangle.alphaPlane.a * x + triangle.alphaPlane.b * y + triangle.alphaPlane.d) *
-                            triangle.one_over_alpha_c;
-                        const float v_over_z =
-                            -(triangle.betaPlane.a * x + triangle.betaPlane.b * y + triangle.betaPlane.d) *
-                            triangle.one_over_beta_c;
-                        const float one_over_z =
-                            -(triangle.gammaPlane.a * x + triangle.gammaPlane.b * y + triangle.gammaPlane.d) *
-                            triangle.one_over_gamma_c;
-                        const float one_over_squared_one_over_z = 1.0f / std::pow(one_over_z, 2);
-
-                        // partial derivatives of U/V coordinates with respect to X/Y pixel's screen
-                        // coordinates
-                        float dudx = one_over_squared_one_over_z *
-                                     (triangle.alpha_ffx * one_over_z - u_over_z * triangle.gamma_ffx);
-                        float dudy = one_over_squared_one_over_z *
-                                     (triangle.beta_ffx * one_over_z - v_over_z * triangle.gamma_ffx);
-                        float dvdx = one_over_squared_one_over_z *
-                                     (triangle.alpha_ffy * one_over_z - u_over_z * triangle.gamma_ffy);
-                        float dvdy = one_over_squared_one_over_z *
-                                     (triangle.beta_ffy * one_over_z - v_over_z * triangle.gamma_ffy);
-
-                        dudx *= texture.value().mipmaps[0].cols;
-                        dudy *= texture.value().mipmaps[0].cols;
-                        dvdx *= texture.value().mipmaps[0].rows;
-                        dvdy *= texture.value().mipmaps[0].rows;
-
-                        // The Texture is in BGR, thus tex2D returns BGR
-                        glm::tvec3<float> texture_color =
-                            detail::tex2d(texcoords_persp, texture.value(), dudx, dudy, dvdx,
-                                          dvdy); // uses the current texture
-                        pixel_color = glm::tvec3<float>(texture_color[2], texture_color[1], texture_color[0]);
-                        // other: color.mul(tex2D(texture, texCoord));
-                        // Old note: for texturing, we load the texture as BGRA, so the colors get the wrong
-                        // way in the next few lines...
-                    } else
-                    { // We use vertex-coloring
-                        // color_persp is in RGB
-                        pixel_color = color_persp;
+                    const int pixel_index_row = yi - offset_y;
+                    const int pixel_index_col = xi - offset_x;
+
+                    const double z_affine = alpha * static_cast<double>(triangle.v0.position[2]) +
+                                            beta * static_cast<double>(triangle.v1.position[2]) +
+                                            gamma * static_cast<double>(triangle.v2.position[2]);
+
+                    bool draw = true;
+                    if (enable_far_clipping)
+                    {
+                        if (z_affine > 1.0)
+                        {
+                            draw = false;
+                        }
                     }
+                    // The '<= 1.0' clips against the far-plane in NDC. We clip against the near-plane earlier.
+                    //if (z_affine < depthbuffer.at<double>(pixelIndexRow, pixelIndexCol)/* && z_affine <= 1.0*/) // what to do in ortho case without n/f "squashing"? should we always squash? or a flag?
+                    if (z_affine < depthbuffer(pixel_index_row, pixel_index_col) && draw)
+                    {
+                        // perspective-correct barycentric weights
+                        double d = alpha * triangle.one_over_z0 + beta * triangle.one_over_z1 +
+                                   gamma * triangle.one_over_z2;
+                        d = 1.0 / d;
+                        alpha *= d * triangle.one_over_z0; // In case of affine cam matrix, everything is 1
+                                                           // and a/b/g don't get changed.
+                        beta *= d * triangle.one_over_z1;
+                        gamma *= d * triangle.one_over_z2;
 
-                    // clamp bytes to 255
-                    const unsigned char red = static_cast<unsigned char>(
-                        255.0f * std::min(pixel_color[0], 1.0f)); // Todo: Proper casting (rounding?)
-                    const unsigned char green =
-                        static_cast<unsigned char>(255.0f * std::min(pixel_color[1], 1.0f));
-                    const unsigned char blue =
-                        static_cast<unsigned char>(255.0f * std::min(pixel_color[2], 1.0f));
-
-                    // update buffers
-                    colorbuffer(pixel_index_row, pixel_index_col)[0] = blue;
-                    colorbuffer(pixel_index_row, pixel_index_col)[1] = green;
-                    colorbuffer(pixel_index_row, pixel_index_col)[2] = red;
-                    colorbuffer(pixel_index_row, pixel_index_col)[3] = 255; // alpha channel
-                    depthbuffer(pixel_index_row, pixel_index_col) = z_affine;
+                        quad.covered[i] = true;
+                        quad.alpha[i] = alpha;
+                        quad.beta[i] = beta;
+                        quad.gamma[i] = gamma;
+                        any_covered = true;
+                        depthbuffer(pixel_index_row, pixel_index_col) = z_affine;
+                    }
                 }
             }
+            if (any_covered)
+            {
+                write_quad(static_cast<const FragmentQuad&>(quad));
+            }
         }
     }
 };
 
+/**
+ * Rasters a triangle into the given colour and depth buffer, with perspective-correct
+ * interpolation of the vertex colours or texture coordinates.
+ *
+ * The buffers may cover only a region of the viewport. In that case, \p offset_x and
+ * \p offset_y give the position of the buffers' top-left pixel in the viewport, and the
+ * triangle's bounding box has to lie within that region.
+ *
+ * @param[in] triangle A triangle, after triangle setup with process_prospective_tri.
+ * @param[in] colorbuffer The colour buffer to draw into.
+ * @param[in] depthbuffer The depth buffer to draw into and use for the depth test.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_far_clipping Whether fragments should be clipped against the far plane.
+ * @param[in] offset_x x-coordinate of the top-left pixel of the buffers in the viewport.
+ * @param[in] offset_y y-coordinate of the top-left pixel of the buffers in the viewport.
+ */
+inline void raster_triangle(const TriangleToRasterize& triangle, core::ImageView4u colorbuffer,
+                            core::ImageView1d depthbuffer, const cpp17::optional<Texture>& texture,
+                            bool enable_far_clipping, int offset_x = 0, int offset_y = 0)
+{
+    raster_triangle_quads(triangle, depthbuffer, enable_far_clipping, offset_x, offset_y,
+                          [&](const FragmentQuad& quad) {
+                              const auto colors = shade_quad(triangle, quad, texture);
+                              for (int i = 0; i < 4; ++i)
+                              {
+                                  if (quad.covered[i])
+                                  {
+                                      colorbuffer(quad.row + (i >> 1), quad.col + (i & 1)) = colors[i];
+                                  }
+                              }
+                          });
+};
+
+/**
+ * Rasters a triangle into the given G-buffer: The colour and depth buffer, and each of the
+ * optional render targets that is allocated (i.e. not empty) in the G-buffer.
+ *
+ * The normals are interpolated from the given vertex normals, using the barycentric
+ * coordinates w.r.t. the mesh triangle that the triangle was set up from. The
+ * barycentrics target stores these coordinates, so it refers to the mesh triangle even
+ * for triangles that were created by clipping.
+ *
+ * @param[in] triangle A triangle, after triangle setup with setup_triangles(...).
+ * @param[in,out] gbuffer The G-buffer to draw into.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_far_clipping Whether fragments should be clipped against the far plane.
+ * @param[in] tvi The triangle vertex indices of the mesh (core::Mesh::tvi).
+ * @param[in] vertex_normals Unit normals for each vertex of the mesh. Only needed if the normals are drawn.
+ */
+inline void raster_triangle_gbuffer(const TriangleToRasterize& triangle, GBuffer& gbuffer,
+                                    const cpp17::optional<Texture>& texture, bool enable_far_clipping,
+                                    const std::vector<std::array<int, 3>>& tvi,
+                                    const std::vector<glm::vec3>& vertex_normals)
+{
+    const bool draw_normals = !gbuffer.normals.data.empty();
+    const bool draw_barycentrics = !gbuffer.barycentrics.data.empty();
+    const bool draw_triangle_ids = !gbuffer.triangle_ids.data.empty();
+    const bool draw_mask = !gbuffer.mask.data.empty();
+    raster_triangle_quads(
+        triangle, gbuffer.depthbuffer, enable_far_clipping, 0, 0, [&](const FragmentQuad& quad) {
+            const auto colors = shade_quad(triangle, quad, texture);
+            for (int i = 0; i < 4; ++i)
+            {
+                if (!quad.covered[i])
+                {
+                    continue;
+                }
+                const int row = quad.row + (i >> 1);
+                const int col = quad.col + (i & 1);
+                gbuffer.colorbuffer(row, col) = colors[i];
+                // Barycentric coordinates w.r.t. the mesh triangle:
+                const glm::vec3 barycentrics = static_cast<float>(quad.alpha[i]) * triangle.barycentrics[0] +
+                                               static_cast<float>(quad.beta[i]) * triangle.barycentrics[1] +
+                                               static_cast<float>(quad.gamma[i]) * triangle.barycentrics[2];
+                if (draw_normals)
+                {
+                    const auto& tri_indices = tvi[triangle.triangle_index];
+                    const glm::vec3 normal = glm::normalize(barycentrics[0] * vertex_normals[tri_indices[0]] +
+                                                            barycentrics[1] * vertex_normals[tri_indices[1]] +
+                                                            barycentrics[2] * vertex_normals[tri_indices[2]]);
+                    gbuffer.normals(row, col) = {normal[0], normal[1], normal[2]};
+                }
+                if (draw_barycentrics)
+                {
+                    gbuffer.barycentrics(row, col) = {barycentrics[0], barycentrics[1], barycentrics[2]};
+                }
+                if (draw_triangle_ids)
+                {
+                    gbuffer.triangle_ids(row, col) = triangle.triangle_index;
+                }
+                if (draw_mask)
+                {
+                    gbuffer.mask(row, col) = 255;
+                }
+            }
+        });
+};
+
 } /* namespace detail */
 } /* namespace render */
 } /* namespace eos */
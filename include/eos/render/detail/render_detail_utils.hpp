@@ -24,13 +24,18 @@
 
 #include "eos/render/Rect.hpp"
 #include "eos/render/detail/Vertex.hpp"
+#include "eos/render/detail/PolygonToClip.hpp"
+#include "eos/render/detail/TriangleToRasterize.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
 
 #include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
 #include "glm/vec4.hpp"
 #include "glm/geometric.hpp"
 
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 /**
  * Implementations of internal functions, not part of the
@@ -76,6 +81,47 @@ Rect<int> calculate_clipped_bounding_box(const glm::tvec2<T, P>& v0, const glm::
     return Rect<int>{minX, minY, maxX - minX, maxY - minY};
 };
 
+/**
+ * Calculates the region of interest (ROI) that encloses all given triangles, i.e. the
+ * union of their (already clipped) bounding boxes, enlarged by \p margin pixels on each
+ * side and clipped to the viewport again.
+ *
+ * In contrast to calculate_clipped_bounding_box(...), the width and height of the returned
+ * rectangle are the number of pixels it covers, so it can directly be used to allocate
+ * buffers. If there are no triangles, an empty rectangle is returned.
+ *
+ * @param[in] triangles Triangles after triangle setup, with their bounding boxes set.
+ * @param[in] margin Number of pixels to add around the bounding box of the triangles.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @return The region of the viewport that the triangles cover.
+ */
+template <typename Triangle>
+Rect<int> calculate_triangles_roi(const std::vector<Triangle>& triangles, int margin, int viewport_width,
+                                  int viewport_height)
+{
+    if (triangles.empty())
+    {
+        return Rect<int>{0, 0, 0, 0};
+    }
+    int min_x = triangles[0].min_x;
+    int max_x = triangles[0].max_x;
+    int min_y = triangles[0].min_y;
+    int max_y = triangles[0].max_y;
+    for (const auto& t : triangles)
+    {
+        min_x = std::min(min_x, t.min_x);
+        max_x = std::max(max_x, t.max_x);
+        min_y = std::min(min_y, t.min_y);
+        max_y = std::max(max_y, t.max_y);
+    }
+    min_x = std::max(min_x - margin, 0);
+    max_x = std::min(max_x + margin, viewport_width - 1);
+    min_y = std::max(min_y - margin, 0);
+    max_y = std::min(max_y + margin, viewport_height - 1);
+    return Rect<int>{min_x, min_y, max_x - min_x + 1, max_y - min_y + 1};
+};
+
 /**
  * Computes whether the triangle formed out of the given three vertices is
  * counter-clockwise in screen space. Assumes the origin of the screen is on
@@ -105,10 +151,24 @@ double implicit_line(float x, float y, const glm::tvec4<T, P>& v1, const glm::tv
            (double)v1[0] * (double)v2[1] - (double)v2[0] * (double)v1[1];
 };
 
-inline std::vector<Vertex<float>> clip_polygon_to_plane_in_4d(const std::vector<Vertex<float>>& vertices,
-                                                              const glm::tvec4<float>& plane_normal)
+/**
+ * Clips a convex polygon in clip space (4D homogeneous coordinates) against a single plane.
+ * Vertices with a negative dot product with the plane normal are on the visible side. Vertices
+ * that lie exactly on the plane are kept, so that clipping a polygon against two planes that
+ * meet at one of its new vertices (e.g. a corner of the guard band) doesn't drop that vertex.
+ *
+ * The result is written to \p clipped_polygon, which must not be the same object as
+ * \p polygon. No memory is allocated.
+ *
+ * @param[in] polygon The polygon to clip.
+ * @param[in] plane_normal The "normal" (4D hyperplane) of the plane to clip against.
+ * @param[out] clipped_polygon The part of the polygon on the visible side of the plane.
+ */
+template <typename T, glm::precision P = glm::defaultp>
+void clip_polygon_to_plane_in_4d(const PolygonToClip<T, P>& polygon, const glm::tvec4<T, P>& plane_normal,
+                                 PolygonToClip<T, P>& clipped_polygon)
 {
-    std::vector<Vertex<float>> clippedVertices;
+    clipped_polygon.size = 0;
 
     // We can have 2 cases:
     //  * 1 vertex visible: we make 1 new triangle out of the visible vertex plus the 2 intersection points
@@ -118,48 +178,144 @@ inline std::vector<Vertex<float>> clip_polygon_to_plane_in_4d(const std::vector<
     // See here for more info?
     // http://math.stackexchange.com/questions/400268/equation-for-a-line-through-a-plane-in-homogeneous-coordinates
 
-    for (unsigned int i = 0; i < vertices.size(); i++)
+    for (int i = 0; i < polygon.size; i++)
     {
-        const int a = i;                         // the current vertex
-        const int b = (i + 1) % vertices.size(); // the following vertex (wraps around 0)
+        const int a = i;                      // the current vertex
+        const int b = (i + 1) % polygon.size; // the following vertex (wraps around 0)
 
-        const float fa = glm::dot(vertices[a].position, plane_normal); // Note: Shouldn't they be unit length?
-        const float fb = glm::dot(vertices[b].position,
-                            plane_normal); // < 0 means on visible side, > 0 means on invisible side?
+        const T fa = glm::dot(polygon[a].position, plane_normal); // Note: Shouldn't they be unit length?
+        const T fb = glm::dot(polygon[b].position,
+                              plane_normal); // < 0 means on visible side, > 0 means on invisible side?
 
         if ((fa < 0 && fb > 0) || (fa > 0 && fb < 0)) // one vertex is on the visible side of the plane, one
                                                       // on the invisible? so we need to split?
         {
-            const auto direction = vertices[b].position - vertices[a].position;
-            const float t = -(glm::dot(plane_normal, vertices[a].position)) /
-                      (glm::dot(plane_normal, direction)); // the parametric value on the line, where the line
-                                                           // to draw intersects the plane?
+            const auto direction = polygon[b].position - polygon[a].position;
+            const T t = -(glm::dot(plane_normal, polygon[a].position)) /
+                        (glm::dot(plane_normal, direction)); // the parametric value on the line, where the
+                                                             // line to draw intersects the plane?
 
             // generate a new vertex at the line-plane intersection point
-            const auto position = vertices[a].position + t * direction;
-            const auto color = vertices[a].color + t * (vertices[b].color - vertices[a].color);
-            const auto texCoord =
-                vertices[a].texcoords +
-                t * (vertices[b].texcoords -
-                     vertices[a].texcoords); // We could omit that if we don't render with texture.
+            const auto position = polygon[a].position + t * direction;
+            const auto color = polygon[a].color + t * (polygon[b].color - polygon[a].color);
+            const auto texcoords =
+                polygon[a].texcoords +
+                t * (polygon[b].texcoords -
+                     polygon[a].texcoords); // We could omit that if we don't render with texture.
 
             if (fa < 0) // we keep the original vertex plus the new one
             {
-                clippedVertices.push_back(vertices[a]);
-                clippedVertices.push_back(Vertex<float>{position, color, texCoord});
+                clipped_polygon.push_back(polygon[a]);
+                clipped_polygon.push_back(Vertex<T, P>{position, color, texcoords});
             } else if (fb < 0) // we use only the new vertex
             {
-                clippedVertices.push_back(Vertex<float>{position, color, texCoord});
+                clipped_polygon.push_back(Vertex<T, P>{position, color, texcoords});
             }
-        } else if (fa < 0 && fb < 0) // both are visible (on the "good" side of the plane), no splitting
-                                     // required, use the current vertex
+        } else if (fa <= 0 && fb <= 0) // both are visible (on the "good" side of the plane, or on the
+                                       // plane), no splitting required, use the current vertex
+        {
+            clipped_polygon.push_back(polygon[a]);
+        } else if (fa == 0) // a lies on the plane and b is invisible: keep a, there is no new vertex
         {
-            clippedVertices.push_back(vertices[a]);
+            clipped_polygon.push_back(polygon[a]);
         }
         // else, both vertices are not visible, nothing to add and draw
     }
+};
 
-    return clippedVertices;
+/**
+ * Clips a convex polygon in clip space against the planes of the view frustum, in place.
+ *
+ * \p planes selects the planes to clip against, using the same bits as the vertex
+ * outcodes (see compute_outcode(...)): 1: left, 2: right, 4: bottom, 8: top, 16: near,
+ * 32: far. Passing the bitwise or of the outcodes of the polygon's vertices clips only
+ * against the planes that the polygon actually crosses.
+ *
+ * With a \p guard_band larger than 1, the left, right, bottom and top planes are moved
+ * outwards to the sides of the guard band. The renderers clip against the near plane, and
+ * against the sides of the guard band only if a triangle extends beyond it (see
+ * compute_guard_band_outcode(...)). Everything else in x and y is handled by clipping each
+ * triangle's bounding box to the viewport, and the far plane by the per-pixel depth test.
+ *
+ * @param[in,out] polygon The polygon to clip. May be empty afterwards.
+ * @param[in] planes Bitmask of the frustum planes to clip against.
+ * @param[in] guard_band Distance of the left, right, bottom and top planes from the centre, in NDC.
+ */
+template <typename T, glm::precision P = glm::defaultp>
+void clip_polygon_to_frustum(PolygonToClip<T, P>& polygon, unsigned int planes, T guard_band = T(1))
+{
+    // "Normals" (or "4D hyperplanes") of the frustum planes, in the order of the outcode bits. For the
+    // near plane, I tested that it works like this but I'm a little bit unsure because Songho says the
+    // normal of the near-plane is (0,0,-1,1) (maybe I have to switch around the < 0 checks?)
+    const glm::tvec4<T, P> plane_normals[6] = {
+        glm::tvec4<T, P>(T(-1), T(0), T(0), -guard_band), glm::tvec4<T, P>(T(1), T(0), T(0), -guard_band),
+        glm::tvec4<T, P>(T(0), T(-1), T(0), -guard_band), glm::tvec4<T, P>(T(0), T(1), T(0), -guard_band),
+        glm::tvec4<T, P>(T(0), T(0), T(-1), T(-1)),       glm::tvec4<T, P>(T(0), T(0), T(1), T(-1))};
+
+    PolygonToClip<T, P> clipped_polygon;
+    for (int i = 0; i < 6 && polygon.size > 0; ++i)
+    {
+        if (planes & (1u << i))
+        {
+            clip_polygon_to_plane_in_4d(polygon, plane_normals[i], clipped_polygon);
+            polygon = clipped_polygon;
+        }
+    }
+};
+
+/**
+ * Computes the sides of the guard band that the polygon extends beyond, i.e. the bitwise or
+ * of the compute_guard_band_outcode(...) of its vertices.
+ *
+ * @param[in] polygon A polygon in clip space.
+ * @return Bitmask of the guard band planes that the polygon crosses, for clip_polygon_to_frustum(...).
+ */
+template <typename T, glm::precision P = glm::defaultp>
+unsigned int compute_guard_band_planes(const PolygonToClip<T, P>& polygon)
+{
+    unsigned int planes = 0;
+    for (int i = 0; i < polygon.size; ++i)
+    {
+        planes |= compute_guard_band_outcode(polygon[i].position[0], polygon[i].position[1],
+                                             polygon[i].position[3], T(guard_band_size));
+    }
+    return planes;
+};
+
+/**
+ * Computes the barycentric coordinates of a point with respect to a triangle, in 4D
+ * homogeneous clip space.
+ *
+ * This is used for triangles that were created by clipping: Their vertices lie on the
+ * original triangle (clipping interpolates linearly in clip space), so this recovers where
+ * on the original mesh triangle each of them lies. The point is assumed to lie in the plane
+ * of the triangle, the coordinates are found by least squares.
+ *
+ * @param[in] point A point in clip space, lying on the triangle.
+ * @param[in] v0 First vertex of the triangle, in clip space.
+ * @param[in] v1 Second vertex of the triangle, in clip space.
+ * @param[in] v2 Third vertex of the triangle, in clip space.
+ * @return The barycentric coordinates of the point, summing to one.
+ */
+template <typename T, glm::precision P = glm::defaultp>
+glm::tvec3<T, P> compute_barycentrics_in_4d(const glm::tvec4<T, P>& point, const glm::tvec4<T, P>& v0,
+                                            const glm::tvec4<T, P>& v1, const glm::tvec4<T, P>& v2)
+{
+    // Solve point - v0 = beta * (v1 - v0) + gamma * (v2 - v0) via the 2x2 normal equations:
+    const glm::tvec4<double> e1(v1 - v0);
+    const glm::tvec4<double> e2(v2 - v0);
+    const glm::tvec4<double> d(point - v0);
+    const double e11 = glm::dot(e1, e1);
+    const double e12 = glm::dot(e1, e2);
+    const double e22 = glm::dot(e2, e2);
+    const double det = e11 * e22 - e12 * e12;
+    if (det == 0.0)
+    {
+        return glm::tvec3<T, P>(T(1), T(0), T(0)); // degenerate triangle
+    }
+    const double beta = (e22 * glm::dot(e1, d) - e12 * glm::dot(e2, d)) / det;
+    const double gamma = (e11 * glm::dot(e2, d) - e12 * glm::dot(e1, d)) / det;
+    return glm::tvec3<T, P>(T(1.0 - beta - gamma), T(beta), T(gamma));
 };
 
 /**
@@ -25,12 +25,21 @@
 #include "eos/core/Image.hpp"
 #include "eos/render/Rect.hpp"
 #include "eos/render/detail/render_detail_utils.hpp"
+#include "eos/cpp17/optional.hpp"
 
 #include "glm/vec2.hpp"
 #include "glm/vec4.hpp"
 
 #include "Eigen/Core"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 /**
  * Implementations of internal functions, not part of the
  * API we expose and not meant to be used by a user.
@@ -40,125 +49,211 @@ namespace render {
 namespace detail {
 
 /**
- * Computes whether the given point is inside (or on the border of) the triangle
- * formed out of the given three vertices.
+ * Checks whether a point on a triangle is visible, by comparing its depth against the
+ * depthbuffer at the pixel that the point falls into.
+ *
+ * The point should be given in the screen coordinates of the depthbuffer, i.e. pixel (r, c)
+ * of the depthbuffer covers the square from (c, r) to (c + 1, r + 1), like in the rasteriser.
+ * Points outside of the depthbuffer are not covered by any triangle, so they are visible.
  *
- * @param[in] point The point to check.
- * @param[in] triV0 First vertex.
- * @param[in] triV1 Second vertex.
- * @param[in] triV2 Third vertex.
- * @return Whether the point is inside the triangle.
+ * The triangle that the point lies on is usually not the one whose depth was stored at
+ * the pixel centre, e.g. at the edges of the triangle, so the point is accepted if it is at
+ * most \p depth_tolerance behind the stored depth.
+ *
+ * @param[in] x The x-coordinate of the point, in screen coordinates of the depthbuffer.
+ * @param[in] y The y-coordinate of the point.
+ * @param[in] z The depth of the point.
+ * @param[in] depth_tolerance How far the point may lie behind the depth in the depthbuffer.
+ * @param[in] depthbuffer Pre-calculated depthbuffer, of float or double precision.
+ * @return True if the point is visible.
  */
-inline bool is_point_in_triangle(Eigen::Vector2f point, Eigen::Vector2f triV0, Eigen::Vector2f triV1,
-                                 Eigen::Vector2f triV2)
+template <typename DepthType>
+bool is_point_visible(float x, float y, float z, float depth_tolerance,
+                      const core::Image<DepthType, 1>& depthbuffer)
 {
-    // See http://www.blackpawn.com/texts/pointinpoly/
-    // Compute vectors
-    const Eigen::Vector2f v0 = triV2 - triV0;
-    const Eigen::Vector2f v1 = triV1 - triV0;
-    const Eigen::Vector2f v2 = point - triV0;
-
-    // Compute dot products
-    const float dot00 = v0.dot(v0);
-    const float dot01 = v0.dot(v1);
-    const float dot02 = v0.dot(v2);
-    const float dot11 = v1.dot(v1);
-    const float dot12 = v1.dot(v2);
-
-    // Compute barycentric coordinates
-    const float invDenom = 1 / (dot00 * dot11 - dot01 * dot01);
-    const float u = (dot11 * dot02 - dot01 * dot12) * invDenom;
-    const float v = (dot00 * dot12 - dot01 * dot02) * invDenom;
-
-    // Check if point is in triangle
-    return (u >= 0) && (v >= 0) && (u + v < 1);
+    const int xi = static_cast<int>(std::floor(x));
+    const int yi = static_cast<int>(std::floor(y));
+    if (xi < 0 || yi < 0 || xi >= static_cast<int>(depthbuffer.cols) ||
+        yi >= static_cast<int>(depthbuffer.rows))
+    {
+        return true;
+    }
+    // Compare in the precision of the depthbuffer, so that a point isn't hidden by its own, rounded depth:
+    return static_cast<DepthType>(z - depth_tolerance) <= depthbuffer(yi, xi);
 };
 
 /**
- * Checks whether all pixels in the given triangle are visible and
- * returns true if and only if the whole triangle is visible.
- * The vertices should be given in screen coordinates, but with their
- * z-values preserved, so they can be compared against the depthbuffer.
- *
- * Obviously the depthbuffer given should have been created with the same projection
- * matrix than the texture extraction is called with.
+ * Samples the image at the given position with bilinear interpolation, using
+ * fixed-point weights.
  *
- * Also, we don't do perspective-correct interpolation here I think, so only
- * use it with affine and orthographic projection matrices.
+ * The position is in the image coordinates that extract_texture(...) uses, i.e. the
+ * centre of pixel (r, c) is at (c, r). At the border of the image, the border pixels are
+ * repeated.
  *
- * @param[in] v0 First vertex, in screen coordinates (but still with their z-value).
- * @param[in] v1 Second vertex.
- * @param[in] v2 Third vertex.
- * @param[in] depthbuffer Pre-calculated depthbuffer.
- * @return True if the whole triangle is visible in the image.
+ * @param[in] image The image to sample from.
+ * @param[in] x The x-coordinate (column) of the position.
+ * @param[in] y The y-coordinate (row) of the position.
+ * @return The interpolated colour, in the channel order of the image.
  */
-inline bool is_triangle_visible(const glm::tvec4<float>& v0, const glm::tvec4<float>& v1,
-                                const glm::tvec4<float>& v2, const core::Image1d& depthbuffer)
+inline std::array<std::uint8_t, 3> sample_bilinear(core::ConstImageView3u image, float x, float y)
 {
-    // #Todo: Actually, only check the 3 vertex points, don't loop over the pixels - this should be enough.
+    const float x_floor = std::floor(x);
+    const float y_floor = std::floor(y);
+    // The weights of the right and bottom pixels, in 1/256ths:
+    const int wx = static_cast<int>((x - x_floor) * 256.0f + 0.5f);
+    const int wy = static_cast<int>((y - y_floor) * 256.0f + 0.5f);
+    const int max_col = static_cast<int>(image.cols) - 1;
+    const int max_row = static_cast<int>(image.rows) - 1;
+    const int x0 = std::min(std::max(static_cast<int>(x_floor), 0), max_col);
+    const int y0 = std::min(std::max(static_cast<int>(y_floor), 0), max_row);
+    const int x1 = std::min(std::max(static_cast<int>(x_floor) + 1, 0), max_col);
+    const int y1 = std::min(std::max(static_cast<int>(y_floor) + 1, 0), max_row);
 
-    const auto viewport_width = depthbuffer.cols;
-    const auto viewport_height = depthbuffer.rows;
-
-    // Well, in in principle, we'd have to do the whole stuff as in render(), like
-    // clipping against the frustums etc.
-    // But as long as our model is fully on the screen, we're fine. Todo: Doublecheck that.
+    // The four weights sum up to 256 * 256, so the result is rounded by adding half of that and shifting:
+    const std::array<int, 4> weights{(256 - wx) * (256 - wy), wx * (256 - wy), (256 - wx) * wy, wx * wy};
+    const std::array<const std::array<std::uint8_t, 3>*, 4> texels{&image(y0, x0), &image(y0, x1),
+                                                                    &image(y1, x0), &image(y1, x1)};
+    std::array<std::uint8_t, 3> color;
+    for (int c = 0; c < 3; ++c)
+    {
+        int sum = 1 << 15;
+        for (int i = 0; i < 4; ++i)
+        {
+            sum += weights[i] * (*texels[i])[c];
+        }
+        color[c] = static_cast<std::uint8_t>(sum >> 16);
+    }
+    return color;
+};
 
-    if (!detail::are_vertices_ccw_in_screen_space(glm::tvec2<float>(v0), glm::tvec2<float>(v1),
-                                                  glm::tvec2<float>(v2)))
-        return false;
+/**
+ * A summed-area table of a 3-channel 8-bit image, which allows to compute the sum of the
+ * pixels in any axis-aligned rectangle in constant time.
+ *
+ * sums[r * (cols + 1) + c] contains the sum of all pixels (r', c') with r' < r and c' < c.
+ * The sums are stored modulo 2^32, which still gives the correct sum for every rectangle
+ * whose true sum fits into 32 bits, i.e. rectangles of up to 2^24 pixels.
+ */
+struct SummedAreaTable
+{
+    int rows = 0;
+    int cols = 0;
+    std::vector<std::array<std::uint32_t, 3>> sums;
+};
 
-    const Rect<int> bbox = detail::calculate_clipped_bounding_box(
-        glm::tvec2<float>(v0), glm::tvec2<float>(v1), glm::tvec2<float>(v2), viewport_width, viewport_height);
-    const int minX = bbox.x;
-    const int maxX = bbox.x + bbox.width;
-    const int minY = bbox.y;
-    const int maxY = bbox.y + bbox.height;
+/**
+ * Computes the summed-area table of the given image.
+ *
+ * @param[in] image An image.
+ * @return The summed-area table of the image.
+ */
+inline SummedAreaTable create_summed_area_table(core::ConstImageView3u image)
+{
+    SummedAreaTable table;
+    table.rows = static_cast<int>(image.rows);
+    table.cols = static_cast<int>(image.cols);
+    const std::size_t stride = table.cols + 1;
+    table.sums.resize((table.rows + 1) * stride); // The first row and column stay zero.
+    for (int r = 0; r < table.rows; ++r)
+    {
+        std::array<std::uint32_t, 3> row_sum{0, 0, 0};
+        const std::array<std::uint32_t, 3>* above = &table.sums[r * stride];
+        std::array<std::uint32_t, 3>* current = &table.sums[(r + 1) * stride];
+        for (int c = 0; c < table.cols; ++c)
+        {
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                row_sum[ch] += image(r, c)[ch];
+                current[c + 1][ch] = above[c + 1][ch] + row_sum[ch];
+            }
+        }
+    }
+    return table;
+};
 
-    // if (t.maxX <= t.minX || t.maxY <= t.minY)  // Note: Can the width/height of the bbox be negative? Maybe we only need to check for equality here?
-    //     continue;                              // Also, I'm not entirely sure why I commented this out
+/**
+ * Computes the mean colour of the pixels in the given rectangle of the image, which is
+ * clipped to the image.
+ *
+ * @param[in] table The summed-area table of the image.
+ * @param[in] min_x First column of the rectangle.
+ * @param[in] min_y First row of the rectangle.
+ * @param[in] max_x Last column of the rectangle (inclusive).
+ * @param[in] max_y Last row of the rectangle (inclusive).
+ * @return The mean colour, or an empty optional if the rectangle doesn't contain any pixel of the image.
+ */
+inline cpp17::optional<std::array<std::uint8_t, 3>> box_filter(const SummedAreaTable& table, int min_x,
+                                                               int min_y, int max_x, int max_y)
+{
+    min_x = std::max(min_x, 0);
+    min_y = std::max(min_y, 0);
+    max_x = std::min(max_x, table.cols - 1);
+    max_y = std::min(max_y, table.rows - 1);
+    if (max_x < min_x || max_y < min_y)
+    {
+        return cpp17::nullopt;
+    }
+    const std::size_t stride = table.cols + 1;
+    const auto& bottom_right = table.sums[(max_y + 1) * stride + max_x + 1];
+    const auto& bottom_left = table.sums[(max_y + 1) * stride + min_x];
+    const auto& top_right = table.sums[min_y * stride + max_x + 1];
+    const auto& top_left = table.sums[min_y * stride + min_x];
+    const std::uint32_t num_pixels = (max_x - min_x + 1) * (max_y - min_y + 1);
+    std::array<std::uint8_t, 3> color;
+    for (int c = 0; c < 3; ++c)
+    {
+        const std::uint32_t sum = bottom_right[c] - bottom_left[c] - top_right[c] + top_left[c];
+        color[c] = static_cast<std::uint8_t>((sum + num_pixels / 2) / num_pixels);
+    }
+    return color;
+};
 
-    bool whole_triangle_is_visible = true;
-    for (int yi = minY; yi <= maxY; yi++)
+/**
+ * Halves the resolution of an isomap, by averaging each block of 2x2 pixels.
+ *
+ * The colours are averaged with premultiplied alpha, i.e. weighted by the alpha value of
+ * each pixel, so that invisible pixels (with alpha 0) don't bleed into the visible ones. The
+ * alpha value is the mean of the four alpha values.
+ *
+ * @param[in] isomap A 4-channel isomap with an even number of rows and columns.
+ * @return The isomap at half the resolution.
+ */
+inline core::Image4u downsample_isomap(const core::Image4u& isomap)
+{
+    assert(isomap.rows % 2 == 0 && isomap.cols % 2 == 0);
+    core::Image4u downsampled(isomap.rows / 2, isomap.cols / 2);
+    for (std::size_t r = 0; r < downsampled.rows; ++r)
     {
-        for (int xi = minX; xi <= maxX; xi++)
+        for (std::size_t c = 0; c < downsampled.cols; ++c)
         {
-            // we want centers of pixels to be used in computations. Do we?
-            const float x = static_cast<float>(xi) + 0.5f;
-            const float y = static_cast<float>(yi) + 0.5f;
-            // these will be used for barycentric weights computation
-            const double one_over_v0ToLine12 = 1.0 / detail::implicit_line(v0[0], v0[1], v1, v2);
-            const double one_over_v1ToLine20 = 1.0 / detail::implicit_line(v1[0], v1[1], v2, v0);
-            const double one_over_v2ToLine01 = 1.0 / detail::implicit_line(v2[0], v2[1], v0, v1);
-            // affine barycentric weights
-            const double alpha = detail::implicit_line(x, y, v1, v2) * one_over_v0ToLine12;
-            const double beta = detail::implicit_line(x, y, v2, v0) * one_over_v1ToLine20;
-            const double gamma = detail::implicit_line(x, y, v0, v1) * one_over_v2ToLine01;
-
-            // if pixel (x, y) is inside the triangle or on one of its edges
-            if (alpha >= 0 && beta >= 0 && gamma >= 0)
+            const std::array<std::uint8_t, 4>* const block[4] = {
+                &isomap(2 * r, 2 * c), &isomap(2 * r + 1, 2 * c), &isomap(2 * r, 2 * c + 1),
+                &isomap(2 * r + 1, 2 * c + 1)};
+            int alpha_sum = 0;
+            std::array<int, 3> premultiplied_sums{0, 0, 0};
+            for (const auto* pixel : block)
             {
-                const double z_affine = alpha * static_cast<double>(v0[2]) +
-                                        beta * static_cast<double>(v1[2]) +
-                                        gamma * static_cast<double>(v2[2]);
-                if (z_affine < depthbuffer(yi, xi))
+                const int alpha = (*pixel)[3];
+                alpha_sum += alpha;
+                for (int ch = 0; ch < 3; ++ch)
                 {
-                    whole_triangle_is_visible = false;
-                    break;
+                    premultiplied_sums[ch] += (*pixel)[ch] * alpha;
                 }
             }
+            if (alpha_sum == 0)
+            {
+                continue; // None of the four pixels is visible, so the pixel stays zero.
+            }
+            auto& downsampled_pixel = downsampled(r, c);
+            for (int ch = 0; ch < 3; ++ch)
+            {
+                downsampled_pixel[ch] =
+                    static_cast<std::uint8_t>((premultiplied_sums[ch] + alpha_sum / 2) / alpha_sum);
+            }
+            downsampled_pixel[3] = static_cast<std::uint8_t>((alpha_sum + 2) / 4);
         }
-        if (!whole_triangle_is_visible)
-        {
-            break;
-        }
-    }
-
-    if (!whole_triangle_is_visible)
-    {
-        return false;
     }
-    return true;
+    return downsampled;
 };
 
 } /* namespace detail */
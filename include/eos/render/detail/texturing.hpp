@@ -29,6 +29,11 @@
 
 #include "opencv2/core/core.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+
 /**
  * Implementations of internal functions, not part of the
  * API we expose and not meant to be used by a user.
@@ -70,120 +75,195 @@ glm::tvec3<T, P> tex2d(const glm::tvec2<T, P>& texcoords, const Texture& texture
     return glm::tvec3<T, P>(ret[0], ret[1], ret[2]);
 };
 
+/**
+ * The two mip levels that a trilinear lookup blends, and the weight of the second one.
+ */
+struct MipmapLevels
+{
+    unsigned char index1;
+    unsigned char index2;
+    float weight2;
+};
+
+/**
+ * Selects the mip levels for a lookup with the given partial derivatives of the texture
+ * coordinates (in texels of the base level) w.r.t. the screen coordinates.
+ */
+inline MipmapLevels compute_mipmap_levels(const Texture& texture, float dudx, float dudy, float dvdx,
+                                          float dvdy)
+{
+    const float px = std::sqrt(std::pow(dudx, 2) + std::pow(dvdx, 2));
+    const float py = std::sqrt(std::pow(dudy, 2) + std::pow(dvdy, 2));
+    const float lambda = std::max(std::log(std::max(px, py)) / static_cast<float>(CV_LOG2), 0.0f);
+    // The second level may be the last one, but a texture can also have fewer levels than the full chain:
+    const int max_index1 = std::max(std::max(texture.widthLog, texture.heightLog) - 1, 0);
+    const int max_index = static_cast<int>(texture.mipmaps_num) - 1;
+    MipmapLevels levels;
+    levels.index1 = static_cast<unsigned char>(std::min({(int)lambda, max_index1, max_index}));
+    levels.index2 = static_cast<unsigned char>(std::min(levels.index1 + 1, max_index));
+    levels.weight2 = lambda - (int)lambda;
+    return levels;
+};
+
 inline glm::vec3 tex2d_linear_mipmap_linear(const glm::vec2& texcoords, const Texture& texture, float dudx,
                                             float dudy, float dvdx, float dvdy)
 {
     using glm::vec2;
-    const float px = std::sqrt(std::pow(dudx, 2) + std::pow(dvdx, 2));
-    const float py = std::sqrt(std::pow(dudy, 2) + std::pow(dvdy, 2));
-    const float lambda = std::log(std::max(px, py)) / static_cast<float>(CV_LOG2);
-    const unsigned char mipmapIndex1 =
-        detail::clamp((int)lambda, 0.0f, std::max(texture.widthLog, texture.heightLog) - 1);
-    const unsigned char mipmapIndex2 = mipmapIndex1 + 1;
+    const MipmapLevels levels = compute_mipmap_levels(texture, dudx, dudy, dvdx, dvdy);
+    const TiledMipmap& mipmap1 = texture.get_mipmap(levels.index1);
+    const TiledMipmap& mipmap2 = texture.get_mipmap(levels.index2);
 
     const vec2 imageTexCoord = detail::texcoord_wrap(texcoords);
-    vec2 imageTexCoord1 = imageTexCoord;
-    imageTexCoord1[0] *= texture.mipmaps[mipmapIndex1].cols;
-    imageTexCoord1[1] *= texture.mipmaps[mipmapIndex1].rows;
-    vec2 imageTexCoord2 = imageTexCoord;
-    imageTexCoord2[0] *= texture.mipmaps[mipmapIndex2].cols;
-    imageTexCoord2[1] *= texture.mipmaps[mipmapIndex2].rows;
-
-    glm::vec3 color, color1, color2;
-    color1 = tex2d_linear(imageTexCoord1, mipmapIndex1, texture);
-    color2 = tex2d_linear(imageTexCoord2, mipmapIndex2, texture);
-    float lambdaFrac = std::max(lambda, 0.0f);
-    lambdaFrac = lambdaFrac - (int)lambdaFrac;
-    color = (1.0f - lambdaFrac) * color1 + lambdaFrac * color2;
+    const vec2 imageTexCoord1(imageTexCoord[0] * mipmap1.width, imageTexCoord[1] * mipmap1.height);
+    const vec2 imageTexCoord2(imageTexCoord[0] * mipmap2.width, imageTexCoord[1] * mipmap2.height);
 
-    return color;
+    const glm::vec3 color1 = tex2d_linear(imageTexCoord1, levels.index1, texture);
+    const glm::vec3 color2 = tex2d_linear(imageTexCoord2, levels.index2, texture);
+    return (1.0f - levels.weight2) * color1 + levels.weight2 * color2;
+};
+
+/**
+ * The texels and weights of a bilinear lookup: The indices of the four taps in
+ * TiledMipmap::texels, and their weights.
+ */
+struct BilinearTaps
+{
+    std::array<std::size_t, 4> indices;
+    std::array<float, 4> weights;
+};
+
+/**
+ * Computes the four taps of a bilinear lookup at the given position on a mip level.
+ *
+ * The position is in texels, with texel (x, y) covering [x, x + 1) x [y, y + 1). Positions
+ * outside the mip level are clamped to it. The taps to the right and below wrap around to
+ * the first column and row, which the padding of TiledMipmap stores, so this needs no
+ * branches.
+ */
+inline BilinearTaps compute_bilinear_taps(const glm::vec2& image_texcoords, const TiledMipmap& mipmap)
+{
+    const int x = std::min(std::max(static_cast<int>(image_texcoords[0]), 0), mipmap.width - 1);
+    const int y = std::min(std::max(static_cast<int>(image_texcoords[1]), 0), mipmap.height - 1);
+    const float alpha = clamp(image_texcoords[0] - x, 0.0f, 1.0f);
+    const float beta = clamp(image_texcoords[1] - y, 0.0f, 1.0f);
+
+    BilinearTaps taps;
+    taps.indices = {mipmap.index(x, y), mipmap.index(x + 1, y), mipmap.index(x, y + 1),
+                    mipmap.index(x + 1, y + 1)};
+    taps.weights = {(1.0f - alpha) * (1.0f - beta), alpha * (1.0f - beta), (1.0f - alpha) * beta,
+                    alpha * beta};
+    return taps;
 };
 
 inline glm::vec3 tex2d_linear(const glm::vec2& imageTexCoord, unsigned char mipmap_index,
                               const Texture& texture)
 {
-    const int x = (int)imageTexCoord[0];
-    const int y = (int)imageTexCoord[1];
-    const float alpha = imageTexCoord[0] - x;
-    const float beta = imageTexCoord[1] - y;
-    const float oneMinusAlpha = 1.0f - alpha;
-    const float oneMinusBeta = 1.0f - beta;
-    const float a = oneMinusAlpha * oneMinusBeta;
-    const float b = alpha * oneMinusBeta;
-    const float c = oneMinusAlpha * beta;
-    const float d = alpha * beta;
-    glm::vec3 color;
-
-    using cv::Vec4b;
-    // int pixelIndex;
-    // pixelIndex = getPixelIndex_wrap(x, y, texture->mipmaps[mipmapIndex].cols,
-    // texture->mipmaps[mipmapIndex].rows);
-    int pixelIndexCol = x;
-    if (pixelIndexCol == texture.mipmaps[mipmap_index].cols)
-    {
-        pixelIndexCol = 0;
-    }
-    int pixelIndexRow = y;
-    if (pixelIndexRow == texture.mipmaps[mipmap_index].rows)
-    {
-        pixelIndexRow = 0;
-    }
-    // std::cout << texture.mipmaps[mipmapIndex].cols << " " << texture.mipmaps[mipmapIndex].rows << " " <<
-    // texture.mipmaps[mipmapIndex].channels() << std::endl;  cv::imwrite("mm.png",
-    // texture.mipmaps[mipmapIndex]);
-    color[0] = a * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[0];
-    color[1] = a * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[1];
-    color[2] = a * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[2];
-
-    // pixelIndex = getPixelIndex_wrap(x + 1, y, texture.mipmaps[mipmapIndex].cols,
-    // texture.mipmaps[mipmapIndex].rows);
-    pixelIndexCol = x + 1;
-    if (pixelIndexCol == texture.mipmaps[mipmap_index].cols)
-    {
-        pixelIndexCol = 0;
-    }
-    pixelIndexRow = y;
-    if (pixelIndexRow == texture.mipmaps[mipmap_index].rows)
+    const TiledMipmap& mipmap = texture.get_mipmap(mipmap_index);
+    const BilinearTaps taps = compute_bilinear_taps(imageTexCoord, mipmap);
+
+    glm::vec3 color(0.0f, 0.0f, 0.0f);
+    for (int tap = 0; tap < 4; ++tap)
     {
-        pixelIndexRow = 0;
+        const auto& texel = mipmap.texels[taps.indices[tap]];
+        color[0] += taps.weights[tap] * texel[0];
+        color[1] += taps.weights[tap] * texel[1];
+        color[2] += taps.weights[tap] * texel[2];
     }
-    color[0] += b * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[0];
-    color[1] += b * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[1];
-    color[2] += b * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[2];
-
-    // pixelIndex = getPixelIndex_wrap(x, y + 1, texture.mipmaps[mipmapIndex].cols,
-    // texture.mipmaps[mipmapIndex].rows);
-    pixelIndexCol = x;
-    if (pixelIndexCol == texture.mipmaps[mipmap_index].cols)
+    return color;
+};
+
+/**
+ * Colours of the four fragments of a 2x2 quad, stored per channel (structure-of-arrays),
+ * in the BGR order of the texture.
+ */
+struct QuadColors
+{
+    std::array<float, 4> b;
+    std::array<float, 4> g;
+    std::array<float, 4> r;
+};
+
+/**
+ * Bilinear lookup of the four fragments of a 2x2 quad on one mip level.
+ *
+ * The texel fetches and the blending are done for all four fragments at once, in
+ * structure-of-arrays form, so that the compiler can vectorise the blending over the
+ * fragments.
+ *
+ * @param[in] image_texcoords The positions of the four fragments on the mip level, in texels.
+ * @param[in] mipmap The mip level to sample from.
+ * @return The four colours, in the range [0, 255].
+ */
+inline QuadColors tex2d_linear_quad(const std::array<glm::vec2, 4>& image_texcoords,
+                                    const TiledMipmap& mipmap)
+{
+    std::array<BilinearTaps, 4> taps;
+    for (int i = 0; i < 4; ++i)
     {
-        pixelIndexCol = 0;
+        taps[i] = compute_bilinear_taps(image_texcoords[i], mipmap);
     }
-    pixelIndexRow = y + 1;
-    if (pixelIndexRow == texture.mipmaps[mipmap_index].rows)
+
+    QuadColors colors{};
+    for (int tap = 0; tap < 4; ++tap)
     {
-        pixelIndexRow = 0;
+        std::array<float, 4> b, g, r, weights;
+        for (int i = 0; i < 4; ++i)
+        {
+            const auto& texel = mipmap.texels[taps[i].indices[tap]];
+            b[i] = texel[0];
+            g[i] = texel[1];
+            r[i] = texel[2];
+            weights[i] = taps[i].weights[tap];
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            colors.b[i] += weights[i] * b[i];
+            colors.g[i] += weights[i] * g[i];
+            colors.r[i] += weights[i] * r[i];
+        }
     }
-    color[0] += c * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[0];
-    color[1] += c * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[1];
-    color[2] += c * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[2];
-
-    // pixelIndex = getPixelIndex_wrap(x + 1, y + 1, texture.mipmaps[mipmapIndex].cols,
-    // texture.mipmaps[mipmapIndex].rows);
-    pixelIndexCol = x + 1;
-    if (pixelIndexCol == texture.mipmaps[mipmap_index].cols)
+    return colors;
+};
+
+/**
+ * Trilinear lookup of the four fragments of a 2x2 quad. Like on a GPU, the mip levels
+ * are selected once for the whole quad, from the given partial derivatives.
+ *
+ * @param[in] texcoords The texture coordinates of the four fragments.
+ * @param[in] texture The texture to sample from.
+ * @param[in] dudx Partial derivative of u w.r.t. x, in texels of the base level.
+ * @param[in] dudy Partial derivative of u w.r.t. y, in texels of the base level.
+ * @param[in] dvdx Partial derivative of v w.r.t. x, in texels of the base level.
+ * @param[in] dvdy Partial derivative of v w.r.t. y, in texels of the base level.
+ * @return The four colours, in BGR order and in the range [0, 1].
+ */
+inline QuadColors tex2d_quad(const std::array<glm::vec2, 4>& texcoords, const Texture& texture, float dudx,
+                             float dudy, float dvdx, float dvdy)
+{
+    const MipmapLevels levels = compute_mipmap_levels(texture, dudx, dudy, dvdx, dvdy);
+    const TiledMipmap& mipmap1 = texture.get_mipmap(levels.index1);
+    const TiledMipmap& mipmap2 = texture.get_mipmap(levels.index2);
+
+    std::array<glm::vec2, 4> image_texcoords1, image_texcoords2;
+    for (int i = 0; i < 4; ++i)
     {
-        pixelIndexCol = 0;
+        const glm::vec2 wrapped = texcoord_wrap(texcoords[i]);
+        image_texcoords1[i] = glm::vec2(wrapped[0] * mipmap1.width, wrapped[1] * mipmap1.height);
+        image_texcoords2[i] = glm::vec2(wrapped[0] * mipmap2.width, wrapped[1] * mipmap2.height);
     }
-    pixelIndexRow = y + 1;
-    if (pixelIndexRow == texture.mipmaps[mipmap_index].rows)
+    const QuadColors colors1 = tex2d_linear_quad(image_texcoords1, mipmap1);
+    const QuadColors colors2 = tex2d_linear_quad(image_texcoords2, mipmap2);
+
+    const float weight1 = (1.0f - levels.weight2) / 255.0f;
+    const float weight2 = levels.weight2 / 255.0f;
+    QuadColors colors;
+    for (int i = 0; i < 4; ++i)
     {
-        pixelIndexRow = 0;
+        colors.b[i] = weight1 * colors1.b[i] + weight2 * colors2.b[i];
+        colors.g[i] = weight1 * colors1.g[i] + weight2 * colors2.g[i];
+        colors.r[i] = weight1 * colors1.r[i] + weight2 * colors2.r[i];
     }
-    color[0] += d * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[0];
-    color[1] += d * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[1];
-    color[2] += d * texture.mipmaps[mipmap_index].at<Vec4b>(pixelIndexRow, pixelIndexCol)[2];
-
-    return color;
+    return colors;
 };
 
 } /* namespace detail */
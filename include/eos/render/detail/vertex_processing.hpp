@@ -0,0 +1,183 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/detail/vertex_processing.hpp
+ *
+ * Copyright 2026 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef VERTEX_PROCESSING_HPP_
+#define VERTEX_PROCESSING_HPP_
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Implementations of internal functions, not part of the
+ * API we expose and not meant to be used by a user.
+ *
+ * This file contains the vertex processing stage that is shared by the renderers
+ * and the texture extraction: All vertices of a mesh are transformed at once, and
+ * their frustum outcodes are computed once per vertex instead of once per triangle
+ * corner.
+ */
+namespace eos {
+namespace render {
+namespace detail {
+
+/**
+ * Converts a glm 4x4 matrix to an Eigen 4x4 matrix.
+ *
+ * @param[in] matrix A glm matrix (column-major, i.e. matrix[col][row]).
+ * @return The same matrix as Eigen type.
+ */
+inline Eigen::Matrix4f to_eigen(const glm::tmat4x4<float>& matrix)
+{
+    Eigen::Matrix4f result;
+    for (int col = 0; col < 4; ++col)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            result(row, col) = matrix[col][row];
+        }
+    }
+    return result;
+};
+
+/**
+ * Transforms all given vertices with the given 4x4 matrix, using homogeneous
+ * coordinates with w = 1.
+ *
+ * The vertices are given as one 3 x N matrix (see core::VertexBuffer::as_matrix()), so the
+ * whole transform is a single matrix product that Eigen evaluates with its vectorised kernels,
+ * instead of N separate 4x4 products.
+ *
+ * @param[in] vertices 3D vertex positions as columns, for example core::Mesh::vertices.as_matrix().
+ * @param[in] transform A 4x4 transformation, for example projection * model_view.
+ * @return A 4 x N matrix with the transformed homogeneous vertices as columns.
+ */
+inline Eigen::Matrix<float, 4, Eigen::Dynamic>
+transform_vertices(const Eigen::Ref<const Eigen::Matrix3Xf>& vertices, const Eigen::Matrix4f& transform)
+{
+    Eigen::Matrix<float, 4, Eigen::Dynamic> transformed = transform.leftCols<3>() * vertices;
+    transformed.colwise() += transform.col(3);
+    return transformed;
+};
+
+/**
+ * Computes the frustum outcode of a vertex in clip space. Each bit is set if the vertex
+ * is outside of the corresponding plane of the view frustum:
+ * 1: left, 2: right, 4: bottom, 8: top, 16: near, 32: far.
+ *
+ * If all bits are 0, the vertex is inside the frustum. If the bitwise and of the
+ * outcodes of a triangle's vertices is non-zero, the triangle is completely outside.
+ *
+ * @param[in] x_cc Clip-space x coordinate.
+ * @param[in] y_cc Clip-space y coordinate.
+ * @param[in] z_cc Clip-space z coordinate.
+ * @param[in] w_cc Clip-space w coordinate.
+ * @param[in] enable_near_clipping Whether to test against the near plane.
+ * @param[in] enable_far_clipping Whether to test against the far plane.
+ * @return The outcode of the vertex.
+ */
+template <typename T>
+std::uint8_t compute_outcode(T x_cc, T y_cc, T z_cc, T w_cc, bool enable_near_clipping,
+                             bool enable_far_clipping)
+{
+    std::uint8_t outcode = 0;
+    if (x_cc < -w_cc) // true if outside of view frustum. False if on or inside the plane.
+        outcode |= 1; // set bit if outside of frustum
+    if (x_cc > w_cc)
+        outcode |= 2;
+    if (y_cc < -w_cc)
+        outcode |= 4;
+    if (y_cc > w_cc)
+        outcode |= 8;
+    if (enable_near_clipping && z_cc < -w_cc) // near plane frustum clipping
+        outcode |= 16;
+    if (enable_far_clipping && z_cc > w_cc) // far plane frustum clipping
+        outcode |= 32;
+    return outcode;
+};
+
+/**
+ * Size of the guard band, in multiples of the viewport's half-width and half-height, i.e. in NDC.
+ *
+ * The renderers don't clip triangles against the left, right, bottom and top planes of the view
+ * frustum. They clip each triangle's bounding box to the viewport instead. That only works while the
+ * screen coordinates stay small enough for the rasteriser's edge equations to be exact, so
+ * triangles that extend beyond the guard band, [-guard_band_size * w, guard_band_size * w] in x
+ * and y, are clipped against its sides (see compute_guard_band_outcode(...)).
+ */
+constexpr float guard_band_size = 8.0f;
+
+/**
+ * Computes which sides of the guard band a vertex in clip space is outside of, using the bits
+ * of compute_outcode(...): 1: left, 2: right, 4: bottom, 8: top.
+ *
+ * @param[in] x_cc Clip-space x coordinate.
+ * @param[in] y_cc Clip-space y coordinate.
+ * @param[in] w_cc Clip-space w coordinate.
+ * @param[in] guard_band The size of the guard band, see guard_band_size.
+ * @return The guard band outcode of the vertex.
+ */
+template <typename T>
+std::uint8_t compute_guard_band_outcode(T x_cc, T y_cc, T w_cc, T guard_band = T(guard_band_size))
+{
+    std::uint8_t outcode = 0;
+    if (x_cc < -guard_band * w_cc)
+        outcode |= 1;
+    if (x_cc > guard_band * w_cc)
+        outcode |= 2;
+    if (y_cc < -guard_band * w_cc)
+        outcode |= 4;
+    if (y_cc > guard_band * w_cc)
+        outcode |= 8;
+    return outcode;
+};
+
+/**
+ * Computes the frustum outcodes of all given clip-space vertices. See compute_outcode(...).
+ *
+ * @param[in] clipspace_vertices A 4 x N matrix with clip-space vertices as columns.
+ * @param[in] enable_near_clipping Whether to test against the near plane.
+ * @param[in] enable_far_clipping Whether to test against the far plane.
+ * @return One outcode per vertex.
+ */
+inline std::vector<std::uint8_t>
+compute_outcodes(const Eigen::Matrix<float, 4, Eigen::Dynamic>& clipspace_vertices, bool enable_near_clipping,
+                 bool enable_far_clipping)
+{
+    std::vector<std::uint8_t> outcodes(clipspace_vertices.cols());
+    for (Eigen::Index i = 0; i < clipspace_vertices.cols(); ++i)
+    {
+        outcodes[i] = compute_outcode(clipspace_vertices(0, i), clipspace_vertices(1, i),
+                                      clipspace_vertices(2, i), clipspace_vertices(3, i),
+                                      enable_near_clipping, enable_far_clipping);
+    }
+    return outcodes;
+};
+
+} /* namespace detail */
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* VERTEX_PROCESSING_HPP_ */
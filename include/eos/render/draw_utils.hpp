@@ -51,7 +51,7 @@ inline void draw_wireframe(cv::Mat image, const core::Mesh& mesh, glm::mat4x4 mo
                            glm::mat4x4 projection, glm::vec4 viewport,
                            cv::Scalar color = cv::Scalar(0, 255, 0, 255))
 {
-    for (const auto& triangle : mesh.tvi)
+    for (const auto& triangle : mesh.tvi())
     {
         const auto p1 = glm::project(
             {mesh.vertices[triangle[0]][0], mesh.vertices[triangle[0]][1], mesh.vertices[triangle[0]][2]},
@@ -92,22 +92,22 @@ inline cv::Mat draw_texcoords(core::Mesh mesh, cv::Mat image = cv::Mat())
         image = cv::Mat(512, 512, CV_8UC4, Scalar(0.0f, 0.0f, 0.0f, 255.0f));
     }
 
-    for (const auto& triIdx : mesh.tvi)
+    for (const auto& triIdx : mesh.tvi())
     {
         cv::line(
             image,
-            Point2f(mesh.texcoords[triIdx[0]][0] * image.cols, mesh.texcoords[triIdx[0]][1] * image.rows),
-            Point2f(mesh.texcoords[triIdx[1]][0] * image.cols, mesh.texcoords[triIdx[1]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[0]][0] * image.cols, mesh.texcoords()[triIdx[0]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[1]][0] * image.cols, mesh.texcoords()[triIdx[1]][1] * image.rows),
             Scalar(255.0f, 0.0f, 0.0f));
         cv::line(
             image,
-            Point2f(mesh.texcoords[triIdx[1]][0] * image.cols, mesh.texcoords[triIdx[1]][1] * image.rows),
-            Point2f(mesh.texcoords[triIdx[2]][0] * image.cols, mesh.texcoords[triIdx[2]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[1]][0] * image.cols, mesh.texcoords()[triIdx[1]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[2]][0] * image.cols, mesh.texcoords()[triIdx[2]][1] * image.rows),
             Scalar(255.0f, 0.0f, 0.0f));
         cv::line(
             image,
-            Point2f(mesh.texcoords[triIdx[2]][0] * image.cols, mesh.texcoords[triIdx[2]][1] * image.rows),
-            Point2f(mesh.texcoords[triIdx[0]][0] * image.cols, mesh.texcoords[triIdx[0]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[2]][0] * image.cols, mesh.texcoords()[triIdx[2]][1] * image.rows),
+            Point2f(mesh.texcoords()[triIdx[0]][0] * image.cols, mesh.texcoords()[triIdx[0]][1] * image.rows),
             Scalar(255.0f, 0.0f, 0.0f));
     }
     return image;
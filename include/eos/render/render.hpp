@@ -24,11 +24,28 @@
 
 #include "eos/core/Image.hpp"
 #include "eos/core/Mesh.hpp"
+#include "eos/morphablemodel/MeshletTopology.hpp"
+#include "eos/render/GBuffer.hpp"
+#include "eos/render/Rect.hpp"
+#include "eos/render/detail/meshlet_culling.hpp"
+#include "eos/render/detail/render_depth_detail.hpp"
 #include "eos/render/detail/render_detail.hpp"
 #include "eos/render/utils.hpp"
 #include "eos/cpp17/optional.hpp"
 
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include "Eigen/Core"
+#include "Eigen/LU"
+
+#include <algorithm>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
 #include <vector>
 
 namespace eos {
@@ -121,7 +138,7 @@ namespace render {
  * @return A pair with the colourbuffer as its first element and the depthbuffer as the second element.
  */
 inline std::pair<core::Image4u, core::Image1d>
-render(core::Mesh mesh, glm::tmat4x4<float> model_view_matrix, glm::tmat4x4<float> projection_matrix,
+render(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix, glm::tmat4x4<float> projection_matrix,
        int viewport_width, int viewport_height, const cpp17::optional<Texture>& texture = cpp17::nullopt,
        bool enable_backface_culling = false, bool enable_near_clipping = true,
        bool enable_far_clipping = true)
@@ -137,10 +154,13 @@ render(core::Mesh mesh, glm::tmat4x4<float> model_view_matrix, glm::tmat4x4<floa
     assert(mesh.vertices.size() == mesh.colors.size() ||
            mesh.colors.empty()); // The number of vertices has to be equal for both shape and colour, or,
                                  // alternatively, it has to be a shape-only model.
-    assert(mesh.vertices.size() == mesh.texcoords.size() || mesh.texcoords.empty()); // same for the texcoords
+    assert(mesh.vertices.size() == mesh.texcoords().size() ||
+           mesh.texcoords().empty()); // same for the texcoords
     // another assert: If cv::Mat texture != empty, then we need texcoords?
 
-    using std::vector;
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster =
+        detail::setup_triangles(mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height,
+                                enable_backface_culling, enable_near_clipping, enable_far_clipping);
 
     core::Image4u colorbuffer(
         viewport_height,
@@ -149,123 +169,432 @@ render(core::Mesh mesh, glm::tmat4x4<float> model_view_matrix, glm::tmat4x4<floa
     std::for_each(std::begin(depthbuffer.data), std::end(depthbuffer.data),
                   [](auto& element) { element = std::numeric_limits<double>::max(); });
 
-    // Vertex shader:
-    // processedVertex = shade(Vertex); // processedVertex : pos, col, tex, texweight
-    // Assemble the vertices, project to clip space, and store as detail::Vertex (the internal
-    // representation):
-    vector<detail::Vertex<float>> clipspace_vertices;
-    clipspace_vertices.reserve(mesh.vertices.size());
-    for (int i = 0; i < mesh.vertices.size(); ++i)
-    { // "previously": mesh.vertex
-        const glm::tvec4<float> vertex(mesh.vertices[i][0], mesh.vertices[i][1], mesh.vertices[i][2], 1.0f);
-        const glm::tvec4<float> clipspace_coords = projection_matrix * model_view_matrix * vertex;
-        glm::tvec3<float> vertex_colour;
-        if (mesh.colors.empty())
-        {
-            vertex_colour = glm::tvec3<float>(0.5f, 0.5f, 0.5f);
-        } else
-        {
-            vertex_colour = glm::tvec3<float>(mesh.colors[i][0], mesh.colors[i][1], mesh.colors[i][2]);
-        }
-        clipspace_vertices.push_back(detail::Vertex<float>{
-            clipspace_coords, vertex_colour, glm::tvec2<float>(mesh.texcoords[i][0], mesh.texcoords[i][1])});
+    // Fragment/pixel shader: Colour the pixel values
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
     }
+    return std::make_pair(colorbuffer, depthbuffer);
+};
+
+/**
+ * Renders the given mesh like render(...), but into the given colour and depth buffer
+ * instead of newly allocated ones. The buffers are cleared first, and their size is the
+ * size of the viewport.
+ *
+ * This allows to re-use the same render targets when rendering many meshes one after
+ * another, for example one pair of buffers per thread when generating synthetic data. The
+ * buffers can be core::Image4u and core::Image1d, or views of pixels that are stored
+ * elsewhere, e.g. in a cv::Mat (see core::from_mat_view(...)) or a numpy array.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in,out] colorbuffer The colour buffer to render into.
+ * @param[in,out] depthbuffer The depth buffer to render into. Must have the same size as \p colorbuffer.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ */
+inline void render_into(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix,
+                        glm::tmat4x4<float> projection_matrix, core::ImageView4u colorbuffer,
+                        core::ImageView1d depthbuffer,
+                        const cpp17::optional<Texture>& texture = cpp17::nullopt,
+                        bool enable_backface_culling = false, bool enable_near_clipping = true,
+                        bool enable_far_clipping = true)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(mesh.vertices.size() == mesh.texcoords().size() || mesh.texcoords().empty());
+    assert(colorbuffer.rows == depthbuffer.rows && colorbuffer.cols == depthbuffer.cols);
+
+    const int viewport_width = static_cast<int>(colorbuffer.cols);
+    const int viewport_height = static_cast<int>(colorbuffer.rows);
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster =
+        detail::setup_triangles(mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height,
+                                enable_backface_culling, enable_near_clipping, enable_far_clipping);
+
+    core::fill(colorbuffer, std::array<std::uint8_t, 4>{});
+    core::fill(depthbuffer, std::numeric_limits<double>::max());
 
-    // All vertices are in clip-space now.
-    // Prepare the rasterisation stage.
-    // For every vertex/tri:
-    vector<detail::TriangleToRasterize> triangles_to_raster;
-    for (const auto& tri_indices : mesh.tvi)
+    for (const auto& tri : triangles_to_raster)
     {
-        // Todo: Split this whole stuff up. Make a "clip" function, ... rename "processProspective..".. what
-        // is "process"... get rid of "continue;"-stuff by moving stuff inside process...
-        // classify vertices visibility with respect to the planes of the view frustum
-        // we're in clip-coords (NDC), so just check if outside [-1, 1] x ...
-        // Actually we're in clip-coords and it's not the same as NDC. We're only in NDC after the division by w.
-        // We should do the clipping in clip-coords though. See
-        // http://www.songho.ca/opengl/gl_projectionmatrix.html for more details.
-        // However, when comparing against w_c below, we might run into the trouble of the sign again in the
-        // affine case.
-
-        // 'w' is always positive, as it is -z_camspace, and all z_camspace are negative.
-        unsigned char visibility_bits[3];
-        for (unsigned char k = 0; k < 3; k++)
-        {
-            visibility_bits[k] = 0;
-            const float x_cc = clipspace_vertices[tri_indices[k]].position[0];
-            const float y_cc = clipspace_vertices[tri_indices[k]].position[1];
-            const float z_cc = clipspace_vertices[tri_indices[k]].position[2];
-            const float w_cc = clipspace_vertices[tri_indices[k]].position[3];
-            if (x_cc < -w_cc)            // true if outside of view frustum. False if on or inside the plane.
-                visibility_bits[k] |= 1; // set bit if outside of frustum
-            if (x_cc > w_cc)
-                visibility_bits[k] |= 2;
-            if (y_cc < -w_cc)
-                visibility_bits[k] |= 4;
-            if (y_cc > w_cc)
-                visibility_bits[k] |= 8;
-            if (enable_near_clipping && z_cc < -w_cc) // near plane frustum clipping
-                visibility_bits[k] |= 16;
-            if (enable_far_clipping && z_cc > w_cc) // far plane frustum clipping
-                visibility_bits[k] |= 32;
-        } // if all bits are 0, then it's inside the frustum
-        // all vertices are not visible - reject the triangle.
-        if ((visibility_bits[0] & visibility_bits[1] & visibility_bits[2]) > 0)
-        {
-            continue;
-        }
-        // all vertices are visible - pass the whole triangle to the rasterizer. = All bits of all 3 triangles
-        // are 0.
-        if ((visibility_bits[0] | visibility_bits[1] | visibility_bits[2]) == 0)
+        detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
+    }
+};
+
+/**
+ * Renders the given mesh like render(...), but first culls whole meshlets (clusters of
+ * triangles) that are outside the view frustum or, if backface culling is enabled, that
+ * face away from the camera. Only the triangles of the remaining meshlets are processed.
+ *
+ * The result is the same as the one of render(...), as long as the bounds of the meshlet
+ * topology are up-to-date for the given mesh. See morphablemodel::update_meshlet_bounds(...).
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] meshlet_topology The meshlet topology of the mesh, with bounds computed from the mesh.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @return A pair with the colourbuffer as its first element and the depthbuffer as the second element.
+ */
+inline std::pair<core::Image4u, core::Image1d>
+render(const core::Mesh& mesh, const morphablemodel::MeshletTopology& meshlet_topology,
+       glm::tmat4x4<float> model_view_matrix, glm::tmat4x4<float> projection_matrix, int viewport_width,
+       int viewport_height, const cpp17::optional<Texture>& texture = cpp17::nullopt,
+       bool enable_backface_culling = false, bool enable_near_clipping = true,
+       bool enable_far_clipping = true)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(mesh.vertices.size() == mesh.texcoords().size() || mesh.texcoords().empty());
+    assert(meshlet_topology.triangle_indices.size() == mesh.tvi().size());
+
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles(
+        mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height, enable_backface_culling,
+        enable_near_clipping, enable_far_clipping,
+        detail::cull_meshlets(meshlet_topology, detail::to_eigen(projection_matrix * model_view_matrix),
+                              enable_backface_culling, enable_near_clipping, enable_far_clipping));
+
+    core::Image4u colorbuffer(viewport_height, viewport_width); // initialised with zeros by the Image4u c'tor
+    core::Image1d depthbuffer(viewport_height, viewport_width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<double>::max());
+
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
+    }
+    return std::make_pair(colorbuffer, depthbuffer);
+};
+
+/**
+ * Renders only the depth buffer of the given mesh, using 4x4 model-view and projection
+ * matrices. Conforms to OpenGL conventions, like render(...).
+ *
+ * This is much faster than render(...) for callers that only need the depth, e.g. for
+ * occlusion or visibility tests: Only the vertex positions are transformed, no vertex
+ * attributes are set up or interpolated, and there is no colour buffer. Depth is stored as
+ * float. Pixels are covered by the same triangles as in render(...), and their depth is the
+ * one of render(...), rounded to float. Pixels that no triangle covers have a depth of
+ * std::numeric_limits<float>::max().
+ *
+ * @param[in] mesh A 3D mesh. Only its vertices and triangle indices are used.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @return The depthbuffer.
+ */
+inline core::Image1f render_depth(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix,
+                                  glm::tmat4x4<float> projection_matrix, int viewport_width,
+                                  int viewport_height, bool enable_backface_culling = false,
+                                  bool enable_near_clipping = true, bool enable_far_clipping = true)
+{
+    const std::vector<detail::DepthTriangle> triangles_to_raster = detail::setup_depth_triangles(
+        mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height, enable_backface_culling,
+        enable_near_clipping, enable_far_clipping);
+
+    core::Image1f depthbuffer(viewport_height, viewport_width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<float>::max());
+
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle_depth(tri, depthbuffer, enable_far_clipping);
+    }
+    return depthbuffer;
+};
+
+/**
+ * Renders only the depth of the given mesh like render_depth(...), but into the given depth
+ * buffer instead of a newly allocated one. The buffer is cleared first, and its size is the
+ * size of the viewport. It can be a core::Image1f or a view, see render_into(...).
+ *
+ * @param[in] mesh A 3D mesh. Only its vertices and triangle indices are used.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in,out] depthbuffer The depth buffer to render into.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ */
+inline void render_depth_into(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix,
+                              glm::tmat4x4<float> projection_matrix, core::ImageView1f depthbuffer,
+                              bool enable_backface_culling = false, bool enable_near_clipping = true,
+                              bool enable_far_clipping = true)
+{
+    const std::vector<detail::DepthTriangle> triangles_to_raster = detail::setup_depth_triangles(
+        mesh, model_view_matrix, projection_matrix, static_cast<int>(depthbuffer.cols),
+        static_cast<int>(depthbuffer.rows), enable_backface_culling, enable_near_clipping,
+        enable_far_clipping);
+
+    core::fill(depthbuffer, std::numeric_limits<float>::max());
+
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle_depth(tri, depthbuffer, enable_far_clipping);
+    }
+};
+
+/**
+ * Renders the given mesh like render(...), and additionally writes the requested render
+ * targets (normals, barycentric coordinates, triangle ids and a mask), all in one
+ * rasterisation pass.
+ *
+ * The normals are eye-space unit normals, interpolated from per-vertex normals (see
+ * compute_vertex_normals(...)) and transformed with the inverse transpose of the
+ * model-view matrix. The barycentric coordinates and triangle ids refer to the visible
+ * triangle of the mesh, i.e. to mesh.tvi, also if the triangle was clipped.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] render_targets Which render targets to write, in addition to the colour and depth buffer.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @return The G-buffer, with the colour and depth buffer and the requested render targets.
+ */
+inline GBuffer render_gbuffer(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix,
+                              glm::tmat4x4<float> projection_matrix, int viewport_width, int viewport_height,
+                              const RenderTargets& render_targets,
+                              const cpp17::optional<Texture>& texture = cpp17::nullopt,
+                              bool enable_backface_culling = false, bool enable_near_clipping = true,
+                              bool enable_far_clipping = true)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(mesh.vertices.size() == mesh.texcoords().size() || mesh.texcoords().empty());
+
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster =
+        detail::setup_triangles(mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height,
+                                enable_backface_culling, enable_near_clipping, enable_far_clipping);
+
+    GBuffer gbuffer;
+    gbuffer.colorbuffer = core::Image4u(viewport_height, viewport_width); // initialised with zeros
+    gbuffer.depthbuffer = core::Image1d(viewport_height, viewport_width);
+    std::fill(std::begin(gbuffer.depthbuffer.data), std::end(gbuffer.depthbuffer.data),
+              std::numeric_limits<double>::max());
+    if (render_targets.normals)
+    {
+        gbuffer.normals = core::Image3f(viewport_height, viewport_width);
+    }
+    if (render_targets.barycentrics)
+    {
+        gbuffer.barycentrics = core::Image3f(viewport_height, viewport_width);
+    }
+    if (render_targets.triangle_ids)
+    {
+        gbuffer.triangle_ids = core::Image1i(viewport_height, viewport_width);
+        std::fill(std::begin(gbuffer.triangle_ids.data), std::end(gbuffer.triangle_ids.data), -1);
+    }
+    if (render_targets.mask)
+    {
+        gbuffer.mask = core::Image1u(viewport_height, viewport_width);
+    }
+
+    // Vertex normals in eye space (normals transform with the inverse transpose of the model-view matrix):
+    std::vector<glm::vec3> vertex_normals;
+    if (render_targets.normals)
+    {
+        const Eigen::Matrix3f normal_matrix =
+            detail::to_eigen(model_view_matrix).topLeftCorner<3, 3>().inverse().transpose();
+        vertex_normals.reserve(mesh.vertices.size());
+        for (const auto& n : compute_vertex_normals(mesh.vertices.as_matrix(), mesh.tvi()))
         {
-            cpp17::optional<detail::TriangleToRasterize> t = detail::process_prospective_tri(
-                clipspace_vertices[tri_indices[0]], clipspace_vertices[tri_indices[1]],
-                clipspace_vertices[tri_indices[2]], viewport_width, viewport_height, enable_backface_culling);
-            if (t)
+            Eigen::Vector3f n_eye = normal_matrix * n;
+            if (n_eye.norm() > 0.0f)
             {
-                triangles_to_raster.push_back(*t);
+                n_eye.normalize();
             }
-            continue;
-        }
-        // at this moment the triangle is known to be intersecting one of the view frustum's planes
-        std::vector<detail::Vertex<float>> vertices;
-        vertices.push_back(clipspace_vertices[tri_indices[0]]);
-        vertices.push_back(clipspace_vertices[tri_indices[1]]);
-        vertices.push_back(clipspace_vertices[tri_indices[2]]);
-        // split the triangle if it intersects the near plane:
-        if (enable_near_clipping)
-        {
-            vertices = detail::clip_polygon_to_plane_in_4d(
-                vertices, glm::tvec4<float>(0.0f, 0.0f, -1.0f, -1.0f)); // "Normal" (or "4D hyperplane") of
-                                                                        // the near-plane. I tested it and it
-                                                                        // works like this but I'm a little
-                                                                        // bit unsure because Songho says the
-                                                                        // normal of the near-plane is
-                                                                        // (0,0,-1,1) (maybe I have to switch
-                                                                        // around the < 0 checks in the
-                                                                        // function?)
+            vertex_normals.push_back(glm::vec3(n_eye[0], n_eye[1], n_eye[2]));
         }
+    }
 
-        // triangulation of the polygon formed of vertices array
-        if (vertices.size() >= 3)
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle_gbuffer(tri, gbuffer, texture, enable_far_clipping, mesh.tvi(),
+                                        vertex_normals);
+    }
+    return gbuffer;
+};
+
+/**
+ * Renders the given mesh like render(...), but only allocates the colour and depth buffer
+ * for the region of the viewport that the mesh covers.
+ *
+ * The region is the bounding box of all triangles that survive clipping and culling,
+ * enlarged by \p margin pixels on each side and clipped to the viewport. This is useful
+ * when the mesh covers only a small part of a large image (for example a face in a 4K
+ * video frame), as memory usage and buffer clearing cost then only depend on the size of
+ * the face, not on the size of the viewport.
+ *
+ * The returned buffers are exactly the ROI-part of the buffers that render(...) would
+ * produce, i.e. pixel (r, c) of the returned buffers corresponds to pixel
+ * (roi.y + r, roi.x + c) in the viewport. If no triangle is visible, the returned buffers
+ * and rectangle are empty.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] texture An optional texture map. If not given, vertex-colouring is used.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @param[in] margin Number of pixels to add around the bounding box of the mesh.
+ * @return A tuple with the colourbuffer, the depthbuffer, and the ROI of the viewport that they cover.
+ */
+inline std::tuple<core::Image4u, core::Image1d, Rect<int>>
+render_roi(const core::Mesh& mesh, glm::tmat4x4<float> model_view_matrix,
+           glm::tmat4x4<float> projection_matrix, int viewport_width, int viewport_height,
+           const cpp17::optional<Texture>& texture = cpp17::nullopt, bool enable_backface_culling = false,
+           bool enable_near_clipping = true, bool enable_far_clipping = true, int margin = 1)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(mesh.vertices.size() == mesh.texcoords().size() || mesh.texcoords().empty());
+
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster =
+        detail::setup_triangles(mesh, model_view_matrix, projection_matrix, viewport_width, viewport_height,
+                                enable_backface_culling, enable_near_clipping, enable_far_clipping);
+    const Rect<int> roi =
+        detail::calculate_triangles_roi(triangles_to_raster, margin, viewport_width, viewport_height);
+
+    core::Image4u colorbuffer(roi.height, roi.width); // initialised with zeros by the Image4u c'tor
+    core::Image1d depthbuffer(roi.height, roi.width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<double>::max());
+
+    for (const auto& tri : triangles_to_raster)
+    {
+        detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping, roi.x, roi.y);
+    }
+    return std::make_tuple(colorbuffer, depthbuffer, roi);
+};
+
+/**
+ * Renders several meshes into one colour and depth buffer, in a single depth-tested
+ * pass. This is useful to overlay the fitted meshes of all faces in an image, without
+ * rendering each face into its own full-size buffer and compositing them afterwards.
+ *
+ * Mesh i is rendered with model_view_matrices[i] and projection_matrices[i], and
+ * textured with textures[i] (or vertex-coloured, if no texture is given for it). The
+ * meshes are depth-tested against each other, which requires all projection matrices to
+ * map to a common depth range - which is the case if they share their near and far
+ * planes, as is usually the case for meshes fitted to the same image.
+ *
+ * The result is the same as rendering each mesh separately with render(...) and, for
+ * every pixel, keeping the colour of the mesh with the smallest depth.
+ *
+ * @param[in] meshes The 3D meshes to render.
+ * @param[in] model_view_matrices A 4x4 OpenGL model-view matrix for each mesh.
+ * @param[in] projection_matrices A 4x4 orthographic or perspective OpenGL projection matrix for each mesh.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] textures An optional texture map for each mesh. If empty, all meshes are vertex-coloured.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @return A pair with the colourbuffer as its first element and the depthbuffer as the second element.
+ * @throws std::runtime_error if the number of matrices or textures doesn't match the number of meshes.
+ */
+inline std::pair<core::Image4u, core::Image1d>
+render_many(const std::vector<core::Mesh>& meshes,
+            const std::vector<glm::tmat4x4<float>>& model_view_matrices,
+            const std::vector<glm::tmat4x4<float>>& projection_matrices, int viewport_width,
+            int viewport_height, const std::vector<cpp17::optional<Texture>>& textures = {},
+            bool enable_backface_culling = false, bool enable_near_clipping = true,
+            bool enable_far_clipping = true)
+{
+    if (model_view_matrices.size() != meshes.size() || projection_matrices.size() != meshes.size())
+    {
+        throw std::runtime_error("render_many: The number of model-view and projection matrices has to be "
+                                 "equal to the number of meshes.");
+    }
+    if (!textures.empty() && textures.size() != meshes.size())
+    {
+        throw std::runtime_error(
+            "render_many: The number of textures has to be zero or equal to the number of meshes.");
+    }
+
+    core::Image4u colorbuffer(viewport_height, viewport_width); // initialised with zeros by the Image4u c'tor
+    core::Image1d depthbuffer(viewport_height, viewport_width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<double>::max());
+
+    const cpp17::optional<Texture> no_texture;
+    // The triangles of each mesh are set up and rasterised right away, so we never hold more than one
+    // mesh's triangles in memory. The shared depth buffer resolves the visibility between meshes.
+    for (std::size_t i = 0; i < meshes.size(); ++i)
+    {
+        assert(meshes[i].vertices.size() == meshes[i].colors.size() || meshes[i].colors.empty());
+        assert(meshes[i].vertices.size() == meshes[i].texcoords().size() || meshes[i].texcoords().empty());
+        const std::vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles(
+            meshes[i], model_view_matrices[i], projection_matrices[i], viewport_width, viewport_height,
+            enable_backface_culling, enable_near_clipping, enable_far_clipping);
+        const cpp17::optional<Texture>& texture = textures.empty() ? no_texture : textures[i];
+        for (const auto& tri : triangles_to_raster)
         {
-            for (unsigned char k = 0; k < vertices.size() - 2; k++)
-            {
-                cpp17::optional<detail::TriangleToRasterize> t =
-                    detail::process_prospective_tri(vertices[0], vertices[1 + k], vertices[2 + k],
-                                                    viewport_width, viewport_height, enable_backface_culling);
-                if (t)
-                {
-                    triangles_to_raster.push_back(*t);
-                }
-            }
+            detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
         }
     }
+    return std::make_pair(colorbuffer, depthbuffer);
+};
 
-    // Fragment/pixel shader: Colour the pixel values
-    for (const auto& tri : triangles_to_raster)
+/**
+ * Renders several instances of the same mesh into one colour and depth buffer, in a
+ * single depth-tested pass. Instance i is rendered with model_view_matrices[i] and
+ * projection_matrices[i].
+ *
+ * See render_many(const std::vector<core::Mesh>&, ...) for details.
+ *
+ * @param[in] mesh The 3D mesh to render.
+ * @param[in] model_view_matrices A 4x4 OpenGL model-view matrix for each instance.
+ * @param[in] projection_matrices A 4x4 orthographic or perspective OpenGL projection matrix for each instance.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] texture An optional texture map that is used for all instances. If not given, vertex-colouring is used.
+ * @param[in] enable_backface_culling Whether the renderer should perform backface culling. If true, only draw triangles with vertices ordered CCW in screen-space.
+ * @param[in] enable_near_clipping Whether vertices should be clipped against the near plane.
+ * @param[in] enable_far_clipping Whether vertices should be clipped against the far plane.
+ * @return A pair with the colourbuffer as its first element and the depthbuffer as the second element.
+ * @throws std::runtime_error if the number of model-view and projection matrices differs.
+ */
+inline std::pair<core::Image4u, core::Image1d>
+render_many(const core::Mesh& mesh, const std::vector<glm::tmat4x4<float>>& model_view_matrices,
+            const std::vector<glm::tmat4x4<float>>& projection_matrices, int viewport_width,
+            int viewport_height, const cpp17::optional<Texture>& texture = cpp17::nullopt,
+            bool enable_backface_culling = false, bool enable_near_clipping = true,
+            bool enable_far_clipping = true)
+{
+    if (model_view_matrices.size() != projection_matrices.size())
     {
-        detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
+        throw std::runtime_error(
+            "render_many: The number of model-view and projection matrices has to be equal.");
+    }
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(mesh.vertices.size() == mesh.texcoords().size() || mesh.texcoords().empty());
+
+    core::Image4u colorbuffer(viewport_height, viewport_width); // initialised with zeros by the Image4u c'tor
+    core::Image1d depthbuffer(viewport_height, viewport_width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<double>::max());
+
+    for (std::size_t i = 0; i < model_view_matrices.size(); ++i)
+    {
+        const std::vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles(
+            mesh, model_view_matrices[i], projection_matrices[i], viewport_width, viewport_height,
+            enable_backface_culling, enable_near_clipping, enable_far_clipping);
+        for (const auto& tri : triangles_to_raster)
+        {
+            detail::raster_triangle(tri, colorbuffer, depthbuffer, texture, enable_far_clipping);
+        }
     }
     return std::make_pair(colorbuffer, depthbuffer);
 };
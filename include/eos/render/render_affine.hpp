@@ -26,6 +26,7 @@
 #include "eos/core/Mesh.hpp"
 #include "eos/render/Rect.hpp"
 #include "eos/render/detail/render_affine_detail.hpp"
+#include "eos/render/detail/render_depth_detail.hpp"
 #include "eos/render/detail/render_detail_utils.hpp"
 
 #include "glm/vec2.hpp"
@@ -34,7 +35,14 @@
 
 #include "Eigen/Core"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 namespace eos {
 namespace render {
@@ -83,76 +91,181 @@ inline std::pair<core::Image4u, core::Image1d> render_affine(const core::Mesh& m
     std::for_each(std::begin(depthbuffer.data), std::end(depthbuffer.data),
                   [](auto& element) { element = std::numeric_limits<double>::max(); });
 
-    const Eigen::Matrix<float, 4, 4> affine_with_z =
-        detail::calculate_affine_z_direction(affine_camera_matrix);
+    const vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles_affine(
+        mesh, affine_camera_matrix, viewport_width, viewport_height, do_backface_culling);
 
-    vector<detail::Vertex<float>> projected_vertices;
-    projected_vertices.reserve(mesh.vertices.size());
-    for (int i = 0; i < mesh.vertices.size(); ++i)
+    // Raster all triangles, i.e. colour the pixel values and write the z-buffer
+    for (auto&& triangle : triangles_to_raster)
     {
-        const Eigen::Vector4f vertex_screen_coords =
-            affine_with_z *
-            Eigen::Vector4f(mesh.vertices[i][0], mesh.vertices[i][1], mesh.vertices[i][2], 1.0f);
-        const glm::tvec4<float> vertex_screen_coords_glm(vertex_screen_coords(0), vertex_screen_coords(1),
-                                                         vertex_screen_coords(2), vertex_screen_coords(3));
-        glm::tvec3<float> vertex_colour;
-        if (mesh.colors.empty())
-        {
-            vertex_colour = glm::tvec3<float>(0.5f, 0.5f, 0.5f);
-        } else
-        {
-            vertex_colour = glm::tvec3<float>(mesh.colors[i][0], mesh.colors[i][1], mesh.colors[i][2]);
-        }
-        projected_vertices.push_back(
-            detail::Vertex<float>{vertex_screen_coords_glm, vertex_colour,
-                                  glm::tvec2<float>(mesh.texcoords[i][0], mesh.texcoords[i][1])});
+        detail::raster_triangle_affine(triangle, colourbuffer, depthbuffer);
     }
+    return std::make_pair(colourbuffer, depthbuffer);
+};
+
+/**
+ * Renders the mesh like render_affine(...), but into the given colour and depth buffer
+ * instead of newly allocated ones, e.g. to draw over an image. The buffers are cleared
+ * first, and their size is the size of the viewport. They can be core::Image4u and
+ * core::Image1d, or views of pixels that are stored elsewhere, e.g. in a cv::Mat (see
+ * core::from_mat_view(...)) or a numpy array.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in,out] colourbuffer The colour buffer to render into.
+ * @param[in,out] depthbuffer The depth buffer to render into. Must have the same size as \p colourbuffer.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ */
+inline void render_affine_into(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                               core::ImageView4u colourbuffer, core::ImageView1d depthbuffer,
+                               bool do_backface_culling = true)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+    assert(colourbuffer.rows == depthbuffer.rows && colourbuffer.cols == depthbuffer.cols);
+
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles_affine(
+        mesh, affine_camera_matrix, static_cast<int>(colourbuffer.cols), static_cast<int>(colourbuffer.rows),
+        do_backface_culling);
+
+    core::fill(colourbuffer, std::array<std::uint8_t, 4>{});
+    core::fill(depthbuffer, std::numeric_limits<double>::max());
 
-    // All vertices are screen-coordinates now
-    vector<detail::TriangleToRasterize> triangles_to_raster;
-    for (const auto& tri_indices : mesh.tvi)
+    for (const auto& triangle : triangles_to_raster)
     {
-        if (do_backface_culling)
-        {
-            if (!detail::are_vertices_ccw_in_screen_space(
-                    glm::tvec2<float>(projected_vertices[tri_indices[0]].position),
-                    glm::tvec2<float>(projected_vertices[tri_indices[1]].position),
-                    glm::tvec2<float>(projected_vertices[tri_indices[2]].position)))
-                continue; // don't render this triangle
-        }
-
-        // Get the bounding box of the triangle:
-        // take care: What do we do if all 3 vertices are not visible. Seems to work on a test case.
-        const Rect<int> bounding_box = detail::calculate_clipped_bounding_box(
-            glm::tvec2<float>(projected_vertices[tri_indices[0]].position),
-            glm::tvec2<float>(projected_vertices[tri_indices[1]].position),
-            glm::tvec2<float>(projected_vertices[tri_indices[2]].position), viewport_width, viewport_height);
-        const auto min_x = bounding_box.x;
-        const auto max_x = bounding_box.x + bounding_box.width;
-        const auto min_y = bounding_box.y;
-        const auto max_y = bounding_box.y + bounding_box.height;
-
-        if (max_x <= min_x || max_y <= min_y) // Note: Can the width/height of the bbox be negative? Maybe we only need to check for equality here?
-            continue;
-
-        detail::TriangleToRasterize t;
-        t.min_x = min_x;
-        t.max_x = max_x;
-        t.min_y = min_y;
-        t.max_y = max_y;
-        t.v0 = projected_vertices[tri_indices[0]];
-        t.v1 = projected_vertices[tri_indices[1]];
-        t.v2 = projected_vertices[tri_indices[2]];
-
-        triangles_to_raster.push_back(t);
+        detail::raster_triangle_affine(triangle, colourbuffer, depthbuffer);
     }
+};
+
+/**
+ * Renders the mesh like render_affine(...), but only allocates the colour and depth buffer
+ * for the region of the viewport that the mesh covers, i.e. the bounding box of all
+ * rendered triangles, enlarged by \p margin pixels on each side and clipped to the viewport.
+ *
+ * Pixel (r, c) of the returned buffers corresponds to pixel (roi.y + r, roi.x + c) in the
+ * viewport. If no triangle is visible, the returned buffers and rectangle are empty.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ * @param[in] margin Number of pixels to add around the bounding box of the mesh.
+ * @return A tuple with the colourbuffer, the depthbuffer, and the ROI of the viewport that they cover.
+ */
+inline std::tuple<core::Image4u, core::Image1d, Rect<int>>
+render_affine_roi(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                  int viewport_width, int viewport_height, bool do_backface_culling = true, int margin = 1)
+{
+    assert(mesh.vertices.size() == mesh.colors.size() || mesh.colors.empty());
+
+    const std::vector<detail::TriangleToRasterize> triangles_to_raster = detail::setup_triangles_affine(
+        mesh, affine_camera_matrix, viewport_width, viewport_height, do_backface_culling);
+    const Rect<int> roi =
+        detail::calculate_triangles_roi(triangles_to_raster, margin, viewport_width, viewport_height);
+
+    core::Image4u colourbuffer(roi.height, roi.width); // Note: auto-initialised to zeros.
+    core::Image1d depthbuffer(roi.height, roi.width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<double>::max());
 
-    // Raster all triangles, i.e. colour the pixel values and write the z-buffer
     for (auto&& triangle : triangles_to_raster)
     {
-        detail::raster_triangle_affine(triangle, colourbuffer, depthbuffer);
+        detail::raster_triangle_affine(triangle, colourbuffer, depthbuffer, roi.x, roi.y);
     }
-    return std::make_pair(colourbuffer, depthbuffer);
+    return std::make_tuple(colourbuffer, depthbuffer, roi);
+};
+
+/**
+ * Renders only the depth buffer of the mesh with the given affine camera matrix.
+ *
+ * This is much faster than render_affine(...) for callers that only need the depth, e.g.
+ * for a visibility test: No vertex attributes are set up or interpolated, and there is no
+ * colour buffer. Depth is stored as float. Pixels are covered by the same triangles as in
+ * render_affine(...), and their depth is the one of render_affine(...), rounded to float.
+ * Pixels that no triangle covers have a depth of std::numeric_limits<float>::max().
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ * @return The depthbuffer.
+ */
+inline core::Image1f render_affine_depth(const core::Mesh& mesh,
+                                         Eigen::Matrix<float, 3, 4> affine_camera_matrix, int viewport_width,
+                                         int viewport_height, bool do_backface_culling = true)
+{
+    const std::vector<detail::DepthTriangle> triangles_to_raster = detail::setup_depth_triangles_affine(
+        mesh, affine_camera_matrix, viewport_width, viewport_height, do_backface_culling);
+
+    core::Image1f depthbuffer(viewport_height, viewport_width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<float>::max());
+
+    for (const auto& triangle : triangles_to_raster)
+    {
+        // render_affine(...) doesn't clip against the far plane either:
+        detail::raster_triangle_depth(triangle, depthbuffer, false);
+    }
+    return depthbuffer;
+};
+
+/**
+ * Renders only the depth of the mesh like render_affine_depth(...), but into the given depth
+ * buffer instead of a newly allocated one. The buffer is cleared first, and its size is the
+ * size of the viewport. It can be a core::Image1f or a view, see render_affine_into(...).
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in,out] depthbuffer The depth buffer to render into.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ */
+inline void render_affine_depth_into(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                                     core::ImageView1f depthbuffer, bool do_backface_culling = true)
+{
+    const std::vector<detail::DepthTriangle> triangles_to_raster = detail::setup_depth_triangles_affine(
+        mesh, affine_camera_matrix, static_cast<int>(depthbuffer.cols), static_cast<int>(depthbuffer.rows),
+        do_backface_culling);
+
+    core::fill(depthbuffer, std::numeric_limits<float>::max());
+
+    for (const auto& triangle : triangles_to_raster)
+    {
+        // render_affine(...) doesn't clip against the far plane either:
+        detail::raster_triangle_depth(triangle, depthbuffer, false);
+    }
+};
+
+/**
+ * Renders only the depth buffer of the mesh like render_affine_depth(...), but only for the
+ * region of the viewport that the mesh covers, like render_affine_roi(...).
+ *
+ * Pixel (r, c) of the returned buffer corresponds to pixel (roi.y + r, roi.x + c) in the
+ * viewport. If no triangle is visible, the returned buffer and rectangle are empty.
+ *
+ * @param[in] mesh A 3D mesh.
+ * @param[in] affine_camera_matrix 3x4 affine camera matrix.
+ * @param[in] viewport_width Screen width.
+ * @param[in] viewport_height Screen height.
+ * @param[in] do_backface_culling Whether the renderer should perform backface culling.
+ * @param[in] margin Number of pixels to add around the bounding box of the mesh.
+ * @return A pair with the depthbuffer and the ROI of the viewport that it covers.
+ */
+inline std::pair<core::Image1f, Rect<int>>
+render_affine_depth_roi(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                        int viewport_width, int viewport_height, bool do_backface_culling = true,
+                        int margin = 1)
+{
+    const std::vector<detail::DepthTriangle> triangles_to_raster = detail::setup_depth_triangles_affine(
+        mesh, affine_camera_matrix, viewport_width, viewport_height, do_backface_culling);
+    const Rect<int> roi =
+        detail::calculate_triangles_roi(triangles_to_raster, margin, viewport_width, viewport_height);
+
+    core::Image1f depthbuffer(roi.height, roi.width);
+    std::fill(std::begin(depthbuffer.data), std::end(depthbuffer.data), std::numeric_limits<float>::max());
+
+    for (const auto& triangle : triangles_to_raster)
+    {
+        detail::raster_triangle_depth(triangle, depthbuffer, false, roi.x, roi.y);
+    }
+    return std::make_pair(depthbuffer, roi);
 };
 
 } /* namespace render */
@@ -25,6 +25,7 @@
 #include "eos/core/Image.hpp"
 #include "eos/core/Mesh.hpp"
 #include "eos/render/detail/texture_extraction_detail.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
 #include "eos/render/render_affine.hpp"
 //#include "eos/render/utils.hpp" // for clip_to_screen_space() in v2::
 //#include "eos/render/Rasterizer.hpp"
@@ -37,11 +38,14 @@
 #include "glm/vec4.hpp"
 
 #include "Eigen/Core"
-#include "Eigen/QR"
+#include "Eigen/LU"
 
 #include <tuple>
+#include <algorithm>
+#include <stdexcept>
 #include <cassert>
 #include <future>
+#include <thread>
 #include <vector>
 #include <array>
 #include <cstddef>
@@ -50,57 +54,6 @@
 namespace eos {
 namespace render {
 
-/* This function is copied from OpenCV,	originally under BSD licence.
- * imgwarp.cpp from OpenCV-3.2.0.
- *
- * Calculates coefficients of affine transformation
- * which maps (xi,yi) to (ui,vi), (i=1,2,3):
- *
- * ui = c00*xi + c01*yi + c02
- *
- * vi = c10*xi + c11*yi + c12
- *
- * Coefficients are calculated by solving linear system:
- * / x0 y0  1  0  0  0 \ /c00\ /u0\
- * | x1 y1  1  0  0  0 | |c01| |u1|
- * | x2 y2  1  0  0  0 | |c02| |u2|
- * |  0  0  0 x0 y0  1 | |c10| |v0|
- * |  0  0  0 x1 y1  1 | |c11| |v1|
- * \  0  0  0 x2 y2  1 / |c12| |v2|
- *
- * where:
- *   cij - matrix coefficients
- */
-// Note: The original functions used doubles.
-inline Eigen::Matrix<float, 2, 3> get_affine_transform(const std::array<Eigen::Vector2f, 3>& src,
-                                                const std::array<Eigen::Vector2f, 3>& dst)
-{
-    using Eigen::Matrix;
-    assert(src.size() == dst.size() && src.size() == 3);
-
-    Matrix<float, 6, 6> A;
-    Matrix<float, 6, 1> b;
-
-    for (int i = 0; i < 3; i++)
-    {
-        A.block<1, 2>(2 * i, 0) = src[i];       // the odd rows
-        A.block<1, 2>((2 * i) + 1, 3) = src[i]; // even rows
-        A(2 * i, 2) = 1.0f;
-        A((2 * i) + 1, 5) = 1.0f;
-        A.block<1, 3>(2 * i, 3).setZero();
-        A.block<1, 3>((2 * i) + 1, 0).setZero();
-        b.segment<2>(2 * i) = dst[i];
-    }
-
-    Matrix<float, 6, 1> X = A.colPivHouseholderQr().solve(b);
-
-    Matrix<float, 2, 3> transform_matrix;
-    transform_matrix.block<1, 3>(0, 0) = X.segment<3>(0);
-    transform_matrix.block<1, 3>(1, 0) = X.segment<3>(3);
-
-    return transform_matrix;
-};
-
 /**
  * The interpolation types that can be used to map the
  * texture from the original image to the isomap.
@@ -113,10 +66,12 @@ enum class TextureInterpolation
 };
 
 // Forward declarations:
+template <typename DepthType>
 core::Image4u extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
-                              const core::Image3u& image, const core::Image1d& depthbuffer,
-                              bool compute_view_angle, TextureInterpolation mapping_type,
-                              int isomap_resolution);
+                              core::ConstImageView3u image, const core::Image<DepthType, 1>& depthbuffer,
+                              const Rect<int>& depthbuffer_roi, bool compute_view_angle = false,
+                              TextureInterpolation mapping_type = TextureInterpolation::NearestNeighbour,
+                              int isomap_resolution = 512);
 namespace detail {
 core::Image4u interpolate_black_line(core::Image4u& isomap);
 }
@@ -125,19 +80,24 @@ core::Image4u interpolate_black_line(core::Image4u& isomap);
  * Extracts the texture of the face from the given image
  * and stores it as isomap (a rectangular texture map).
  *
- * Note/Todo: Only use TextureInterpolation::NearestNeighbour
- * for the moment, the other methods don't have correct handling of
- * the alpha channel (and will most likely throw an exception).
+ * TextureInterpolation::Bilinear interpolates between the four nearest
+ * pixels of the image, and TextureInterpolation::Area averages the pixels
+ * that each isomap pixel covers in the image, which avoids aliasing if the
+ * face is larger in the image than in the isomap.
+ *
+ * The visibility is tested for every isomap pixel against the depth buffer of
+ * the mesh, so parts of triangles that are occluded, e.g. by the nose at
+ * profile poses, are left empty, while their visible parts are extracted.
  *
  * Todo: These should be renamed to extract_texture_affine? Can we combine both cases somehow?
  * Or an overload with RenderingParameters?
  *
- * For TextureInterpolation::NearestNeighbour, returns a 4-channel isomap
- * with the visibility in the 4th channel (0=invis, 255=visible).
+ * Returns a 4-channel isomap with the visibility in the 4th channel
+ * (0=invis, 255=visible).
  *
  * @param[in] mesh A mesh with texture coordinates.
  * @param[in] affine_camera_matrix An estimated 3x4 affine camera matrix.
- * @param[in] image The image to extract the texture from. Should be 8UC3, other types not supported yet.
+ * @param[in] image The image to extract the texture from. A core::Image3u, or a view of an image that is stored elsewhere, e.g. in a cv::Mat (see core::from_mat_view(...)), which isn't copied.
  * @param[in] compute_view_angle A flag whether the view angle of each vertex should be computed and returned. If set to true, the angle will be encoded into the alpha channel (0 meaning occluded or facing away 90, 127 meaning facing a 45 angle and 255 meaning front-facing, and all values in between). If set to false, the alpha channel will only contain 0 for occluded vertices and 255 for visible vertices.
  * @param[in] mapping_type The interpolation type to be used for the extraction.
  * @param[in] isomap_resolution The resolution of the generated isomap. Defaults to 512x512.
@@ -145,20 +105,21 @@ core::Image4u interpolate_black_line(core::Image4u& isomap);
  */
 inline core::Image4u
 extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
-                const core::Image3u& image, bool compute_view_angle = false,
+                core::ConstImageView3u image, bool compute_view_angle = false,
                 TextureInterpolation mapping_type = TextureInterpolation::NearestNeighbour,
                 int isomap_resolution = 512)
 {
-    // Render the model to get a depth buffer:
-    core::Image1d depthbuffer;
-    std::tie(std::ignore, depthbuffer) =
-        render::render_affine(mesh, affine_camera_matrix, image.cols, image.rows);
-    // Note: There's potential for optimisation here - we don't need to do everything that is done in
-    // render_affine to just get the depthbuffer.
+    // Render the depth buffer of the model. It only needs to cover the region of the image that the
+    // mesh projects to, so we don't allocate and clear a buffer of the size of the whole image, and we
+    // don't need a colour buffer either:
+    core::Image1f depthbuffer;
+    Rect<int> depthbuffer_roi;
+    std::tie(depthbuffer, depthbuffer_roi) =
+        render::render_affine_depth_roi(mesh, affine_camera_matrix, image.cols, image.rows);
 
     // Now forward the call to the actual texture extraction function:
-    return extract_texture(mesh, affine_camera_matrix, image, depthbuffer, compute_view_angle, mapping_type,
-                           isomap_resolution);
+    return extract_texture(mesh, affine_camera_matrix, image, depthbuffer, depthbuffer_roi,
+                           compute_view_angle, mapping_type, isomap_resolution);
 };
 
 /**
@@ -175,19 +136,53 @@ extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera
  * @param[in] mesh A mesh with texture coordinates.
  * @param[in] affine_camera_matrix An estimated 3x4 affine camera matrix.
  * @param[in] image The image to extract the texture from.
- * @param[in] depthbuffer A pre-calculated depthbuffer image.
+ * @param[in] depthbuffer A pre-calculated depthbuffer image, e.g. from render_affine(...) or render_affine_depth(...).
  * @param[in] compute_view_angle A flag whether the view angle of each vertex should be computed and returned. If set to true, the angle will be encoded into the alpha channel (0 meaning occluded or facing away 90, 127 meaning facing a 45 angle and 255 meaning front-facing, and all values in between). If set to false, the alpha channel will only contain 0 for occluded vertices and 255 for visible vertices.
  * @param[in] mapping_type The interpolation type to be used for the extraction.
  * @param[in] isomap_resolution The resolution of the generated isomap. Defaults to 512x512.
  * @return The extracted texture as isomap (texture map).
  */
-inline core::Image4u
+template <typename DepthType>
+core::Image4u
 extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
-                const core::Image3u& image, const core::Image1d& depthbuffer, bool compute_view_angle = false,
+                core::ConstImageView3u image, const core::Image<DepthType, 1>& depthbuffer,
+                bool compute_view_angle = false,
                 TextureInterpolation mapping_type = TextureInterpolation::NearestNeighbour,
                 int isomap_resolution = 512)
 {
-    assert(mesh.vertices.size() == mesh.texcoords.size());
+    const Rect<int> depthbuffer_roi{0, 0, static_cast<int>(depthbuffer.cols),
+                                    static_cast<int>(depthbuffer.rows)};
+    return extract_texture(mesh, affine_camera_matrix, image, depthbuffer, depthbuffer_roi,
+                           compute_view_angle, mapping_type, isomap_resolution);
+};
+
+/**
+ * Extracts the texture of the face from the given image
+ * and stores it as isomap (a rectangular texture map).
+ * This function can be used if a depth buffer has already been computed
+ * that only covers a region of the image, for example with render_affine_depth_roi(...).
+ *
+ * Pixel (r, c) of the depthbuffer corresponds to pixel
+ * (depthbuffer_roi.y + r, depthbuffer_roi.x + c) of the image. The region must
+ * contain all pixels that the mesh is rendered to.
+ *
+ * @param[in] mesh A mesh with texture coordinates.
+ * @param[in] affine_camera_matrix An estimated 3x4 affine camera matrix.
+ * @param[in] image The image to extract the texture from.
+ * @param[in] depthbuffer A pre-calculated depthbuffer image, covering \p depthbuffer_roi of the image.
+ * @param[in] depthbuffer_roi The region of the image that the depthbuffer covers.
+ * @param[in] compute_view_angle A flag whether the view angle of each vertex should be computed and returned. See the other overloads.
+ * @param[in] mapping_type The interpolation type to be used for the extraction.
+ * @param[in] isomap_resolution The resolution of the generated isomap. Defaults to 512x512.
+ * @return The extracted texture as isomap (texture map).
+ */
+template <typename DepthType>
+core::Image4u extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                              core::ConstImageView3u image, const core::Image<DepthType, 1>& depthbuffer,
+                              const Rect<int>& depthbuffer_roi, bool compute_view_angle,
+                              TextureInterpolation mapping_type, int isomap_resolution)
+{
+    assert(mesh.vertices.size() == mesh.texcoords().size());
 
     using Eigen::Vector2f;
     using Eigen::Vector3f;
@@ -196,318 +191,268 @@ extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera
     using std::floor;
     using std::max;
     using std::min;
-    using std::pow;
     using std::round;
-    using std::sqrt;
 
     Eigen::Matrix<float, 4, 4> affine_camera_matrix_with_z =
         detail::calculate_affine_z_direction(affine_camera_matrix);
+    // Project all vertices to screen coordinates once, instead of (twice) per triangle:
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> vertices_screen_coords =
+        detail::transform_vertices(mesh.vertices.as_matrix(), affine_camera_matrix_with_z);
 
     // Todo: We should handle gray images, but output a 4-channel isomap nevertheless I think.
     core::Image4u isomap(isomap_resolution, isomap_resolution); // We should initialise with zeros.
                                                                 // Incidentially, the current Image4u c'tor
                                                                 // does that.
 
-    std::vector<std::future<void>> results;
-    for (const auto& triangle_indices : mesh.tvi)
-    {
+    // The area mapping averages the image over the footprint of each isomap pixel, in constant time per
+    // pixel with a summed-area table of the image:
+    const detail::SummedAreaTable summed_area_table = mapping_type == TextureInterpolation::Area
+                                                          ? detail::create_summed_area_table(image)
+                                                          : detail::SummedAreaTable();
+
+    // Extracts the part of a triangle that lies in the rows [row_begin, row_end) of the isomap:
+    const auto extract_triangle = [&mesh, &affine_camera_matrix_with_z, &vertices_screen_coords, &depthbuffer,
+                                   &depthbuffer_roi, &isomap, &mapping_type, &image, &compute_view_angle,
+                                   &summed_area_table](const std::array<int, 3>& triangle_indices,
+                                                       int row_begin, int row_end) {
+        std::array<Vector2f, 3> dst_tri;
+        dst_tri[0] = Vector2f((isomap.cols - 0.5) * mesh.texcoords()[triangle_indices[0]][0],
+                              (isomap.rows - 0.5) * mesh.texcoords()[triangle_indices[0]][1]);
+        dst_tri[1] = Vector2f((isomap.cols - 0.5) * mesh.texcoords()[triangle_indices[1]][0],
+                              (isomap.rows - 0.5) * mesh.texcoords()[triangle_indices[1]][1]);
+        dst_tri[2] = Vector2f((isomap.cols - 0.5) * mesh.texcoords()[triangle_indices[2]][0],
+                              (isomap.rows - 0.5) * mesh.texcoords()[triangle_indices[2]][1]);
+
+        // The bounding box of the triangle in the isomap, limited to the rows that this call extracts:
+        const Vector2f dst_min = dst_tri[0].cwiseMin(dst_tri[1]).cwiseMin(dst_tri[2]);
+        const Vector2f dst_max = dst_tri[0].cwiseMax(dst_tri[1]).cwiseMax(dst_tri[2]);
+        const int min_x = max(0, static_cast<int>(dst_min[0]));
+        const int max_x = min(static_cast<int>(isomap.cols), static_cast<int>(ceil(dst_max[0])));
+        const int min_y = max(row_begin, static_cast<int>(dst_min[1]));
+        const int max_y = min(row_end, static_cast<int>(ceil(dst_max[1])));
+        if (min_y >= max_y)
+        {
+            return;
+        }
 
-        // Note: If there's a performance problem, there's no need to capture the whole mesh - we could
-        // capture only the three required vertices with their texcoords.
-        auto extract_triangle = [&mesh, &affine_camera_matrix_with_z, &triangle_indices, &depthbuffer,
-                                 &isomap, &mapping_type, &image, &compute_view_angle]() {
-
-            // Find out if the current triangle is visible:
-            // We do a second rendering-pass here. We use the depth-buffer of the final image, and then, here,
-            // check if each pixel in a triangle is visible. If the whole triangle is visible, we use it to
-            // extract the texture.
-            // Possible improvement: - If only part of the triangle is visible, split it
-
-            // This could be optimized in 2 ways though:
-            // - Use render(), or as in render(...), transfer the vertices once, not in a loop over all
-            //   triangles (vertices are getting transformed multiple times)
-            // - We transform them later (below) a second time. Only do it once.
-
-            const Vector4f v0_as_Vector4f(mesh.vertices[triangle_indices[0]][0],
-                                          mesh.vertices[triangle_indices[0]][1],
-                                          mesh.vertices[triangle_indices[0]][2], 1.0f);
-            const Vector4f v1_as_Vector4f(mesh.vertices[triangle_indices[1]][0],
-                                          mesh.vertices[triangle_indices[1]][1],
-                                          mesh.vertices[triangle_indices[1]][2], 1.0f);
-            const Vector4f v2_as_Vector4f(mesh.vertices[triangle_indices[2]][0],
-                                          mesh.vertices[triangle_indices[2]][1],
-                                          mesh.vertices[triangle_indices[2]][2], 1.0f);
-
-            // Project the triangle vertices to screen coordinates, and use the depthbuffer to check whether
-            // the triangle is visible:
-            const Vector4f v0 = affine_camera_matrix_with_z * v0_as_Vector4f;
-            const Vector4f v1 = affine_camera_matrix_with_z * v1_as_Vector4f;
-            const Vector4f v2 = affine_camera_matrix_with_z * v2_as_Vector4f;
-
-            if (!detail::is_triangle_visible(glm::tvec4<float>(v0[0], v0[1], v0[2], v0[3]),
-                                             glm::tvec4<float>(v1[0], v1[1], v1[2], v1[3]),
-                                             glm::tvec4<float>(v2[0], v2[1], v2[2], v2[3]), depthbuffer))
-            {
-                // continue;
-                return;
-            }
+        // The visibility is tested for every isomap pixel further below, against the depth-buffer of the
+        // final image, so triangles that are only partly occluded still contribute their visible part.
+
+        // The vertices are transformed to screen coordinates only once, before the loop over all
+        // triangles.
+
+        const Vector4f v0_as_Vector4f(mesh.vertices[triangle_indices[0]][0],
+                                      mesh.vertices[triangle_indices[0]][1],
+                                      mesh.vertices[triangle_indices[0]][2], 1.0f);
+        const Vector4f v1_as_Vector4f(mesh.vertices[triangle_indices[1]][0],
+                                      mesh.vertices[triangle_indices[1]][1],
+                                      mesh.vertices[triangle_indices[1]][2], 1.0f);
+        const Vector4f v2_as_Vector4f(mesh.vertices[triangle_indices[2]][0],
+                                      mesh.vertices[triangle_indices[2]][1],
+                                      mesh.vertices[triangle_indices[2]][2], 1.0f);
+
+        // Get the triangle vertices in screen coordinates, and skip triangles that face away from the
+        // camera:
+        const Vector4f v0 = vertices_screen_coords.col(triangle_indices[0]);
+        const Vector4f v1 = vertices_screen_coords.col(triangle_indices[1]);
+        const Vector4f v2 = vertices_screen_coords.col(triangle_indices[2]);
+        if (!detail::are_vertices_ccw_in_screen_space(glm::tvec2<float>(v0[0], v0[1]),
+                                                      glm::tvec2<float>(v1[0], v1[1]),
+                                                      glm::tvec2<float>(v2[0], v2[1])))
+        {
+            return;
+        }
 
-            float alpha_value;
-            if (compute_view_angle)
+        float alpha_value;
+        if (compute_view_angle)
+        {
+            // Calculate how well visible the current triangle is:
+            // (in essence, the dot product of the viewing direction (0, 0, 1) and the face normal)
+            const Vector3f face_normal =
+                compute_face_normal(v0_as_Vector4f, v1_as_Vector4f, v2_as_Vector4f);
+            // Transform the normal to "screen" (kind of "eye") space using the upper 3x3 part of the
+            // affine camera matrix (=the translation can be ignored):
+            Vector3f face_normal_transformed =
+                affine_camera_matrix_with_z.block<3, 3>(0, 0) * face_normal;
+            face_normal_transformed.normalize(); // normalise to unit length
+            // Implementation notes regarding the affine camera matrix and the sign:
+            // If the matrix given were the model_view matrix, the sign would be correct.
+            // However, affine_camera_matrix includes glm::ortho, which includes a z-flip.
+            // So we need to flip one of the two signs.
+            // * viewing_direction(0.0f, 0.0f, 1.0f) is correct if affine_camera_matrix were only a model_view matrix
+            // * affine_camera_matrix includes glm::ortho, which flips z, so we flip the sign of viewing_direction.
+            // We don't need the dot product since viewing_direction.xy are 0 and .z is 1:
+            const float angle = -face_normal_transformed[2]; // flip sign, see above
+            assert(angle >= -1.f && angle <= 1.f);
+            // angle is [-1, 1].
+            //  * +1 means   0 (same direction)
+            //  *  0 means  90
+            //  * -1 means 180 (facing opposite directions)
+            // It's a linear relation, so +0.5 is 45 etc.
+            // An angle larger than 90 means the vertex won't be rendered anyway (because it's
+            // back-facing) so we encode 0 to 90.
+            if (angle < 0.0f)
             {
-                // Calculate how well visible the current triangle is:
-                // (in essence, the dot product of the viewing direction (0, 0, 1) and the face normal)
-                const Vector3f face_normal =
-                    compute_face_normal(v0_as_Vector4f, v1_as_Vector4f, v2_as_Vector4f);
-                // Transform the normal to "screen" (kind of "eye") space using the upper 3x3 part of the
-                // affine camera matrix (=the translation can be ignored):
-                Vector3f face_normal_transformed =
-                    affine_camera_matrix_with_z.block<3, 3>(0, 0) * face_normal;
-                face_normal_transformed.normalize(); // normalise to unit length
-                // Implementation notes regarding the affine camera matrix and the sign:
-                // If the matrix given were the model_view matrix, the sign would be correct.
-                // However, affine_camera_matrix includes glm::ortho, which includes a z-flip.
-                // So we need to flip one of the two signs.
-                // * viewing_direction(0.0f, 0.0f, 1.0f) is correct if affine_camera_matrix were only a model_view matrix
-                // * affine_camera_matrix includes glm::ortho, which flips z, so we flip the sign of viewing_direction.
-                // We don't need the dot product since viewing_direction.xy are 0 and .z is 1:
-                const float angle = -face_normal_transformed[2]; // flip sign, see above
-                assert(angle >= -1.f && angle <= 1.f);
-                // angle is [-1, 1].
-                //  * +1 means   0 (same direction)
-                //  *  0 means  90
-                //  * -1 means 180 (facing opposite directions)
-                // It's a linear relation, so +0.5 is 45 etc.
-                // An angle larger than 90 means the vertex won't be rendered anyway (because it's
-                // back-facing) so we encode 0 to 90.
-                if (angle < 0.0f)
-                {
-                    alpha_value = 0.0f;
-                } else
-                {
-                    alpha_value = angle * 255.0f;
-                }
+                alpha_value = 0.0f;
             } else
             {
-                // no visibility angle computation - if the triangle/pixel is visible, set the alpha chan to
-                // 255 (fully visible pixel).
-                alpha_value = 255.0f;
+                alpha_value = angle * 255.0f;
             }
+        } else
+        {
+            // no visibility angle computation - if the triangle/pixel is visible, set the alpha chan to
+            // 255 (fully visible pixel).
+            alpha_value = 255.0f;
+        }
 
-            // Todo: Documentation
-            std::array<Vector2f, 3> src_tri;
-            std::array<Vector2f, 3> dst_tri;
-
-            Vector4f vec(mesh.vertices[triangle_indices[0]][0], mesh.vertices[triangle_indices[0]][1],
-                         mesh.vertices[triangle_indices[0]][2], 1.0f);
-            Vector4f res = affine_camera_matrix_with_z * vec;
-            src_tri[0] = Vector2f(res[0], res[1]);
-
-            vec = Vector4f(mesh.vertices[triangle_indices[1]][0], mesh.vertices[triangle_indices[1]][1],
-                           mesh.vertices[triangle_indices[1]][2], 1.0f);
-            res = affine_camera_matrix_with_z * vec;
-            src_tri[1] = Vector2f(res[0], res[1]);
-
-            vec = Vector4f(mesh.vertices[triangle_indices[2]][0], mesh.vertices[triangle_indices[2]][1],
-                           mesh.vertices[triangle_indices[2]][2], 1.0f);
-            res = affine_camera_matrix_with_z * vec;
-            src_tri[2] = Vector2f(res[0], res[1]);
-
-            dst_tri[0] = Vector2f((isomap.cols - 0.5) * mesh.texcoords[triangle_indices[0]][0],
-                                  (isomap.rows - 0.5) * mesh.texcoords[triangle_indices[0]][1]);
-            dst_tri[1] = Vector2f((isomap.cols - 0.5) * mesh.texcoords[triangle_indices[1]][0],
-                                  (isomap.rows - 0.5) * mesh.texcoords[triangle_indices[1]][1]);
-            dst_tri[2] = Vector2f((isomap.cols - 0.5) * mesh.texcoords[triangle_indices[2]][0],
-                                  (isomap.rows - 0.5) * mesh.texcoords[triangle_indices[2]][1]);
-
-            // We now have the source triangles in the image and the source triangle in the isomap
-            // We use the inverse/ backward mapping approach, so we want to find the corresponding texel
-            // (texture-pixel) for each pixel in the isomap
-
-            // Get the inverse Affine Transform from original image: from dst (pixel in isomap) to src (in
-            // image)
-            Eigen::Matrix<float, 2, 3> warp_mat_org_inv = get_affine_transform(dst_tri, src_tri);
-
-            // We now loop over all pixels in the triangle and select, depending on the mapping type, the
-            // corresponding texel(s) in the source image
-            for (int x = min(dst_tri[0][0], min(dst_tri[1][0], dst_tri[2][0]));
-                 x < max(dst_tri[0][0], max(dst_tri[1][0], dst_tri[2][0])); ++x)
+        // We now have the source triangle in the image and the destination triangle in the isomap.
+        // We use the inverse/ backward mapping approach, so we want to find the corresponding position
+        // in the image for each pixel in the isomap: The offset of an isomap pixel from the first vertex
+        // gives its barycentric coordinates (in the edge basis of the triangle), and these give its
+        // position and depth in the image, so the mapping is set up only once per triangle.
+        Eigen::Matrix2f dst_edges;
+        dst_edges << dst_tri[1] - dst_tri[0], dst_tri[2] - dst_tri[0];
+        if (dst_edges.determinant() == 0.0f)
+        {
+            return; // The triangle doesn't cover any area in the isomap.
+        }
+        const Eigen::Matrix2f dst_to_barycentric = dst_edges.inverse();
+        Eigen::Matrix<float, 3, 2> src_edges;
+        src_edges << (v1 - v0).head<3>(), (v2 - v0).head<3>();
+        // The inverse affine transform from the isomap to the original image (without the depth), for the
+        // footprint of an isomap pixel:
+        const Eigen::Matrix2f warp_mat_org_inv = src_edges.topRows<2>() * dst_to_barycentric;
+
+        // The depth-buffer was rendered with the same triangles, but a point in the triangle is compared
+        // against the depth at the centre of its pixel, which may lie on a neighbouring triangle. So we
+        // allow the depth to differ by as much as the triangle's depth changes across one pixel, plus a
+        // bit for rounding:
+        const float screen_area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+        const float depth_change_x =
+            ((v1[2] - v0[2]) * (v2[1] - v0[1]) - (v2[2] - v0[2]) * (v1[1] - v0[1])) / screen_area;
+        const float depth_change_y =
+            ((v2[2] - v0[2]) * (v1[0] - v0[0]) - (v1[2] - v0[2]) * (v2[0] - v0[0])) / screen_area;
+        const float depth_tolerance =
+            std::abs(depth_change_x) + std::abs(depth_change_y) +
+            1e-4f * max(std::abs(v0[2]), max(std::abs(v1[2]), std::abs(v2[2])));
+        // The depthbuffer may only cover a region of the image, so shift the points into its coordinate
+        // system for the depth test:
+        const float roi_x = static_cast<float>(depthbuffer_roi.x);
+        const float roi_y = static_cast<float>(depthbuffer_roi.y);
+
+        // The mapping is affine, so every isomap pixel covers a parallelogram of the same size in the
+        // image. These are the half extents of its bounding box, for the area mapping:
+        const float footprint_half_width =
+            0.5f * (std::abs(warp_mat_org_inv(0, 0)) + std::abs(warp_mat_org_inv(0, 1)));
+        const float footprint_half_height =
+            0.5f * (std::abs(warp_mat_org_inv(1, 0)) + std::abs(warp_mat_org_inv(1, 1)));
+        // Whether a position in the image lies on a pixel, where the centre of pixel (r, c) is at (c, r):
+        const auto is_inside_image = [&image](const Vector2f& position) {
+            return position[0] >= -0.5f && position[0] < image.cols - 0.5f && position[1] >= -0.5f &&
+                   position[1] < image.rows - 0.5f;
+        };
+
+        // We now loop over all pixels in the triangle (in this task's rows) and select, depending on the
+        // mapping type, the corresponding texel(s) in the source image
+        for (int y = min_y; y < max_y; ++y)
+        {
+            for (int x = min_x; x < max_x; ++x)
             {
-                for (int y = min(dst_tri[0][1], min(dst_tri[1][1], dst_tri[2][1]));
-                     y < max(dst_tri[0][1], max(dst_tri[1][1], dst_tri[2][1])); ++y)
+                const Vector2f barycentric =
+                    dst_to_barycentric * Vector2f(x - dst_tri[0][0], y - dst_tri[0][1]);
+                // Pixels on an edge belong to both triangles. The small tolerance makes sure that
+                // rounding errors don't exclude them from both. Both triangles are extracted by the same
+                // task, so the later one wins, like in a sequential extraction:
+                if (barycentric[0] >= -1e-5f && barycentric[1] >= -1e-5f &&
+                    barycentric[0] + barycentric[1] <= 1.0f + 1e-5f)
                 {
-                    if (detail::is_point_in_triangle(Vector2f(x, y), dst_tri[0], dst_tri[1], dst_tri[2]))
+                    // Position and depth of the isomap pixel centre in the image (src):
+                    const Vector3f src_point = v0.head<3>() + src_edges * barycentric;
+                    const Vector2f src_texel = src_point.head<2>();
+                    if (!detail::is_point_visible(src_texel[0] - roi_x, src_texel[1] - roi_y,
+                                                  src_point[2], depth_tolerance, depthbuffer))
                     {
+                        continue;
+                    }
 
-                        // As the coordinates of the transformed pixel in the image will most likely not lie
-                        // on a texel, we have to choose how to calculate the pixel colors depending on the
-                        // next texels
+                    // As the coordinates of the transformed pixel in the image will most likely not lie
+                    // on a texel, we have to choose how to calculate the pixel colors depending on the
+                    // next texels
 
-                        // There are three different texture interpolation methods: area, bilinear and nearest
-                        // neighbour
+                    // There are three different texture interpolation methods: area, bilinear and nearest
+                    // neighbour
 
-                        // Area mapping: calculate mean color of texels in transformed pixel area
-                        if (mapping_type == TextureInterpolation::Area)
+                    // Area mapping: calculate mean color of texels in transformed pixel area
+                    if (mapping_type == TextureInterpolation::Area)
+                    {
+                        // The texels in the bounding box of the pixel's footprint in the image are
+                        // averaged in constant time with the summed-area table. If the footprint
+                        // doesn't contain any texel centre, we're magnifying, and interpolate instead.
+                        const int min_a = static_cast<int>(ceil(src_texel[0] - footprint_half_width));
+                        const int max_a = static_cast<int>(floor(src_texel[0] + footprint_half_width));
+                        const int min_b = static_cast<int>(ceil(src_texel[1] - footprint_half_height));
+                        const int max_b = static_cast<int>(floor(src_texel[1] + footprint_half_height));
+                        cpp17::optional<std::array<std::uint8_t, 3>> color;
+                        if (min_a <= max_a && min_b <= max_b)
                         {
-
-                            // calculate positions of 4 corners of pixel in image (src)
-                            const Vector3f homogenous_dst_upper_left(x - 0.5f, y - 0.5f, 1.0f);
-                            const Vector3f homogenous_dst_upper_right(x + 0.5f, y - 0.5f, 1.0f);
-                            const Vector3f homogenous_dst_lower_left(x - 0.5f, y + 0.5f, 1.0f);
-                            const Vector3f homogenous_dst_lower_right(x + 0.5f, y + 0.5f, 1.0f);
-
-                            const Vector2f src_texel_upper_left =
-                                warp_mat_org_inv * homogenous_dst_upper_left;
-                            const Vector2f src_texel_upper_right =
-                                warp_mat_org_inv * homogenous_dst_upper_right;
-                            const Vector2f src_texel_lower_left =
-                                warp_mat_org_inv * homogenous_dst_lower_left;
-                            const Vector2f src_texel_lower_right =
-                                warp_mat_org_inv * homogenous_dst_lower_right;
-
-                            const float min_a = min(min(src_texel_upper_left[0], src_texel_upper_right[0]),
-                                                    min(src_texel_lower_left[0], src_texel_lower_right[0]));
-                            const float max_a = max(max(src_texel_upper_left[0], src_texel_upper_right[0]),
-                                                    max(src_texel_lower_left[0], src_texel_lower_right[0]));
-                            const float min_b = min(min(src_texel_upper_left[1], src_texel_upper_right[1]),
-                                                    min(src_texel_lower_left[1], src_texel_lower_right[1]));
-                            const float max_b = max(max(src_texel_upper_left[1], src_texel_upper_right[1]),
-                                                    max(src_texel_lower_left[1], src_texel_lower_right[1]));
-
-                            Eigen::Vector3i color; // std::uint8_t actually.
-                            int num_texels = 0;
-
-                            // loop over square in which quadrangle out of the four corners of pixel is
-                            for (int a = ceil(min_a); a <= floor(max_a); ++a)
-                            {
-                                for (int b = ceil(min_b); b <= floor(max_b); ++b)
-                                {
-                                    // check if texel is in quadrangle
-                                    if (detail::is_point_in_triangle(Vector2f(a, b), src_texel_upper_left,
-                                                                     src_texel_lower_left,
-                                                                     src_texel_upper_right) ||
-                                        detail::is_point_in_triangle(Vector2f(a, b), src_texel_lower_left,
-                                                                     src_texel_upper_right,
-                                                                     src_texel_lower_right))
-                                    {
-                                        if (a < image.cols && b < image.rows)
-                                        { // check if texel is in image
-                                            num_texels++;
-                                            color += Eigen::Vector3i(image(b, a)[0], image(b, a)[1],
-                                                                     image(b, a)[2]);
-                                        }
-                                    }
-                                }
-                            }
-                            if (num_texels > 0)
-                                color = color / num_texels;
-                            else
-                            { // if no corresponding texel found, nearest neighbour interpolation
-                                // calculate corresponding position of dst_coord pixel center in image (src)
-                                Vector3f homogenous_dst_coord(x, y, 1.0f);
-                                Vector2f src_texel = warp_mat_org_inv * homogenous_dst_coord;
-
-                                if ((round(src_texel[1]) < image.rows) && round(src_texel[0]) < image.cols)
-                                {
-                                    const int y = round(src_texel[1]);
-                                    const int x = round(src_texel[0]);
-                                    color = Eigen::Vector3i(image(y, x)[0], image(y, x)[1], image(y, x)[2]);
-                                }
-                            }
-                            isomap(y, x) = {
-                                static_cast<std::uint8_t>(color[0]), static_cast<std::uint8_t>(color[1]),
-                                static_cast<std::uint8_t>(color[2]), static_cast<std::uint8_t>(alpha_value)};
+                            color = detail::box_filter(summed_area_table, min_a, min_b, max_a, max_b);
+                        } else if (is_inside_image(src_texel))
+                        {
+                            color = detail::sample_bilinear(image, src_texel[0], src_texel[1]);
                         }
-                        // Bilinear mapping: calculate pixel color depending on the four neighbouring texels
-                        else if (mapping_type == TextureInterpolation::Bilinear)
+                        if (color)
                         {
-
-                            // calculate corresponding position of dst_coord pixel center in image (src)
-                            const Vector3f homogenous_dst_coord(x, y, 1.0f);
-                            const Vector2f src_texel = warp_mat_org_inv * homogenous_dst_coord;
-
-                            // calculate euclidean distances to next 4 texels
-                            float distance_upper_left = sqrt(pow(src_texel[0] - floor(src_texel[0]), 2) +
-                                                             pow(src_texel[1] - floor(src_texel[1]), 2));
-                            float distance_upper_right = sqrt(pow(src_texel[0] - floor(src_texel[0]), 2) +
-                                                              pow(src_texel[1] - ceil(src_texel[1]), 2));
-                            float distance_lower_left = sqrt(pow(src_texel[0] - ceil(src_texel[0]), 2) +
-                                                             pow(src_texel[1] - floor(src_texel[1]), 2));
-                            float distance_lower_right = sqrt(pow(src_texel[0] - ceil(src_texel[0]), 2) +
-                                                              pow(src_texel[1] - ceil(src_texel[1]), 2));
-
-                            // normalise distances that the sum of all distances is 1
-                            const float sum_distances = distance_lower_left + distance_lower_right +
-                                                        distance_upper_left + distance_upper_right;
-                            distance_lower_left /= sum_distances;
-                            distance_lower_right /= sum_distances;
-                            distance_upper_left /= sum_distances;
-                            distance_upper_right /= sum_distances;
-
-                            // set color depending on distance from next 4 texels
-                            // (we map the data from std::array<uint8_t, 3> to an Eigen::Map, then cast that
-                            // to float to multiply with the float-scalar distance.)
-                            // (this is untested!)
-                            const Vector3f color_upper_left =
-                                Eigen::Map<const Eigen::Matrix<std::uint8_t, 1, 3>>(
-                                    image(floor(src_texel[1]), floor(src_texel[0])).data(), 3)
-                                    .cast<float>() *
-                                distance_upper_left;
-                            const Vector3f color_upper_right =
-                                Eigen::Map<const Eigen::Matrix<std::uint8_t, 1, 3>>(
-                                    image(floor(src_texel[1]), ceil(src_texel[0])).data(), 3)
-                                    .cast<float>() *
-                                distance_upper_right;
-                            const Vector3f color_lower_left =
-                                Eigen::Map<const Eigen::Matrix<std::uint8_t, 1, 3>>(
-                                    image(ceil(src_texel[1]), floor(src_texel[0])).data(), 3)
-                                    .cast<float>() *
-                                distance_lower_left;
-                            const Vector3f color_lower_right =
-                                Eigen::Map<const Eigen::Matrix<std::uint8_t, 1, 3>>(
-                                    image(ceil(src_texel[1]), ceil(src_texel[0])).data(), 3)
-                                    .cast<float>() *
-                                distance_lower_right;
-
-                            // isomap(y, x)[color] = color_upper_left + color_upper_right + color_lower_left +
-                            // color_lower_right;
-                            isomap(y, x)[0] = static_cast<std::uint8_t>(
-                                glm::clamp(color_upper_left[0] + color_upper_right[0] + color_lower_left[0] +
-                                               color_lower_right[0],
-                                           0.f, 255.0f));
-                            isomap(y, x)[1] = static_cast<std::uint8_t>(
-                                glm::clamp(color_upper_left[1] + color_upper_right[1] + color_lower_left[1] +
-                                               color_lower_right[1],
-                                           0.f, 255.0f));
-                            isomap(y, x)[2] = static_cast<std::uint8_t>(
-                                glm::clamp(color_upper_left[2] + color_upper_right[2] + color_lower_left[2] +
-                                               color_lower_right[2],
-                                           0.f, 255.0f));
-                            isomap(y, x)[3] = static_cast<std::uint8_t>(alpha_value); // pixel is visible
+                            isomap(y, x) = {(*color)[0], (*color)[1], (*color)[2],
+                                            static_cast<std::uint8_t>(alpha_value)};
                         }
-                        // NearestNeighbour mapping: set color of pixel to color of nearest texel
-                        else if (mapping_type == TextureInterpolation::NearestNeighbour)
+                    }
+                    // Bilinear mapping: calculate pixel color depending on the four neighbouring texels
+                    else if (mapping_type == TextureInterpolation::Bilinear)
+                    {
+                        if (is_inside_image(src_texel))
                         {
+                            const std::array<std::uint8_t, 3> color =
+                                detail::sample_bilinear(image, src_texel[0], src_texel[1]);
+                            isomap(y, x) = {color[0], color[1], color[2],
+                                            static_cast<std::uint8_t>(alpha_value)}; // pixel is visible
+                        }
+                    }
+                    // NearestNeighbour mapping: set color of pixel to color of nearest texel
+                    else if (mapping_type == TextureInterpolation::NearestNeighbour)
+                    {
 
-                            // calculate corresponding position of dst_coord pixel center in image (src)
-                            const Vector3f homogenous_dst_coord(x, y, 1.0f);
-                            const Vector2f src_texel = warp_mat_org_inv * homogenous_dst_coord;
-
-                            if ((round(src_texel[1]) < image.rows) && (round(src_texel[0]) < image.cols) &&
-                                round(src_texel[0]) > 0 && round(src_texel[1]) > 0)
-                            {
-                                isomap(y, x)[0] = image(round(src_texel[1]), round(src_texel[0]))[0];
-                                isomap(y, x)[1] = image(round(src_texel[1]), round(src_texel[0]))[1];
-                                isomap(y, x)[2] = image(round(src_texel[1]), round(src_texel[0]))[2];
-                                isomap(y, x)[3] = static_cast<std::uint8_t>(alpha_value); // pixel is visible
-                            }
+                        if ((round(src_texel[1]) < image.rows) && (round(src_texel[0]) < image.cols) &&
+                            round(src_texel[0]) > 0 && round(src_texel[1]) > 0)
+                        {
+                            isomap(y, x)[0] = image(round(src_texel[1]), round(src_texel[0]))[0];
+                            isomap(y, x)[1] = image(round(src_texel[1]), round(src_texel[0]))[1];
+                            isomap(y, x)[2] = image(round(src_texel[1]), round(src_texel[0]))[2];
+                            isomap(y, x)[3] = static_cast<std::uint8_t>(alpha_value); // pixel is visible
                         }
                     }
                 }
             }
-        }; // end lambda auto extract_triangle();
-        results.emplace_back(std::async(extract_triangle));
-    } // end for all mesh.tvi
+        }
+    }; // end lambda auto extract_triangle();
+
+    // The isomap is split into bands of rows, one task per band. Each task goes through all triangles, but
+    // only writes the pixels in its own band. So every isomap pixel is written by a single task, including
+    // the pixels on the edges shared by two triangles, and the result doesn't depend on the scheduling.
+    const int num_bands =
+        max(1, min(isomap_resolution, static_cast<int>(std::thread::hardware_concurrency())));
+    std::vector<std::future<void>> results;
+    results.reserve(num_bands);
+    for (int band = 0; band < num_bands; ++band)
+    {
+        const int row_begin = band * isomap_resolution / num_bands;
+        const int row_end = (band + 1) * isomap_resolution / num_bands;
+        results.emplace_back(std::async(std::launch::async, [&mesh, &extract_triangle, row_begin, row_end]() {
+            for (const auto& triangle_indices : mesh.tvi())
+            {
+                extract_triangle(triangle_indices, row_begin, row_end);
+            }
+        }));
+    }
     // Collect all the launched tasks:
     for (auto&& r : results)
     {
@@ -523,6 +468,99 @@ extract_texture(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera
     return isomap;
 };
 
+/**
+ * Creates isomaps of several resolutions from the given isomap, by repeatedly halving its
+ * resolution with a 2x2 box filter.
+ *
+ * The colours are averaged with premultiplied alpha, so the regions of the isomap that are
+ * not visible (alpha 0) don't bleed into the visible regions, and the alpha channel of each
+ * level is the mean of the alpha values it covers, e.g. partly visible at the border.
+ *
+ * Each requested resolution has to be the resolution of the given isomap divided by a power
+ * of two (including 2^0, i.e. the isomap itself).
+ *
+ * @param[in] isomap A 4-channel isomap, with the visibility in the 4th channel, e.g. from extract_texture(...).
+ * @param[in] isomap_resolutions The resolutions of the isomaps to create, in any order.
+ * @return An isomap for each of the given resolutions, in the same order.
+ * @throws std::runtime_error if a resolution can't be reached by halving the resolution of the isomap.
+ */
+inline std::vector<core::Image4u> create_isomap_pyramid(const core::Image4u& isomap,
+                                                        const std::vector<int>& isomap_resolutions)
+{
+    std::vector<core::Image4u> isomaps(isomap_resolutions.size());
+    core::Image4u level = isomap;
+    while (true)
+    {
+        bool all_levels_done = true;
+        for (std::size_t i = 0; i < isomap_resolutions.size(); ++i)
+        {
+            if (isomap_resolutions[i] == static_cast<int>(level.cols))
+            {
+                isomaps[i] = level;
+            } else if (isomap_resolutions[i] < static_cast<int>(level.cols))
+            {
+                all_levels_done = false;
+            }
+        }
+        if (all_levels_done)
+        {
+            break;
+        }
+        if (level.rows % 2 != 0 || level.cols % 2 != 0)
+        {
+            throw std::runtime_error("create_isomap_pyramid: Each resolution has to be the resolution of the "
+                                     "isomap divided by a power of two.");
+        }
+        level = detail::downsample_isomap(level);
+    }
+    for (const auto& created_isomap : isomaps)
+    {
+        if (created_isomap.data.empty())
+        {
+            throw std::runtime_error("create_isomap_pyramid: Each resolution has to be the resolution of the "
+                                     "isomap divided by a power of two.");
+        }
+    }
+    return isomaps;
+};
+
+/**
+ * Extracts the texture of the face from the given image and stores it as isomaps of
+ * several resolutions, e.g. for different consumers.
+ *
+ * The texture is extracted only once, at the highest of the given resolutions, and the
+ * isomaps of the other resolutions are created from it with create_isomap_pyramid(...), which
+ * is a lot faster than extracting the texture once per resolution. Each resolution has to be
+ * the highest resolution divided by a power of two, e.g. 256, 512 and 2048.
+ *
+ * See extract_texture(...) for a description of the remaining parameters.
+ *
+ * @param[in] mesh A mesh with texture coordinates.
+ * @param[in] affine_camera_matrix An estimated 3x4 affine camera matrix.
+ * @param[in] image The image to extract the texture from.
+ * @param[in] isomap_resolutions The resolutions of the isomaps to create, in any order.
+ * @param[in] compute_view_angle A flag whether the view angle of each vertex should be computed and encoded into the alpha channel.
+ * @param[in] mapping_type The interpolation type to be used for the extraction.
+ * @return An isomap for each of the given resolutions, in the same order.
+ * @throws std::runtime_error if the resolutions are empty or not all a power of two apart.
+ */
+inline std::vector<core::Image4u>
+extract_texture_pyramid(const core::Mesh& mesh, Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                        core::ConstImageView3u image, const std::vector<int>& isomap_resolutions,
+                        bool compute_view_angle = false,
+                        TextureInterpolation mapping_type = TextureInterpolation::NearestNeighbour)
+{
+    if (isomap_resolutions.empty())
+    {
+        throw std::runtime_error("extract_texture_pyramid: At least one isomap resolution has to be given.");
+    }
+    const int highest_resolution =
+        *std::max_element(std::begin(isomap_resolutions), std::end(isomap_resolutions));
+    const core::Image4u isomap = extract_texture(mesh, affine_camera_matrix, image, compute_view_angle,
+                                                 mapping_type, highest_resolution);
+    return create_isomap_pyramid(isomap, isomap_resolutions);
+};
+
 /* New texture extraction, will replace above one at some point: */
 namespace v2 {
 
@@ -573,7 +611,7 @@ namespace v2 {
     {
         bool visible = true;
         // For every tri of the rotated mesh:
-        for (auto&& tri : mesh.tvi)
+        for (auto&& tri : mesh.tvi())
         {
             auto& v0 = rotated_vertices[tri[0]]; // const?
             auto& v1 = rotated_vertices[tri[1]];
@@ -616,7 +654,7 @@ namespace v2 {
     const int tex_width = isomap_resolution;
     const int tex_height =
         isomap_resolution; // keeping this in case we need non-square texture maps at some point
-    for (const auto& tvi : mesh.tvi)
+    for (const auto& tvi : mesh.tvi())
     {
         if (visibility_ray[tvi[0]] && visibility_ray[tvi[1]] &&
             visibility_ray[tvi[2]]) // can also try using ||, but...
@@ -625,8 +663,8 @@ namespace v2 {
             // definitely need to correct this. Probably here.
             // It looks like it is 1-2 pixels off. Definitely a bit more than 1.
             detail::Vertex<double> pa{
-                vec4(mesh.texcoords[tvi[0]][0] * tex_width,
-					 mesh.texcoords[tvi[0]][1] * tex_height,
+                vec4(mesh.texcoords()[tvi[0]][0] * tex_width,
+					 mesh.texcoords()[tvi[0]][1] * tex_height,
                      wnd_coords[tvi[0]].z, // z_ndc
 					 wnd_coords[tvi[0]].w), // 1/w_clip
                 vec3(), // empty
@@ -635,8 +673,8 @@ namespace v2 {
                     wnd_coords[tvi[0]].y / image.rows // (maybe '1 - wndcoords...'?) wndcoords of the projected/rendered model triangle (in the input img). Normalised to 0,1.
 					)};
             detail::Vertex<double> pb{
-                vec4(mesh.texcoords[tvi[1]][0] * tex_width,
-				mesh.texcoords[tvi[1]][1] * tex_height,
+                vec4(mesh.texcoords()[tvi[1]][0] * tex_width,
+				mesh.texcoords()[tvi[1]][1] * tex_height,
                 wnd_coords[tvi[1]].z, // z_ndc
 				wnd_coords[tvi[1]].w), // 1/w_clip
                 vec3(), // empty
@@ -645,8 +683,8 @@ namespace v2 {
                     wnd_coords[tvi[1]].y / image.rows // (maybe '1 - wndcoords...'?) wndcoords of the projected/rendered model triangle (in the input img). Normalised to 0,1.
 					)};
             detail::Vertex<double> pc{
-                vec4(mesh.texcoords[tvi[2]][0] * tex_width,
-				mesh.texcoords[tvi[2]][1] * tex_height,
+                vec4(mesh.texcoords()[tvi[2]][0] * tex_width,
+				mesh.texcoords()[tvi[2]][1] * tex_height,
                 wnd_coords[tvi[2]].z, // z_ndc 
 				wnd_coords[tvi[2]].w), // 1/w_clip
                 vec3(), // empty
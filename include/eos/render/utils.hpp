@@ -26,6 +26,10 @@
 #include "glm/geometric.hpp"
 
 #include "Eigen/Core"
+#include "Eigen/Geometry"
+
+#include <array>
+#include <vector>
 
 namespace eos {
 namespace render {
@@ -139,6 +143,39 @@ inline glm::vec3 compute_face_normal(const glm::vec3& v0, const glm::vec3& v1, c
     return n;
 };
 
+/**
+ * Computes the per-vertex normals of a mesh, as the normalised sum of the normals of the
+ * faces adjacent to each vertex, weighted by their area.
+ * Assumes the triangles are given in CCW order, like compute_face_normal(...). Vertices
+ * that aren't part of any (non-degenerate) triangle get a zero normal.
+ *
+ * @param[in] vertices The vertices of the mesh as columns, e.g. core::Mesh::vertices.as_matrix().
+ * @param[in] tvi The triangle vertex indices of the mesh.
+ * @return The unit-length normal of each vertex.
+ */
+inline std::vector<Eigen::Vector3f> compute_vertex_normals(const Eigen::Ref<const Eigen::Matrix3Xf>& vertices,
+                                                           const std::vector<std::array<int, 3>>& tvi)
+{
+    std::vector<Eigen::Vector3f> normals(vertices.cols(), Eigen::Vector3f::Zero());
+    for (const auto& tri : tvi)
+    {
+        // The length of the cross product is twice the triangle's area:
+        const Eigen::Vector3f n = (vertices.col(tri[1]) - vertices.col(tri[0]))
+                                      .cross(vertices.col(tri[2]) - vertices.col(tri[0]));
+        normals[tri[0]] += n;
+        normals[tri[1]] += n;
+        normals[tri[2]] += n;
+    }
+    for (auto& n : normals)
+    {
+        if (n.norm() > 0.0f)
+        {
+            n.normalize();
+        }
+    }
+    return normals;
+};
+
 } /* namespace render */
 } /* namespace eos */
 
@@ -0,0 +1,189 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/render/vertex_color_extraction.hpp
+ *
+ * Copyright 2014-2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef VERTEX_COLOR_EXTRACTION_HPP_
+#define VERTEX_COLOR_EXTRACTION_HPP_
+
+#include "eos/core/Image.hpp"
+#include "eos/core/Mesh.hpp"
+#include "eos/render/utils.hpp"
+#include "eos/render/detail/render_affine_detail.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
+
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+
+#include "Eigen/Core"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eos {
+namespace render {
+
+namespace detail {
+
+/**
+ * Bilinearly samples the colour of the given image at a point in screen coordinates,
+ * where the centre of pixel (r, c) is at (c + 0.5, r + 0.5), like in the rasteriser.
+ *
+ * The image is expected in BGR order, like the images given to extract_texture(...).
+ * The colour is returned in RGB order and in the range [0, 1], like the colours of a
+ * core::Mesh.
+ *
+ * @param[in] image The image to sample from.
+ * @param[in] x The x-coordinate of the point. Has to be within [0, image.cols).
+ * @param[in] y The y-coordinate of the point. Has to be within [0, image.rows).
+ * @return The RGB colour of the image at the given point.
+ */
+inline Eigen::Vector3f sample_bilinear_rgb(core::ConstImageView3u image, float x, float y)
+{
+    // Shift to pixel centres, and clamp at the border, where there is no neighbouring pixel to blend with:
+    const float px = std::max(x - 0.5f, 0.0f);
+    const float py = std::max(y - 0.5f, 0.0f);
+    const int x0 = static_cast<int>(px);
+    const int y0 = static_cast<int>(py);
+    const int x1 = std::min(x0 + 1, static_cast<int>(image.cols) - 1);
+    const int y1 = std::min(y0 + 1, static_cast<int>(image.rows) - 1);
+    const float ax = px - x0;
+    const float ay = py - y0;
+
+    const auto to_vector = [](const std::array<std::uint8_t, 3>& bgr) {
+        return Eigen::Vector3f(bgr[2], bgr[1], bgr[0]);
+    };
+    const Eigen::Vector3f top = (1.0f - ax) * to_vector(image(y0, x0)) + ax * to_vector(image(y0, x1));
+    const Eigen::Vector3f bottom = (1.0f - ax) * to_vector(image(y1, x0)) + ax * to_vector(image(y1, x1));
+    return ((1.0f - ay) * top + ay * bottom) / 255.0f;
+};
+
+/**
+ * Samples the colour of every vertex from the image, given the screen coordinates of the
+ * vertices. See extract_vertex_colors(...) for a description of the remaining parameters.
+ *
+ * @param[in] screen_coords The x and y screen coordinates of every vertex, in the first two rows.
+ * @param[in] in_front Whether each vertex is in front of the camera, or an empty vector if all are.
+ * @return The RGB colour of every vertex.
+ */
+inline std::vector<Eigen::Vector3f>
+sample_vertex_colors(const core::Mesh& mesh, const Eigen::Matrix<float, 4, Eigen::Dynamic>& screen_coords,
+                     const std::vector<bool>& in_front, core::ConstImageView3u image,
+                     const std::vector<bool>& visibility)
+{
+    assert(visibility.empty() || visibility.size() == mesh.vertices.size());
+    assert(mesh.colors.empty() || mesh.colors.size() == mesh.vertices.size());
+
+    std::vector<Eigen::Vector3f> colors(mesh.vertices.size());
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const float x = screen_coords(0, i);
+        const float y = screen_coords(1, i);
+        const bool is_visible = (visibility.empty() || visibility[i]) && (in_front.empty() || in_front[i]);
+        if (is_visible && x >= 0.0f && x < image.cols && y >= 0.0f && y < image.rows)
+        {
+            colors[i] = sample_bilinear_rgb(image, x, y);
+        } else
+        {
+            // The renderer draws meshes without colour information in grey, so we do the same:
+            colors[i] =
+                mesh.colors.empty() ? Eigen::Vector3f(0.5f, 0.5f, 0.5f) : Eigen::Vector3f(mesh.colors[i]);
+        }
+    }
+    return colors;
+};
+
+} /* namespace detail */
+
+/**
+ * Extracts a colour for every vertex of the mesh from the given image, as a fast
+ * alternative to extracting a whole isomap with extract_texture(...), e.g. for previews
+ * or for feedback while tracking.
+ *
+ * Every vertex is projected once with the given affine camera matrix, and the image is
+ * sampled bilinearly at its position. No triangles are rasterised, so this runs in
+ * O(number of vertices). The result can be assigned to mesh.colors, and the mesh can then
+ * be rendered with vertex colouring, e.g. with render(...) or with the
+ * VertexColoringFragmentShader.
+ *
+ * Vertices that are not visible, or that project outside of the image, keep the colour
+ * they have in the mesh, or get grey if the mesh has no colours.
+ *
+ * @param[in] mesh A mesh.
+ * @param[in] affine_camera_matrix An estimated 3x4 affine camera matrix.
+ * @param[in] image The image to sample the colours from, in BGR order.
+ * @param[in] visibility Whether each vertex is visible (not self-occluded). If empty, all vertices are assumed visible.
+ * @return A colour for each vertex, in RGB order and in the range [0, 1], like core::Mesh::colors.
+ */
+inline std::vector<Eigen::Vector3f> extract_vertex_colors(const core::Mesh& mesh,
+                                                          Eigen::Matrix<float, 3, 4> affine_camera_matrix,
+                                                          core::ConstImageView3u image,
+                                                          const std::vector<bool>& visibility = {})
+{
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> screen_coords =
+        detail::transform_vertices(mesh.vertices.as_matrix(),
+                                   detail::calculate_affine_z_direction(affine_camera_matrix));
+    return detail::sample_vertex_colors(mesh, screen_coords, {}, image, visibility);
+};
+
+/**
+ * Extracts a colour for every vertex of the mesh from the given image, like
+ * extract_vertex_colors(const core::Mesh&, Eigen::Matrix<float, 3, 4>, ...), but projects
+ * the vertices with 4x4 OpenGL model-view and projection matrices, like render(...).
+ *
+ * Vertices behind the camera are treated like invisible vertices.
+ *
+ * @param[in] mesh A mesh.
+ * @param[in] model_view_matrix A 4x4 OpenGL model-view matrix.
+ * @param[in] projection_matrix A 4x4 orthographic or perspective OpenGL projection matrix.
+ * @param[in] image The image to sample the colours from, in BGR order.
+ * @param[in] visibility Whether each vertex is visible (not self-occluded). If empty, all vertices are assumed visible.
+ * @return A colour for each vertex, in RGB order and in the range [0, 1], like core::Mesh::colors.
+ */
+inline std::vector<Eigen::Vector3f> extract_vertex_colors(const core::Mesh& mesh,
+                                                          glm::tmat4x4<float> model_view_matrix,
+                                                          glm::tmat4x4<float> projection_matrix,
+                                                          core::ConstImageView3u image,
+                                                          const std::vector<bool>& visibility = {})
+{
+    Eigen::Matrix<float, 4, Eigen::Dynamic> screen_coords =
+        detail::transform_vertices(mesh.vertices.as_matrix(),
+                                   detail::to_eigen(projection_matrix * model_view_matrix));
+    std::vector<bool> in_front(mesh.vertices.size());
+    for (Eigen::Index i = 0; i < screen_coords.cols(); ++i)
+    {
+        const float w = screen_coords(3, i);
+        in_front[i] = w > 0.0f;
+        const glm::vec2 screen_position = clip_to_screen_space(
+            glm::vec2(screen_coords(0, i) / w, screen_coords(1, i) / w), static_cast<int>(image.cols),
+            static_cast<int>(image.rows));
+        screen_coords(0, i) = screen_position[0];
+        screen_coords(1, i) = screen_position[1];
+    }
+    return detail::sample_vertex_colors(mesh, screen_coords, in_front, image, visibility);
+};
+
+} /* namespace render */
+} /* namespace eos */
+
+#endif /* VERTEX_COLOR_EXTRACTION_HPP_ */
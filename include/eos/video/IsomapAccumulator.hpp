@@ -0,0 +1,184 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/video/IsomapAccumulator.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef ISOMAPACCUMULATOR_HPP_
+#define ISOMAPACCUMULATOR_HPP_
+
+#include "eos/core/Image.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace eos {
+namespace video {
+
+/**
+ * @brief Fuses the isomaps of several frames into one texture map with a running weighted mean.
+ *
+ * Each texel of an added isomap is weighted with its alpha value (the visibility or view
+ * angle, as returned by render::extract_texture(...)) times a weight for the whole frame, e.g.
+ * its keyframe score. Only the weighted colour sums and the sum of the weights are stored, in a
+ * single float buffer, so the memory stays constant, no matter how many frames are added.
+ *
+ * A frame's contribution can be removed again by calling remove(...) with the same isomap
+ * and weight, so when a keyframe gets replaced, e.g. in a PoseBinningKeyframeSelector, the
+ * fused texture map can be updated with one call to remove(...) and add(...), in O(number of
+ * texels), instead of merging all keyframes from scratch.
+ */
+class IsomapAccumulator
+{
+public:
+    /**
+     * Constructs an empty accumulator for isomaps of the given resolution.
+     *
+     * @param[in] isomap_resolution Width and height of the isomaps that will be added.
+     */
+    IsomapAccumulator(int isomap_resolution = 512)
+        : resolution(isomap_resolution),
+          sums(static_cast<std::size_t>(isomap_resolution) * isomap_resolution * 4, 0.0f){};
+
+    /**
+     * Adds the contribution of a frame's isomap.
+     *
+     * @param[in] isomap A 4-channel isomap, with the weight of each texel in the 4th channel.
+     * @param[in] weight A weight for the whole frame, that all the texel weights are multiplied with.
+     * @throws std::runtime_error if the isomap doesn't have the resolution of the accumulator.
+     */
+    void add(core::ConstImageView4u isomap, float weight = 1.0f)
+    {
+        accumulate(isomap, weight);
+    };
+
+    /**
+     * Removes the contribution of a frame's isomap, that has previously been added with add(...).
+     *
+     * The isomap and weight have to be the same as they were when the frame was added.
+     *
+     * @param[in] isomap A 4-channel isomap that has been added before.
+     * @param[in] weight The weight that the isomap has been added with.
+     * @throws std::runtime_error if the isomap doesn't have the resolution of the accumulator.
+     */
+    void remove(core::ConstImageView4u isomap, float weight = 1.0f)
+    {
+        accumulate(isomap, -weight);
+        // Adding and subtracting in float precision doesn't give exactly zero again, so reset texels that
+        // no frame contributes to anymore, so that the rounding errors don't accumulate over time:
+        for (std::size_t i = 0; i < sums.size(); i += 4)
+        {
+            if (sums[i + 3] <= min_weight)
+            {
+                std::fill(&sums[i], &sums[i] + 4, 0.0f);
+            }
+        }
+    };
+
+    /**
+     * Removes the contributions of all frames.
+     */
+    void clear()
+    {
+        std::fill(std::begin(sums), std::end(sums), 0.0f);
+    };
+
+    /**
+     * Returns the fused texture map, i.e. the weighted mean of all the isomaps that have been
+     * added (and not removed again).
+     *
+     * The 4th channel contains the accumulated weight of each texel, saturated at 255. It is
+     * 255 for texels that have been seen at least once from the front with a frame weight of
+     * 1, and 0 for texels that haven't been seen in any frame.
+     *
+     * @return The fused texture map (isomap), 4-channel uchar.
+     */
+    core::Image4u get_isomap() const
+    {
+        core::Image4u isomap(resolution, resolution);
+        for (std::size_t i = 0; i < isomap.data.size(); ++i)
+        {
+            const float weight = sums[4 * i + 3];
+            if (weight <= min_weight)
+            {
+                continue; // The Image4u c'tor initialises the texel with zeros.
+            }
+            for (int c = 0; c < 3; ++c)
+            {
+                isomap.data[i][c] =
+                    static_cast<std::uint8_t>(std::min(sums[4 * i + c] / weight + 0.5f, 255.0f));
+            }
+            isomap.data[i][3] = static_cast<std::uint8_t>(std::min(weight * 255.0f + 0.5f, 255.0f));
+        }
+        return isomap;
+    };
+
+    /**
+     * Returns the resolution of the isomaps that the accumulator accepts.
+     *
+     * @return Width and height of the isomaps.
+     */
+    int get_resolution() const
+    {
+        return resolution;
+    };
+
+private:
+    int resolution;          ///< Width and height of the isomaps.
+    std::vector<float> sums; ///< For each texel, the weighted sums of the 3 colour channels, and the sum of
+                             ///< the weights. Has the same (row-major) texel order as core::Image4u.
+
+    // Texels whose accumulated weight is at most this value are treated as empty. It's well below the
+    // smallest weight that a texel can get from one frame (1/255).
+    static constexpr float min_weight = 1e-4f;
+
+    void accumulate(core::ConstImageView4u isomap, float weight)
+    {
+        if (isomap.rows != static_cast<std::size_t>(resolution) ||
+            isomap.cols != static_cast<std::size_t>(resolution))
+        {
+            throw std::runtime_error("IsomapAccumulator: The isomap has to have the resolution of the "
+                                     "accumulator.");
+        }
+        // The alpha channel is in [0, 255], and we scale the weights to [0, 1]:
+        const float scale = weight / 255.0f;
+        for (std::size_t r = 0; r < isomap.rows; ++r)
+        {
+            const std::array<std::uint8_t, 4>* row = isomap.row_ptr(r);
+            float* row_sums = &sums[4 * r * isomap.cols];
+            for (std::size_t c = 0; c < isomap.cols; ++c)
+            {
+                const float texel_weight = row[c][3] * scale;
+                for (int ch = 0; ch < 3; ++ch)
+                {
+                    row_sums[4 * c + ch] += row[c][ch] * texel_weight;
+                }
+                row_sums[4 * c + 3] += texel_weight;
+            }
+        }
+    };
+};
+
+} /* namespace video */
+} /* namespace eos */
+
+#endif /* ISOMAPACCUMULATOR_HPP_ */
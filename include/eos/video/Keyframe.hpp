@@ -23,6 +23,11 @@
 #define KEYFRAME_HPP_
 
 #include "eos/fitting/FittingResult.hpp"
+#include "eos/cpp17/optional.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace eos {
 namespace video {
@@ -74,6 +79,27 @@ public:
      */
     bool try_add(float frame_score, const ImageType& image, const fitting::FittingResult& fitting_result)
     {
+        cpp17::optional<Keyframe<ImageType>> replaced_keyframe;
+        return try_add(frame_score, image, fitting_result, replaced_keyframe);
+    };
+
+    /**
+     * Try to add the frame with the given score, and return whether the frame was added.
+     *
+     * If adding the frame pushes a keyframe with a lower score out of its bin, that keyframe is
+     * returned in \p replaced_keyframe, so that e.g. an IsomapAccumulator can remove its
+     * contribution.
+     *
+     * @param[in] frame_score Quality score of the given image.
+     * @param[in] image The image to potentially add.
+     * @param[in] fitting_result Fitting result of the given image - used to compute the yaw angle.
+     * @param[out] replaced_keyframe The keyframe that was removed to make room for the given frame, if any.
+     * @return Whether the given image has been added as a keyframe.
+     */
+    bool try_add(float frame_score, const ImageType& image, const fitting::FittingResult& fitting_result,
+                 cpp17::optional<Keyframe<ImageType>>& replaced_keyframe)
+    {
+        replaced_keyframe = cpp17::nullopt;
         // Determine whether to add or not:
         auto yaw_angle = glm::degrees(glm::yaw(fitting_result.rendering_parameters.get_rotation()));
         auto idx = angle_to_index(yaw_angle);
@@ -91,12 +117,13 @@ public:
             return false;
         }
         // Add the keyframe:
-        bins[idx].push_back(video::Keyframe{frame_score, image, fitting_result});
+        bins[idx].push_back(video::Keyframe<ImageType>{frame_score, image, fitting_result});
         if (bins[idx].size() > frames_per_bin)
         {
             // need to remove the lowest one:
             std::sort(std::begin(bins[idx]), std::end(bins[idx]),
                       [](const auto& lhs, const auto& rhs) { return lhs.score > rhs.score; });
+            replaced_keyframe = std::move(bins[idx].back());
             bins[idx].resize(frames_per_bin);
         }
         return true;
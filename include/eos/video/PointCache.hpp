@@ -0,0 +1,631 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: include/eos/video/PointCache.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef POINTCACHE_HPP_
+#define POINTCACHE_HPP_
+
+#include "eos/core/MemoryMappedFile.hpp"
+#include "eos/core/Mesh.hpp"
+#include "eos/core/VertexBuffer.hpp"
+#include "eos/core/detail/BufferedWriter.hpp"
+#include "eos/core/detail/little_endian.hpp"
+
+#include "Eigen/Core"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A point cache stores the vertex positions of a mesh over all frames of a video, with the
+ * topology and texture coordinates, which are the same in every frame, stored only once.
+ *
+ * The file consists of (all values little-endian):
+ *  - A header: the magic string "eospcach", the version, the number of vertices and triangles,
+ *    whether there are texture coordinates, the quantisation step and the keyframe interval.
+ *  - The triangle list (int32), the texture coordinates (float32), and, if the positions are
+ *    quantised, the quantised reference positions (int32).
+ *  - The frames, one after the other.
+ *  - The frame index: the file offset of every frame (uint64).
+ *  - A trailer: the offset of the frame index, the number of frames, and the magic string
+ *    "eospcend". The trailer is written last, so a file whose writer didn't finish is detected.
+ *
+ * If the quantisation step is zero, the frames contain the positions as float32. Otherwise,
+ * the positions are rounded to multiples of the quantisation step, and each frame contains
+ * the differences of these integers to a prediction, as zigzag-encoded variable-length integers
+ * (7 bits per byte). Keyframes (every keyframe_interval-th frame, starting with the first) are
+ * predicted by the reference positions, and all other frames by the previous frame. Since the
+ * prediction is done on the integers, there is no drift, the error of every position is at most
+ * half the quantisation step.
+ */
+namespace eos {
+namespace video {
+
+namespace detail {
+
+constexpr char point_cache_magic[8] = {'e', 'o', 's', 'p', 'c', 'a', 'c', 'h'};
+constexpr char point_cache_end_magic[8] = {'e', 'o', 's', 'p', 'c', 'e', 'n', 'd'};
+constexpr std::uint32_t point_cache_version = 1;
+constexpr std::size_t point_cache_header_size = 8 + 6 * 4;
+constexpr std::size_t point_cache_trailer_size = 8 + 8 + 8;
+
+/**
+ * Rounds the given value to the nearest multiple of the quantisation step, and returns the
+ * multiple. Values are limited to +-2^30 steps, so that differences of two of them fit into 32 bits.
+ *
+ * @throw std::runtime_error If the value is not finite, or too large for the quantisation step.
+ */
+inline std::int32_t quantise_position(float value, float quantisation_step)
+{
+    const float scaled = value / quantisation_step;
+    if (!(std::abs(scaled) < 1073741824.0f)) // Also catches NaN.
+    {
+        throw std::runtime_error("PointCacheWriter: A vertex position is not finite, or too large for the "
+                                 "quantisation step.");
+    }
+    return static_cast<std::int32_t>(std::lround(scaled));
+};
+
+/**
+ * Appends the given float in little-endian byte order, like BufferedWriter::write_float32(...).
+ */
+inline void append_float32(std::vector<char>& bytes, float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; ++i)
+    {
+        bytes.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+    }
+};
+
+/**
+ * Appends the given value as a zigzag-encoded variable-length integer, i.e. small positive and
+ * negative values take one byte.
+ */
+inline void append_varint(std::vector<char>& bytes, std::int64_t value)
+{
+    std::uint64_t zigzag = (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    while (zigzag >= 0x80)
+    {
+        bytes.push_back(static_cast<char>((zigzag & 0x7F) | 0x80));
+        zigzag >>= 7;
+    }
+    bytes.push_back(static_cast<char>(zigzag));
+};
+
+/**
+ * Reads a variable-length integer written by append_varint(...), and advances \p first past it.
+ *
+ * @throw std::runtime_error If the integer doesn't end before \p last.
+ */
+inline std::int64_t read_varint(const char*& first, const char* last)
+{
+    std::uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (first == last)
+        {
+            break;
+        }
+        const auto byte = static_cast<unsigned char>(*first++);
+        zigzag |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (byte < 0x80)
+        {
+            return static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+        }
+    }
+    throw std::runtime_error("PointCacheReader: A frame in the point cache is corrupt.");
+};
+
+} /* namespace detail */
+
+/**
+ * Options for writing a point cache.
+ */
+struct PointCacheOptions
+{
+    /**
+     * The positions are rounded to multiples of this value, e.g. 0.01 (millimetres), and stored
+     * as compressed integers. If zero, the positions are stored losslessly as float32.
+     */
+    float quantisation_step = 0.0f;
+    /**
+     * Every this many frames, a frame is stored relative to the reference positions instead of
+     * the previous frame, which limits how many frames have to be decoded to seek to a frame.
+     * With a value of 1, every frame is stored relative to the reference. Only used if the
+     * positions are quantised.
+     */
+    int keyframe_interval = 30;
+};
+
+/**
+ * @brief Writes the vertex positions of a mesh over the frames of a video to a point cache file.
+ *
+ * The frames are streamed to the file as they are added, and the frame index is written by
+ * close(). See the description of the file format above.
+ *
+ * Example:
+ * \code
+ * video::PointCacheOptions options;
+ * options.quantisation_step = 0.01f; // in the units of the model, e.g. millimetres
+ * video::PointCacheWriter writer("video.eospc", mesh, options, mean_mesh.vertices);
+ * for (...) { writer.add_frame(fitted_mesh.vertices); }
+ * writer.close();
+ * \endcode
+ */
+class PointCacheWriter
+{
+public:
+    /**
+     * Creates the given file and writes the topology and texture coordinates of the mesh.
+     *
+     * @param[in] filename The file to write to.
+     * @param[in] mesh A mesh with the triangle list and texture coordinates that all frames share.
+     * @param[in] options Whether and how to quantise the positions.
+     * @param[in] reference Positions that keyframes are predicted with, e.g. the mean of the
+     * model. Quantised frames are smallest if the reference is close to them. If empty, all
+     * positions are zero.
+     * @throw std::runtime_error If the file can't be opened, the options are invalid, or a triangle
+     * refers to a vertex that doesn't exist.
+     */
+    PointCacheWriter(std::string filename, const core::Mesh& mesh, PointCacheOptions options = {},
+                     const core::VertexBuffer& reference = {})
+        : file(filename), num_vertices(mesh.vertices.size()), options(options)
+    {
+        if (options.quantisation_step < 0.0f || options.keyframe_interval < 1)
+        {
+            throw std::runtime_error("PointCacheWriter: The quantisation step has to be non-negative, and "
+                                     "the keyframe interval positive.");
+        }
+        if (!reference.empty() && reference.size() != num_vertices)
+        {
+            throw std::runtime_error("PointCacheWriter: The reference has to have as many vertices as the "
+                                     "mesh.");
+        }
+        for (const auto& triangle : mesh.tvi())
+        {
+            for (const int index : triangle)
+            {
+                if (index < 0 || static_cast<std::size_t>(index) >= num_vertices)
+                {
+                    throw std::runtime_error("PointCacheWriter: A triangle of the mesh refers to a vertex "
+                                             "that doesn't exist.");
+                }
+            }
+        }
+        const bool has_texcoords = !mesh.texcoords().empty();
+        if (has_texcoords && mesh.texcoords().size() != num_vertices)
+        {
+            throw std::runtime_error("PointCacheWriter: The mesh has to have one texture coordinate per "
+                                     "vertex.");
+        }
+        file.write(detail::point_cache_magic, sizeof(detail::point_cache_magic));
+        file.write_uint32(detail::point_cache_version);
+        file.write_uint32(static_cast<std::uint32_t>(num_vertices));
+        file.write_uint32(static_cast<std::uint32_t>(mesh.tvi().size()));
+        file.write_uint32(has_texcoords ? 1 : 0);
+        file.write_float32(options.quantisation_step);
+        file.write_uint32(static_cast<std::uint32_t>(options.keyframe_interval));
+        for (const auto& triangle : mesh.tvi())
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                file.write_uint32(static_cast<std::uint32_t>(triangle[j]));
+            }
+        }
+        if (has_texcoords)
+        {
+            for (const auto& texcoord : mesh.texcoords())
+            {
+                file.write_float32(texcoord[0]);
+                file.write_float32(texcoord[1]);
+            }
+        }
+        if (options.quantisation_step > 0.0f)
+        {
+            reference_positions.resize(3 * num_vertices, 0);
+            for (std::size_t i = 0; i < reference.size(); ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    reference_positions[3 * i + j] =
+                        detail::quantise_position(reference[i][j], options.quantisation_step);
+                }
+            }
+            for (const auto position : reference_positions)
+            {
+                file.write_uint32(static_cast<std::uint32_t>(position));
+            }
+            previous_positions.resize(3 * num_vertices);
+        }
+    };
+
+    /**
+     * Writes the frame index and closes the file, if it hasn't been closed yet. Errors can't be
+     * reported from the destructor, so call close() to find out about them.
+     */
+    ~PointCacheWriter()
+    {
+        if (!closed)
+        {
+            try
+            {
+                close();
+            } catch (const std::exception&)
+            {
+            }
+        }
+    };
+
+    PointCacheWriter(const PointCacheWriter&) = delete;
+    PointCacheWriter& operator=(const PointCacheWriter&) = delete;
+
+    /**
+     * Appends a frame.
+     *
+     * The frame is encoded completely before anything is written, so if this throws, the frame
+     * isn't added, and the writer can be used as if add_frame(...) hadn't been called.
+     *
+     * @param[in] vertices The vertex positions in this frame.
+     * @throw std::runtime_error If the number of vertices is wrong, or a position can't be quantised.
+     */
+    void add_frame(const core::VertexBuffer& vertices)
+    {
+        if (vertices.size() != num_vertices)
+        {
+            throw std::runtime_error("PointCacheWriter: Every frame has to have as many vertices as the "
+                                     "mesh.");
+        }
+        frame_bytes.clear();
+        if (options.quantisation_step == 0.0f)
+        {
+            for (const auto& vertex : vertices)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    detail::append_float32(frame_bytes, vertex[j]);
+                }
+            }
+        } else
+        {
+            const bool is_keyframe = frame_offsets.size() % options.keyframe_interval == 0;
+            const std::vector<std::int32_t>& prediction =
+                is_keyframe ? reference_positions : previous_positions;
+            frame_positions.resize(3 * num_vertices);
+            for (std::size_t i = 0; i < num_vertices; ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                {
+                    const std::int32_t position =
+                        detail::quantise_position(vertices[i][j], options.quantisation_step);
+                    detail::append_varint(frame_bytes,
+                                          static_cast<std::int64_t>(position) - prediction[3 * i + j]);
+                    frame_positions[3 * i + j] = position;
+                }
+            }
+        }
+        // The frame has been encoded, nothing below throws:
+        frame_offsets.push_back(file.get_position());
+        file.write(frame_bytes.data(), frame_bytes.size());
+        previous_positions.swap(frame_positions);
+    };
+
+    /**
+     * Returns the number of frames that have been added.
+     *
+     * @return The number of frames.
+     */
+    int get_num_frames() const
+    {
+        return static_cast<int>(frame_offsets.size());
+    };
+
+    /**
+     * Writes the frame index and the trailer, and closes the file.
+     *
+     * @throw std::runtime_error If writing to the file failed.
+     */
+    void close()
+    {
+        closed = true;
+        const std::uint64_t index_offset = file.get_position();
+        for (const auto offset : frame_offsets)
+        {
+            file.write_uint64(offset);
+        }
+        file.write_uint64(index_offset);
+        file.write_uint64(frame_offsets.size());
+        file.write(detail::point_cache_end_magic, sizeof(detail::point_cache_end_magic));
+        file.close();
+    };
+
+private:
+    core::detail::BufferedWriter file;
+    std::size_t num_vertices;
+    PointCacheOptions options;
+    std::vector<std::int32_t> reference_positions; ///< Quantised reference positions (xyzxyz...).
+    std::vector<std::int32_t> previous_positions;  ///< Quantised positions of the previous frame.
+    std::vector<std::int32_t> frame_positions;     ///< Quantised positions of the frame being added.
+    std::vector<std::uint64_t> frame_offsets;      ///< Offset of each frame in the file.
+    std::vector<char> frame_bytes;                 ///< Buffer for the encoded frame.
+    bool closed = false;
+};
+
+/**
+ * @brief Reads a point cache written by PointCacheWriter.
+ *
+ * The file is memory-mapped, so opening it is instant, and only the frames that are read are
+ * loaded from disk. Lossless frames can be read in any order in constant time. To read a
+ * quantised frame, the frames since the last keyframe have to be decoded, but the reader
+ * remembers the last frame it decoded, so playing the frames in order decodes each frame once.
+ */
+class PointCacheReader
+{
+public:
+    /**
+     * Opens the given point cache and reads its topology and frame index.
+     *
+     * @param[in] filename The point cache file.
+     * @throw std::runtime_error If the file can't be opened, or isn't a complete and valid point cache,
+     * e.g. if a triangle refers to a vertex that doesn't exist.
+     */
+    explicit PointCacheReader(std::string filename)
+        : file(std::make_shared<const core::MemoryMappedFile>(filename))
+    {
+        const char* const data = file->data();
+        const std::size_t size = file->size();
+        const auto invalid_file = [&filename]() {
+            return std::runtime_error("PointCacheReader: Not a complete point cache: " + filename);
+        };
+        if (size < detail::point_cache_header_size + detail::point_cache_trailer_size ||
+            std::memcmp(data, detail::point_cache_magic, 8) != 0 ||
+            std::memcmp(data + size - 8, detail::point_cache_end_magic, 8) != 0)
+        {
+            throw invalid_file();
+        }
+        if (core::detail::read_uint32(data + 8) != detail::point_cache_version)
+        {
+            throw std::runtime_error("PointCacheReader: Unsupported point cache version: " + filename);
+        }
+        num_vertices = core::detail::read_uint32(data + 12);
+        const std::size_t num_triangles = core::detail::read_uint32(data + 16);
+        const bool has_texcoords = core::detail::read_uint32(data + 20) != 0;
+        quantisation_step = core::detail::read_float32(data + 24);
+        keyframe_interval = static_cast<int>(core::detail::read_uint32(data + 28));
+        index_offset = core::detail::read_uint64(data + size - detail::point_cache_trailer_size);
+        const std::uint64_t num_frames =
+            core::detail::read_uint64(data + size - detail::point_cache_trailer_size + 8);
+
+        const std::size_t topology_size = num_triangles * 12 + (has_texcoords ? num_vertices * 8 : 0) +
+                                          (quantisation_step > 0.0f ? num_vertices * 12 : 0);
+        if (num_vertices > static_cast<std::size_t>(std::numeric_limits<int>::max()) ||
+            detail::point_cache_header_size + topology_size > index_offset ||
+            index_offset + num_frames * 8 + detail::point_cache_trailer_size != size ||
+            (quantisation_step > 0.0f && keyframe_interval < 1))
+        {
+            throw invalid_file();
+        }
+        const char* p = data + detail::point_cache_header_size;
+        core::MeshTopology mesh_topology;
+        mesh_topology.tvi.resize(num_triangles);
+        for (auto& triangle : mesh_topology.tvi)
+        {
+            for (int j = 0; j < 3; ++j, p += 4)
+            {
+                const std::uint32_t index = core::detail::read_uint32(p);
+                if (index >= num_vertices)
+                {
+                    throw invalid_file();
+                }
+                triangle[j] = static_cast<int>(index);
+            }
+        }
+        if (has_texcoords)
+        {
+            mesh_topology.texcoords.resize(num_vertices);
+            for (auto& texcoord : mesh_topology.texcoords)
+            {
+                texcoord = Eigen::Vector2f(core::detail::read_float32(p), core::detail::read_float32(p + 4));
+                p += 8;
+            }
+        }
+        if (quantisation_step > 0.0f)
+        {
+            reference_positions.resize(3 * num_vertices);
+            for (auto& position : reference_positions)
+            {
+                position = static_cast<std::int32_t>(core::detail::read_uint32(p));
+                p += 4;
+            }
+        }
+        topology = std::make_shared<const core::MeshTopology>(std::move(mesh_topology));
+        frame_offsets.resize(num_frames);
+        for (std::size_t i = 0; i < num_frames; ++i)
+        {
+            frame_offsets[i] = core::detail::read_uint64(data + index_offset + 8 * i);
+            if (frame_offsets[i] < static_cast<std::uint64_t>(p - data) || frame_offsets[i] > index_offset ||
+                (i > 0 && frame_offsets[i] < frame_offsets[i - 1]))
+            {
+                throw invalid_file();
+            }
+        }
+    };
+
+    /**
+     * Returns the number of frames in the point cache.
+     *
+     * @return The number of frames.
+     */
+    int get_num_frames() const
+    {
+        return static_cast<int>(frame_offsets.size());
+    };
+
+    /**
+     * Returns the number of vertices of the mesh.
+     *
+     * @return The number of vertices.
+     */
+    int get_num_vertices() const
+    {
+        return static_cast<int>(num_vertices);
+    };
+
+    /**
+     * Returns the triangle list that all frames share.
+     *
+     * @return The triangle list.
+     */
+    const std::vector<std::array<int, 3>>& get_triangle_list() const
+    {
+        return topology->tvi;
+    };
+
+    /**
+     * Returns the texture coordinates that all frames share, or an empty vector if the mesh had none.
+     *
+     * @return The texture coordinates.
+     */
+    const std::vector<Eigen::Vector2f>& get_texcoords() const
+    {
+        return topology->texcoords;
+    };
+
+    /**
+     * Reads the vertex positions of the given frame.
+     *
+     * @param[in] frame The index of the frame, in [0, get_num_frames()).
+     * @return The vertex positions.
+     * @throw std::runtime_error If the frame is out of range, or corrupt.
+     */
+    core::VertexBuffer read_frame_vertices(int frame)
+    {
+        if (frame < 0 || frame >= get_num_frames())
+        {
+            throw std::runtime_error("PointCacheReader: The frame index is out of range.");
+        }
+        Eigen::VectorXf positions(3 * num_vertices);
+        if (quantisation_step == 0.0f)
+        {
+            const char* p = get_frame_begin(frame);
+            if (get_frame_end(frame) - p != static_cast<std::ptrdiff_t>(num_vertices * 12))
+            {
+                throw std::runtime_error("PointCacheReader: A frame in the point cache is corrupt.");
+            }
+            for (Eigen::Index i = 0; i < positions.size(); ++i)
+            {
+                positions[i] = core::detail::read_float32(p);
+                p += 4;
+            }
+            return core::VertexBuffer(std::move(positions));
+        }
+
+        // Decode from the last keyframe, or continue from the frame decoded last, if that's closer:
+        const int keyframe = frame - frame % keyframe_interval;
+        int next_frame = keyframe;
+        if (decoded_frame >= keyframe && decoded_frame <= frame)
+        {
+            next_frame = decoded_frame + 1;
+        }
+        decoded_positions.resize(3 * num_vertices);
+        for (; next_frame <= frame; ++next_frame)
+        {
+            decode_frame(next_frame);
+            decoded_frame = next_frame;
+        }
+        for (std::size_t i = 0; i < 3 * num_vertices; ++i)
+        {
+            positions[i] = decoded_positions[i] * quantisation_step;
+        }
+        return core::VertexBuffer(std::move(positions));
+    };
+
+    /**
+     * Reads the given frame as a mesh. All the meshes that are read from the cache share one topology.
+     *
+     * @param[in] frame The index of the frame, in [0, get_num_frames()).
+     * @return The mesh of the frame.
+     * @throw std::runtime_error If the frame is out of range, or corrupt.
+     */
+    core::Mesh read_frame(int frame)
+    {
+        core::Mesh mesh;
+        mesh.vertices = read_frame_vertices(frame);
+        mesh.topology = topology;
+        return mesh;
+    };
+
+private:
+    std::shared_ptr<const core::MemoryMappedFile> file;
+    std::size_t num_vertices = 0;
+    float quantisation_step = 0.0f;
+    int keyframe_interval = 1;
+    std::uint64_t index_offset = 0;
+    std::shared_ptr<const core::MeshTopology> topology; ///< The triangle list and texture coordinates.
+    std::vector<std::int32_t> reference_positions;
+    std::vector<std::uint64_t> frame_offsets;
+
+    int decoded_frame = -1;                       ///< The frame that decoded_positions contains, or -1.
+    std::vector<std::int32_t> decoded_positions;  ///< Quantised positions of decoded_frame.
+
+    const char* get_frame_begin(int frame) const
+    {
+        return file->data() + frame_offsets[frame];
+    };
+
+    const char* get_frame_end(int frame) const
+    {
+        return file->data() + (frame + 1 < get_num_frames() ? frame_offsets[frame + 1] : index_offset);
+    };
+
+    // Decodes the given frame into decoded_positions, which has to contain the previous frame,
+    // unless the given frame is a keyframe.
+    void decode_frame(int frame)
+    {
+        decoded_frame = -1; // In case the frame is corrupt.
+        const bool is_keyframe = frame % keyframe_interval == 0;
+        const char* p = get_frame_begin(frame);
+        const char* const end = get_frame_end(frame);
+        for (std::size_t i = 0; i < decoded_positions.size(); ++i)
+        {
+            const std::int64_t prediction = is_keyframe ? reference_positions[i] : decoded_positions[i];
+            decoded_positions[i] = static_cast<std::int32_t>(prediction + detail::read_varint(p, end));
+        }
+        if (p != end)
+        {
+            throw std::runtime_error("PointCacheReader: A frame in the point cache is corrupt.");
+        }
+    };
+};
+
+} /* namespace video */
+} /* namespace eos */
+
+#endif /* POINTCACHE_HPP_ */
@@ -27,6 +27,7 @@
 #include "eos/morphablemodel/MorphableModel.hpp"
 #include "eos/render/texture_extraction.hpp"
 #include "eos/video/Keyframe.hpp"
+#include "eos/video/IsomapAccumulator.hpp"
 
 #include "Eigen/Core"
 
@@ -39,24 +40,51 @@
 namespace eos {
 namespace video {
 
+/**
+ * @brief Extracts the texture of a keyframe as isomap.
+ *
+ * The isomap contains the view angle in its alpha channel, so it can be weighted with it
+ * when it's merged with the isomaps of other keyframes, e.g. with an IsomapAccumulator.
+ *
+ * @param[in] keyframe The keyframe to extract the texture from.
+ * @param[in] morphable_model The Morphable Model with which the keyframe has been fitted.
+ * @param[in] blendshapes The blendshapes with which the keyframe has been fitted.
+ * @param[in] isomap_resolution The resolution of the generated isomap.
+ * @return The isomap of the keyframe, 4-channel uchar.
+ */
+inline core::Image4u extract_keyframe_isomap(const Keyframe<cv::Mat>& keyframe,
+                                             const morphablemodel::MorphableModel& morphable_model,
+                                             const std::vector<morphablemodel::Blendshape>& blendshapes,
+                                             int isomap_resolution = 1024)
+{
+    using Eigen::VectorXf;
+
+    const VectorXf shape =
+        morphable_model.get_shape_model().draw_sample(keyframe.fitting_result.pca_shape_coefficients) +
+        morphablemodel::to_matrix(blendshapes) *
+            Eigen::Map<const Eigen::VectorXf>(keyframe.fitting_result.expression_coefficients.data(),
+                                              keyframe.fitting_result.expression_coefficients.size());
+    const auto mesh = morphablemodel::sample_to_mesh(shape, {}, morphable_model.get_topology());
+    const auto affine_camera_matrix = fitting::get_3x4_affine_camera_matrix(
+        keyframe.fitting_result.rendering_parameters, keyframe.frame.cols, keyframe.frame.rows);
+    return render::extract_texture(mesh, affine_camera_matrix, core::from_mat(keyframe.frame), true,
+                                   render::TextureInterpolation::NearestNeighbour, isomap_resolution);
+};
+
 /**
  * @brief Extracts texture from each keyframe and merges them using a weighted mean.
  *
  * Uses the view angle as weighting.
  *
- * Note 1: Would be nice to eventually return a 4-channel texture map, with a sensible weight in the 4th
- * channel (i.e. the max of all weights for a given pixel).
- *
- * Note 2: On each call to this, it generates all isomaps. This is quite time-consuming (and we could compute
- * the weighted mean incrementally). But caching them is not trivial (maybe with a hashing or comparing the
- * cv::Mat frame data* member?).
+ * Note: On each call to this, it generates all isomaps. This is quite time-consuming. When the keyframes
+ * change one at a time, e.g. with a PoseBinningKeyframeSelector, it is much faster to keep an
+ * IsomapAccumulator, and to only add the isomap of each new keyframe (and remove the one of the keyframe
+ * that it replaces), using extract_keyframe_isomap(...).
  * On the other hand, for the more complex merging techniques (super-res, involving ceres, or a median
  * cost-func?), there might be no caching possible anyway and we will recompute the merged isomap from scratch
  * each time anyway, but not by first extracting all isomaps - instead we would just do a lookup of the
  * required pixel value(s) in the original image.
  *
- * // struct KeyframeMerger {};
- *
  * @param[in] keyframes The keyframes that will be merged.
  * @param[in] morphable_model The Morphable Model with which the keyframes have been fitted.
  * @param[in] blendshapes The blendshapes with which the keyframes have been fitted.
@@ -68,68 +96,16 @@ inline cv::Mat merge_weighted_mean(const std::vector<Keyframe<cv::Mat>>& keyfram
 {
     assert(keyframes.size() >= 1);
 
-    using cv::Mat;
-    using Eigen::VectorXf;
-    using std::vector;
-
-    vector<Mat> isomaps;
-    for (const auto& frame_data : keyframes)
-    {
-        const VectorXf shape =
-            morphable_model.get_shape_model().draw_sample(frame_data.fitting_result.pca_shape_coefficients) +
-            morphablemodel::to_matrix(blendshapes) *
-                Eigen::Map<const Eigen::VectorXf>(frame_data.fitting_result.expression_coefficients.data(),
-                                                  frame_data.fitting_result.expression_coefficients.size());
-        const auto mesh =
-            morphablemodel::sample_to_mesh(shape, {}, morphable_model.get_shape_model().get_triangle_list(),
-                                           {}, morphable_model.get_texture_coordinates());
-        const auto affine_camera_matrix = fitting::get_3x4_affine_camera_matrix(
-            frame_data.fitting_result.rendering_parameters, frame_data.frame.cols, frame_data.frame.rows);
-        const Mat isomap = core::to_mat(render::extract_texture(mesh, affine_camera_matrix, core::from_mat(frame_data.frame), true,
-                                                   render::TextureInterpolation::NearestNeighbour, 1024));
-        isomaps.push_back(isomap);
-    }
-
-    // Now do the actual merging:
-    Mat r = Mat::zeros(isomaps[0].rows, isomaps[0].cols, CV_32FC1);
-    Mat g = Mat::zeros(isomaps[0].rows, isomaps[0].cols, CV_32FC1);
-    Mat b = Mat::zeros(isomaps[0].rows, isomaps[0].cols, CV_32FC1);
-    Mat accumulated_weight = Mat::zeros(isomaps[0].rows, isomaps[0].cols, CV_32FC1);
     // Currently, this just uses the weights in the alpha channel for weighting - they contain only the
     // view-angle. We should use the keyframe's score as well. Plus the area of the source triangle.
-    for (auto&& isomap : isomaps)
+    IsomapAccumulator accumulator(1024);
+    for (const auto& frame_data : keyframes)
     {
-        vector<Mat> channels;
-        cv::split(isomap, channels);
-        // channels[0].convertTo(channels[0], CV_32FC1);
-        // We could avoid this explicit temporary, but then we'd have to convert both matrices
-        // to CV_32FC1 first - and manually multiply with 1/255. Not sure which one is faster.
-        // If we do it like this, the add just becomes '+=' - so I think it's fine like this.
-        // The final formula is:
-        // b += chan_0 * alpha * 1/255; (and the same for g and r respectively)
-        Mat weighted_b, weighted_g, weighted_r;
-        // // we scale the weights from [0, 255] to [0, 1]:
-        cv::multiply(channels[0], channels[3], weighted_b, 1 / 255.0, CV_32FC1);
-        cv::multiply(channels[1], channels[3], weighted_g, 1 / 255.0, CV_32FC1);
-        cv::multiply(channels[2], channels[3], weighted_r, 1 / 255.0, CV_32FC1);
-        b += weighted_b;
-        g += weighted_g;
-        r += weighted_r;
-        channels[3].convertTo(channels[3], CV_32FC1); // needed for the '/ 255.0f' below to work
-        cv::add(accumulated_weight, channels[3] / 255.0f, accumulated_weight, cv::noArray(), CV_32FC1);
+        accumulator.add(extract_keyframe_isomap(frame_data, morphable_model, blendshapes, 1024));
     }
-    b = b.mul(1.0 / (accumulated_weight)); // divide by number of frames used too?
-    g = g.mul(1.0 / (accumulated_weight));
-    r = r.mul(1.0 / (accumulated_weight));
-
-    // Let's return accumulated_weight too: Normalise by num_isomaps * 255 (=maximum weight)
-    // This sets the returned weight to the average from all the isomaps. Maybe the maximum would make more
-    // sense? => Not returning anything for now.
-    // accumulated_weight = (accumulated_weight / isomaps.size()) * 255;
-
-    Mat merged_isomap;
-    cv::merge(vector<Mat>{b, g, r}, merged_isomap);
-    merged_isomap.convertTo(merged_isomap, CV_8UC3);
+
+    cv::Mat merged_isomap;
+    cv::cvtColor(core::to_mat(accumulator.get_isomap()), merged_isomap, cv::COLOR_BGRA2BGR);
     return merged_isomap;
 };
 
@@ -39,6 +39,7 @@
 
 #include <array>
 #include <cstdint>
+#include <memory>
 #include <vector>
 
 /**
@@ -371,7 +372,7 @@ mxArray* MxArray::from(const eos::core::Mesh& mesh)
 {
     // C++ counts the vertex indices starting at zero, Matlab starts counting
     // at one - therefore, add +1 to all triangle indices:
-    auto tvi_1based = mesh.tvi;
+    auto tvi_1based = mesh.tvi();
     for (auto&& t : tvi_1based)
     {
         for (auto&& idx : t)
@@ -380,7 +381,7 @@ mxArray* MxArray::from(const eos::core::Mesh& mesh)
         }
     }
     // Same for tci:
-    auto tci_1based = mesh.tci;
+    auto tci_1based = mesh.tci();
     for (auto&& t : tci_1based)
     {
         for (auto&& idx : t)
@@ -390,9 +391,9 @@ mxArray* MxArray::from(const eos::core::Mesh& mesh)
     }
 
     MxArray out_array(MxArray::Struct());
-    out_array.set("vertices", mesh.vertices);
-    out_array.set("colors", mesh.colors);
-    out_array.set("texcoords", mesh.texcoords);
+    out_array.set("vertices", mesh.vertices.to_vector());
+    out_array.set("colors", mesh.colors.to_vector());
+    out_array.set("texcoords", mesh.texcoords());
     out_array.set("tvi", tvi_1based);
     out_array.set("tci", tci_1based);
 
@@ -425,17 +426,21 @@ void MxArray::to(const mxArray* in_array, eos::core::Mesh* mesh)
 
     // We could check whether num_vertices is equal for these, but we'll leave it up to the user to give us
     // valid mesh data.
-    array.at("vertices", &mesh->vertices);   // num_vertices x 4 double
-    array.at("texcoords", &mesh->texcoords); // num_vertices x 2 double
-    array.at("tvi", &mesh->tvi);             // num_faces x 3 int32
+    eos::core::MeshTopology topology;
+    std::vector<Eigen::Vector3f> vertices;
+    array.at("vertices", &vertices);            // num_vertices x 4 double
+    mesh->vertices = vertices;
+    array.at("texcoords", &topology.texcoords); // num_vertices x 2 double
+    array.at("tvi", &topology.tvi);             // num_faces x 3 int32
 
     // Adjust the vertex indices from 1-based (Matlab) to 0-based (C++):
-    for (auto&& t : mesh->tvi)
+    for (auto&& t : topology.tvi)
     {
         t[0] -= 1;
         t[1] -= 1;
         t[2] -= 1;
     }
+    mesh->topology = std::make_shared<const eos::core::MeshTopology>(std::move(topology));
 };
 
 /**
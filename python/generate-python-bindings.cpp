@@ -20,7 +20,9 @@
 #include "eos/core/Image.hpp"
 #include "eos/core/LandmarkMapper.hpp"
 #include "eos/core/Mesh.hpp"
+#include "eos/core/MeshTopology.hpp"
 #include "eos/core/read_obj.hpp"
+#include "eos/core/write_mesh.hpp"
 #include "eos/fitting/RenderingParameters.hpp"
 #include "eos/fitting/contour_correspondence.hpp"
 #include "eos/fitting/fitting.hpp"
@@ -29,6 +31,7 @@
 #include "eos/morphablemodel/EdgeTopology.hpp"
 #include "eos/morphablemodel/MorphableModel.hpp"
 #include "eos/morphablemodel/PcaModel.hpp"
+#include "eos/morphablemodel/io/mapped_model.hpp"
 #include "eos/pca/pca.hpp"
 #include "eos/render/texture_extraction.hpp"
 
@@ -42,12 +45,23 @@
 
 #include "Eigen/Core"
 
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace py = pybind11;
 using namespace eos;
 
+// The image view casters are templates, and only compiled for the views that a binding uses. Instantiate
+// all of them, so that building the bindings checks them:
+template struct pybind11::detail::uint8_image_view_caster<std::array<std::uint8_t, 3>, 3>;
+template struct pybind11::detail::uint8_image_view_caster<const std::array<std::uint8_t, 3>, 3>;
+template struct pybind11::detail::uint8_image_view_caster<std::array<std::uint8_t, 4>, 4>;
+
 /**
  * Generate python bindings for the eos library using pybind11.
  */
@@ -62,6 +76,7 @@ PYBIND11_MODULE(eos, eos_module)
      *  - LandmarkMapper
      *  - Mesh
      *  - write_obj(), write_textured_obj()
+     *  - write_ply(), write_glb(), write_glb_index_buffer()
      */
     py::module core_module = eos_module.def_submodule("core", "Essential functions and classes to work with 3D face models and landmarks.");
     
@@ -72,22 +87,52 @@ PYBIND11_MODULE(eos, eos_module)
 
     py::class_<core::Mesh>(core_module, "Mesh", "This class represents a 3D mesh consisting of vertices, vertex colour information and texture coordinates.")
         .def(py::init<>(), "Creates an empty mesh.")
-        .def_readwrite("vertices", &core::Mesh::vertices, "Vertices")
-        .def_readwrite("tvi", &core::Mesh::tvi, "Triangle vertex indices")
-        .def_readwrite("colors", &core::Mesh::colors, "Colour data")
-        .def_readwrite("tci", &core::Mesh::tci, "Triangle colour indices (usually the same as tvi)")
-        .def_readwrite("texcoords", &core::Mesh::texcoords, "Texture coordinates");
+        .def_property("vertices", [](const core::Mesh& mesh) { return mesh.vertices.to_vector(); },
+                      [](core::Mesh& mesh, const std::vector<Eigen::Vector3f>& vertices) {
+                          mesh.vertices = vertices;
+                      },
+                      "Vertices")
+        .def_property("tvi", &core::Mesh::tvi,
+                      [](core::Mesh& mesh, std::vector<std::array<int, 3>> tvi) {
+                          // The topology may be shared with other meshes, so it is replaced, not modified:
+                          core::MeshTopology topology = mesh.get_topology();
+                          topology.tvi = std::move(tvi);
+                          mesh.topology = std::make_shared<const core::MeshTopology>(std::move(topology));
+                      },
+                      "Triangle vertex indices")
+        .def_property("colors", [](const core::Mesh& mesh) { return mesh.colors.to_vector(); },
+                      [](core::Mesh& mesh, const std::vector<Eigen::Vector3f>& colors) { mesh.colors = colors; },
+                      "Colour data")
+        .def_property("tci", &core::Mesh::tci,
+                      [](core::Mesh& mesh, std::vector<std::array<int, 3>> tci) {
+                          core::MeshTopology topology = mesh.get_topology();
+                          topology.tci = std::move(tci);
+                          mesh.topology = std::make_shared<const core::MeshTopology>(std::move(topology));
+                      },
+                      "Triangle colour indices (usually the same as tvi)")
+        .def_property("texcoords", &core::Mesh::texcoords,
+                      [](core::Mesh& mesh, std::vector<Eigen::Vector2f> texcoords) {
+                          core::MeshTopology topology = mesh.get_topology();
+                          topology.texcoords = std::move(texcoords);
+                          mesh.topology = std::make_shared<const core::MeshTopology>(std::move(topology));
+                      },
+                      "Texture coordinates");
 
     core_module.def("write_obj", &core::write_obj, "Writes the given Mesh to an obj file.", py::arg("mesh"), py::arg("filename"));
     core_module.def("write_textured_obj", &core::write_textured_obj, "Writes the given Mesh to an obj file, including texture coordinates, and an mtl file containing a reference to the isomap. The texture (isomap) has to be saved separately.", py::arg("mesh"), py::arg("filename"));
 
-    core_module.def("read_obj", &core::read_obj, "Reads the given Wavefront .obj file into a Mesh.", py::arg("filename"));
+    core_module.def("write_ply", &core::write_ply, "Writes the given Mesh to a binary ply file.", py::arg("mesh"), py::arg("filename"));
+    core_module.def("write_glb", &core::write_glb, "Writes the given Mesh to a binary glTF 2.0 (.glb) file. If index_buffer_uri is given, the triangle indices are read from that file, which has to be written with write_glb_index_buffer().", py::arg("mesh"), py::arg("filename"), py::arg("index_buffer_uri") = "");
+    core_module.def("write_glb_index_buffer", &core::write_glb_index_buffer, "Writes the given triangle indices to a binary file that glb files can share.", py::arg("triangle_indices"), py::arg("filename"));
+
+    core_module.def("read_obj", &core::read_obj, "Reads the given Wavefront .obj file into a Mesh.", py::arg("filename"),
+                    py::arg("num_threads") = 1);
 
     /**
      * Bindings for the eos::morphablemodel namespace:
      *  - PcaModel
      *  - MorphableModel
-     *  - load_model(), save_model()
+     *  - load_model(), save_model(), load_mapped_model()
      *  - load_pca_model(), save_pca_model()
      */
     py::module morphablemodel_module = eos_module.def_submodule("morphablemodel", "Functionality to represent a Morphable Model, its PCA models, and functions to load models and blendshapes.");
@@ -98,11 +143,11 @@ PYBIND11_MODULE(eos, eos_module)
         .def("get_num_principal_components", &morphablemodel::PcaModel::get_num_principal_components, "Returns the number of principal components in the model.")
         .def("get_data_dimension", &morphablemodel::PcaModel::get_data_dimension, "Returns the dimension of the data, i.e. the number of shape dimensions.")
         .def("get_triangle_list", &morphablemodel::PcaModel::get_triangle_list, "Returns a list of triangles on how to assemble the vertices into a mesh.")
-        .def("get_mean", &morphablemodel::PcaModel::get_mean, "Returns the mean of the model.")
+        .def("get_mean", &morphablemodel::PcaModel::get_mean, py::return_value_policy::reference_internal, "Returns the mean of the model.")
         .def("get_mean_at_point", &morphablemodel::PcaModel::get_mean_at_point, "Return the value of the mean at a given vertex index.", py::arg("vertex_index"))
-        .def("get_orthonormal_pca_basis", &morphablemodel::PcaModel::get_orthonormal_pca_basis, "Returns the orthonormal PCA basis matrix, i.e. the eigenvectors. Each column of the matrix is an eigenvector.")
-        .def("get_rescaled_pca_basis", &morphablemodel::PcaModel::get_rescaled_pca_basis, "Returns the rescaled PCA basis matrix, i.e. the eigenvectors. Each column of the matrix is an eigenvector, and each eigenvector has been rescaled by multiplying it with the square root of its eigenvalue.")
-        .def("get_eigenvalues", &morphablemodel::PcaModel::get_eigenvalues, "Returns the models eigenvalues.")
+        .def("get_orthonormal_pca_basis", &morphablemodel::PcaModel::get_orthonormal_pca_basis, py::return_value_policy::reference_internal, "Returns the orthonormal PCA basis matrix, i.e. the eigenvectors. Each column of the matrix is an eigenvector.")
+        .def("get_rescaled_pca_basis", &morphablemodel::PcaModel::get_rescaled_pca_basis, py::return_value_policy::reference_internal, "Returns the rescaled PCA basis matrix, i.e. the eigenvectors. Each column of the matrix is an eigenvector, and each eigenvector has been rescaled by multiplying it with the square root of its eigenvalue.")
+        .def("get_eigenvalues", &morphablemodel::PcaModel::get_eigenvalues, py::return_value_policy::reference_internal, "Returns the models eigenvalues.")
         .def("draw_sample", (Eigen::VectorXf(morphablemodel::PcaModel::*)(std::vector<float>)const)&morphablemodel::PcaModel::draw_sample, "Returns a sample from the model with the given PCA coefficients. The given coefficients should follow a standard normal distribution, i.e. not be scaled with their eigenvalues/variances.", py::arg("coefficients"));
 
     py::class_<morphablemodel::MorphableModel>(morphablemodel_module, "MorphableModel", "A class representing a 3D Morphable Model, consisting of a shape- and colour (albedo) PCA model, as well as texture (uv) coordinates.")
@@ -116,6 +161,7 @@ PYBIND11_MODULE(eos, eos_module)
 
     morphablemodel_module.def("load_model", &morphablemodel::load_model, "Load a Morphable Model from a cereal::BinaryInputArchive (.bin) from the harddisk.", py::arg("filename"));
     morphablemodel_module.def("save_model", &morphablemodel::save_model, "Save a Morphable Model as cereal::BinaryOutputArchive.", py::arg("model"), py::arg("filename"));
+    morphablemodel_module.def("load_mapped_model", &morphablemodel::load_mapped_model, "Load a Morphable Model from a memory-mapped model file, without copying the model's data.", py::arg("filename"));
     morphablemodel_module.def("load_pca_model", &morphablemodel::load_pca_model, "Load a PCA model from a cereal::BinaryInputArchive (.bin) from the harddisk.", py::arg("filename"));
     morphablemodel_module.def("save_pca_model", &morphablemodel::save_pca_model, "Save a PCA model as cereal::BinaryOutputArchive.", py::arg("model"), py::arg("filename"));
 
@@ -154,7 +200,7 @@ PYBIND11_MODULE(eos, eos_module)
             }
             // Draw sample from colour model if color_coefficients given, otherwise set to empty:
             const Eigen::VectorXf albedo = color_coefficients.size() > 0 ? morphable_model.get_color_model().draw_sample(color_coefficients) : Eigen::VectorXf();
-            return morphablemodel::sample_to_mesh(shape, albedo, morphable_model.get_shape_model().get_triangle_list(), {}, morphable_model.get_texture_coordinates());
+            return morphablemodel::sample_to_mesh(shape, albedo, morphable_model.get_topology());
         },
         "Draws a sample with given shape, blendshape and colour coeffs, and returns a mesh.",
         py::arg("morphable_model"), py::arg("blendshapes"), py::arg("shape_coefficients"), py::arg("blendshape_coefficients"), py::arg("color_coefficients"));
@@ -283,7 +329,7 @@ PYBIND11_MODULE(eos, eos_module)
 
     render_module.def("extract_texture",
                       [](const core::Mesh& mesh, const fitting::RenderingParameters& rendering_params,
-                         const core::Image3u& image, bool compute_view_angle, int isomap_resolution) {
+                         core::ConstImageView3u image, bool compute_view_angle, int isomap_resolution) {
                           Eigen::Matrix<float, 3, 4> affine_from_ortho = fitting::get_3x4_affine_camera_matrix(rendering_params, image.cols, image.rows);
                           return render::extract_texture(mesh, affine_from_ortho, image, compute_view_angle, render::TextureInterpolation::NearestNeighbour, isomap_resolution);
                       },
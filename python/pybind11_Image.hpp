@@ -22,11 +22,18 @@
 #ifndef EOS_PYBIND11_IMAGE_HPP_
 #define EOS_PYBIND11_IMAGE_HPP_
 
+#include "eos/core/Image.hpp"
+
 #include "pybind11/numpy.h"
 
 #include "Eigen/Core"
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 NAMESPACE_BEGIN(pybind11)
@@ -34,140 +41,165 @@ NAMESPACE_BEGIN(detail)
 
 /**
  * @file python/pybind11_Image.hpp
- * @brief Transparent conversion to and from Python for eos::core::Image.
+ * @brief Transparent conversion to and from Python for eos::core::Image and eos::core::ImageView.
  *
- * Numpy uses row-major storage order by default.
- * eos::core::Image uses col-major storage (like Eigen).
- * 
- * If given non-standard strides or something from numpy, probably doesn't work.
- * May need to .clone()? in numpy before passing to the C++ function.
+ * Numpy uses row-major storage order by default, and so does eos::core::Image, with interleaved
+ * channels. So an image can be handed over in both directions without transposing it:
+ *  - An Image returned (by value) from C++ is moved into the numpy array, without copying its pixels.
+ *  - A numpy array is copied into an Image with one memcpy if it is C-contiguous, and pixel by pixel
+ *    otherwise (e.g. for a slice of a larger array).
+ *  - A numpy array that is passed to a function taking an ImageView is not copied at all. Its rows may be
+ *    padded (e.g. for a slice), but the channels of each pixel and the pixels of each row have to be
+ *    contiguous.
  */
 
-
 /**
- * @brief Transparent conversion for eos::core::Image3u to and from Python.
- *
- * Converts an eos::core::Image3u to and from Python. Can construct a eos::core::Image3u from numpy arrays,
- * as well as potentially other Python array types.
- *
- * Note: Not sure what happens if the given numpy array is not contiguous, not in default (row-major) storage
- *       order, or has non-standard strides. It may or may not work.
+ * @brief Conversion for eos::core::Image<std::array<std::uint8_t, num_channels>, num_channels> to and from
+ * numpy arrays of shape [m, n, num_channels] and type uint8.
  */
-template<>
-struct type_caster<eos::core::Image3u>
+template <int num_channels>
+struct uint8_image_caster
 {
+	using ImageType = eos::core::Image<std::array<std::uint8_t, num_channels>, num_channels>;
+
 	bool load(handle src, bool)
 	{
 		auto buf = pybind11::array::ensure(src);
 		if (!buf)
 			return false;
 
-		// Todo: We should probably check that buf.strides(i) is "default", by dividing it by the Scalar type or something.
-
 		if (!pybind11::isinstance<pybind11::array_t<std::uint8_t>>(buf))
 		{
 			return false; // we only convert uint8_t for now.
 		}
-
-		if (buf.ndim() != 3) {
-			return false; // we expected a numpy array with 3 dimensions.
+		if (buf.ndim() != 3 || buf.shape(2) != num_channels) {
+			return false; // We expected an image with num_channels channels.
 		}
-		// We got something with 3 dimensions, i.e. an image with 2, 3 or 4 channels (or 'k' for that matter):
-		if (buf.shape(2) != 3) {
-			return false; // We expected a 3-channel image.
+
+		value = ImageType(buf.shape(0), buf.shape(1));
+		if (buf.flags() & pybind11::array::c_style)
+		{
+			std::memcpy(value.data.data(), buf.data(), value.data.size() * num_channels);
+			return true;
 		}
-		
-		// Note: If our Image class had support for col/row major, we could just map buf.mutable_data().
-		// Like with OpenCV: value = cv::Mat(buf.shape(0), buf.shape(1), opencv_type, buf.mutable_data());
-		// But since it doesn't, we just copy the data for now:
-		value = eos::core::Image3u(buf.shape(0), buf.shape(1));
-		array_t<std::uint8_t> buf_as_array(buf);
-		for (int r = 0; r < buf.shape(0); ++r) {
-			for (int c = 0; c < buf.shape(1); ++c) {
-				value(r, c)[0] = buf_as_array.at(r, c, 0);
-				value(r, c)[1] = buf_as_array.at(r, c, 1);
-				value(r, c)[2] = buf_as_array.at(r, c, 2);
+		const array_t<std::uint8_t> buf_as_array(buf);
+		const auto pixels = buf_as_array.template unchecked<3>();
+		for (ssize_t r = 0; r < buf.shape(0); ++r) {
+			for (ssize_t c = 0; c < buf.shape(1); ++c) {
+				for (int ch = 0; ch < num_channels; ++ch) {
+					value(r, c)[ch] = pixels(r, c, ch);
+				}
 			}
 		}
 		return true;
 	};
 
-    static handle cast(const eos::core::Image3u& src, return_value_policy /* policy */, handle /* parent */)
+	static handle cast(const ImageType& src, return_value_policy /* policy */, handle /* parent */)
 	{
-		const std::size_t num_channels = 3;
-		std::vector<std::size_t> shape = { src.rows, src.cols, num_channels };
+		// Without a base object, pybind11 copies the pixels into the array:
+		return array(pybind11::dtype::of<std::uint8_t>(), shape(src), strides(src), src.data.data()).release();
+	};
 
-		// (2048, 4, 1) is default which results in transposed image
-		// Below line works now. In numpy the strides are (2048, 4, 1) though. I think a copy gets created nevertheless?
-		std::vector<std::size_t> strides = { num_channels, num_channels * src.rows, 1 }; // might be cols or rows...? I think rows?
-		return array(pybind11::dtype::of<std::uint8_t>(), shape, strides, &src.data[0]).release();
+	static handle cast(ImageType&& src, return_value_policy /* policy */, handle /* parent */)
+	{
+		// Move the image to the heap, and let the numpy array own it, so its pixels don't have to be copied:
+		ImageType* moved = new ImageType(std::move(src));
+		capsule base(moved, [](void* image) { delete reinterpret_cast<ImageType*>(image); });
+		return array(pybind11::dtype::of<std::uint8_t>(), shape(*moved), strides(*moved), moved->data.data(), base)
+			.release();
 	};
 
-    PYBIND11_TYPE_CASTER(eos::core::Image3u, _("numpy.ndarray[uint8[m, n, 3]]"));
+	PYBIND11_TYPE_CASTER(ImageType, _("numpy.ndarray[uint8[m, n, ") + _<num_channels>() + _("]]"));
+
+private:
+	static std::vector<std::size_t> shape(const ImageType& image)
+	{
+		return { image.rows, image.cols, num_channels };
+	};
+	static std::vector<std::size_t> strides(const ImageType& image)
+	{
+		return { num_channels * image.cols, num_channels, 1 }; // row-major, with interleaved channels
+	};
 };
 
 /**
- * @brief Transparent conversion for eos::core::Image4u to and from Python.
- *
- * Converts an eos::core::Image4u to and from Python. Can construct a eos::core::Image4u from numpy arrays,
- * as well as potentially other Python array types.
+ * @brief Conversion from numpy arrays of shape [m, n, num_channels] and type uint8 to an
+ * eos::core::ImageView, without copying the pixels.
  *
- * Note: Not sure what happens if the given numpy array is not contiguous, not in default (row-major) storage
- *       order, or has non-standard strides. It may or may not work.
+ * The view refers to the numpy array's buffer, so it's only valid for the duration of the call.
  */
-template<>
-struct type_caster<eos::core::Image4u>
+template <class T, int num_channels>
+struct uint8_image_view_caster
 {
+	using ImageViewType = eos::core::ImageView<T, num_channels>;
+
 	bool load(handle src, bool)
 	{
-		auto buf = pybind11::array::ensure(src);
-		if (!buf)
-			return false;
-
-		// Todo: We should probably check that buf.strides(i) is "default", by dividing it by the Scalar type or something.
-
-		if (!pybind11::isinstance<pybind11::array_t<std::uint8_t>>(buf))
+		if (!pybind11::isinstance<pybind11::array_t<std::uint8_t>>(src))
 		{
-			return false; // we only convert uint8_t for now.
+			return false; // We don't convert other types, as we'd have to copy, and the view couldn't own the copy.
 		}
-
-		if (buf.ndim() != 3) {
-			return false; // we expected a numpy array with 3 dimensions.
+		auto buf = reinterpret_borrow<array>(src);
+		if (buf.ndim() != 3 || buf.shape(2) != num_channels) {
+			return false; // We expected an image with num_channels channels.
 		}
-		// We got something with 3 dimensions, i.e. an image with 2, 3 or 4 channels (or 'k' for that matter):
-		if (buf.shape(2) != 4) {
-			return false; // We expected a 4-channel image.
+		// The channels of a pixel and the pixels of a row have to be contiguous, the rows can be padded:
+		const ssize_t pixel_size = num_channels * sizeof(std::uint8_t);
+		if (buf.strides(2) != 1 || buf.strides(1) != pixel_size || buf.strides(0) % pixel_size != 0 ||
+			buf.strides(0) < buf.shape(1) * pixel_size)
+		{
+			return false;
 		}
-
-		// Note: If our Image class had support for col/row major, we could just map buf.mutable_data().
-		// Like with OpenCV: value = cv::Mat(buf.shape(0), buf.shape(1), opencv_type, buf.mutable_data());
-		// But since it doesn't, we just copy the data for now:
-		value = eos::core::Image4u(buf.shape(0), buf.shape(1));
-		array_t<std::uint8_t> buf_as_array(buf);
-		for (int r = 0; r < buf.shape(0); ++r) {
-			for (int c = 0; c < buf.shape(1); ++c) {
-				value(r, c)[0] = buf_as_array.at(r, c, 0);
-				value(r, c)[1] = buf_as_array.at(r, c, 1);
-				value(r, c)[2] = buf_as_array.at(r, c, 2);
-				value(r, c)[3] = buf_as_array.at(r, c, 3);
-			}
+		if (!std::is_const<T>::value && !buf.writeable())
+		{
+			return false;
 		}
+		value = ImageViewType(reinterpret_cast<T*>(const_cast<void*>(buf.data())), buf.shape(0), buf.shape(1),
+			buf.strides(0) / pixel_size);
 		return true;
 	};
 
-    static handle cast(const eos::core::Image4u& src, return_value_policy /* policy */, handle /* parent */)
+	static handle cast(const ImageViewType& src, return_value_policy /* policy */, handle /* parent */)
 	{
-		const std::size_t num_chanels = 4;
-		std::vector<std::size_t> shape;
-		shape = { src.rows, src.cols, num_chanels };
-
-		// (2048, 4, 1) is default which results in transposed image
-		// Below line works now. In numpy the strides are (2048, 4, 1) though. I think a copy gets created nevertheless?
-		std::vector<size_t> strides = { num_chanels, num_chanels * src.rows, 1 }; // might be cols or rows...? I think rows?
-		return array(pybind11::dtype::of<std::uint8_t>(), shape, strides, &src.data[0]).release();
+		// A view can't own its pixels, so we return a copy:
+		const std::vector<std::size_t> shape = { src.rows, src.cols, num_channels };
+		const std::vector<std::size_t> strides = { num_channels * src.stride, num_channels, 1 };
+		return array(pybind11::dtype::of<std::uint8_t>(), shape, strides, src.data).release();
 	};
 
-    PYBIND11_TYPE_CASTER(eos::core::Image4u, _("numpy.ndarray[uint8[m, n, 4]]"));
+	PYBIND11_TYPE_CASTER(ImageViewType, _("numpy.ndarray[uint8[m, n, ") + _<num_channels>() + _("]]"));
+};
+
+/**
+ * @brief Transparent conversion for eos::core::Image3u to and from Python.
+ */
+template<>
+struct type_caster<eos::core::Image3u> : uint8_image_caster<3>
+{
+};
+
+/**
+ * @brief Transparent conversion for eos::core::Image4u to and from Python.
+ */
+template<>
+struct type_caster<eos::core::Image4u> : uint8_image_caster<4>
+{
+};
+
+template<>
+struct type_caster<eos::core::ImageView3u> : uint8_image_view_caster<std::array<std::uint8_t, 3>, 3>
+{
+};
+
+template<>
+struct type_caster<eos::core::ImageView<const std::array<std::uint8_t, 3>, 3>>
+	: uint8_image_view_caster<const std::array<std::uint8_t, 3>, 3>
+{
+};
+
+template<>
+struct type_caster<eos::core::ImageView4u> : uint8_image_view_caster<std::array<std::uint8_t, 4>, 4>
+{
 };
 
 NAMESPACE_END(detail)
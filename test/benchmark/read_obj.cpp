@@ -0,0 +1,69 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/benchmark/read_obj.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/read_obj.hpp"
+
+#include "synthetic_mesh.hpp"
+#include "synthetic_obj.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+using namespace eos;
+
+namespace {
+
+void benchmark_read_obj(int rings, int segments, const std::string& name)
+{
+    const std::string filename =
+        (std::filesystem::temp_directory_path() / ("eos_benchmark_" + name + ".obj")).string();
+    test::write_synthetic_obj(test::make_sphere(rings, segments), filename);
+    const int num_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+
+    BENCHMARK("old reader (std::getline and std::string tokens)")
+    {
+        return test::read_obj_reference(filename);
+    };
+    BENCHMARK("read_obj, 1 thread")
+    {
+        return core::read_obj(filename, 1);
+    };
+    BENCHMARK("read_obj, " + std::to_string(num_threads) + " threads")
+    {
+        return core::read_obj(filename, num_threads);
+    };
+    std::remove(filename.c_str());
+};
+
+} // namespace
+
+TEST_CASE("Reading an obj file with 53465 vertices (9 MB)", "[read_obj]")
+{
+    benchmark_read_obj(185, 289, "read_obj_bfm_sized");
+}
+
+TEST_CASE("Reading an obj file with 1000000 vertices (180 MB)", "[read_obj]")
+{
+    benchmark_read_obj(1000, 1000, "read_obj_1m");
+}
@@ -0,0 +1,78 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/benchmark/render_depth.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/render/render.hpp"
+#include "eos/render/render_affine.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include "Eigen/Core"
+
+using namespace eos;
+
+namespace {
+
+void benchmark_render_depth(const core::Mesh& mesh)
+{
+    // The mesh covers a large part of a 640x480 image:
+    const glm::tmat4x4<float> model_view =
+        glm::translate(glm::tmat4x4<float>(1.0f), glm::tvec3<float>(0.0f, 0.0f, -2.5f));
+    const glm::tmat4x4<float> projection = glm::perspective(0.8f, 4.0f / 3.0f, 0.1f, 100.0f);
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 200.0f;
+    affine_camera_matrix(1, 1) = -200.0f;
+    affine_camera_matrix(2, 2) = 1.0f;
+    affine_camera_matrix(0, 3) = 320.0f;
+    affine_camera_matrix(1, 3) = 240.0f;
+
+    BENCHMARK("render")
+    {
+        return render::render(mesh, model_view, projection, 640, 480);
+    };
+    BENCHMARK("render_depth")
+    {
+        return render::render_depth(mesh, model_view, projection, 640, 480);
+    };
+    BENCHMARK("render_affine")
+    {
+        return render::render_affine(mesh, affine_camera_matrix, 640, 480);
+    };
+    BENCHMARK("render_affine_depth")
+    {
+        return render::render_affine_depth(mesh, affine_camera_matrix, 640, 480);
+    };
+};
+
+} // namespace
+
+TEST_CASE("Depth-only rendering of a mesh with 3440 vertices", "[render_depth]")
+{
+    benchmark_render_depth(test::make_sfm_sized_sphere());
+}
+
+TEST_CASE("Depth-only rendering of a mesh with 53465 vertices", "[render_depth]")
+{
+    benchmark_render_depth(test::make_bfm_sized_sphere());
+}
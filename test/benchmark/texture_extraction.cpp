@@ -0,0 +1,96 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/benchmark/texture_extraction.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Image.hpp"
+#include "eos/render/texture_extraction.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <string>
+
+using namespace eos;
+
+namespace {
+
+// An image with some structure in all three channels, so that the interpolation has something to do.
+core::Image3u make_test_image(int width, int height)
+{
+    core::Image3u image(height, width);
+    for (int r = 0; r < height; ++r)
+    {
+        for (int c = 0; c < width; ++c)
+        {
+            image(r, c) = {static_cast<std::uint8_t>(c * 7), static_cast<std::uint8_t>(r * 5),
+                           static_cast<std::uint8_t>((r + c) * 3)};
+        }
+    }
+    return image;
+};
+
+void benchmark_extract_texture(const core::Mesh& mesh, int isomap_resolution)
+{
+    // The mesh covers about 400x400 pixels of a 640x480 image:
+    const core::Image3u image = make_test_image(640, 480);
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 200.0f;
+    affine_camera_matrix(1, 1) = -200.0f;
+    affine_camera_matrix(2, 2) = 1.0f;
+    affine_camera_matrix(0, 3) = 320.0f;
+    affine_camera_matrix(1, 3) = 240.0f;
+
+    const std::string resolution = std::to_string(isomap_resolution);
+    BENCHMARK("NearestNeighbour, isomap " + resolution)
+    {
+        return render::extract_texture(mesh, affine_camera_matrix, image, false,
+                                       render::TextureInterpolation::NearestNeighbour, isomap_resolution);
+    };
+    BENCHMARK("Bilinear, isomap " + resolution)
+    {
+        return render::extract_texture(mesh, affine_camera_matrix, image, false,
+                                       render::TextureInterpolation::Bilinear, isomap_resolution);
+    };
+    BENCHMARK("Area, isomap " + resolution)
+    {
+        return render::extract_texture(mesh, affine_camera_matrix, image, false,
+                                       render::TextureInterpolation::Area, isomap_resolution);
+    };
+};
+
+} // namespace
+
+// The isomap of 1024 magnifies the image, the one of 256 minifies it, where the area mapping averages
+// over several pixels:
+TEST_CASE("Texture extraction from a mesh with 3440 vertices", "[texture_extraction]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    benchmark_extract_texture(mesh, 256);
+    benchmark_extract_texture(mesh, 1024);
+}
+
+TEST_CASE("Texture extraction from a mesh with 53465 vertices", "[texture_extraction]")
+{
+    const core::Mesh mesh = test::make_bfm_sized_sphere();
+    benchmark_extract_texture(mesh, 256);
+    benchmark_extract_texture(mesh, 1024);
+}
@@ -0,0 +1,95 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/benchmark/vertex_processing.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/render/detail/vertex_processing.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <vector>
+
+using namespace eos;
+
+namespace {
+
+// How the renderers transformed the vertices before the batched vertex processing stage: One 4x4
+// product per vertex, and the outcodes of each triangle corner.
+std::vector<Eigen::Vector4f> transform_each_vertex(const core::Mesh& mesh, const Eigen::Matrix4f& transform)
+{
+    std::vector<Eigen::Vector4f> transformed;
+    for (const auto& vertex : mesh.vertices)
+    {
+        transformed.push_back(transform * Eigen::Vector4f(vertex[0], vertex[1], vertex[2], 1.0f));
+    }
+    return transformed;
+};
+
+std::vector<std::uint8_t> compute_corner_outcodes(const core::Mesh& mesh,
+                                                  const std::vector<Eigen::Vector4f>& clipspace_vertices)
+{
+    std::vector<std::uint8_t> outcodes;
+    for (const auto& triangle : mesh.tvi())
+    {
+        for (const int index : triangle)
+        {
+            const Eigen::Vector4f& v = clipspace_vertices[index];
+            outcodes.push_back(render::detail::compute_outcode(v[0], v[1], v[2], v[3], true, true));
+        }
+    }
+    return outcodes;
+};
+
+void benchmark_vertex_processing(const core::Mesh& mesh)
+{
+    Eigen::Matrix4f transform = Eigen::Matrix4f::Identity();
+    transform(0, 3) = 0.1f;
+    transform(2, 2) = 0.5f;
+
+    BENCHMARK("One 4x4 product per vertex, outcodes per triangle corner")
+    {
+        const std::vector<Eigen::Vector4f> transformed = transform_each_vertex(mesh, transform);
+        return compute_corner_outcodes(mesh, transformed);
+    };
+    BENCHMARK("transform_vertices")
+    {
+        return render::detail::transform_vertices(mesh.vertices.as_matrix(), transform);
+    };
+    BENCHMARK("transform_vertices and compute_outcodes")
+    {
+        const Eigen::Matrix<float, 4, Eigen::Dynamic> transformed =
+            render::detail::transform_vertices(mesh.vertices.as_matrix(), transform);
+        return render::detail::compute_outcodes(transformed, true, true);
+    };
+};
+
+} // namespace
+
+TEST_CASE("Vertex processing of a mesh with 3440 vertices", "[vertex_processing]")
+{
+    benchmark_vertex_processing(test::make_sfm_sized_sphere());
+}
+
+TEST_CASE("Vertex processing of a mesh with 53465 vertices", "[vertex_processing]")
+{
+    benchmark_vertex_processing(test::make_bfm_sized_sphere());
+}
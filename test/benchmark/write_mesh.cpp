@@ -0,0 +1,100 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/benchmark/write_mesh.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Mesh.hpp"
+#include "eos/core/write_mesh.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace eos;
+
+namespace {
+
+/**
+ * Writes meshes with the given function for about a second, and prints how many meshes per
+ * second it writes. That's the number that matters when writing a mesh per frame of a video.
+ *
+ * The files go to the temporary directory. On a disk, the writers are mostly limited by the disk,
+ * so set TMPDIR to a RAM disk (e.g. /dev/shm) to measure the writers themselves.
+ */
+template <typename WriteMesh>
+void report_meshes_per_second(const std::string& name, WriteMesh write_mesh)
+{
+    using clock = std::chrono::steady_clock;
+    write_mesh(); // Warm-up, e.g. to create the file.
+    int num_meshes = 0;
+    const auto start = clock::now();
+    do
+    {
+        write_mesh();
+        ++num_meshes;
+    } while (clock::now() - start < std::chrono::seconds(1));
+    const double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << name << ": " << num_meshes / seconds << " meshes/s\n";
+};
+
+void benchmark_write_mesh(const core::Mesh& mesh)
+{
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string obj_filename = (directory / "eos_benchmark_write_mesh.obj").string();
+    const std::string textured_obj_filename = (directory / "eos_benchmark_write_mesh_textured.obj").string();
+    const std::string ply_filename = (directory / "eos_benchmark_write_mesh.ply").string();
+    const std::string glb_filename = (directory / "eos_benchmark_write_mesh.glb").string();
+    const std::string index_buffer_filename = (directory / "eos_benchmark_write_mesh.bin").string();
+    core::write_glb_index_buffer(mesh.tvi(), index_buffer_filename);
+
+    std::cout << "Writing a mesh with " << mesh.vertices.size() << " vertices to " << directory.string()
+              << ":\n";
+    report_meshes_per_second("write_obj", [&]() { core::write_obj(mesh, obj_filename); });
+    report_meshes_per_second("write_textured_obj",
+                             [&]() { core::write_textured_obj(mesh, textured_obj_filename); });
+    report_meshes_per_second("write_ply", [&]() { core::write_ply(mesh, ply_filename); });
+    report_meshes_per_second("write_glb", [&]() { core::write_glb(mesh, glb_filename); });
+    report_meshes_per_second("write_glb, shared index buffer", [&]() {
+        core::write_glb(mesh, glb_filename, "eos_benchmark_write_mesh.bin");
+    });
+
+    for (const auto& filename :
+         {obj_filename, textured_obj_filename, ply_filename, glb_filename, index_buffer_filename})
+    {
+        std::remove(filename.c_str());
+    }
+    const std::string mtl_filename = (directory / "eos_benchmark_write_mesh_textured.mtl").string();
+    std::remove(mtl_filename.c_str());
+};
+
+} // namespace
+
+TEST_CASE("Meshes per second written with 3440 vertices", "[write_mesh]")
+{
+    benchmark_write_mesh(test::make_sfm_sized_sphere());
+}
+
+TEST_CASE("Meshes per second written with 53465 vertices", "[write_mesh]")
+{
+    benchmark_write_mesh(test::make_bfm_sized_sphere());
+}
@@ -0,0 +1,243 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/clipping.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Mesh.hpp"
+#include "eos/core/MeshTopology.hpp"
+#include "eos/render/detail/PolygonToClip.hpp"
+#include "eos/render/detail/Vertex.hpp"
+#include "eos/render/detail/render_detail_utils.hpp"
+#include "eos/render/detail/vertex_processing.hpp"
+#include "eos/render/render.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec2.hpp"
+#include "glm/vec3.hpp"
+#include "glm/vec4.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace eos;
+using render::detail::PolygonToClip;
+using render::detail::Vertex;
+
+namespace {
+
+// The clipper that the renderers used before the fixed-capacity PolygonToClip, to compare against. It
+// differs from the current one only for vertices that lie exactly on a plane, which it drops.
+std::vector<Vertex<float>> reference_clip_polygon_to_plane_in_4d(const std::vector<Vertex<float>>& vertices,
+                                                                 const glm::tvec4<float>& plane_normal)
+{
+    std::vector<Vertex<float>> clipped_vertices;
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        const int a = i;
+        const int b = (i + 1) % vertices.size();
+        const float fa = glm::dot(vertices[a].position, plane_normal);
+        const float fb = glm::dot(vertices[b].position, plane_normal);
+        if ((fa < 0 && fb > 0) || (fa > 0 && fb < 0))
+        {
+            const auto direction = vertices[b].position - vertices[a].position;
+            const float t =
+                -(glm::dot(plane_normal, vertices[a].position)) / (glm::dot(plane_normal, direction));
+            const auto position = vertices[a].position + t * direction;
+            const auto color = vertices[a].color + t * (vertices[b].color - vertices[a].color);
+            const auto texcoords =
+                vertices[a].texcoords + t * (vertices[b].texcoords - vertices[a].texcoords);
+            if (fa < 0)
+            {
+                clipped_vertices.push_back(vertices[a]);
+                clipped_vertices.push_back(Vertex<float>{position, color, texcoords});
+            } else if (fb < 0)
+            {
+                clipped_vertices.push_back(Vertex<float>{position, color, texcoords});
+            }
+        } else if (fa < 0 && fb < 0)
+        {
+            clipped_vertices.push_back(vertices[a]);
+        }
+    }
+    return clipped_vertices;
+};
+
+const glm::tvec4<float> frustum_planes[6] = {
+    glm::tvec4<float>(-1.0f, 0.0f, 0.0f, -1.0f), glm::tvec4<float>(1.0f, 0.0f, 0.0f, -1.0f),
+    glm::tvec4<float>(0.0f, -1.0f, 0.0f, -1.0f), glm::tvec4<float>(0.0f, 1.0f, 0.0f, -1.0f),
+    glm::tvec4<float>(0.0f, 0.0f, -1.0f, -1.0f), glm::tvec4<float>(0.0f, 0.0f, 1.0f, -1.0f)};
+
+void check_same_polygon(const PolygonToClip<float>& polygon, const std::vector<Vertex<float>>& expected)
+{
+    REQUIRE(polygon.size == static_cast<int>(expected.size()));
+    for (int i = 0; i < polygon.size; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            CHECK(polygon[i].position[j] == Approx(expected[i].position[j]).margin(1e-6));
+        }
+        for (int j = 0; j < 3; ++j)
+        {
+            CHECK(polygon[i].color[j] == Approx(expected[i].color[j]).margin(1e-6));
+        }
+        for (int j = 0; j < 2; ++j)
+        {
+            CHECK(polygon[i].texcoords[j] == Approx(expected[i].texcoords[j]).margin(1e-6));
+        }
+    }
+};
+
+} // namespace
+
+TEST_CASE("clip_polygon_to_frustum gives the same polygons as the previous clipper", "[clipping]")
+{
+    std::mt19937 engine(42);
+    std::uniform_real_distribution<float> coordinate(-3.0f, 3.0f);
+    std::uniform_real_distribution<float> w(-0.5f, 2.0f);
+    std::uniform_real_distribution<float> attribute(0.0f, 1.0f);
+    std::uniform_int_distribution<unsigned int> planes_distribution(0, 63);
+
+    for (int n = 0; n < 2000; ++n)
+    {
+        PolygonToClip<float> polygon;
+        std::vector<Vertex<float>> expected;
+        for (int k = 0; k < 3; ++k)
+        {
+            const Vertex<float> vertex{
+                glm::tvec4<float>(coordinate(engine), coordinate(engine), coordinate(engine), w(engine)),
+                glm::tvec3<float>(attribute(engine), attribute(engine), attribute(engine)),
+                glm::tvec2<float>(attribute(engine), attribute(engine))};
+            polygon.push_back(vertex);
+            expected.push_back(vertex);
+        }
+        // The planes are clipped against one after the other, in the order of the outcode bits:
+        const unsigned int planes = planes_distribution(engine);
+        for (int i = 0; i < 6 && !expected.empty(); ++i)
+        {
+            if (planes & (1u << i))
+            {
+                expected = reference_clip_polygon_to_plane_in_4d(expected, frustum_planes[i]);
+            }
+        }
+        render::detail::clip_polygon_to_frustum(polygon, planes);
+        check_same_polygon(polygon, expected);
+    }
+}
+
+TEST_CASE("A triangle clipped against all six planes stays within the frustum", "[clipping]")
+{
+    PolygonToClip<float> polygon;
+    polygon.push_back({glm::tvec4<float>(-5.0f, -5.0f, -0.5f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    polygon.push_back({glm::tvec4<float>(5.0f, -5.0f, 0.5f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    polygon.push_back({glm::tvec4<float>(0.0f, 5.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    render::detail::clip_polygon_to_frustum(polygon, 63u);
+
+    REQUIRE(polygon.size >= 3);
+    REQUIRE(polygon.size <= PolygonToClip<float>::max_vertices);
+    for (int i = 0; i < polygon.size; ++i)
+    {
+        const auto& p = polygon[i].position;
+        CHECK(render::detail::compute_outcode(p[0] * 0.9999f, p[1] * 0.9999f, p[2] * 0.9999f, p[3], true,
+                                              true) == 0);
+    }
+}
+
+TEST_CASE("Triangles are only clipped against the guard band if they extend beyond it", "[clipping]")
+{
+    const float guard_band = render::detail::guard_band_size;
+    PolygonToClip<float> inside;
+    inside.push_back({glm::tvec4<float>(-3.0f, -3.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                      glm::tvec2<float>(0.0f)});
+    inside.push_back({glm::tvec4<float>(3.0f, -3.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                      glm::tvec2<float>(0.0f)});
+    inside.push_back({glm::tvec4<float>(0.0f, 3.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                      glm::tvec2<float>(0.0f)});
+    CHECK(render::detail::compute_guard_band_planes(inside) == 0);
+
+    PolygonToClip<float> beyond = inside;
+    beyond[1].position = glm::tvec4<float>(1000.0f, -3.0f, 0.0f, 1.0f);
+    const unsigned int planes = render::detail::compute_guard_band_planes(beyond);
+    CHECK(planes == 2u);
+    render::detail::clip_polygon_to_frustum(beyond, planes, guard_band);
+    REQUIRE(beyond.size == 4);
+    for (int i = 0; i < beyond.size; ++i)
+    {
+        CHECK(beyond[i].position[0] <= guard_band * beyond[i].position[3] + 1e-4f);
+    }
+}
+
+TEST_CASE("Clipping against the guard band doesn't change the rendered image", "[clipping]")
+{
+    // Two quads that both cover the whole viewport with the same colour. The first one extends beyond
+    // the guard band and is clipped, the second one isn't:
+    const auto make_quad = [](float size) {
+        core::MeshTopology topology;
+        topology.tvi = {{0, 1, 2}, {0, 2, 3}};
+        topology.texcoords = {Eigen::Vector2f(0.0f, 0.0f), Eigen::Vector2f(1.0f, 0.0f),
+                              Eigen::Vector2f(1.0f, 1.0f), Eigen::Vector2f(0.0f, 1.0f)};
+        core::Mesh mesh;
+        mesh.vertices = std::vector<Eigen::Vector3f>{
+            Eigen::Vector3f(-size, -size, -0.5f), Eigen::Vector3f(size, -size, -0.5f),
+            Eigen::Vector3f(size, size, -0.5f), Eigen::Vector3f(-size, size, -0.5f)};
+        mesh.colors = std::vector<Eigen::Vector3f>(4, Eigen::Vector3f(0.2f, 0.4f, 0.6f));
+        mesh.topology = std::make_shared<const core::MeshTopology>(topology);
+        return mesh;
+    };
+    const glm::tmat4x4<float> model_view(1.0f);
+    const glm::tmat4x4<float> projection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, 0.1f, 10.0f);
+
+    const auto clipped = render::render(make_quad(1000.0f), model_view, projection, 64, 48);
+    const auto unclipped = render::render(make_quad(1.5f), model_view, projection, 64, 48);
+    // The colours are interpolated from the clipped vertices, so they can differ by rounding:
+    for (int r = 0; r < 48; ++r)
+    {
+        for (int c = 0; c < 64; ++c)
+        {
+            for (int ch = 0; ch < 4; ++ch)
+            {
+                CHECK(std::abs(clipped.first(r, c)[ch] - unclipped.first(r, c)[ch]) <= 1);
+            }
+            CHECK(clipped.second(r, c) == Approx(unclipped.second(r, c)).margin(1e-6));
+        }
+    }
+    CHECK(clipped.first(20, 30)[3] == 255);
+}
+
+TEST_CASE("Vertices that lie on a clipping plane are kept", "[clipping]")
+{
+    // Clipping against the right side of the guard band creates a vertex at (8, 8), which lies exactly on
+    // the top side:
+    PolygonToClip<float> polygon;
+    polygon.push_back({glm::tvec4<float>(-9.0f, -9.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    polygon.push_back({glm::tvec4<float>(9.0f, -9.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    polygon.push_back({glm::tvec4<float>(9.0f, 9.0f, 0.0f, 1.0f), glm::tvec3<float>(0.0f),
+                       glm::tvec2<float>(0.0f)});
+    render::detail::clip_polygon_to_frustum(polygon, 15u, render::detail::guard_band_size);
+    REQUIRE(polygon.size == 3);
+}
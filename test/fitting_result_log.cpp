@@ -0,0 +1,119 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/fitting_result_log.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/fitting/FittingResult.hpp"
+#include "eos/fitting/FittingResultLog.hpp"
+#include "eos/fitting/RenderingParameters.hpp"
+
+#include "catch2/catch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+using namespace eos;
+
+namespace {
+
+std::string temp_log_filename(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("eos_test_" + name + ".eosfit")).string();
+};
+
+fitting::FittingResult make_fitting_result(int frame)
+{
+    fitting::FittingResult fitting_result;
+    fitting_result.rendering_parameters = fitting::RenderingParameters(
+        fitting::CameraType::Orthographic, fitting::Frustum(-1.0f, 1.0f, -1.0f, 1.0f), 0.1f * frame, 0.0f,
+        0.0f, 2.0f * frame, -1.0f, 640, 480);
+    fitting_result.pca_shape_coefficients = {1.0f * frame, -0.5f, 0.25f};
+    fitting_result.expression_coefficients = {0.5f * frame};
+    return fitting_result;
+};
+
+} // namespace
+
+TEST_CASE("FittingResultLogWriter::flush makes the records readable before the log is closed",
+          "[fitting_result_log]")
+{
+    const std::string filename = temp_log_filename("fitting_result_log_flush");
+    fitting::FittingResultLogWriter writer(filename, 3, 1);
+    for (int frame = 0; frame < 5; ++frame)
+    {
+        writer.add(100 + frame, make_fitting_result(frame));
+    }
+    writer.flush();
+
+    const fitting::FittingResultLogReader reader(filename);
+    REQUIRE(reader.get_num_records() == 5);
+    CHECK(reader.get_frame_number(4) == 104);
+    CHECK(reader.read(3).pca_shape_coefficients == std::vector<float>{3.0f, -0.5f, 0.25f});
+    writer.close();
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("FittingResultLogWriter::flush throws if the records can't be written", "[fitting_result_log]")
+{
+    if (!std::filesystem::exists("/dev/full"))
+    {
+        return; // Writing to /dev/full always fails, but only some systems have it.
+    }
+    fitting::FittingResultLogWriter writer("/dev/full", 3, 1);
+    writer.add(0, make_fitting_result(0));
+    CHECK_THROWS_AS(writer.flush(), std::runtime_error);
+}
+
+TEST_CASE("FittingResultLogReader doesn't read a partly written footer as records", "[fitting_result_log]")
+{
+    const std::string filename = temp_log_filename("fitting_result_log_footer");
+    const int num_frames = 20;
+    {
+        fitting::FittingResultLogWriter writer(filename, 3, 1);
+        for (int frame = 0; frame < num_frames; ++frame)
+        {
+            writer.add(100 + frame, make_fitting_result(frame));
+        }
+        writer.close();
+    }
+    const auto size = std::filesystem::file_size(filename);
+    {
+        const fitting::FittingResultLogReader reader(filename);
+        REQUIRE(reader.get_num_records() == num_frames);
+        CHECK(reader.find_frame(107) == std::size_t(7));
+    }
+
+    // The footer (8 + 8 * 20 + 8 + 8 bytes) is longer than a record (8 + 3 * 4 + 10 * 4 + 4 * 4 bytes),
+    // so a part of it could be taken for a record. Cut the file in every byte of the footer:
+    const std::uintmax_t footer_size = 8 + 8 * num_frames + 8 + 8;
+    REQUIRE(footer_size > 8 + 3 * 4 + 10 * 4 + 4 * 4);
+    for (std::uintmax_t footer_part = footer_size - 1; footer_part > 0; --footer_part)
+    {
+        std::filesystem::resize_file(filename, size - footer_size + footer_part);
+        const fitting::FittingResultLogReader reader(filename);
+        INFO("With " << footer_part << " bytes of the footer");
+        REQUIRE(reader.get_num_records() == num_frames);
+        CHECK(reader.get_frame_numbers().back() == 100 + num_frames - 1);
+        CHECK(reader.find_frame(107) == std::size_t(7));
+        CHECK(reader.read(19).expression_coefficients == std::vector<float>{9.5f});
+    }
+    std::remove(filename.c_str());
+}
@@ -0,0 +1,179 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/image_view.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Image.hpp"
+#include "eos/render/render.hpp"
+#include "eos/render/render_affine.hpp"
+#include "eos/render/texture_extraction.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include "Eigen/Core"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using namespace eos;
+
+namespace {
+
+// A buffer with room for a 320x240 view at (x, y) = (16, 8), with padded rows, and a marker value
+// everywhere, to check that nothing outside the view is written:
+template <class T, int num_channels>
+core::ImageView<T, num_channels> make_padded_view(core::Image<T, num_channels>& buffer, const T& marker)
+{
+    buffer = core::Image<T, num_channels>(260, 400);
+    core::fill(core::ImageView<T, num_channels>(buffer), marker);
+    return core::ImageView<T, num_channels>(&buffer(8, 16), 240, 320, buffer.cols);
+};
+
+template <class T, int num_channels>
+void check_view_equals_image(const core::ImageView<T, num_channels>& view,
+                             const core::Image<T, num_channels>& image)
+{
+    REQUIRE(view.rows == image.rows);
+    REQUIRE(view.cols == image.cols);
+    for (std::size_t r = 0; r < image.rows; ++r)
+    {
+        for (std::size_t c = 0; c < image.cols; ++c)
+        {
+            CHECK(view(r, c) == image(r, c));
+        }
+    }
+};
+
+template <class T, int num_channels>
+void check_only_view_written(const core::Image<T, num_channels>& buffer, const T& marker)
+{
+    for (std::size_t r = 0; r < buffer.rows; ++r)
+    {
+        for (std::size_t c = 0; c < buffer.cols; ++c)
+        {
+            if (r < 8 || r >= 8 + 240 || c < 16 || c >= 16 + 320)
+            {
+                CHECK(buffer(r, c) == marker);
+            }
+        }
+    }
+};
+
+Eigen::Matrix<float, 3, 4> make_affine_camera_matrix()
+{
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 100.0f;
+    affine_camera_matrix(1, 1) = -100.0f;
+    affine_camera_matrix(2, 2) = 1.0f;
+    affine_camera_matrix(0, 3) = 160.0f;
+    affine_camera_matrix(1, 3) = 120.0f;
+    return affine_camera_matrix;
+};
+
+} // namespace
+
+TEST_CASE("The renderers write into views like into images", "[image_view]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    const glm::tmat4x4<float> model_view =
+        glm::translate(glm::tmat4x4<float>(1.0f), glm::tvec3<float>(0.2f, -0.1f, -3.0f));
+    const glm::tmat4x4<float> projection = glm::perspective(0.8f, 4.0f / 3.0f, 0.1f, 100.0f);
+    const Eigen::Matrix<float, 3, 4> affine_camera_matrix = make_affine_camera_matrix();
+    const std::array<std::uint8_t, 4> colour_marker{1, 2, 3, 4};
+
+    SECTION("render_into")
+    {
+        core::Image4u colour_buffer;
+        core::Image1d depth_buffer;
+        const core::ImageView4u colour_view = make_padded_view(colour_buffer, colour_marker);
+        const core::ImageView1d depth_view = make_padded_view(depth_buffer, -1.0);
+        render::render_into(mesh, model_view, projection, colour_view, depth_view);
+
+        const auto expected = render::render(mesh, model_view, projection, 320, 240);
+        check_view_equals_image(colour_view, expected.first);
+        check_view_equals_image(depth_view, expected.second);
+        check_only_view_written(colour_buffer, colour_marker);
+        check_only_view_written(depth_buffer, -1.0);
+    }
+    SECTION("render_depth_into")
+    {
+        core::Image1f depth_buffer;
+        const core::ImageView1f depth_view = make_padded_view(depth_buffer, -1.0f);
+        render::render_depth_into(mesh, model_view, projection, depth_view);
+
+        check_view_equals_image(depth_view, render::render_depth(mesh, model_view, projection, 320, 240));
+        check_only_view_written(depth_buffer, -1.0f);
+    }
+    SECTION("render_affine_into")
+    {
+        core::Image4u colour_buffer;
+        core::Image1d depth_buffer;
+        const core::ImageView4u colour_view = make_padded_view(colour_buffer, colour_marker);
+        const core::ImageView1d depth_view = make_padded_view(depth_buffer, -1.0);
+        render::render_affine_into(mesh, affine_camera_matrix, colour_view, depth_view);
+
+        const auto expected = render::render_affine(mesh, affine_camera_matrix, 320, 240);
+        check_view_equals_image(colour_view, expected.first);
+        check_view_equals_image(depth_view, expected.second);
+        check_only_view_written(colour_buffer, colour_marker);
+        check_only_view_written(depth_buffer, -1.0);
+    }
+    SECTION("render_affine_depth_into")
+    {
+        core::Image1f depth_buffer;
+        const core::ImageView1f depth_view = make_padded_view(depth_buffer, -1.0f);
+        render::render_affine_depth_into(mesh, affine_camera_matrix, depth_view);
+
+        check_view_equals_image(depth_view,
+                                render::render_affine_depth(mesh, affine_camera_matrix, 320, 240));
+        check_only_view_written(depth_buffer, -1.0f);
+    }
+}
+
+TEST_CASE("extract_texture reads from a view like from an image", "[image_view]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    const Eigen::Matrix<float, 3, 4> affine_camera_matrix = make_affine_camera_matrix();
+
+    // The view refers to a region of a larger image, so its rows are padded:
+    core::Image3u larger_image(260, 400);
+    for (std::size_t r = 0; r < larger_image.rows; ++r)
+    {
+        for (std::size_t c = 0; c < larger_image.cols; ++c)
+        {
+            larger_image(r, c) = {static_cast<std::uint8_t>(c * 7), static_cast<std::uint8_t>(r * 5),
+                                  static_cast<std::uint8_t>((r + c) * 3)};
+        }
+    }
+    const core::ConstImageView3u view(&larger_image(8, 16), 240, 320, larger_image.cols);
+    const core::Image3u image(view);
+
+    for (const auto mapping_type :
+         {render::TextureInterpolation::NearestNeighbour, render::TextureInterpolation::Bilinear,
+          render::TextureInterpolation::Area})
+    {
+        CHECK(render::extract_texture(mesh, affine_camera_matrix, view, false, mapping_type, 128).data ==
+              render::extract_texture(mesh, affine_camera_matrix, image, false, mapping_type, 128).data);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/point_cache.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/video/PointCache.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace eos;
+
+namespace {
+
+std::string temp_point_cache_filename(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("eos_test_" + name + ".eospc")).string();
+};
+
+// The vertices of the mesh, moved by a different offset in every frame:
+core::VertexBuffer make_frame(const core::Mesh& mesh, int frame)
+{
+    core::VertexBuffer vertices = mesh.vertices;
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices.mutable_vertex(i) += Eigen::Vector3f(0.1f * frame, -0.05f * frame, 0.01f * i);
+    }
+    return vertices;
+};
+
+} // namespace
+
+TEST_CASE("A frame that fails to be added leaves the point cache as it was", "[point_cache]")
+{
+    const core::Mesh mesh = test::make_sphere(6, 8);
+    const std::string filename = temp_point_cache_filename("point_cache_failed_frame");
+    for (const float quantisation_step : {0.0f, 0.001f})
+    {
+        video::PointCacheOptions options;
+        options.quantisation_step = quantisation_step;
+        options.keyframe_interval = 4;
+        {
+            video::PointCacheWriter writer(filename, mesh, options, mesh.vertices);
+            for (int frame = 0; frame < 10; ++frame)
+            {
+                // A frame that can't be quantised, after the first vertices have been encoded:
+                core::VertexBuffer invalid_frame = make_frame(mesh, frame);
+                invalid_frame.mutable_vertex(10)[1] = std::numeric_limits<float>::quiet_NaN();
+                if (quantisation_step > 0.0f)
+                {
+                    CHECK_THROWS_AS(writer.add_frame(invalid_frame), std::runtime_error);
+                }
+                CHECK_THROWS_AS(writer.add_frame(core::VertexBuffer(Eigen::VectorXf(6))), std::runtime_error);
+                writer.add_frame(make_frame(mesh, frame));
+            }
+            CHECK(writer.get_num_frames() == 10);
+            writer.close();
+        }
+
+        video::PointCacheReader reader(filename);
+        REQUIRE(reader.get_num_frames() == 10);
+        CHECK(reader.get_triangle_list() == mesh.tvi());
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            const core::VertexBuffer expected = make_frame(mesh, frame);
+            const core::VertexBuffer vertices = reader.read_frame_vertices(frame);
+            const float tolerance = quantisation_step > 0.0f ? quantisation_step / 2 + 1e-5f : 0.0f;
+            CHECK((vertices.as_vector() - expected.as_vector()).cwiseAbs().maxCoeff() <= tolerance);
+        }
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("PointCacheReader rejects triangles that refer to vertices that don't exist", "[point_cache]")
+{
+    const core::Mesh mesh = test::make_sphere(6, 8);
+    const std::string filename = temp_point_cache_filename("point_cache_invalid_triangle");
+    {
+        video::PointCacheWriter writer(filename, mesh);
+        writer.add_frame(mesh.vertices);
+        writer.close();
+    }
+    REQUIRE_NOTHROW(video::PointCacheReader(filename));
+
+    // The triangle list follows the header. Make the second index of the first triangle one too large:
+    {
+        std::fstream file(filename, std::ios::binary | std::ios::in | std::ios::out);
+        const std::uint32_t index = static_cast<std::uint32_t>(mesh.vertices.size()); // little-endian machine
+        file.seekp(video::detail::point_cache_header_size + 4);
+        file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+    }
+    CHECK_THROWS_AS(video::PointCacheReader(filename), std::runtime_error);
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("PointCacheWriter rejects a mesh with triangles that refer to vertices that don't exist",
+          "[point_cache]")
+{
+    core::Mesh mesh = test::make_sphere(6, 8);
+    core::MeshTopology topology = mesh.get_topology();
+    topology.tvi[3][2] = static_cast<int>(mesh.vertices.size());
+    mesh.topology = std::make_shared<const core::MeshTopology>(std::move(topology));
+    const std::string filename = temp_point_cache_filename("point_cache_invalid_mesh");
+    CHECK_THROWS_AS(video::PointCacheWriter(filename, mesh), std::runtime_error);
+    std::remove(filename.c_str());
+}
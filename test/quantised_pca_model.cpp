@@ -0,0 +1,115 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/quantised_pca_model.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/fitting/linear_shape_fitting.hpp"
+#include "eos/morphablemodel/PcaModel.hpp"
+#include "eos/morphablemodel/QuantisedPcaModel.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+#include "Eigen/QR"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+using namespace eos;
+
+namespace {
+
+// A model with an orthonormal basis and decreasing eigenvalues, in the millimetre range of the shape
+// models.
+morphablemodel::PcaModel make_random_pca_model(int num_vertices, int num_components)
+{
+    const Eigen::MatrixXf random = Eigen::MatrixXf::Random(3 * num_vertices, num_components);
+    const Eigen::MatrixXf orthonormal_basis =
+        random.householderQr().householderQ() * Eigen::MatrixXf::Identity(3 * num_vertices, num_components);
+    const Eigen::VectorXf mean = 50.0f * Eigen::VectorXf::Random(3 * num_vertices);
+    Eigen::VectorXf eigenvalues(num_components);
+    for (int i = 0; i < num_components; ++i)
+    {
+        eigenvalues(i) = 1e4f / (i + 1);
+    }
+    return morphablemodel::PcaModel(mean, orthonormal_basis, eigenvalues, {});
+};
+
+} // namespace
+
+TEST_CASE("QuantisedPcaModel draws samples close to the float model", "[quantised_pca_model]")
+{
+    const morphablemodel::PcaModel model = make_random_pca_model(500, 20);
+    const morphablemodel::QuantisedPcaModel16 model16(model);
+    const morphablemodel::QuantisedPcaModel8 model8(model);
+
+    const auto error16 = morphablemodel::compute_quantisation_error(model16, model);
+    const auto error8 = morphablemodel::compute_quantisation_error(model8, model);
+    CHECK(error16.max_abs_error < 1e-2f);
+    CHECK(error8.max_abs_error < 1.0f);
+    CHECK(error16.max_abs_error < error8.max_abs_error);
+
+    const std::vector<float> coefficients{1.0f, -0.5f, 0.0f, 2.0f, 0.3f, -1.2f, 0.0f, 0.7f, 0.1f};
+    CHECK((model16.draw_sample(coefficients) - model.draw_sample(coefficients)).cwiseAbs().maxCoeff() <
+          1e-2f);
+    CHECK(model16.get_rescaled_pca_basis_at_point(7).isApprox(model.get_rescaled_pca_basis_at_point(7),
+                                                               1e-3f));
+}
+
+TEST_CASE("fit_shape_to_landmarks_linear gives the same coefficients for a quantised model",
+          "[quantised_pca_model]")
+{
+    const morphablemodel::PcaModel model = make_random_pca_model(500, 20);
+    const morphablemodel::QuantisedPcaModel16 model16(model);
+
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 2.0f;
+    affine_camera_matrix(0, 1) = 0.3f;
+    affine_camera_matrix(1, 1) = -2.0f;
+    affine_camera_matrix(0, 3) = 320.0f;
+    affine_camera_matrix(1, 3) = 240.0f;
+    affine_camera_matrix(2, 3) = 1.0f;
+
+    // Landmarks that are the projection of a model instance:
+    const std::vector<float> true_coefficients{1.0f, -0.5f, 0.8f, 0.2f, -1.1f};
+    const Eigen::VectorXf instance = model.draw_sample(true_coefficients);
+    std::vector<int> vertex_ids;
+    std::vector<Eigen::Vector2f> landmarks;
+    for (int vertex_id = 0; vertex_id < 500; vertex_id += 7)
+    {
+        const Eigen::Vector4f point(instance(3 * vertex_id), instance(3 * vertex_id + 1),
+                                    instance(3 * vertex_id + 2), 1.0f);
+        vertex_ids.push_back(vertex_id);
+        landmarks.push_back((affine_camera_matrix * point).head<2>());
+    }
+
+    const std::vector<float> coefficients =
+        fitting::fit_shape_to_landmarks_linear(model, affine_camera_matrix, landmarks, vertex_ids);
+    const std::vector<float> coefficients16 =
+        fitting::fit_shape_to_landmarks_linear(model16, affine_camera_matrix, landmarks, vertex_ids);
+
+    REQUIRE(coefficients16.size() == coefficients.size());
+    for (std::size_t i = 0; i < coefficients.size(); ++i)
+    {
+        CHECK(coefficients16[i] == Approx(coefficients[i]).margin(1e-3));
+    }
+    for (std::size_t i = 0; i < true_coefficients.size(); ++i)
+    {
+        CHECK(coefficients[i] == Approx(true_coefficients[i]).margin(0.05));
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/read_obj.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/read_obj.hpp"
+
+#include "synthetic_mesh.hpp"
+#include "synthetic_obj.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+using namespace eos;
+
+namespace {
+
+std::string temp_obj_filename(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("eos_test_" + name + ".obj")).string();
+};
+
+void write_text_file(const std::string& filename, const std::string& contents)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file << contents;
+};
+
+} // namespace
+
+TEST_CASE("read_obj reads the same mesh as the old obj reader", "[read_obj]")
+{
+    const std::string filename = temp_obj_filename("read_obj_reference");
+    test::write_synthetic_obj(test::make_sphere(40, 50), filename);
+    const test::ReferenceObj reference = test::read_obj_reference(filename);
+    REQUIRE(reference.vertices.size() == 2000);
+
+    for (const int num_threads : {1, 3, 8})
+    {
+        const core::Mesh mesh = core::read_obj(filename, num_threads);
+        REQUIRE(mesh.vertices.size() == reference.vertices.size());
+        REQUIRE(mesh.colors.size() == reference.colors.size());
+        REQUIRE(mesh.texcoords().size() == reference.texcoords.size());
+        REQUIRE(mesh.tvi().size() == reference.tvi.size());
+        for (std::size_t i = 0; i < reference.vertices.size(); ++i)
+        {
+            CHECK(Eigen::Vector3f(mesh.vertices[i]) == reference.vertices[i]);
+            CHECK(Eigen::Vector3f(mesh.colors[i]) == reference.colors[i]);
+        }
+        // The old reader didn't flip the texture coordinates to the top-left origin of the mesh:
+        for (std::size_t i = 0; i < reference.texcoords.size(); ++i)
+        {
+            CHECK(mesh.texcoords()[i] ==
+                  Eigen::Vector2f(reference.texcoords[i][0], 1.0f - reference.texcoords[i][1]));
+        }
+        CHECK(mesh.tvi() == reference.tvi);
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("read_obj resolves relative indices across chunks", "[read_obj]")
+{
+    const std::string filename = temp_obj_filename("read_obj_relative");
+    std::string contents;
+    for (int i = 0; i < 100; ++i)
+    {
+        contents += "v " + std::to_string(i) + " 0 0\n";
+        if (i >= 2)
+        {
+            contents += "f -3 -2 -1\n";
+        }
+    }
+    write_text_file(filename, contents);
+
+    const core::Mesh single_threaded = core::read_obj(filename, 1);
+    REQUIRE(single_threaded.tvi().size() == 98);
+    CHECK(single_threaded.tvi()[97] == std::array<int, 3>{97, 98, 99});
+    CHECK(core::read_obj(filename, 7).tvi() == single_threaded.tvi());
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("read_obj rejects faces with vertex indices that are out of range", "[read_obj]")
+{
+    const std::string vertices = "v 0 0 0\nv 1 0 0\nv 0 1 0\n";
+    // Padding, so that with several threads, the faces end up in a different chunk than the vertices:
+    const std::string padding = std::string(200, '#') + "\n";
+    const auto faces = {"f 1 2 4\n",  "f 1 2 3 4\n", "f 0 1 2\n", "f -4 -2 -1\n", "f 1 2 -4\n",
+                        "f 1 2 2147483648\n", "f 1 2 99999999999999999999\n", "f 1 2 -2147483648\n"};
+    const std::string filename = temp_obj_filename("read_obj_invalid");
+    for (const std::string face : faces)
+    {
+        write_text_file(filename, vertices + padding + face);
+        for (const int num_threads : {1, 4})
+        {
+            INFO(face << " with " << num_threads << " threads");
+            CHECK_THROWS_AS(core::read_obj(filename, num_threads), std::runtime_error);
+        }
+    }
+    // A face before the vertices it refers to is fine, as long as they're in the file:
+    write_text_file(filename, "f 1 2 3\n" + padding + vertices);
+    CHECK(core::read_obj(filename, 4).tvi().size() == 1);
+    std::remove(filename.c_str());
+}
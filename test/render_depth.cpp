@@ -0,0 +1,94 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/render_depth.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/render/render.hpp"
+#include "eos/render/render_affine.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <limits>
+
+using namespace eos;
+
+namespace {
+
+// The depth that render_depth(...) should give for a pixel with the given depth in render(...).
+// Uncovered pixels are std::numeric_limits<double>::max() in render(...), which doesn't fit a float.
+float expected_depth(double depth)
+{
+    return depth == std::numeric_limits<double>::max() ? std::numeric_limits<float>::max()
+                                                       : static_cast<float>(depth);
+};
+
+} // namespace
+
+TEST_CASE("render_depth gives the depth buffer of render", "[render_depth]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    const glm::tmat4x4<float> model_view =
+        glm::translate(glm::tmat4x4<float>(1.0f), glm::tvec3<float>(0.2f, -0.1f, -3.0f));
+    const glm::tmat4x4<float> projection = glm::perspective(0.8f, 4.0f / 3.0f, 0.1f, 100.0f);
+
+    const auto colour_and_depth = render::render(mesh, model_view, projection, 320, 240);
+    const core::Image1f depth = render::render_depth(mesh, model_view, projection, 320, 240);
+
+    REQUIRE(depth.rows == 240);
+    REQUIRE(depth.cols == 320);
+    int covered = 0;
+    for (std::size_t r = 0; r < depth.rows; ++r)
+    {
+        for (std::size_t c = 0; c < depth.cols; ++c)
+        {
+            CHECK(depth(r, c) == expected_depth(colour_and_depth.second(r, c)));
+            covered += colour_and_depth.first(r, c)[3] == 255;
+        }
+    }
+    CHECK(covered > 0);
+}
+
+TEST_CASE("render_affine_depth gives the depth buffer of render_affine", "[render_depth]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 100.0f;
+    affine_camera_matrix(1, 1) = -100.0f;
+    affine_camera_matrix(2, 2) = 1.0f;
+    affine_camera_matrix(0, 3) = 160.0f;
+    affine_camera_matrix(1, 3) = 120.0f;
+
+    const auto colour_and_depth = render::render_affine(mesh, affine_camera_matrix, 320, 240);
+    const core::Image1f depth = render::render_affine_depth(mesh, affine_camera_matrix, 320, 240);
+
+    for (std::size_t r = 0; r < depth.rows; ++r)
+    {
+        for (std::size_t c = 0; c < depth.cols; ++c)
+        {
+            CHECK(depth(r, c) == expected_depth(colour_and_depth.second(r, c)));
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/synthetic_mesh.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_TEST_SYNTHETIC_MESH_HPP_
+#define EOS_TEST_SYNTHETIC_MESH_HPP_
+
+#include "eos/core/Mesh.hpp"
+#include "eos/core/MeshTopology.hpp"
+
+#include "Eigen/Core"
+
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace eos {
+namespace test {
+
+/**
+ * Creates a sphere around the origin, with vertex colours and texture coordinates, to test and
+ * benchmark with meshes of the size of the models, without needing the model files.
+ *
+ * The vertices are arranged in \p rings rings of \p segments vertices each. The poles are left
+ * open. The triangles are counter-clockwise when seen from the outside.
+ *
+ * @param[in] rings Number of rings, at least 2.
+ * @param[in] segments Number of vertices per ring, at least 3.
+ * @param[in] radius Radius of the sphere.
+ * @return The sphere mesh, with rings * segments vertices.
+ */
+inline core::Mesh make_sphere(int rings, int segments, float radius = 1.0f)
+{
+    const float pi = 3.14159265358979f;
+    core::MeshTopology topology;
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<Eigen::Vector3f> colors;
+    for (int r = 0; r < rings; ++r)
+    {
+        const float theta = pi * (r + 0.5f) / rings;
+        for (int s = 0; s < segments; ++s)
+        {
+            const float phi = 2.0f * pi * s / segments;
+            const Eigen::Vector3f direction(std::sin(theta) * std::cos(phi), std::cos(theta),
+                                            std::sin(theta) * std::sin(phi));
+            vertices.push_back(radius * direction);
+            colors.push_back(0.5f * (direction + Eigen::Vector3f::Ones()));
+            topology.texcoords.emplace_back(static_cast<float>(s) / segments,
+                                            static_cast<float>(r) / (rings - 1));
+        }
+    }
+    for (int r = 0; r + 1 < rings; ++r)
+    {
+        for (int s = 0; s < segments; ++s)
+        {
+            const int a = r * segments + s;
+            const int b = r * segments + (s + 1) % segments;
+            const int c = a + segments;
+            const int d = b + segments;
+            topology.tvi.push_back({a, b, c});
+            topology.tvi.push_back({b, d, c});
+        }
+    }
+    topology.tci = topology.tvi;
+
+    core::Mesh mesh;
+    mesh.vertices = vertices;
+    mesh.colors = colors;
+    mesh.topology = std::make_shared<const core::MeshTopology>(std::move(topology));
+    return mesh;
+};
+
+/**
+ * A sphere with about as many vertices as the Surrey Face Model (3448 vertices).
+ */
+inline core::Mesh make_sfm_sized_sphere()
+{
+    return make_sphere(43, 80); // 3440 vertices
+};
+
+/**
+ * A sphere with about as many vertices as the Basel Face Model (53490 vertices).
+ */
+inline core::Mesh make_bfm_sized_sphere()
+{
+    return make_sphere(185, 289); // 53465 vertices
+};
+
+} /* namespace test */
+} /* namespace eos */
+
+#endif /* EOS_TEST_SYNTHETIC_MESH_HPP_ */
@@ -0,0 +1,181 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/synthetic_obj.hpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#ifndef EOS_TEST_SYNTHETIC_OBJ_HPP_
+#define EOS_TEST_SYNTHETIC_OBJ_HPP_
+
+#include "eos/core/Mesh.hpp"
+
+#include "Eigen/Core"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace eos {
+namespace test {
+
+/**
+ * Writes a mesh to an obj file in the v/vt/vn form of the FaceWarehouse scans, the only one that
+ * read_obj_reference(...) understands. Every vertex has a colour and texture coordinates, and the
+ * pairs of triangles (a, b, c), (b, d, c) of the sphere of make_sphere(...) in every other ring
+ * are written as a quad (a, b, d, c), so that the file has both triangles and quads.
+ *
+ * @param[in] mesh A mesh with colours, e.g. from make_sphere(...).
+ * @param[in] filename The file to write.
+ */
+inline void write_synthetic_obj(const core::Mesh& mesh, const std::string& filename)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error("Error creating given file: " + filename);
+    }
+    char line[256];
+    file << "# Synthetic obj file\n";
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const Eigen::Vector3f v = mesh.vertices[i];
+        const Eigen::Vector3f c = mesh.colors[i];
+        std::snprintf(line, sizeof(line), "v %.9g %.9g %.9g %.9g %.9g %.9g\n", v[0], v[1], v[2], c[0], c[1],
+                      c[2]);
+        file << line;
+    }
+    for (const auto& tc : mesh.texcoords())
+    {
+        std::snprintf(line, sizeof(line), "vt %.9g %.9g\n", tc[0], tc[1]);
+        file << line;
+    }
+    file << "vn 0 0 1\n";
+    const auto& tvi = mesh.tvi();
+    for (std::size_t i = 0; i < tvi.size(); ++i)
+    {
+        const auto& t = tvi[i];
+        if (i % 4 == 0 && i + 1 < tvi.size())
+        {
+            const int d = tvi[i + 1][1];
+            file << "f " << t[0] + 1 << '/' << t[0] + 1 << "/1 " << t[1] + 1 << '/' << t[1] + 1 << "/1 "
+                 << d + 1 << '/' << d + 1 << "/1 " << t[2] + 1 << '/' << t[2] + 1 << "/1\n";
+            ++i;
+        } else
+        {
+            file << "f " << t[0] + 1 << '/' << t[0] + 1 << "/1 " << t[1] + 1 << '/' << t[1] + 1 << "/1 "
+                 << t[2] + 1 << '/' << t[2] + 1 << "/1\n";
+        }
+    }
+};
+
+/**
+ * The data that read_obj_reference(...) reads.
+ */
+struct ReferenceObj
+{
+    std::vector<Eigen::Vector3f> vertices;
+    std::vector<Eigen::Vector3f> colors;
+    std::vector<Eigen::Vector2f> texcoords;
+    std::vector<std::array<int, 3>> tvi;
+};
+
+namespace detail {
+
+// From: https://stackoverflow.com/a/1493195/1345959
+inline std::vector<std::string> tokenize(const std::string& str, const std::string& delimiters)
+{
+    std::vector<std::string> tokens;
+    std::string::size_type pos, last_pos = 0;
+    const auto length = str.length();
+    while (last_pos < length + 1)
+    {
+        pos = str.find_first_of(delimiters, last_pos);
+        if (pos == std::string::npos)
+        {
+            pos = length;
+        }
+        tokens.push_back(str.substr(last_pos, pos - last_pos));
+        last_pos = pos + 1;
+    }
+    return tokens;
+};
+
+} /* namespace detail */
+
+/**
+ * The obj reader that eos had before read_obj(...) parsed the file in place, to compare against.
+ *
+ * It reads the file line by line with std::getline, and splits the lines into std::strings. It
+ * only understands faces with three or four corners in the v/vt/vn form.
+ *
+ * @param[in] filename The obj file to read.
+ * @return The data in the file.
+ */
+inline ReferenceObj read_obj_reference(const std::string& filename)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        throw std::runtime_error(std::string("Could not open obj file: " + filename));
+    }
+    const auto starts_with = [](const std::string& input, const std::string& match) {
+        return input.size() >= match.size() && std::equal(match.begin(), match.end(), input.begin());
+    };
+    ReferenceObj obj;
+    std::string line;
+    while (getline(file, line))
+    {
+        if (starts_with(line, "v "))
+        {
+            const auto tokens = detail::tokenize(line.substr(2), " ");
+            obj.vertices.emplace_back(std::stof(tokens[0]), std::stof(tokens[1]), std::stof(tokens[2]));
+            if (tokens.size() == 6)
+            {
+                obj.colors.emplace_back(std::stof(tokens[3]), std::stof(tokens[4]), std::stof(tokens[5]));
+            }
+        }
+        if (starts_with(line, "vt "))
+        {
+            const auto tokens = detail::tokenize(line.substr(3), " ");
+            obj.texcoords.emplace_back(std::stof(tokens[0]), std::stof(tokens[1]));
+        }
+        if (starts_with(line, "f "))
+        {
+            std::vector<int> vertex_indices;
+            for (const auto& token : detail::tokenize(line.substr(2), " "))
+            {
+                vertex_indices.push_back(std::stoi(detail::tokenize(token, "/")[0]) - 1);
+            }
+            obj.tvi.push_back({vertex_indices[0], vertex_indices[1], vertex_indices[2]});
+            if (vertex_indices.size() == 4)
+            {
+                obj.tvi.push_back({vertex_indices[0], vertex_indices[2], vertex_indices[3]});
+            }
+        }
+    }
+    return obj;
+};
+
+} /* namespace test */
+} /* namespace eos */
+
+#endif /* EOS_TEST_SYNTHETIC_OBJ_HPP_ */
@@ -0,0 +1,76 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/texture_extraction.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Image.hpp"
+#include "eos/render/texture_extraction.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace eos;
+
+TEST_CASE("extract_texture gives the same isomap every time", "[texture_extraction]")
+{
+    // The triangles are extracted in parallel. Pixels on an edge shared by two triangles must not depend
+    // on which of them is extracted first:
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    core::Image3u image(480, 640);
+    for (int r = 0; r < 480; ++r)
+    {
+        for (int c = 0; c < 640; ++c)
+        {
+            image(r, c) = {static_cast<std::uint8_t>(c * 7), static_cast<std::uint8_t>(r * 5),
+                           static_cast<std::uint8_t>((r + c) * 3)};
+        }
+    }
+    Eigen::Matrix<float, 3, 4> affine_camera_matrix = Eigen::Matrix<float, 3, 4>::Zero();
+    affine_camera_matrix(0, 0) = 200.0f;
+    affine_camera_matrix(1, 1) = -200.0f;
+    affine_camera_matrix(2, 2) = 1.0f;
+    affine_camera_matrix(0, 3) = 320.0f;
+    affine_camera_matrix(1, 3) = 240.0f;
+
+    for (const auto mapping_type :
+         {render::TextureInterpolation::NearestNeighbour, render::TextureInterpolation::Bilinear,
+          render::TextureInterpolation::Area})
+    {
+        const core::Image4u isomap =
+            render::extract_texture(mesh, affine_camera_matrix, image, false, mapping_type, 256);
+        std::size_t visible = 0;
+        for (std::size_t r = 0; r < isomap.rows; ++r)
+        {
+            for (std::size_t c = 0; c < isomap.cols; ++c)
+            {
+                visible += isomap(r, c)[3] > 0;
+            }
+        }
+        CHECK(visible > isomap.rows * isomap.cols / 4);
+        for (int i = 0; i < 5; ++i)
+        {
+            CHECK(render::extract_texture(mesh, affine_camera_matrix, image, false, mapping_type, 256).data ==
+                  isomap.data);
+        }
+    }
+}
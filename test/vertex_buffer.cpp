@@ -0,0 +1,99 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/vertex_buffer.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/VertexBuffer.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace eos;
+
+namespace {
+
+core::VertexBuffer make_buffer()
+{
+    return core::VertexBuffer(std::vector<Eigen::Vector3f>{Eigen::Vector3f(1.0f, 2.0f, 3.0f),
+                                                           Eigen::Vector3f(4.0f, 5.0f, 6.0f),
+                                                           Eigen::Vector3f(7.0f, 8.0f, 9.0f)});
+};
+
+} // namespace
+
+TEST_CASE("Reading a vertex from a VertexBuffer gives a copy", "[vertex_buffer]")
+{
+    // Assigning to buffer[i] would change a temporary, so it mustn't compile:
+    using Element = decltype(std::declval<core::VertexBuffer&>()[0]);
+    static_assert(std::is_same<Element, const Eigen::Vector3f>::value,
+                  "VertexBuffer::operator[] should return a const copy of the vertex");
+
+    core::VertexBuffer buffer = make_buffer();
+    auto vertex = buffer[1];
+    vertex += Eigen::Vector3f(10.0f, 10.0f, 10.0f);
+    CHECK(vertex == Eigen::Vector3f(14.0f, 15.0f, 16.0f));
+    CHECK(buffer[1] == Eigen::Vector3f(4.0f, 5.0f, 6.0f));
+
+    for (auto v : buffer)
+    {
+        v.setZero();
+    }
+    CHECK(buffer.to_vector() == make_buffer().to_vector());
+}
+
+TEST_CASE("A read, modified and written back vertex changes only that vertex", "[vertex_buffer]")
+{
+    core::VertexBuffer buffer = make_buffer();
+    Eigen::Vector3f vertex = buffer[1];
+    vertex.x() = -vertex.x();
+    buffer.set(1, vertex);
+    CHECK(buffer[0] == Eigen::Vector3f(1.0f, 2.0f, 3.0f));
+    CHECK(buffer[1] == Eigen::Vector3f(-4.0f, 5.0f, 6.0f));
+    CHECK(buffer[2] == Eigen::Vector3f(7.0f, 8.0f, 9.0f));
+    CHECK(buffer.as_vector()(3) == -4.0f);
+}
+
+TEST_CASE("Writing through mutable_vertex and as_matrix changes the buffer", "[vertex_buffer]")
+{
+    core::VertexBuffer buffer = make_buffer();
+    buffer.mutable_vertex(0) += Eigen::Vector3f(1.0f, 1.0f, 1.0f);
+    auto view = buffer.mutable_vertex(2);
+    view[2] = 0.0f;
+    CHECK(buffer[0] == Eigen::Vector3f(2.0f, 3.0f, 4.0f));
+    CHECK(buffer[2] == Eigen::Vector3f(7.0f, 8.0f, 0.0f));
+
+    buffer.as_matrix().col(1) *= 2.0f;
+    CHECK(buffer[1] == Eigen::Vector3f(8.0f, 10.0f, 12.0f));
+}
+
+TEST_CASE("Iterating over a VertexBuffer visits the vertices in order", "[vertex_buffer]")
+{
+    const core::VertexBuffer buffer = make_buffer();
+    std::vector<Eigen::Vector3f> visited;
+    for (const auto& vertex : buffer)
+    {
+        visited.push_back(vertex);
+    }
+    CHECK(visited == buffer.to_vector());
+    CHECK(visited.size() == 3);
+    CHECK(visited[2] == Eigen::Vector3f(7.0f, 8.0f, 9.0f));
+}
@@ -0,0 +1,69 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/vertex_processing.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/render/detail/vertex_processing.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <cstdint>
+
+using namespace eos;
+
+TEST_CASE("transform_vertices gives the same result as transforming each vertex", "[vertex_processing]")
+{
+    const core::Mesh mesh = test::make_sfm_sized_sphere();
+    Eigen::Matrix4f transform = Eigen::Matrix4f::Random();
+    transform.row(3) << 0.1f, 0.2f, 0.3f, 1.0f;
+
+    const Eigen::Matrix<float, 4, Eigen::Dynamic> transformed =
+        render::detail::transform_vertices(mesh.vertices.as_matrix(), transform);
+
+    REQUIRE(transformed.cols() == static_cast<Eigen::Index>(mesh.vertices.size()));
+    for (std::size_t i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const Eigen::Vector4f vertex(mesh.vertices[i][0], mesh.vertices[i][1], mesh.vertices[i][2], 1.0f);
+        const Eigen::Vector4f expected = transform * vertex;
+        CHECK(transformed.col(i).isApprox(expected, 1e-5f));
+    }
+}
+
+TEST_CASE("compute_outcodes sets one bit per frustum plane", "[vertex_processing]")
+{
+    Eigen::Matrix<float, 4, Eigen::Dynamic> clipspace(4, 8);
+    clipspace.col(0) << 0.0f, 0.0f, 0.0f, 1.0f;  // inside
+    clipspace.col(1) << -2.0f, 0.0f, 0.0f, 1.0f; // left
+    clipspace.col(2) << 2.0f, 0.0f, 0.0f, 1.0f;  // right
+    clipspace.col(3) << 0.0f, -2.0f, 0.0f, 1.0f; // bottom
+    clipspace.col(4) << 0.0f, 2.0f, 0.0f, 1.0f;  // top
+    clipspace.col(5) << 0.0f, 0.0f, -2.0f, 1.0f; // near
+    clipspace.col(6) << 0.0f, 0.0f, 2.0f, 1.0f;  // far
+    clipspace.col(7) << 1.0f, -1.0f, 1.0f, 1.0f; // on the planes counts as inside
+
+    const std::vector<std::uint8_t> outcodes = render::detail::compute_outcodes(clipspace, true, true);
+    CHECK(outcodes == std::vector<std::uint8_t>{0, 1, 2, 4, 8, 16, 32, 0});
+
+    const std::vector<std::uint8_t> without_near_and_far =
+        render::detail::compute_outcodes(clipspace, false, false);
+    CHECK(without_near_and_far == std::vector<std::uint8_t>{0, 1, 2, 4, 8, 0, 0, 0});
+}
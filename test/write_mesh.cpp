@@ -0,0 +1,163 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: test/write_mesh.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/core/Mesh.hpp"
+#include "eos/core/read_obj.hpp"
+#include "eos/core/write_mesh.hpp"
+#include "eos/core/detail/BufferedWriter.hpp"
+
+#include "synthetic_mesh.hpp"
+
+#include "catch2/catch.hpp"
+
+#include "Eigen/Core"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+using namespace eos;
+
+namespace {
+
+std::string temp_filename(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("eos_test_" + name)).string();
+};
+
+std::string read_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+};
+
+float read_float32(const std::string& data, std::size_t offset)
+{
+    float value;
+    std::memcpy(&value, data.data() + offset, sizeof(value)); // The tests run on little-endian machines.
+    return value;
+};
+
+std::uint32_t read_uint32(const std::string& data, std::size_t offset)
+{
+    std::uint32_t value;
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+};
+
+} // namespace
+
+TEST_CASE("write_obj and read_obj give back the mesh", "[write_mesh]")
+{
+    const core::Mesh mesh = test::make_sphere(10, 12);
+    const std::string filename = temp_filename("write_obj.obj");
+    core::write_obj(mesh, filename);
+    const core::Mesh read_mesh = core::read_obj(filename);
+
+    REQUIRE(read_mesh.vertices.size() == mesh.vertices.size());
+    CHECK(read_mesh.vertices.as_vector() == mesh.vertices.as_vector());
+    CHECK(read_mesh.colors.as_vector() == mesh.colors.as_vector());
+    CHECK(read_mesh.tvi() == mesh.tvi());
+    REQUIRE(read_mesh.texcoords().size() == mesh.texcoords().size());
+    for (std::size_t i = 0; i < mesh.texcoords().size(); ++i)
+    {
+        // The v coordinate is flipped twice, which can round:
+        CHECK(read_mesh.texcoords()[i][0] == mesh.texcoords()[i][0]);
+        CHECK(read_mesh.texcoords()[i][1] == Approx(mesh.texcoords()[i][1]).margin(1e-6));
+    }
+    std::remove(filename.c_str());
+}
+
+TEST_CASE("write_obj, write_textured_obj and write_ply store v with a bottom-left origin, write_glb with a "
+          "top-left one",
+          "[write_mesh]")
+{
+    const core::Mesh mesh = test::make_sphere(10, 12);
+    const Eigen::Vector2f texcoord = mesh.texcoords()[20];
+    REQUIRE(texcoord[1] != 0.5f);
+
+    const auto vt_line = [](const std::string& obj) {
+        std::size_t line_start = obj.find("\nvt ");
+        for (int i = 0; i < 20; ++i)
+        {
+            line_start = obj.find("\nvt ", line_start + 1);
+        }
+        return obj.substr(line_start + 4, obj.find('\n', line_start + 1) - line_start - 4);
+    };
+    float u, v;
+    const std::string obj_filename = temp_filename("write_mesh_uv.obj");
+    core::write_obj(mesh, obj_filename);
+    REQUIRE(std::sscanf(vt_line(read_file(obj_filename)).c_str(), "%f %f", &u, &v) == 2);
+    CHECK(u == texcoord[0]);
+    CHECK(v == 1.0f - texcoord[1]);
+    core::write_textured_obj(mesh, obj_filename);
+    REQUIRE(std::sscanf(vt_line(read_file(obj_filename)).c_str(), "%f %f", &u, &v) == 2);
+    CHECK(u == texcoord[0]);
+    CHECK(v == 1.0f - texcoord[1]);
+    std::remove(obj_filename.c_str());
+    std::remove((obj_filename.substr(0, obj_filename.size() - 4) + ".mtl").c_str());
+
+    // A ply vertex is x, y, z (float), r, g, b (uchar), s, t (float):
+    const std::string ply_filename = temp_filename("write_mesh_uv.ply");
+    core::write_ply(mesh, ply_filename);
+    const std::string ply = read_file(ply_filename);
+    const std::size_t ply_vertex = ply.find("end_header\n") + 11 + 20 * (3 * 4 + 3 + 2 * 4);
+    CHECK(read_float32(ply, ply_vertex) == mesh.vertices[20][0]);
+    CHECK(read_float32(ply, ply_vertex + 15) == texcoord[0]);
+    CHECK(read_float32(ply, ply_vertex + 19) == 1.0f - texcoord[1]);
+    std::remove(ply_filename.c_str());
+
+    // The binary chunk of a glb starts after the header and the JSON chunk, and has the positions,
+    // colours and texture coordinates one after the other:
+    const std::string glb_filename = temp_filename("write_mesh_uv.glb");
+    core::write_glb(mesh, glb_filename);
+    const std::string glb = read_file(glb_filename);
+    const std::size_t binary_chunk = 12 + 8 + read_uint32(glb, 12) + 8;
+    const std::size_t glb_texcoord = binary_chunk + 2 * mesh.vertices.size() * 12 + 20 * 8;
+    CHECK(read_float32(glb, glb_texcoord) == texcoord[0]);
+    CHECK(read_float32(glb, glb_texcoord + 4) == texcoord[1]);
+    std::remove(glb_filename.c_str());
+}
+
+TEST_CASE("BufferedWriter works with a buffer smaller than a formatted number", "[write_mesh]")
+{
+    const std::string filename = temp_filename("buffered_writer.txt");
+    std::string expected;
+    {
+        core::detail::BufferedWriter writer(filename, 1);
+        for (int i = 0; i < 100; ++i)
+        {
+            writer.write_int(-1234567890123456789 + i);
+            writer.write(' ');
+            writer.write_float(-1.2345678e-20f * i);
+            writer.write('\n');
+            char number[core::detail::max_formatted_float_length];
+            expected += std::to_string(-1234567890123456789 + i) + " " +
+                        std::string(number, core::detail::format_float(number, -1.2345678e-20f * i)) + "\n";
+        }
+        writer.close();
+    }
+    CHECK(read_file(filename) == expected);
+    std::remove(filename.c_str());
+}
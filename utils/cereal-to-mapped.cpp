@@ -0,0 +1,82 @@
+/*
+ * eos - A 3D Morphable Model fitting library written in modern C++11/14.
+ *
+ * File: utils/cereal-to-mapped.cpp
+ *
+ * Copyright 2017 Patrik Huber
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "eos/morphablemodel/Blendshape.hpp"
+#include "eos/morphablemodel/MorphableModel.hpp"
+#include "eos/morphablemodel/io/mapped_model.hpp"
+
+#include "boost/program_options.hpp"
+
+#include <iostream>
+#include <vector>
+
+using namespace eos;
+namespace po = boost::program_options;
+using std::cout;
+using std::endl;
+
+/**
+ * Reads a Morphable Model in cereal binary format (.bin), and optionally a file with
+ * blendshapes, and converts them to a mapped model file, which can be loaded with
+ * morphablemodel::load_mapped_model(...) without deserialising the model.
+ */
+int main(int argc, char* argv[])
+{
+    std::string modelfile, blendshapesfile, outputfile;
+    try
+    {
+        po::options_description desc("Allowed options");
+        // clang-format off
+        desc.add_options()
+            ("help,h", "display the help message")
+            ("model,m", po::value<std::string>(&modelfile)->required(),
+                "a Morphable Model stored as cereal BinaryArchive")
+            ("blendshapes,b", po::value<std::string>(&blendshapesfile),
+                "optional file with blendshapes, stored as cereal BinaryArchive")
+            ("output,o", po::value<std::string>(&outputfile)->required()->default_value("converted_model.eosm"),
+                "output filename for the mapped model file");
+        // clang-format on
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).run(), vm);
+        if (vm.count("help"))
+        {
+            cout << "Usage: cereal-to-mapped [options]" << endl;
+            cout << desc;
+            return EXIT_SUCCESS;
+        }
+        po::notify(vm);
+    } catch (const po::error& e)
+    {
+        cout << "Error while parsing command-line arguments: " << e.what() << endl;
+        cout << "Use --help to display a list of options." << endl;
+        return EXIT_FAILURE;
+    }
+
+    const morphablemodel::MorphableModel morphable_model = morphablemodel::load_model(modelfile);
+    std::vector<morphablemodel::Blendshape> blendshapes;
+    if (!blendshapesfile.empty())
+    {
+        blendshapes = morphablemodel::load_blendshapes(blendshapesfile);
+    }
+
+    morphablemodel::save_mapped_model(morphable_model, outputfile, blendshapes);
+
+    cout << "Saved converted model as " << outputfile << "." << endl;
+    return EXIT_SUCCESS;
+}